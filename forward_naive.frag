@@ -0,0 +1,76 @@
+#version 440
+
+// forward lighting without lists, every fragment sums every light. the
+// baseline lightbench measures forward_plus.frag against
+
+in vec3 col;
+in vec3 normal;
+in vec2 uv;
+in vec3 world;
+in vec4 clip;
+in float depth;
+
+out vec4 frag_col;
+
+struct point_light
+{
+    vec4 position;
+    vec4 colour;
+};
+
+layout(std430, binding = 8) readonly buffer lights
+{
+    point_light light[];
+};
+
+// one atlas for every object, white until it is resident
+layout(binding = 0) uniform sampler2D albedo;
+
+// cascades of the sun, see shadows.h
+layout(std140, binding = 1) uniform shadows
+{
+    mat4 cascade[4];
+    vec4 split;
+    vec4 texel;
+    vec4 sun;
+} shadow;
+
+layout(binding = 3) uniform sampler2DArrayShadow shadow_map;
+
+layout(location = 0) uniform uint light_count;
+
+// 0 in the shadow of the sun, 1 in its light, filtered 2x2 by the sampler
+float sun_visibility(vec3 world, vec3 n, float depth)
+{
+    int c = 0;
+    int count = int(shadow.sun.w);
+    while (c < count && depth > shadow.split[c])
+        ++c;
+    if (c >= count)
+        return 1.0;
+
+    // out along the normal by about a texel, against acne on sloped faces
+    vec3 offset = n * shadow.texel[c] * 1.5;
+    vec4 p = shadow.cascade[c] * vec4(world + offset, 1.0);
+    return texture(shadow_map, vec4(p.xy, float(c), p.z));
+}
+
+void main()
+{
+    vec3 n = normalize(normal);
+    float sun = max(dot(n, shadow.sun.xyz), 0.0);
+    if (sun > 0.0)
+        sun *= sun_visibility(world, n, depth);
+    vec3 total = vec3(0.15 + 0.35 * sun);
+    for (uint i = 0u; i < light_count; ++i) {
+        point_light l = light[i];
+        vec3 to_light = l.position.xyz - world;
+        float distance2 = max(dot(to_light, to_light), 1e-6);
+        float r = l.position.w;
+        float falloff = max(1.0 - distance2 / (r * r), 0.0);
+        float diffuse = max(dot(n, to_light * inversesqrt(distance2)), 0.0);
+        total += l.colour.rgb * falloff * falloff * diffuse;
+    }
+    vec3 base = col * texture(albedo, uv).rgb;
+    frag_col = vec4(base * total, 1.0);
+}
@@ -0,0 +1,94 @@
+#version 440
+
+// clustered forward lighting, every fragment finds its froxel and sums
+// only the lights clusters_assign listed for it
+
+in vec3 col;
+in vec3 normal;
+in vec2 uv;
+in vec3 world;
+in vec4 clip;
+in float depth;
+
+out vec4 frag_col;
+
+struct point_light
+{
+    vec4 position;
+    vec4 colour;
+};
+
+layout(std430, binding = 8) readonly buffer lights
+{
+    point_light light[];
+};
+
+layout(std430, binding = 10) readonly buffer clusters
+{
+    uvec4 size;
+    vec4 slice;
+    uvec2 range[];
+};
+
+layout(std430, binding = 11) readonly buffer cluster_indices
+{
+    uint light_index[];
+};
+
+// one atlas for every object, white until it is resident
+layout(binding = 0) uniform sampler2D albedo;
+
+// cascades of the sun, see shadows.h
+layout(std140, binding = 1) uniform shadows
+{
+    mat4 cascade[4];
+    vec4 split;
+    vec4 texel;
+    vec4 sun;
+} shadow;
+
+layout(binding = 3) uniform sampler2DArrayShadow shadow_map;
+
+// 0 in the shadow of the sun, 1 in its light, filtered 2x2 by the sampler
+float sun_visibility(vec3 world, vec3 n, float depth)
+{
+    int c = 0;
+    int count = int(shadow.sun.w);
+    while (c < count && depth > shadow.split[c])
+        ++c;
+    if (c >= count)
+        return 1.0;
+
+    // out along the normal by about a texel, against acne on sloped faces
+    vec3 offset = n * shadow.texel[c] * 1.5;
+    vec4 p = shadow.cascade[c] * vec4(world + offset, 1.0);
+    return texture(shadow_map, vec4(p.xy, float(c), p.z));
+}
+
+void main()
+{
+    vec2 ndc = clip.xy / clip.w;
+    uvec3 cell;
+    cell.xy = uvec2(clamp(ivec2((ndc * 0.5 + 0.5) * vec2(size.xy)),
+                          ivec2(0), ivec2(size.xy) - 1));
+    cell.z = uint(clamp(int(log(max(depth, 1e-6)) * slice.x + slice.y), 0,
+                        int(size.z) - 1));
+    uvec2 lights_in = range[(cell.z * size.y + cell.y) * size.x + cell.x];
+
+    vec3 n = normalize(normal);
+    float sun = max(dot(n, shadow.sun.xyz), 0.0);
+    if (sun > 0.0)
+        sun *= sun_visibility(world, n, depth);
+    vec3 total = vec3(0.15 + 0.35 * sun);
+    for (uint i = 0u; i < lights_in.y; ++i) {
+        point_light l = light[light_index[lights_in.x + i]];
+        vec3 to_light = l.position.xyz - world;
+        float distance2 = max(dot(to_light, to_light), 1e-6);
+        float r = l.position.w;
+        float falloff = max(1.0 - distance2 / (r * r), 0.0);
+        float diffuse = max(dot(n, to_light * inversesqrt(distance2)), 0.0);
+        total += l.colour.rgb * falloff * falloff * diffuse;
+    }
+    vec3 base = col * texture(albedo, uv).rgb;
+    frag_col = vec4(base * total, 1.0);
+}
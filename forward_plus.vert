@@ -0,0 +1,51 @@
+#version 440
+
+layout(location = 0)in vec3 v_pos;
+layout(location = 1)in vec3 v_normal;
+layout(location = 2)in uint v_draw_id;
+layout(location = 3)in vec2 v_uv;
+
+layout(std140, binding = 0) uniform camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec4 position;
+} cam;
+
+struct object_data
+{
+    mat4 model;
+    vec4 colour;
+    vec4 uv_transform;
+    vec4 bounds_min;
+    vec4 bounds_max;
+};
+
+layout(std430, binding = 1) readonly buffer objects
+{
+    object_data object[];
+};
+
+out vec3 col;
+out vec3 normal;
+out vec2 uv;
+out vec3 world;
+// clip position and view depth, to find the cluster of the fragment
+out vec4 clip;
+out float depth;
+
+void main()
+{
+    object_data obj = object[v_draw_id];
+
+    // lights are summed per fragment from the lists of its cluster
+    vec4 p = obj.model * vec4(v_pos, 1.0);
+    col = obj.colour.rgb;
+    normal = mat3(obj.model) * v_normal;
+    uv = v_uv * obj.uv_transform.xy + obj.uv_transform.zw;
+    world = p.xyz;
+    depth = -(cam.view * p).z;
+    clip = cam.view_projection * p;
+    gl_Position = clip;
+}
@@ -0,0 +1,27 @@
+#version 440
+
+in vec3 col;
+in vec3 normal;
+in vec2 uv;
+
+layout(location = 0) out vec4 albedo_out;
+layout(location = 1) out vec2 normal_out;
+
+// one atlas for every object, white until it is resident
+layout(binding = 0) uniform sampler2D albedo;
+
+// fold the unit sphere onto the octahedron and flatten it into a square,
+// two snorm channels keep a world normal to well under a degree
+vec2 octahedral_encode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0,
+                                           n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : folded;
+}
+
+void main()
+{
+    albedo_out = vec4(col * texture(albedo, uv).rgb, 1.0);
+    normal_out = octahedral_encode(normalize(normal));
+}
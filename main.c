@@ -10,18 +10,254 @@
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 
+#include "src/arena.h"
+#include "src/atlas.h"
+#include "src/bvh.h"
+#include "src/cpuparticles.h"
+#include "src/damage.h"
+#include "src/clusters.h"
+#include "src/deferred.h"
+#include "src/drawlist.h"
+#include "src/frustum.h"
+#include "src/glresource.h"
+#include "src/glstate.h"
+#include "src/hiz.h"
+#include "src/jobs.h"
+#include "src/lights.h"
 #include "src/matrix.h"
+#include "src/mesh.h"
+#include "src/pacer.h"
+#include "src/pack.h"
+#include "src/particles.h"
+#include "src/renderqueue.h"
+#include "src/renderthread.h"
+#include "src/shadows.h"
+#include "src/texcache.h"
+#include "src/texture.h"
+#include "src/transform.h"
+#include "src/uniforms.h"
 #include "src/utils.h"
 #include "src/vec.h"
 
 #define GL_LOG_FILE "./gl.log"
 #define FRAG_FILE "./shader.frag"
 #define VERT_FILE "./shader.vert"
+// depth pyramid reduction and the occlusion test against it
+#define HIZ_BUILD_FILE "./hiz_build.comp"
+#define HIZ_CULL_FILE "./hiz_cull.comp"
+// particles are emitted, simulated and compacted by compute shaders
+#define PARTICLE_EMIT_FILE "./particle_emit.comp"
+#define PARTICLE_DISPATCH_FILE "./particle_dispatch.comp"
+#define PARTICLE_SIMULATE_FILE "./particle_simulate.comp"
+#define PARTICLE_VERT_FILE "./particle.vert"
+#define PARTICLE_FRAG_FILE "./particle.frag"
+#define PARTICLE_CPU_VERT_FILE "./particle_cpu.vert"
+// g-buffer fill and the tiled light pass reading it
+#define GBUFFER_VERT_FILE "./gbuffer.vert"
+#define GBUFFER_FRAG_FILE "./gbuffer.frag"
+#define DEFERRED_LIGHT_FILE "./deferred_light.comp"
+// forward shading from per cluster light lists
+#define FORWARD_PLUS_VERT_FILE "./forward_plus.vert"
+#define FORWARD_PLUS_FRAG_FILE "./forward_plus.frag"
+
+#define SHADOW_VERT_FILE "./shadow.vert"
+// built by the packer target, loose files are used when it is missing
+#define PACK_FILE "./assets.pack"
+#define MESH_FILE "./cube.obj"
+// rebuilt when missing or older than MESH_FILE
+#define MESH_CACHE_FILE "./cube.mesh"
+// lods switch where their error covers about a pixel, the margin keeps
+// objects near a threshold from flickering between two levels
+#define LOD_PIXEL_ERROR 1.0f
+#define LOD_HYSTERESIS 0.25f
+#define FIELD_OF_VIEW DEG2RAD(67.0)
+#define NEAR_PLANE 0.1f
+#define FAR_PLANE 100.0f
+#define TEXTURE_FILE "./checker.png"
+
+#define OBJECT_COUNT 16
+// static wall and floor behind the grid, drawn after the grid objects
+#define SCENERY_COUNT 2
+#define SCENE_COUNT (OBJECT_COUNT + SCENERY_COUNT)
+#define GL_RESOURCE_COUNT 256
+// per frame scratch, double buffered, the cluster light lists are the
+// largest part
+#define FRAME_ARENA_SIZE (512 * 1024)
+// window title text, main thread only
+#define TITLE_ARENA_SIZE 1024
+// below this the linear simd cull beats walking the bvh, cullbench has
+// them even between 2k and 4k boxes and the bvh twice as fast at 64k
+#define BVH_MIN_OBJECTS 4096
+// false submits frames inline on the main thread, for comparison
+#define RENDER_THREADED true
+// V cycles present modes, L toggles the limiter at LIMIT_FPS
+#define PRESENT_MODE PRESENT_VSYNC_ADAPTIVE
+#define LIMIT_FPS 60
+// frames the gpu may queue before the render thread waits, lower is less
+// input latency, higher is more throughput
+#define MAX_FRAMES_IN_FLIGHT 2
+// SPACE pauses the animation, with nothing changing the loop blocks on
+// events for up to this long instead of drawing
+#define IDLE_WAIT_SECONDS 0.25
+// texture rows copied to the gpu per frame, a 512x512 rgba8 image is 1MB
+#define TEXTURE_UPLOAD_BUDGET (256 * 1024)
+// every object texture shares one atlas, borders keep 3 mips clean
+#define ATLAS_SIZE 1024
+#define ATLAS_BORDER 4
+#define ATLAS_ALIGN 4
+// bc7 copy of the atlas, rebuilt whenever the atlas pixels change
+#define ATLAS_CACHE_FILE "./atlas.btx"
+#define ATLAS_FORMAT BC_FORMAT_BC7
+// H toggles occlusion culling against last frames depth
+#define HIZ_ENABLED true
+// P toggles the fountain, rate * mean lifetime of 1.5s stays under the pool
+#define PARTICLES_ENABLED true
+#define PARTICLE_COUNT (64 * 1024)
+#define PARTICLE_RATE 20000.0f
+// C moves them to the job system, faster where gl is software only
+#define PARTICLES_ON_CPU false
+// D cycles the forward pass, deferred shading and clustered forward
+// shading, both lit by LIGHT_COUNT point lights drifting around the grid
+#define LIGHTING_MODE LIGHTING_DEFERRED
+#define LIGHT_COUNT 256
+#define LIGHT_RADIUS 0.6f
+// froxels of the clustered path, about 40x40 pixels and 24 depth slices
+#define CLUSTER_X 16
+#define CLUSTER_Y 12
+#define CLUSTER_Z 24
+// S toggles the sun's cascaded shadows, cast over the first
+// SHADOW_DISTANCE units in front of the camera
+#define SHADOWS_ENABLED true
+#define SHADOW_SIZE 1024
+#define SHADOW_DISTANCE 12.0f
+
+/* *
+ * how the opaque draws are lit
+ * */
+enum lighting_mode {
+  LIGHTING_FORWARD,
+  LIGHTING_DEFERRED,
+  LIGHTING_CLUSTERED,
+  LIGHTING_MODE_COUNT
+};
+typedef enum lighting_mode lighting_mode;
 
 const GLint WIDTH = 640;
 const GLint HEIGHT = 480;
 const char *NAME = "GLFW CMAKE";
 
+// set from the key callback, applied by the main loop
+global_var present_mode requested_present = PRESENT_MODE;
+global_var bool requested_limit = false;
+global_var bool requested_animate = true;
+global_var bool requested_hiz = HIZ_ENABLED;
+global_var bool requested_particles = PARTICLES_ENABLED;
+global_var bool requested_cpu_particles = PARTICLES_ON_CPU;
+global_var lighting_mode requested_lighting = LIGHTING_MODE;
+global_var bool requested_shadows = SHADOWS_ENABLED;
+
+// marked by callbacks, taken by the main loop before drawing
+global_var damage_tracker damage;
+
+/* *
+ * per frame counters shown in the window title
+ * */
+struct frame_stats {
+  gl_state_stats gl;
+  render_queue_stats queue;
+  cull_stats cull;
+  unsigned transforms_updated;
+  unsigned triangles;
+  unsigned lod_switches;
+  // items the render queue could not grow for, not drawn
+  unsigned dropped_draws;
+  bool hiz_enabled;
+  hiz_stats hiz;
+  bool particles_enabled;
+  bool particles_on_cpu;
+  particle_stats particles;
+  cpu_particle_stats cpu_particles;
+  lighting_mode lighting;
+  deferred_stats deferred;
+  cluster_stats clusters;
+  bool shadows_enabled;
+  shadow_stats shadows;
+  pacer_stats pacer;
+  present_mode present;
+  int limit_fps;
+  unsigned frames_drawn;
+  unsigned frames_skipped;
+  double idle_ms;
+  texture_stream_stats textures;
+};
+typedef struct frame_stats frame_stats;
+
+/* *
+ * everything the render thread needs to draw one frame
+ *
+ * recorded by the main thread, arrays live in the frame arena that was
+ * current while recording, it is not reset until the packet is free again.
+ * */
+struct frame_packet {
+  render_queue queue;
+  // indexed by object, only visible objects are written
+  object_block *objects;
+  // one per queued item, copied from objects in draw id order by the
+  // render thread
+  object_block *draw_objects;
+  camera_block camera;
+  present_mode present;
+  bool hiz_enabled;
+  bool particles_enabled;
+  bool particles_on_cpu;
+  // vertex region written by the cpu particles for this frame
+  int particle_region;
+  particle_emitter emitter;
+  lighting_mode lighting;
+  point_light *lights;
+  uint32_t light_count;
+  // light lists of the clustered mode
+  cluster_lists clusters;
+  bool shadows_enabled;
+  // direction the sunlight travels, and everything that may cast
+  vec3 sun;
+  shadow_caster *casters;
+  uint32_t caster_count;
+  // seconds of animation since the last packet
+  float delta;
+  // when input for this frame was polled
+  double input_ms;
+
+  // written back by the render thread
+  gl_state_stats gl;
+  render_queue_stats queue_stats;
+  pacer_stats pacer;
+  texture_stream_stats textures;
+  hiz_stats hiz;
+  particle_stats particles;
+  deferred_stats deferred;
+  shadow_stats shadows;
+};
+typedef struct frame_packet frame_packet;
+
+/* *
+ * gl objects used only by the thread owning the context
+ * */
+struct render_context {
+  GLFWwindow *window;
+  draw_list *draws;
+  uniform_buffers *uniforms;
+  frame_pacer *pacer;
+  texture_streamer *textures;
+  hiz *hiz;
+  particle_system *particles;
+  cpu_particle_system *cpu_particles;
+  deferred_renderer *deferred;
+  light_buffer *lights;
+  cluster_grid *clusters;
+  shadow_map *shadows;
+};
+typedef struct render_context render_context;
 
 /* --- */
 
@@ -188,63 +424,100 @@ internal bool link_shaders(GLuint program, GLuint vert, GLuint frag,
 }
 
 /* *
- * get text from file and copy into buffer
+ * read a whole text file into a buffer sized from the file
  *
  * @param *file_path of text file.
- * @param *buffer to store text.
- * @return true if file was successfully read.
+ * @return zero terminated text to free, NULL if the file was not read.
  * */
-internal bool get_text_from_file(const char *file_path, char *buffer) {
+internal char *get_text_from_file(const char *file_path) {
   FILE *fp = NULL;
   errno_t err = fopen_s(&fp, file_path, "r");
   if (err) {
     fprintf_s(stderr, "ERROR: failed to open file %s\n", file_path);
-    return false;
+    return NULL;
   }
 
-  // loop over all text and store chars
-  // into buffer
-  char c;
-  int idx = 0;
-  while ((c = fgetc(fp)) != EOF) {
-    buffer[idx] = c;
-    ++idx;
+  long size = -1;
+  if (fseek(fp, 0, SEEK_END) == 0) {
+    size = ftell(fp);
+    rewind(fp);
   }
-  buffer[idx] = '\0';
+  char *buffer = size >= 0 ? malloc((size_t)size + 1) : NULL;
+  if (not buffer) {
+    fprintf_s(stderr, "ERROR: failed to read file %s\n", file_path);
+    fclose(fp);
+    return NULL;
+  }
+
+  // text mode may read fewer chars than the file holds
+  size_t count = fread(buffer, 1, (size_t)size, fp);
+  buffer[count] = '\0';
 
   fclose(fp);
 
-  return true;
+  return buffer;
+}
+
+/* *
+ * get shader text from the pack, or from file when it is not packed
+ *
+ * @param *assets pack to look in first, may be NULL.
+ * @param *file_path of shader.
+ * @param **owned set to the text read from file, freed by the caller.
+ * @return text pointing into the pack or owned, NULL on failure.
+ * */
+internal const char *get_shader_source(const pack *assets,
+                                       const char *file_path, char **owned) {
+  *owned = NULL;
+
+  // packed blobs are zero terminated, used in place
+  if (assets) {
+    const char *text = pack_find(assets, file_path, NULL);
+    if (text) {
+      return text;
+    }
+  }
+
+  *owned = get_text_from_file(file_path);
+  return *owned;
 }
 
 /*
  * create shaders vert and frag from file and link to shader program
  *
  * @param program id generated from glCreateProgram.
+ * @param *assets pack to load shaders from, may be NULL.
  * @param *v_file path for vertex shader data.
  * @param *f_file path for fragment shader data.
  * @return true if shaders were created and linked to program.
  * */
 internal bool create_shaders_and_link_to_program(GLuint program,
+                                                 const pack *assets,
                                                  const char *v_file,
                                                  const char *f_file) {
-  char vert_buffer[512];
-  if (not get_text_from_file(v_file, vert_buffer)) {
+  char *vert_text = NULL;
+  const char *vert_source = get_shader_source(assets, v_file, &vert_text);
+  if (not vert_source) {
     return false;
   }
 
   GLuint v_shader = glad_glCreateShader(GL_VERTEX_SHADER);
-  if (not compile_shader(v_shader, vert_buffer, true)) {
+  bool compiled = compile_shader(v_shader, vert_source, true);
+  free(vert_text);
+  if (not compiled) {
     return false;
   }
 
-  char frag_buffer[512];
-  if (not get_text_from_file(f_file, frag_buffer)) {
+  char *frag_text = NULL;
+  const char *frag_source = get_shader_source(assets, f_file, &frag_text);
+  if (not frag_source) {
     return false;
   }
 
   GLuint f_shader = glad_glCreateShader(GL_FRAGMENT_SHADER);
-  if (not compile_shader(f_shader, frag_buffer, true)) {
+  compiled = compile_shader(f_shader, frag_source, true);
+  free(frag_text);
+  if (not compiled) {
     return false;
   }
 
@@ -267,36 +540,310 @@ internal bool create_shaders_and_link_to_program(GLuint program,
   return true;
 }
 
+/* *
+ * create compute shader from file and link it to program
+ *
+ * @param program id generated from glCreateProgram.
+ * @param *assets pack to load the shader from, may be NULL.
+ * @param *c_file path for compute shader data.
+ * @return true if the shader was created and linked to program.
+ * */
+internal bool create_compute_shader_and_link_to_program(GLuint program,
+                                                        const pack *assets,
+                                                        const char *c_file) {
+  char *text = NULL;
+  const char *source = get_shader_source(assets, c_file, &text);
+  if (not source) {
+    return false;
+  }
+
+  GLuint c_shader = glad_glCreateShader(GL_COMPUTE_SHADER);
+  bool compiled = compile_shader(c_shader, source, true);
+  free(text);
+  if (not compiled) {
+    return false;
+  }
+
+  glad_glAttachShader(program, c_shader);
+  glad_glLinkProgram(program);
+
+  int check = -1;
+  glad_glGetProgramiv(program, GL_LINK_STATUS, &check);
+  if (check != GL_TRUE) {
+    fprintf(stderr, "ERROR: failed to link compute program %s\n", c_file);
+    print_program_infolog(program);
+    return false;
+  }
+
+  // CLEAN UP
+  glad_glDeleteShader(c_shader);
+
+  return true;
+}
+
+/* *
+ * create vertex shader from file and link it to program without a
+ * fragment shader, for depth only passes
+ *
+ * @param program id generated from glCreateProgram.
+ * @param *assets pack to load the shader from, may be NULL.
+ * @param *v_file path for vertex shader data.
+ * @return true if the shader was created and linked to program.
+ * */
+internal bool create_vertex_shader_and_link_to_program(GLuint program,
+                                                       const pack *assets,
+                                                       const char *v_file) {
+  char *text = NULL;
+  const char *source = get_shader_source(assets, v_file, &text);
+  if (not source) {
+    return false;
+  }
+
+  GLuint v_shader = glad_glCreateShader(GL_VERTEX_SHADER);
+  bool compiled = compile_shader(v_shader, source, true);
+  free(text);
+  if (not compiled) {
+    return false;
+  }
+
+  glad_glAttachShader(program, v_shader);
+  glad_glLinkProgram(program);
+
+  int check = -1;
+  glad_glGetProgramiv(program, GL_LINK_STATUS, &check);
+  if (check != GL_TRUE) {
+    fprintf(stderr, "ERROR: failed to link depth program %s\n", v_file);
+    print_program_infolog(program);
+    return false;
+  }
+
+  // CLEAN UP
+  glad_glDeleteShader(v_shader);
+
+  return true;
+}
+
 /* *
  * update fps counter
  *
  * @param *dest_prev_time from glfwGetTime get will be updated to store new prev_time
  * @param *window from glfwCreatewindow
+ * @param *stats counters of the last frame
+ * @param *render render thread, its timings are taken on each refresh
+ * @param *scratch arena for the title text, reset by the caller
  * */
-internal void update_fps(double *dest_prev_time,  GLFWwindow *window) {
-  local_persist int counter;
+internal void update_fps(double *dest_prev_time,  GLFWwindow *window,
+                         const frame_stats *stats, render_thread *render,
+                         arena *scratch) {
   double current = glfwGetTime();
   double elapsed = current - *dest_prev_time;
 
   if(elapsed > 0.25) {
     *dest_prev_time = current;
-    double fps = (double)counter / elapsed;
 
-    char buffer[128];
-    sprintf(buffer, "FPS: %.3f", fps);
-    glfwSetWindowTitle(window, buffer);
-    counter = 0;
+    // only drawn frames count, skipped ones are shown with idle time
+    local_persist unsigned previous_drawn;
+    local_persist unsigned previous_skipped;
+    local_persist double previous_idle;
+    double fps = (double)(stats->frames_drawn - previous_drawn) / elapsed;
+    unsigned skipped = stats->frames_skipped - previous_skipped;
+    double idle = (stats->idle_ms - previous_idle) / (elapsed * 10.0);
+    previous_drawn = stats->frames_drawn;
+    previous_skipped = stats->frames_skipped;
+    previous_idle = stats->idle_ms;
+
+    // per frame averages, overlap is how much faster than one thread
+    render_thread_stats timing = render_thread_take_stats(render);
+
+    // pacer totals since the last refresh
+    local_persist pacer_stats previous_pacer;
+    unsigned latency_frames =
+        stats->pacer.latency_frames - previous_pacer.latency_frames;
+    unsigned paced_frames = stats->pacer.frames - previous_pacer.frames;
+    double latency = latency_frames > 0
+                         ? (stats->pacer.latency_total_ms -
+                            previous_pacer.latency_total_ms) /
+                               (double)latency_frames
+                         : 0.0;
+    double fence_wait = paced_frames > 0
+                            ? (stats->pacer.fence_wait_ms -
+                               previous_pacer.fence_wait_ms) /
+                                  (double)paced_frames
+                            : 0.0;
+    previous_pacer = stats->pacer;
+    double frames = timing.frames > 0 ? (double)timing.frames : 1.0;
+    double overlap = timing.wall_ms > 0.0
+                         ? (timing.main_ms + timing.render_ms) / timing.wall_ms
+                         : 0.0;
+
+    // gpu time of the compute path or cpu time of the job system path
+    const char *particle_mode = "off";
+    unsigned particle_alive = 0;
+    double particle_ms = 0.0;
+    if (stats->particles_enabled and stats->particles_on_cpu) {
+      particle_mode = "cpu";
+      particle_alive = stats->cpu_particles.alive;
+      particle_ms = stats->cpu_particles.update_ms;
+    } else if (stats->particles_enabled) {
+      particle_mode = "gpu";
+      particle_alive = stats->particles.alive;
+      particle_ms = stats->particles.gpu_ms;
+    }
+
+    // lights kept per tile and light pass time, or per cluster and the
+    // time spent building the lists
+    const char *lighting_mode_text = "forward";
+    unsigned light_total = 0;
+    float per_region = 0.0f;
+    const char *region = "tile";
+    if (stats->lighting == LIGHTING_DEFERRED) {
+      lighting_mode_text = "deferred";
+      light_total = stats->deferred.lights;
+      per_region = stats->deferred.tile_lights;
+    } else if (stats->lighting == LIGHTING_CLUSTERED) {
+      lighting_mode_text = "clustered";
+      light_total = stats->clusters.lights;
+      per_region = stats->clusters.cell_lights;
+      region = "cell";
+    }
+
+    char *buffer = arena_printf(scratch,
+            "FPS: %.3f | GL: %u issued %u filtered | "
+            "DRAWS: %u batches %u programs %u vaos %u textures %u "
+            "dropped %u | "
+            "CULL: %u visible %u culled | XFORM: %u updated | "
+            "LOD: %u triangles %u switches | HIZ: %s %u/%u occluded | "
+            "PARTICLES: %s %u alive %.2fms | "
+            "LIGHTS: %s %u lights %.1f/%s %.2fms gbuffer %.2fms shade "
+            "%.2fms assign | "
+            "SHADOWS: %s %u casters %u static %u cached redraws %.2fms | "
+            "THREAD: %.2fms main %.2fms render %.2fms wait x%.2f | "
+            "PACE: vsync %s limit %d | LATENCY: %.2fms %.2fms fence | "
+            "IDLE: %u skipped %.0f%% | "
+            "TEX: %u/%u resident %.0fKB vram %.0fKB peak",
+            fps, stats->gl.issued, stats->gl.filtered, stats->queue.items,
+            stats->queue.batches, stats->queue.program_changes,
+            stats->queue.vao_changes, stats->queue.texture_changes,
+            stats->dropped_draws,
+            stats->cull.visible, stats->cull.culled,
+            stats->transforms_updated, stats->triangles, stats->lod_switches,
+            stats->hiz_enabled ? "on" : "off", stats->hiz.occluded,
+            stats->hiz.tested, particle_mode, particle_alive, particle_ms,
+            lighting_mode_text, light_total, per_region, region,
+            stats->deferred.geometry_ms, stats->deferred.lighting_ms,
+            stats->clusters.assign_ms,
+            stats->shadows_enabled ? "on" : "off", stats->shadows.casters,
+            stats->shadows.static_casters, stats->shadows.cache_updates,
+            stats->shadows.gpu_ms, timing.main_ms / frames,
+            timing.render_ms / frames, timing.main_wait_ms / frames, overlap,
+            present_mode_name(stats->present), stats->limit_fps, latency,
+            fence_wait, skipped, idle, stats->textures.resident,
+            stats->textures.requested,
+            (double)stats->textures.resident_bytes / 1024.0,
+            (double)stats->textures.peak_frame_bytes / 1024.0);
+    if (buffer) {
+      glfwSetWindowTitle(window, buffer);
+    }
+  }
+}
+
+/* *
+ * decode an image from the pack, or from file when it is not packed
+ *
+ * @param *assets pack to look in first, may be NULL.
+ * @param *file_path of image.
+ * @param *img to decode into.
+ * @return true if the image was decoded.
+ * */
+internal bool load_image(const pack *assets, const char *file_path,
+                         image *img) {
+  size_t size = 0;
+  const void *data = assets ? pack_find(assets, file_path, &size) : NULL;
+  if (data) {
+    return image_decode(img, data, size);
   }
 
-  ++counter;
+  file_map map;
+  if (not file_map_open(&map, file_path)) {
+    fprintf(stderr, "ERROR: failed to open file %s\n", file_path);
+    return false;
+  }
+  bool ok = image_decode(img, map.data, map.size);
+  file_map_close(&map);
+  return ok;
+}
+
+/* *
+ * fill img with stripes, size and colours vary with seed
+ *
+ * @param *img to allocate and fill.
+ * @param seed picks the pattern.
+ * @return true if pixels could be allocated.
+ * */
+internal bool generate_tile(image *img, int seed) {
+  img->width = 32 + (uint32_t)(seed * 23) % 96;
+  img->height = 32 + (uint32_t)(seed * 41) % 96;
+  img->pixels = malloc((size_t)img->width * img->height * 4);
+  if (not img->pixels) {
+    return false;
+  }
+
+  uint8_t light[3] = {(uint8_t)(120 + seed * 53 % 136),
+                      (uint8_t)(120 + seed * 97 % 136),
+                      (uint8_t)(120 + seed * 31 % 136)};
+  uint32_t stripe = 4 + (uint32_t)seed % 5;
+  for (uint32_t y = 0; y < img->height; ++y) {
+    for (uint32_t x = 0; x < img->width; ++x) {
+      uint8_t *p = img->pixels + ((size_t)y * img->width + x) * 4;
+      bool on = ((x + y) / stripe) % 2 == 0;
+      for (int c = 0; c < 3; ++c) {
+        p[c] = on ? light[c] : (uint8_t)(light[c] / 3);
+      }
+      p[3] = 255;
+    }
+  }
+  return true;
+}
+
+/* *
+ * pack one texture per object into an atlas
+ *
+ * @param *a atlas to add to.
+ * @param *assets pack the first texture is loaded from, may be NULL.
+ * @param transforms uv scale and offset of each object.
+ * @return true if every texture was loaded and fit.
+ * */
+internal bool build_atlas(atlas *a, const pack *assets,
+                          float transforms[OBJECT_COUNT][4]) {
+  image images[OBJECT_COUNT] = {0};
+  atlas_rect rects[OBJECT_COUNT];
+
+  // first object shows the file texture, the rest are generated
+  bool ok = load_image(assets, TEXTURE_FILE, &images[0]);
+  for (int i = 1; ok and i < OBJECT_COUNT; ++i) {
+    ok = generate_tile(&images[i], i);
+  }
+  ok = ok and atlas_add_all(a, images, OBJECT_COUNT, rects);
+
+  for (int i = 0; i < OBJECT_COUNT; ++i) {
+    if (ok) {
+      atlas_uv_transform(a, &rects[i], transforms[i]);
+    }
+    image_destroy(&images[i]);
+  }
+  if (not ok) {
+    fprintf(stderr, "ERROR: failed to build texture atlas\n");
+  }
+  return ok;
 }
 
 internal mat4 perspective(float fov, float aspect, float near, float far) {
   /* *
+   * row order, looks down -z, depth maps near..far to -1..1
    * | sx  0  0  0 |
    * |  0 sy  0  0 |
    * |  0  0 sz -1 |
-   * |  0  0 ss  0 |
+   * |  0  0 pz  0 |
    * */
 
   float range = 1.0 / tanf(fov * 0.5);
@@ -304,8 +851,8 @@ internal mat4 perspective(float fov, float aspect, float near, float far) {
 
   float sx = range / aspect;
   float sy = range;
-  float sz = (near + far) * fn;
-  float pz = (2.0 * far * near) * fn;
+  float sz = -(near + far) * fn;
+  float pz = -(2.0 * far * near) * fn;
 
   return mat4_new( sx, 0.0, 0.0,  0.0,
 		  0.0,  sy, 0.0,  0.0,
@@ -325,6 +872,128 @@ internal void title(void) {
 
 /* --- */
 
+/* RENDER THREAD */
+
+internal void render_attach(void *user) {
+  render_context *r = user;
+  glfwMakeContextCurrent(r->window);
+
+  // swap interval belongs to the context, so it is set here
+  r->pacer->tear_supported =
+      glfwExtensionSupported("WGL_EXT_swap_control_tear") or
+      glfwExtensionSupported("GLX_EXT_swap_control_tear");
+  glfwSwapInterval(frame_pacer_swap_interval(r->pacer));
+}
+
+internal void render_detach(void *user) {
+  render_context *r = user;
+  frame_pacer_destroy(r->pacer);
+  glfwMakeContextCurrent(NULL);
+}
+
+/* *
+ * submit one recorded frame, runs on the thread owning the context
+ * */
+internal void render_frame(void *user, void *data) {
+  render_context *r = user;
+  frame_packet *packet = data;
+
+  if (packet->present != r->pacer->mode) {
+    glfwSwapInterval(frame_pacer_set_mode(r->pacer, packet->present));
+  }
+  frame_pacer_begin(r->pacer);
+
+  glstate_begin_frame();
+  packet->gl = glstate_frame_stats();
+
+  // a budget of texture rows, before the draws that may sample them
+  texture_streamer_update(r->textures, &packet->textures);
+
+  // the sun's depth from every caster, before the draws that sample it
+  shadow_update(r->shadows, &packet->camera.view, &packet->sun,
+                packet->shadows_enabled);
+  packet->shadows = (shadow_stats){0};
+  if (packet->shadows_enabled) {
+    shadow_render(r->shadows, packet->casters, packet->caster_count,
+                  &packet->shadows);
+  }
+  shadow_bind(r->shadows);
+
+  glstate_clear_color(0.1, 0.1, 0.1, 1.0);
+  glad_glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glstate_viewport(0, 0, WIDTH, HEIGHT);
+
+  // out of memory drops the frames draws instead of drawing past them
+  draw_list_clear(r->draws);
+  if (not render_queue_build(&packet->queue, r->draws) or
+      not draw_list_upload(r->draws)) {
+    render_queue_clear(&packet->queue);
+    draw_list_clear(r->draws);
+  }
+
+  // per object data in draw id order
+  for (uint32_t d = 0; d < packet->queue.count; ++d) {
+    packet->draw_objects[d] = packet->objects[packet->queue.draw_objects[d]];
+  }
+  uniforms_upload_camera(r->uniforms, &packet->camera);
+  uniforms_upload_objects(r->uniforms, packet->draw_objects,
+                          (GLsizei)packet->queue.count);
+  uniforms_bind(r->uniforms);
+
+  // hidden draws lose their instances before the indirect draws read them
+  packet->hiz = (hiz_stats){0};
+  if (packet->hiz_enabled) {
+    hiz_cull(r->hiz, r->draws, &packet->hiz);
+  }
+
+  // opaque draws fill the g-buffer instead, lit and blitted back before
+  // anything blends over them
+  packet->deferred = (deferred_stats){0};
+  if (packet->lighting == LIGHTING_DEFERRED) {
+    light_buffer_upload(r->lights, packet->lights,
+                        (GLsizei)packet->light_count);
+    deferred_begin(r->deferred, &packet->deferred);
+  }
+
+  // or shade themselves from the lists built while recording
+  if (packet->lighting == LIGHTING_CLUSTERED) {
+    light_buffer_upload(r->lights, packet->lights,
+                        (GLsizei)packet->light_count);
+    light_buffer_bind(r->lights);
+    clusters_upload(r->clusters, &packet->clusters);
+    clusters_bind(r->clusters);
+  }
+
+  render_queue_execute(&packet->queue, r->draws, GL_TRIANGLES);
+  packet->queue_stats = packet->queue.stats;
+
+  if (packet->lighting == LIGHTING_DEFERRED) {
+    deferred_end(r->deferred, r->lights);
+  }
+
+  // blended over the opaque draws, the cpu path was simulated while
+  // recording and only draws here
+  if (packet->particles_enabled and packet->particles_on_cpu) {
+    cpu_particles_draw(r->cpu_particles, packet->particle_region);
+  } else if (packet->particles_enabled) {
+    particles_update(r->particles, &packet->emitter, packet->delta,
+                     &packet->particles);
+    particles_draw(r->particles);
+  }
+
+  // this frames depth, culls the next one
+  hiz_build(r->hiz);
+
+  // wireframe mode
+  // glad_glPolygonMode(GL_FRONT, GL_LINE);
+
+  glfwSwapBuffers(r->window);
+  frame_pacer_end(r->pacer, packet->input_ms);
+  packet->pacer = r->pacer->stats;
+}
+
+/* --- */
+
 /* CALLBACKS */
 
 internal void error_callback(int error, const char *description) {
@@ -336,6 +1005,49 @@ internal void key_callback(GLFWwindow *window, int key, int scancode,
   if (key == GLFW_KEY_Q and action == GLFW_PRESS) {
     glfwSetWindowShouldClose(window, GLFW_TRUE);
   }
+  if (key == GLFW_KEY_V and action == GLFW_PRESS) {
+    requested_present = (requested_present + 1) % PRESENT_MODE_COUNT;
+  }
+  if (key == GLFW_KEY_L and action == GLFW_PRESS) {
+    requested_limit = not requested_limit;
+  }
+  if (key == GLFW_KEY_SPACE and action == GLFW_PRESS) {
+    requested_animate = not requested_animate;
+  }
+  if (key == GLFW_KEY_H and action == GLFW_PRESS) {
+    requested_hiz = not requested_hiz;
+  }
+  if (key == GLFW_KEY_P and action == GLFW_PRESS) {
+    requested_particles = not requested_particles;
+  }
+  if (key == GLFW_KEY_C and action == GLFW_PRESS) {
+    requested_cpu_particles = not requested_cpu_particles;
+  }
+  if (key == GLFW_KEY_D and action == GLFW_PRESS) {
+    requested_lighting = (requested_lighting + 1) % LIGHTING_MODE_COUNT;
+  }
+  if (key == GLFW_KEY_S and action == GLFW_PRESS) {
+    requested_shadows = not requested_shadows;
+  }
+  damage_mark(&damage, DAMAGE_INPUT);
+}
+
+internal void mouse_button_callback(GLFWwindow *window, int button,
+                                    int action, int modes) {
+  damage_mark(&damage, DAMAGE_INPUT);
+}
+
+internal void refresh_callback(GLFWwindow *window) {
+  damage_mark(&damage, DAMAGE_WINDOW);
+}
+
+internal void framebuffer_size_callback(GLFWwindow *window, int width,
+                                        int height) {
+  damage_mark(&damage, DAMAGE_WINDOW);
+}
+
+internal void focus_callback(GLFWwindow *window, int focused) {
+  damage_mark(&damage, DAMAGE_WINDOW);
 }
 
 /* --- */
@@ -352,8 +1064,9 @@ int main(void) {
     return EXIT_FAILURE;
   }
 
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  // 4.3+ for glMultiDrawElementsIndirect, shaders are #version 440
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
 
   GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, NAME, NULL, NULL);
   if (not window) {
@@ -361,7 +1074,15 @@ int main(void) {
     return EXIT_FAILURE;
   }
 
+  // texture decodes and the render thread mark damage too, their marks
+  // wake the idle wait
+  damage_init(&damage);
+  damage_set_wake(&damage, glfwPostEmptyEvent);
   glfwSetKeyCallback(window, key_callback);
+  glfwSetMouseButtonCallback(window, mouse_button_callback);
+  glfwSetWindowRefreshCallback(window, refresh_callback);
+  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+  glfwSetWindowFocusCallback(window, focus_callback);
   glfwMakeContextCurrent(window);
 
   /* GLAD */
@@ -374,92 +1095,771 @@ int main(void) {
   const GLubyte *version = glad_glGetString(GL_VERSION);
   printf("RENDERER:: %s\nVERSION:: %s\n", renderer, version);
 
-  glad_glEnable(GL_DEPTH_TEST);
-  glad_glDepthFunc(GL_LESS);
+  glstate_enable(GL_DEPTH_TEST);
+  glstate_depth_func(GL_LESS);
+
+  // JOBS
+  // main thread is worker 0, one background worker per remaining core
+  if (not jobs_init(jobs_cpu_count() - 1)) {
+    return EXIT_FAILURE;
+  }
+  printf("JOBS:: %d threads\n", jobs_thread_count());
 
   /* --- */
 
-  mat3 points =
-      mat3_new(0.0f, 0.5f, 0.0f, 0.5f, -0.5f, 0.0f, -0.5f, -0.5f, 0.0f);
+  // PACK
+  // one mapping for every packed asset, lookups point straight into it
+  pack assets;
+  double pack_start = pacer_now_ms();
+  bool packed = pack_open(&assets, PACK_FILE);
+  if (packed) {
+    printf("PACK:: %s %u entries opened in %.2fms\n", PACK_FILE,
+           assets.entry_count, pacer_now_ms() - pack_start);
+  } else {
+    printf("PACK:: %s missing, loading loose files\n", PACK_FILE);
+  }
+
+  /* --- */
 
-  mat3 colour = mat3_identity();
+  // MESH
+  // imported on the first run, later runs map the cache and upload it as is
+  mesh_data mesh;
+  mesh_load_stats mesh_stats;
+  if (not mesh_load(&mesh, MESH_FILE, MESH_CACHE_FILE, &mesh_stats)) {
+    return EXIT_FAILURE;
+  }
 
   /* --- */
 
-  // VBO (vertex buffer object) array of data
-  //  position
-  GLuint points_vbo = 0;
-  glad_glGenBuffers(1, &points_vbo);
-  glad_glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
-  glad_glBufferData(GL_ARRAY_BUFFER, sizeof(points.arr), points.arr,
-                    GL_STATIC_DRAW);
-
-  //  colour
-  GLuint colour_vbo = 0;
-  glad_glGenBuffers(1, &colour_vbo);
-  glad_glBindBuffer(GL_ARRAY_BUFFER, colour_vbo);
-  glad_glBufferData(GL_ARRAY_BUFFER, sizeof(colour.arr), colour.arr,
-                    GL_STATIC_DRAW);
+  // GL RESOURCES
+  // every gl object is owned by the pool, leaks are reported at shutdown
+  gl_resources resources;
+  if (not gl_resources_init(&resources, GL_RESOURCE_COUNT)) {
+    return EXIT_FAILURE;
+  }
+
+  // VBO (vertex buffer object) interleaved mesh_vertex data
+  handle vbo_handle =
+      gl_resource_create(&resources, GL_RESOURCE_BUFFER, "mesh vbo");
+  GLuint vbo = gl_resource_name(&resources, vbo_handle);
+
+  // EBO (element buffer object) stays bound to the vao
+  handle ebo_handle =
+      gl_resource_create(&resources, GL_RESOURCE_BUFFER, "mesh ebo");
+  GLuint ebo = gl_resource_name(&resources, ebo_handle);
 
   // VAO
   // store values from vbo
   // 0 = position
-  // 1 = colour
-  GLuint vao = 0;
-  glad_glGenVertexArrays(1, &vao);
-  glad_glBindVertexArray(vao);
-
-  glad_glEnableVertexAttribArray(0);
-  glad_glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
-  glad_glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+  // 1 = normal
+  // 3 = uv
+  handle vao_handle =
+      gl_resource_create(&resources, GL_RESOURCE_VERTEX_ARRAY, "mesh vao");
+  GLuint vao = gl_resource_name(&resources, vao_handle);
+  glstate_bind_vertex_array(vao);
+
+  double upload_start = glfwGetTime();
+  mesh_upload(&mesh, vbo, ebo);
+  mesh_bind_attributes(vbo, 0, 1, 3);
+  double upload_ms = (glfwGetTime() - upload_start) * 1000.0;
+
+  printf("MESH:: %s %u vertices %u triangles from %s\n"
+         "MESH:: import %.2fms lods %.2fms cache write %.2fms "
+         "cache load %.2fms upload %.2fms\n",
+         MESH_FILE, mesh.vertex_count, mesh.lods[0].index_count / 3,
+         mesh_stats.from_cache ? "cache" : "source", mesh_stats.import_ms,
+         mesh_stats.lod_ms, mesh_stats.cache_write_ms,
+         mesh_stats.cache_load_ms, upload_ms);
+  for (uint32_t i = 0; i < mesh.lod_count; ++i) {
+    printf("MESH:: lod %u %u triangles error %.4f\n", i,
+           mesh.lods[i].index_count / 3, mesh.lods[i].error);
+  }
 
-  glad_glEnableVertexAttribArray(1);
-  glad_glBindBuffer(GL_ARRAY_BUFFER, colour_vbo);
-  glad_glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+  // bounds and lod ranges are all that is needed after the upload
+  aabb local_box = mesh.bounds;
+  mesh_lod lods[MESH_MAX_LODS];
+  uint32_t lod_count = mesh.lod_count;
+  memcpy(lods, mesh.lods, sizeof(lods));
+  mesh_destroy(&mesh);
+
+  // DRAW LIST
+  // every draw of a pass goes through one glMultiDrawElementsIndirect
+  // 2 = draw id, per draw index from base_instance
+  draw_list draws;
+  if (not draw_list_init(&draws, 64)) {
+    return EXIT_FAILURE;
+  }
+  draw_list_bind_draw_id(&draws, 2);
 
   // SHADER PROGRAM
-  GLuint program = glad_glCreateProgram();
-  if (not create_shaders_and_link_to_program(program, VERT_FILE, FRAG_FILE)) {
+  handle program_handle =
+      gl_resource_create(&resources, GL_RESOURCE_PROGRAM, "forward program");
+  GLuint program = gl_resource_name(&resources, program_handle);
+  if (not create_shaders_and_link_to_program(
+          program, packed ? &assets : NULL, VERT_FILE, FRAG_FILE)) {
+    return EXIT_FAILURE;
+  }
+
+  glstate_use_program(program);
+
+  // DEFERRED
+  // opaque draws switch to the g-buffer program, lights are culled per tile
+  handle gbuffer_handle =
+      gl_resource_create(&resources, GL_RESOURCE_PROGRAM, "g-buffer program");
+  handle deferred_light_handle = gl_resource_create(
+      &resources, GL_RESOURCE_PROGRAM, "deferred light program");
+  GLuint gbuffer_program = gl_resource_name(&resources, gbuffer_handle);
+  GLuint deferred_light_program =
+      gl_resource_name(&resources, deferred_light_handle);
+  if (not create_shaders_and_link_to_program(
+          gbuffer_program, packed ? &assets : NULL, GBUFFER_VERT_FILE,
+          GBUFFER_FRAG_FILE) or
+      not create_compute_shader_and_link_to_program(
+          deferred_light_program, packed ? &assets : NULL,
+          DEFERRED_LIGHT_FILE)) {
+    return EXIT_FAILURE;
+  }
+  deferred_renderer deferred;
+  if (not deferred_init(&deferred, WIDTH, HEIGHT, deferred_light_program)) {
+    return EXIT_FAILURE;
+  }
+  light_buffer lights;
+  if (not light_buffer_init(&lights, LIGHT_COUNT)) {
+    return EXIT_FAILURE;
+  }
+
+  // the lights wander around and just in front of the grid
+  vec3 light_min = vec3_new(-2.5f, -2.5f, -2.5f);
+  vec3 light_max = vec3_new(2.5f, 2.5f, 1.0f);
+  aabb light_area = aabb_new(&light_min, &light_max);
+  printf("DEFERRED:: %dx%d g-buffer %dx%d tiles %d lights\n", WIDTH, HEIGHT,
+         (WIDTH + DEFERRED_TILE_SIZE - 1) / DEFERRED_TILE_SIZE,
+         (HEIGHT + DEFERRED_TILE_SIZE - 1) / DEFERRED_TILE_SIZE, LIGHT_COUNT);
+
+  // CLUSTERS
+  // the same lights listed per froxel on the cpu, for forward shading
+  handle forward_plus_handle =
+      gl_resource_create(&resources, GL_RESOURCE_PROGRAM, "forward+ program");
+  GLuint forward_plus_program =
+      gl_resource_name(&resources, forward_plus_handle);
+  if (not create_shaders_and_link_to_program(
+          forward_plus_program, packed ? &assets : NULL,
+          FORWARD_PLUS_VERT_FILE, FORWARD_PLUS_FRAG_FILE)) {
+    return EXIT_FAILURE;
+  }
+  cluster_grid clusters;
+  if (not clusters_init(&clusters, CLUSTER_X, CLUSTER_Y, CLUSTER_Z,
+                        FIELD_OF_VIEW, (float)WIDTH / (float)HEIGHT,
+                        NEAR_PLANE, FAR_PLANE)) {
+    return EXIT_FAILURE;
+  }
+  printf("CLUSTERS:: %dx%dx%d cells\n", CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+
+  // SHADOWS
+  // depth of every caster seen from the sun, in cascades along the view
+  handle shadow_handle =
+      gl_resource_create(&resources, GL_RESOURCE_PROGRAM, "shadow program");
+  GLuint shadow_program = gl_resource_name(&resources, shadow_handle);
+  if (not create_vertex_shader_and_link_to_program(
+          shadow_program, packed ? &assets : NULL, SHADOW_VERT_FILE)) {
+    return EXIT_FAILURE;
+  }
+  shadow_map shadows;
+  if (not shadow_init(&shadows, SHADOW_SIZE, shadow_program, FIELD_OF_VIEW,
+                      (float)WIDTH / (float)HEIGHT, NEAR_PLANE,
+                      SHADOW_DISTANCE, vbo, ebo)) {
+    return EXIT_FAILURE;
+  }
+  // the sun is high, behind and to the right of the camera
+  vec3 sun = vec3_new(-0.4f, -0.8f, -0.6f);
+  printf("SHADOWS:: %d cascades %dx%d over %.0f units, %d cached\n",
+         SHADOW_CASCADES, SHADOW_SIZE, SHADOW_SIZE, SHADOW_DISTANCE,
+         SHADOW_CASCADES - SHADOW_CACHED_FIRST);
+
+  // HIZ
+  // depth pyramid of the last frame, hidden draws are dropped on the gpu
+  handle hiz_build_handle =
+      gl_resource_create(&resources, GL_RESOURCE_PROGRAM, "hiz build program");
+  handle hiz_cull_handle =
+      gl_resource_create(&resources, GL_RESOURCE_PROGRAM, "hiz cull program");
+  GLuint hiz_build_program = gl_resource_name(&resources, hiz_build_handle);
+  GLuint hiz_cull_program = gl_resource_name(&resources, hiz_cull_handle);
+  if (not create_compute_shader_and_link_to_program(
+          hiz_build_program, packed ? &assets : NULL, HIZ_BUILD_FILE) or
+      not create_compute_shader_and_link_to_program(
+          hiz_cull_program, packed ? &assets : NULL, HIZ_CULL_FILE)) {
+    return EXIT_FAILURE;
+  }
+  hiz occlusion;
+  if (not hiz_init(&occlusion, WIDTH, HEIGHT, hiz_build_program,
+                   hiz_cull_program)) {
+    return EXIT_FAILURE;
+  }
+  printf("HIZ:: %dx%d pyramid %d levels\n", WIDTH / 2, HEIGHT / 2,
+         occlusion.levels);
+
+  // PARTICLES
+  // state lives in shader storage, the cpu only issues the dispatches
+  handle particle_handles[5];
+  const char *particle_labels[5] = {"particle emit program",
+                                    "particle dispatch program",
+                                    "particle simulate program",
+                                    "particle draw program",
+                                    "cpu particle draw program"};
+  GLuint particle_names[5];
+  for (int i = 0; i < 5; ++i) {
+    particle_handles[i] = gl_resource_create(&resources, GL_RESOURCE_PROGRAM,
+                                             particle_labels[i]);
+    particle_names[i] = gl_resource_name(&resources, particle_handles[i]);
+  }
+  particle_programs particle_shaders = {
+      .emit = particle_names[0],
+      .dispatch = particle_names[1],
+      .simulate = particle_names[2],
+      .draw = particle_names[3],
+  };
+  if (not create_compute_shader_and_link_to_program(
+          particle_shaders.emit, packed ? &assets : NULL,
+          PARTICLE_EMIT_FILE) or
+      not create_compute_shader_and_link_to_program(
+          particle_shaders.dispatch, packed ? &assets : NULL,
+          PARTICLE_DISPATCH_FILE) or
+      not create_compute_shader_and_link_to_program(
+          particle_shaders.simulate, packed ? &assets : NULL,
+          PARTICLE_SIMULATE_FILE) or
+      not create_shaders_and_link_to_program(
+          particle_shaders.draw, packed ? &assets : NULL, PARTICLE_VERT_FILE,
+          PARTICLE_FRAG_FILE) or
+      not create_shaders_and_link_to_program(
+          particle_names[4], packed ? &assets : NULL, PARTICLE_CPU_VERT_FILE,
+          PARTICLE_FRAG_FILE)) {
+    return EXIT_FAILURE;
+  }
+  particle_system particles;
+  if (not particles_init(&particles, PARTICLE_COUNT, &particle_shaders)) {
+    return EXIT_FAILURE;
+  }
+  // a region is rewritten once the packets and frames in flight after it
+  // have drawn, the pacer has retired it from the gpu by then
+  cpu_particle_system cpu_particles;
+  if (not cpu_particles_init(&cpu_particles, PARTICLE_COUNT,
+                             RENDER_PACKETS + MAX_FRAMES_IN_FLIGHT + 1,
+                             particle_names[4])) {
+    return EXIT_FAILURE;
+  }
+  // fountain in front of the grid
+  particle_emitter emitter = {
+      .origin = {0.0f, -1.5f, 0.5f},
+      .rate = PARTICLE_RATE,
+      .speed = 2.5f,
+      .spread = 0.35f,
+      .lifetime = 2.0f,
+      .size = 0.03f,
+  };
+
+  // TEXTURES
+  // decoded in the background and streamed in by the render thread
+  texture_streamer textures;
+  if (not texture_streamer_init(&textures, TEXTURE_UPLOAD_BUDGET,
+                                packed ? &assets : NULL, &damage)) {
     return EXIT_FAILURE;
   }
 
-  glad_glUseProgram(program);
+  // ATLAS
+  // one bind serves every object, each samples its own rect
+  float uv_transforms[OBJECT_COUNT][4];
+  atlas object_atlas;
+  double atlas_start = pacer_now_ms();
+  if (not atlas_init(&object_atlas, ATLAS_SIZE, ATLAS_SIZE, ATLAS_BORDER,
+                     ATLAS_ALIGN) or
+      not build_atlas(&object_atlas, packed ? &assets : NULL,
+                      uv_transforms)) {
+    return EXIT_FAILURE;
+  }
+  printf("ATLAS:: %d textures %.0f%% used %d mip levels in %.2fms\n",
+         OBJECT_COUNT, atlas_occupancy(&object_atlas) * 100.0f,
+         atlas_mip_levels(&object_atlas), pacer_now_ms() - atlas_start);
+
+  // compressed once, later runs stream the cached blocks straight to gl
+  uint64_t atlas_key = texcache_key(&object_atlas.pixels);
+  bool atlas_cached = texcache_current(ATLAS_CACHE_FILE, atlas_key);
+  if (not atlas_cached) {
+    double compress_start = pacer_now_ms();
+    atlas_cached = texcache_write(ATLAS_CACHE_FILE, &object_atlas.pixels,
+                                  ATLAS_FORMAT, atlas_mip_levels(&object_atlas),
+                                  atlas_key);
+    printf("BCN:: %s %s in %.2fms\n", ATLAS_CACHE_FILE,
+           bc_format_name(ATLAS_FORMAT), pacer_now_ms() - compress_start);
+  }
+  uint32_t atlas_texture =
+      atlas_cached
+          ? texture_request(&textures, ATLAS_CACHE_FILE)
+          : texture_request_image(&textures, "object atlas",
+                                  &object_atlas.pixels,
+                                  atlas_mip_levels(&object_atlas));
+  atlas_destroy(&object_atlas);
 
   /* FPS Timer */
   double previous_fps = glfwGetTime();
 
-  mat4 projection = perspective(DEG2RAD(67.0),
+  mat4 projection = perspective(FIELD_OF_VIEW,
 				(float)WIDTH / (float)HEIGHT,
-				0.1,
-				100.0);
+				NEAR_PLANE,
+				FAR_PLANE);
+
+  /* CAMERA */
+  vec3 eye = vec3_new(0.0f, 0.0f, 3.0f);
+  vec3 to_view = vec3_mul(&eye, -1.0f);
+  mat4 view = mat4_identity();
+  view = mat4_translation(&view, &to_view);
+
+  /* OBJECTS */
+  // 4x4 grid of triangles under one root node, and their tints
+  transform_hierarchy transforms;
+  if (not transform_init(&transforms, SCENE_COUNT + 1)) {
+    return EXIT_FAILURE;
+  }
+  uint32_t grid_node = transform_create(&transforms, TRANSFORM_NONE);
+
+  uint32_t object_nodes[SCENE_COUNT];
+  float tints[SCENE_COUNT][4];
+  for (int i = 0; i < OBJECT_COUNT; ++i) {
+    vec3 scale = vec3_new(0.5f, 0.5f, 0.5f);
+    // tilted so three faces of each mesh face the camera
+    vec3 rotation = vec3_new(25.0f, 35.0f, 0.0f);
+    vec3 position = vec3_new((float)(i % 4) - 1.5f, (float)(i / 4) - 1.5f,
+                             -(float)(i % 3));
+    object_nodes[i] = transform_create(&transforms, grid_node);
+    transform_set_scale(&transforms, object_nodes[i], &scale);
+    transform_set_rotation(&transforms, object_nodes[i], &rotation);
+    transform_set_position(&transforms, object_nodes[i], &position);
+
+    tints[i][0] = 0.5f + 0.5f * (float)(i % 2);
+    tints[i][1] = 0.5f + 0.5f * (float)((i / 2) % 2);
+    tints[i][2] = 1.0f;
+    tints[i][3] = 1.0f;
+  }
 
+  // a wall behind the grid and a floor under it, never moved so their
+  // shadows stay cached
+  const float scenery[SCENERY_COUNT][2][3] = {
+      {{0.0f, 0.0f, -4.5f}, {14.0f, 10.0f, 0.5f}},
+      {{0.0f, -3.0f, -1.5f}, {14.0f, 0.5f, 7.0f}},
+  };
+  for (int s = 0; s < SCENERY_COUNT; ++s) {
+    int i = OBJECT_COUNT + s;
+    vec3 position = vec3_new(scenery[s][0][0], scenery[s][0][1],
+                             scenery[s][0][2]);
+    vec3 scale = vec3_new(scenery[s][1][0], scenery[s][1][1],
+                          scenery[s][1][2]);
+    object_nodes[i] = transform_create(&transforms, TRANSFORM_NONE);
+    transform_set_scale(&transforms, object_nodes[i], &scale);
+    transform_set_position(&transforms, object_nodes[i], &position);
+
+    tints[i][0] = 0.8f;
+    tints[i][1] = 0.8f;
+    tints[i][2] = 0.8f;
+    tints[i][3] = 1.0f;
+  }
+
+  /* BOUNDS */
+  // world space bounds of each object, tested against the frustum
+
+  aabb world_boxes[SCENE_COUNT];
+  bounds_soa bounds;
+  if (not bounds_soa_init(&bounds, SCENE_COUNT)) {
+    return EXIT_FAILURE;
+  }
+  transform_update(&transforms);
+  for (int i = 0; i < SCENE_COUNT; ++i) {
+    const mat4 *model = transform_world(&transforms, object_nodes[i]);
+    world_boxes[i] = aabb_transform(&local_box, model);
+    bounds_soa_push(&bounds, &world_boxes[i], NULL);
+  }
+
+  // scene bvh for queries, large scenes cull through it too
+  bvh scene_bvh;
+  if (not bvh_build(&scene_bvh, world_boxes, SCENE_COUNT)) {
+    return EXIT_FAILURE;
+  }
+
+  /* LOD */
+  // a mesh unit at distance d covers pixels_per_unit * scale / d pixels
+  vec3 local_extent = vec3_sub(&local_box.max, &local_box.min);
+  float local_radius = 0.5f * vec3_len(&local_extent);
+  float pixels_per_unit = projection._22 * (float)HEIGHT * 0.5f;
+  uint32_t object_lods[SCENE_COUNT] = {0};
+
+  /* UNIFORMS */
+  // camera ubo at binding 0, per draw object ssbo at binding 1
+  uniform_buffers uniforms;
+  if (not uniforms_init(&uniforms, SCENE_COUNT)) {
+    return EXIT_FAILURE;
+  }
+
+  camera_block camera;
+  camera_block_set(&camera, &view, &projection, &eye);
+
+  /* FRAME ARENA */
+  // transient per frame data, no heap allocations inside the loop
+  frame_arena frame;
+  if (not frame_arena_init(&frame, FRAME_ARENA_SIZE)) {
+    return EXIT_FAILURE;
+  }
+
+  arena title_scratch;
+  if (not arena_init(&title_scratch, TITLE_ARENA_SIZE)) {
+    return EXIT_FAILURE;
+  }
 
   /* Defaults */
-  glad_glEnable(GL_CULL_FACE);
-  glad_glCullFace(GL_BACK);
-  glad_glFrontFace(GL_CW);
+  glstate_enable(GL_CULL_FACE);
+  glstate_cull_face(GL_BACK);
+  glstate_front_face(GL_CCW);
+
+  /* FRAME PACKETS */
+  // each packet has its own render queue, draws are sorted by key each
+  // frame to minimise state changes
+  frame_packet packets[RENDER_PACKETS] = {0};
+  void *packet_slots[RENDER_PACKETS];
+  for (int i = 0; i < RENDER_PACKETS; ++i) {
+    if (not render_queue_init(&packets[i].queue, 64)) {
+      return EXIT_FAILURE;
+    }
+    packet_slots[i] = &packets[i];
+  }
 
-  while (not glfwWindowShouldClose(window)) {
-    update_fps(&previous_fps, window);
+  /* PACING */
+  // limiter runs on the main thread before input is polled, fences and
+  // swap interval on the render thread
+  frame_limiter limiter;
+  frame_limiter_init(&limiter, requested_limit ? LIMIT_FPS : 0);
+  bool limit = requested_limit;
+
+  frame_pacer pacer;
+  frame_pacer_init(&pacer, requested_present, false, MAX_FRAMES_IN_FLIGHT);
+
+  /* RENDER THREAD */
+  // the render thread owns the context from here until it stops, the main
+  // thread records frame n + 1 while frame n is submitted
+  render_context render_data = {
+      .window = window,
+      .draws = &draws,
+      .uniforms = &uniforms,
+      .pacer = &pacer,
+      .textures = &textures,
+      .hiz = &occlusion,
+      .particles = &particles,
+      .cpu_particles = &cpu_particles,
+      .deferred = &deferred,
+      .lights = &lights,
+      .clusters = &clusters,
+      .shadows = &shadows,
+  };
+  if (RENDER_THREADED) {
+    glfwMakeContextCurrent(NULL);
+  }
+  render_thread render;
+  if (not render_thread_start(&render, packet_slots, render_frame,
+                              render_attach, render_detach, &render_data,
+                              RENDER_THREADED)) {
+    return EXIT_FAILURE;
+  }
+
+  frame_stats stats = {0};
 
-    /* */
-    glad_glClearColor(0.1, 0.1, 0.1, 1.0);
-    glad_glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glad_glViewport(0, 0, WIDTH, HEIGHT);
+  // animation time only advances while animating
+  double animation_time = 0.0;
+  double previous_time = glfwGetTime();
+  bool animating = false;
+
+  while (not glfwWindowShouldClose(window)) {
+    double now = glfwGetTime();
+    double step = animating ? now - previous_time : 0.0;
+    animation_time += step;
+    previous_time = now;
+    animating = requested_animate;
+    if (animating) {
+      damage_mark(&damage, DAMAGE_ANIMATION);
+    }
 
-    /* DRAW */
-    glad_glUseProgram(program);
-    glad_glBindVertexArray(vao);
-    glad_glDrawArrays(GL_TRIANGLES, 0, 3);
+    /* IDLE */
+    // nothing changed, block on events instead of drawing the same image
+    if (not damage_pending(&damage)) {
+      double wait_start = pacer_now_ms();
+      if (damage_wait_begin(&damage)) {
+        glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+      }
+      damage_wait_end(&damage);
+
+      // events like cursor motion wake the wait without changing anything
+      if (not damage_pending(&damage)) {
+        damage_skip(&damage, pacer_now_ms() - wait_start);
+        stats.frames_skipped = damage.frames_skipped;
+        stats.idle_ms = damage.idle_ms;
+        arena_reset(&title_scratch);
+        update_fps(&previous_fps, window, &stats, &render, &title_scratch);
+        continue;
+      }
+    }
 
-    // wireframe mode
-    // glad_glPolygonMode(GL_FRONT, GL_LINE);
+    if (limit != requested_limit) {
+      limit = requested_limit;
+      frame_limiter_set_fps(&limiter, limit ? LIMIT_FPS : 0);
+    }
+    frame_limiter_wait(&limiter);
 
-    /* */
+    // packets and arena halves alternate together, so the arena the render
+    // thread reads is never the one being reset
+    frame_packet *packet = render_thread_acquire(&render);
+    frame_arena_begin(&frame);
+    arena *scratch = frame_arena_current(&frame);
 
-    glfwSwapBuffers(window);
+    // input is polled as late as possible before recording
     glfwPollEvents();
+    packet->input_ms = pacer_now_ms();
+    packet->present = requested_present;
+    packet->hiz_enabled = requested_hiz;
+    packet->particles_enabled = requested_particles;
+    packet->particles_on_cpu = requested_cpu_particles;
+    packet->lighting = requested_lighting;
+    packet->shadows_enabled = requested_shadows;
+    packet->sun = sun;
+    packet->emitter = emitter;
+    packet->delta = (float)step;
+    damage_take(&damage);
+
+    // results of the last frame rendered from this packet
+    stats.gl = packet->gl;
+    stats.queue = packet->queue_stats;
+    stats.pacer = packet->pacer;
+    stats.textures = packet->textures;
+    stats.hiz = packet->hiz;
+    stats.hiz_enabled = requested_hiz;
+    stats.particles = packet->particles;
+    stats.particles_enabled = requested_particles;
+    stats.particles_on_cpu = requested_cpu_particles;
+    stats.deferred = packet->deferred;
+    stats.lighting = requested_lighting;
+    stats.shadows = packet->shadows;
+    stats.shadows_enabled = requested_shadows;
+    stats.present = requested_present;
+    stats.limit_fps = limit ? LIMIT_FPS : 0;
+    stats.frames_drawn = damage.frames_drawn;
+    arena_reset(&title_scratch);
+    update_fps(&previous_fps, window, &stats, &render, &title_scratch);
+
+    /* UPDATE */
+    // slowly spin the whole grid, children follow their parent
+    vec3 grid_rotation = vec3_new(0.0f, 0.0f, (float)animation_time * 10.0f);
+    transform_set_rotation(&transforms, grid_node, &grid_rotation);
+    stats.transforms_updated = transform_update(&transforms);
+
+    for (int i = 0; i < SCENE_COUNT; ++i) {
+      if (not transform_was_updated(&transforms, object_nodes[i])) {
+        continue;
+      }
+      const mat4 *model = transform_world(&transforms, object_nodes[i]);
+      world_boxes[i] = aabb_transform(&local_box, model);
+      bounds_soa_set(&bounds, (uint32_t)i, &world_boxes[i], NULL);
+      bvh_update(&scene_bvh, (uint32_t)i, &world_boxes[i]);
+    }
+
+    frustum view_frustum = frustum_from_mat4(&camera.view_projection);
+    stats.cull = (cull_stats){0};
+    // out of scratch the frame draws nothing, the arena reports it
+    uint32_t *visible = arena_push_array(scratch, uint32_t, bounds.count);
+    packet->objects = arena_push_array(scratch, object_block, SCENE_COUNT);
+    uint32_t visible_count;
+    if (not visible or not packet->objects) {
+      visible_count = 0;
+    } else if (scene_bvh.count >= BVH_MIN_OBJECTS) {
+      visible_count = bvh_query_frustum(&scene_bvh, &view_frustum, visible,
+                                        bounds.count, &stats.cull);
+    } else {
+      visible_count = frustum_cull_parallel(&view_frustum, &bounds, 0,
+                                            bounds.count, visible, &stats.cull);
+    }
+
+    /* RECORD */
+    // the same draws either shade themselves or fill the g-buffer
+    GLuint opaque_program = program;
+    if (requested_lighting == LIGHTING_DEFERRED) {
+      opaque_program = gbuffer_program;
+    } else if (requested_lighting == LIGHTING_CLUSTERED) {
+      opaque_program = forward_plus_program;
+    }
+    render_queue *queue = &packet->queue;
+    render_queue_clear(queue);
+    stats.triangles = 0;
+    stats.lod_switches = 0;
+    stats.dropped_draws = 0;
+
+    for (uint32_t v = 0; v < visible_count; ++v) {
+      uint32_t i = visible[v];
+      const mat4 *model = transform_world(&transforms, object_nodes[i]);
+      vec3 position = vec3_new(model->_41, model->_42, model->_43);
+      vec3 to_eye = vec3_sub(&eye, &position);
+      float depth = vec3_len(&to_eye);
+
+      // level from how large the object is on screen
+      vec3 world_extent = vec3_sub(&world_boxes[i].max, &world_boxes[i].min);
+      float scale = local_radius > 0.0f
+                        ? 0.5f * vec3_len(&world_extent) / local_radius
+                        : 1.0f;
+      float projected =
+          pixels_per_unit * scale / (depth > NEAR_PLANE ? depth : NEAR_PLANE);
+      uint32_t lod = mesh_select_lod(lods, lod_count, projected,
+                                     LOD_PIXEL_ERROR, LOD_HYSTERESIS,
+                                     object_lods[i]);
+      stats.lod_switches += lod != object_lods[i];
+      object_lods[i] = lod;
+
+      render_item item = {
+          .key = render_key_opaque(RENDER_PASS_OPAQUE, opaque_program, 0,
+                                   depth),
+          .object = i,
+          .program = opaque_program,
+          .vao = vao,
+          .texture = texture_name(&textures, atlas_texture),
+          .count = lods[lod].index_count,
+          .first_index = lods[lod].first_index,
+          .base_vertex = 0,
+      };
+      if (render_queue_push(queue, &item)) {
+        stats.triangles += lods[lod].index_count / 3;
+      } else {
+        ++stats.dropped_draws;
+      }
+    }
+
+    render_queue_sort(queue);
+
+    // room for the render thread to order the objects by draw, without it
+    // the frames draws are dropped
+    packet->draw_objects =
+        arena_push_array(scratch, object_block, queue->count);
+    if (not packet->draw_objects) {
+      stats.dropped_draws += queue->count;
+      stats.triangles = 0;
+      render_queue_clear(queue);
+    }
+
+    // per object data, put in draw id order by the render thread
+    for (uint32_t v = 0; v < visible_count; ++v) {
+      uint32_t idx = visible[v];
+      mat4_cpy(&packet->objects[idx].model,
+               transform_world(&transforms, object_nodes[idx]));
+      memcpy(packet->objects[idx].colour, tints[idx], sizeof(tints[idx]));
+      // scenery stretches the first atlas rect
+      const float *uv = uv_transforms[idx < OBJECT_COUNT ? idx : 0];
+      memcpy(packet->objects[idx].uv_transform, uv, sizeof(uv_transforms[0]));
+      const aabb *box = &world_boxes[idx];
+      float *bounds_min = packet->objects[idx].bounds_min;
+      float *bounds_max = packet->objects[idx].bounds_max;
+      bounds_min[0] = box->min.x;
+      bounds_min[1] = box->min.y;
+      bounds_min[2] = box->min.z;
+      bounds_min[3] = 1.0f;
+      bounds_max[0] = box->max.x;
+      bounds_max[1] = box->max.y;
+      bounds_max[2] = box->max.z;
+      bounds_max[3] = 1.0f;
+    }
+    packet->camera = camera;
+
+    /* SHADOWS */
+    // every object casts, seen or not, at the level it was last drawn with.
+    // out of scratch the frame is drawn as if shadows were off
+    packet->casters = NULL;
+    packet->caster_count = 0;
+    if (requested_shadows) {
+      packet->casters = arena_push_array(scratch, shadow_caster, SCENE_COUNT);
+      packet->shadows_enabled = packet->casters != NULL;
+    }
+    if (packet->casters) {
+      packet->caster_count = SCENE_COUNT;
+      for (uint32_t i = 0; i < SCENE_COUNT; ++i) {
+        shadow_caster *caster = &packet->casters[i];
+        mat4_cpy(&caster->model, transform_world(&transforms, object_nodes[i]));
+        caster->count = lods[object_lods[i]].index_count;
+        caster->first_index = lods[object_lods[i]].first_index;
+        caster->is_static = i >= OBJECT_COUNT;
+      }
+    }
+
+    /* LIGHTS */
+    // out of scratch the frame is lit by the sun alone
+    packet->lights = NULL;
+    packet->light_count = 0;
+    if (requested_lighting != LIGHTING_FORWARD) {
+      packet->lights = arena_push_array(scratch, point_light, LIGHT_COUNT);
+    }
+    if (packet->lights) {
+      packet->light_count = LIGHT_COUNT;
+      lights_animate(packet->lights, LIGHT_COUNT, &light_area, LIGHT_RADIUS,
+                     (float)animation_time);
+    }
+    // lists for the clustered mode, every cell empty if scratch ran out
+    stats.clusters = (cluster_stats){0};
+    packet->clusters = (cluster_lists){0};
+    if (requested_lighting == LIGHTING_CLUSTERED and
+        not clusters_assign(&clusters, packet->lights, packet->light_count,
+                            &camera.view, scratch, &packet->clusters,
+                            &stats.clusters)) {
+      fprintf(stderr, "ERROR: frame arena too small for cluster lists\n");
+    }
+
+    /* PARTICLES */
+    // cpu particles go straight into mapped vertices across the workers
+    if (requested_particles and requested_cpu_particles) {
+      packet->particle_region = cpu_particles_update(
+          &cpu_particles, &emitter, (float)step, &stats.cpu_particles);
+    }
+
+    render_thread_submit(&render);
+  }
+
+  // take the context back to free gl objects
+  render_thread_stop(&render);
+  glfwMakeContextCurrent(window);
+
+  frame_arena_report(&frame);
+  frame_arena_destroy(&frame);
+  arena_destroy(&title_scratch);
+  bvh_destroy(&scene_bvh);
+  transform_destroy(&transforms);
+  bounds_soa_destroy(&bounds);
+  uniforms_destroy(&uniforms);
+  for (int i = 0; i < RENDER_PACKETS; ++i) {
+    render_queue_destroy(&packets[i].queue);
+  }
+  draw_list_destroy(&draws);
+
+  texture_streamer_destroy(&textures);
+  hiz_destroy(&occlusion);
+  deferred_destroy(&deferred);
+  clusters_destroy(&clusters);
+  shadow_destroy(&shadows);
+  light_buffer_destroy(&lights);
+  particles_destroy(&particles);
+  cpu_particles_destroy(&cpu_particles);
+  for (int i = 0; i < 5; ++i) {
+    gl_resource_destroy(&resources, particle_handles[i]);
   }
+  gl_resource_destroy(&resources, shadow_handle);
+  gl_resource_destroy(&resources, forward_plus_handle);
+  gl_resource_destroy(&resources, deferred_light_handle);
+  gl_resource_destroy(&resources, gbuffer_handle);
+  gl_resource_destroy(&resources, hiz_cull_handle);
+  gl_resource_destroy(&resources, hiz_build_handle);
+  gl_resource_destroy(&resources, program_handle);
+  gl_resource_destroy(&resources, ebo_handle);
+  gl_resource_destroy(&resources, vao_handle);
+  gl_resource_destroy(&resources, vbo_handle);
+  gl_resources_shutdown(&resources);
+  jobs_shutdown();
+  pack_close(&assets);
 
   // CLEAN UP WINDOW
   glfwDestroyWindow(window);
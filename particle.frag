@@ -0,0 +1,12 @@
+#version 440
+
+in vec2 corner;
+in vec4 tint;
+out vec4 frag_col;
+
+void main()
+{
+    // round soft sprite, blended additively
+    float falloff = max(1.0 - dot(corner, corner), 0.0);
+    frag_col = vec4(tint.rgb * tint.a * falloff, 1.0);
+}
@@ -0,0 +1,46 @@
+#version 440
+
+layout(std140, binding = 0) uniform camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec4 position;
+} cam;
+
+struct particle
+{
+    vec4 position;
+    vec4 velocity;
+};
+
+layout(std430, binding = 4) readonly buffer particles
+{
+    particle state[];
+};
+
+layout(std430, binding = 5) readonly buffer alive_lists
+{
+    uint alive[];
+};
+
+layout(location = 0) uniform uint list;
+layout(location = 1) uniform float size;
+
+out vec2 corner;
+out vec4 tint;
+
+void main()
+{
+    particle p = state[alive[list + gl_InstanceID]];
+    float t = p.position.w / p.velocity.w;
+
+    // 4 vertex strip facing the camera, the view rotation holds its axes
+    corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 right = vec3(cam.view[0][0], cam.view[1][0], cam.view[2][0]);
+    vec3 up = vec3(cam.view[0][1], cam.view[1][1], cam.view[2][1]);
+    vec3 world = p.position.xyz + (corner.x * right + corner.y * up) * size * (1.0 - 0.5 * t);
+
+    tint = mix(vec4(1.0, 0.8, 0.4, 1.0), vec4(0.9, 0.2, 0.1, 0.0), t);
+    gl_Position = cam.view_projection * vec4(world, 1.0);
+}
@@ -0,0 +1,32 @@
+#version 440
+
+layout(std140, binding = 0) uniform camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec4 position;
+} cam;
+
+// xyz position, w age over lifetime, one per instance
+layout(location = 0) in vec4 v_particle;
+
+layout(location = 1) uniform float size;
+
+out vec2 corner;
+out vec4 tint;
+
+void main()
+{
+    float t = v_particle.w;
+
+    // 4 vertex strip facing the camera, dead particles collapse to a point
+    corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 right = vec3(cam.view[0][0], cam.view[1][0], cam.view[2][0]);
+    vec3 up = vec3(cam.view[0][1], cam.view[1][1], cam.view[2][1]);
+    float scale = t < 1.0 ? size * (1.0 - 0.5 * t) : 0.0;
+    vec3 world = v_particle.xyz + (corner.x * right + corner.y * up) * scale;
+
+    tint = mix(vec4(1.0, 0.8, 0.4, 1.0), vec4(0.9, 0.2, 0.1, 0.0), min(t, 1.0));
+    gl_Position = cam.view_projection * vec4(world, 1.0);
+}
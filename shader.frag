@@ -1,9 +1,49 @@
 #version 440
  
 in vec3 col;
+in vec3 normal;
+in vec2 uv;
+in vec3 world;
+in float depth;
 out vec4 frag_col;
 
+// one atlas for every object, white until it is resident
+layout(binding = 0) uniform sampler2D albedo;
+
+// cascades of the sun, see shadows.h
+layout(std140, binding = 1) uniform shadows
+{
+    mat4 cascade[4];
+    vec4 split;
+    vec4 texel;
+    vec4 sun;
+} shadow;
+
+layout(binding = 3) uniform sampler2DArrayShadow shadow_map;
+
+// 0 in the shadow of the sun, 1 in its light, filtered 2x2 by the sampler
+float sun_visibility(vec3 world, vec3 n, float depth)
+{
+    int c = 0;
+    int count = int(shadow.sun.w);
+    while (c < count && depth > shadow.split[c])
+        ++c;
+    if (c >= count)
+        return 1.0;
+
+    // out along the normal by about a texel, against acne on sloped faces
+    vec3 offset = n * shadow.texel[c] * 1.5;
+    vec4 p = shadow.cascade[c] * vec4(world + offset, 1.0);
+    return texture(shadow_map, vec4(p.xy, float(c), p.z));
+}
+
 void main()
 {
-    frag_col = vec4(col, 1.0);
+    // one directional light so the faces read as solid
+    vec3 n = normalize(normal);
+    float sun = max(dot(n, shadow.sun.xyz), 0.0);
+    if (sun > 0.0)
+        sun *= sun_visibility(world, n, depth);
+    float light = 0.35 + 0.65 * sun;
+    frag_col = vec4(col * light * texture(albedo, uv).rgb, 1.0);
 }
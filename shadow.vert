@@ -0,0 +1,19 @@
+#version 440
+
+layout(location = 0)in vec3 v_pos;
+layout(location = 2)in uint v_draw_id;
+
+// model of each caster, in draw order
+layout(std430, binding = 12) readonly buffer casters
+{
+    mat4 model[];
+};
+
+// light view projection of the cascade being drawn
+layout(location = 0) uniform mat4 view_projection;
+
+void main()
+{
+    // depth only, no fragment shader
+    gl_Position = view_projection * model[v_draw_id] * vec4(v_pos, 1.0);
+}
@@ -0,0 +1,128 @@
+/* *
+ * arena allocator
+ * */
+#include <assert.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "utils.h"
+
+/* ARENA */
+
+bool arena_init(arena *a, size_t size) {
+  assert(size > 0);
+  memset(a, 0, sizeof(*a));
+
+  a->base = malloc(size);
+  if (not a->base) {
+    fprintf(stderr, "ERROR: arena failed to reserve %zu bytes\n", size);
+    return false;
+  }
+
+  a->size = size;
+  return true;
+}
+
+void arena_destroy(arena *a) {
+  free(a->base);
+  memset(a, 0, sizeof(*a));
+}
+
+void *arena_alloc(arena *a, size_t size, size_t align) {
+  assert(align > 0 and (align & (align - 1)) == 0);
+
+  uintptr_t start = (uintptr_t)a->base + a->offset;
+  uintptr_t aligned = (start + (align - 1)) & ~(uintptr_t)(align - 1);
+  size_t offset = (size_t)(aligned - (uintptr_t)a->base);
+
+  if (offset + size > a->size) {
+    if (a->failed++ == 0) {
+      fprintf(stderr, "ERROR: arena full, %zu of %zu bytes used\n",
+              a->offset, a->size);
+    }
+    return NULL;
+  }
+
+  a->offset = offset + size;
+  if (a->offset > a->high_water) {
+    a->high_water = a->offset;
+  }
+
+  return a->base + offset;
+}
+
+void arena_reset(arena *a) { a->offset = 0; }
+
+char *arena_printf(arena *a, const char *format, ...) {
+  va_list list;
+  va_start(list, format);
+  int len = vsnprintf(NULL, 0, format, list);
+  va_end(list);
+
+  if (len < 0) {
+    return NULL;
+  }
+
+  char *buffer = arena_alloc(a, (size_t)len + 1, 1);
+  if (not buffer) {
+    return NULL;
+  }
+
+  va_start(list, format);
+  vsnprintf(buffer, (size_t)len + 1, format, list);
+  va_end(list);
+
+  return buffer;
+}
+
+/* FRAME ARENA */
+
+bool frame_arena_init(frame_arena *fa, size_t size) {
+  memset(fa, 0, sizeof(*fa));
+  if (not arena_init(&fa->arenas[0], size) or
+      not arena_init(&fa->arenas[1], size)) {
+    frame_arena_destroy(fa);
+    return false;
+  }
+  return true;
+}
+
+void frame_arena_destroy(frame_arena *fa) {
+  arena_destroy(&fa->arenas[0]);
+  arena_destroy(&fa->arenas[1]);
+}
+
+void frame_arena_begin(frame_arena *fa) {
+  fa->current ^= 1;
+  arena_reset(&fa->arenas[fa->current]);
+  ++fa->frame;
+}
+
+arena *frame_arena_current(frame_arena *fa) {
+  return &fa->arenas[fa->current];
+}
+
+arena *frame_arena_previous(frame_arena *fa) {
+  return &fa->arenas[fa->current ^ 1];
+}
+
+size_t frame_arena_high_water(const frame_arena *fa) {
+  size_t a = fa->arenas[0].high_water;
+  size_t b = fa->arenas[1].high_water;
+  return a > b ? a : b;
+}
+
+void frame_arena_report(const frame_arena *fa) {
+  size_t high_water = frame_arena_high_water(fa);
+  size_t size = fa->arenas[0].size;
+  unsigned failed = fa->arenas[0].failed + fa->arenas[1].failed;
+
+  printf("FRAME ARENA:: %u frames, high water %zu / %zu bytes (%.1f%%), "
+         "%u failed allocations\n",
+         fa->frame, high_water, size,
+         size ? 100.0 * (double)high_water / (double)size : 0.0, failed);
+}
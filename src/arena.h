@@ -0,0 +1,64 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* *
+ * linear bump allocator, everything is freed at once by arena_reset
+ * */
+struct arena {
+  unsigned char *base;
+  size_t size;
+  size_t offset;
+  // largest offset reached since init
+  size_t high_water;
+  // allocations that did not fit
+  unsigned failed;
+};
+typedef struct arena arena;
+
+/* *
+ * two arenas swapped every frame
+ *
+ * data allocated in frame N stays valid until the end of frame N + 1,
+ * so results can be read one frame later without copying.
+ * */
+struct frame_arena {
+  arena arenas[2];
+  int current;
+  unsigned frame;
+};
+typedef struct frame_arena frame_arena;
+
+/* reserve size bytes up front */
+bool arena_init(arena *a, size_t size);
+/* free reserved memory */
+void arena_destroy(arena *a);
+/* allocate size bytes aligned to align, NULL if full */
+void *arena_alloc(arena *a, size_t size, size_t align);
+/* release every allocation */
+void arena_reset(arena *a);
+/* format into arena memory, NULL if full */
+char *arena_printf(arena *a, const char *format, ...);
+
+/* allocate count items of type */
+#define arena_push_array(a, type, count)                                      \
+  ((type *)arena_alloc((a), sizeof(type) * (count), _Alignof(type)))
+
+/* reserve size bytes for each of the two frames */
+bool frame_arena_init(frame_arena *fa, size_t size);
+/* free both arenas */
+void frame_arena_destroy(frame_arena *fa);
+/* swap arenas and reset the one used two frames ago */
+void frame_arena_begin(frame_arena *fa);
+/* arena for this frame */
+arena *frame_arena_current(frame_arena *fa);
+/* arena of last frame, still valid until the next begin */
+arena *frame_arena_previous(frame_arena *fa);
+/* largest single frame use of either arena */
+size_t frame_arena_high_water(const frame_arena *fa);
+/* print usage to stdout */
+void frame_arena_report(const frame_arena *fa);
+
+#endif /* _ARENA_H_ */
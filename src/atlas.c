@@ -0,0 +1,257 @@
+/* *
+ * skyline texture atlas
+ * */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atlas.h"
+#include "bits.h"
+#include "utils.h"
+
+/* HELPERS */
+
+internal uint32_t clamp_u32(int64_t value, uint32_t max) {
+  if (value < 0) {
+    return 0;
+  }
+  return value > max ? max : (uint32_t)value;
+}
+
+/* *
+ * lowest y a width x height cell can sit at when its left edge is on
+ * node index, false if it runs off the atlas
+ * */
+internal bool skyline_fit(const atlas *a, uint32_t index, uint32_t width,
+                          uint32_t height, uint32_t *y) {
+  uint32_t x = a->skyline[index].x;
+  if (x + width > a->pixels.width) {
+    return false;
+  }
+
+  uint32_t top = 0;
+  int64_t left = width;
+  for (uint32_t i = index; left > 0; ++i) {
+    assert(i < a->node_count);
+    if (a->skyline[i].y > top) {
+      top = a->skyline[i].y;
+    }
+    if (top + height > a->pixels.height) {
+      return false;
+    }
+    left -= a->skyline[i].width;
+  }
+  *y = top;
+  return true;
+}
+
+/* raise the skyline over a new cell and merge runs at the same height */
+internal void skyline_insert(atlas *a, uint32_t index, uint32_t x,
+                             uint32_t top, uint32_t width) {
+  assert(a->node_count < a->node_capacity);
+  skyline_node *nodes = a->skyline;
+  memmove(nodes + index + 1, nodes + index,
+          sizeof(*nodes) * (a->node_count - index));
+  nodes[index] = (skyline_node){.x = x, .y = top, .width = width};
+  ++a->node_count;
+
+  // cut away the nodes now under the cell
+  uint32_t i = index + 1;
+  while (i < a->node_count) {
+    uint32_t end = nodes[i - 1].x + nodes[i - 1].width;
+    if (nodes[i].x >= end) {
+      break;
+    }
+    uint32_t overlap = end - nodes[i].x;
+    if (nodes[i].width > overlap) {
+      nodes[i].x += overlap;
+      nodes[i].width -= overlap;
+      break;
+    }
+    memmove(nodes + i, nodes + i + 1,
+            sizeof(*nodes) * (a->node_count - i - 1));
+    --a->node_count;
+  }
+
+  for (i = 0; i + 1 < a->node_count;) {
+    if (nodes[i].y == nodes[i + 1].y) {
+      nodes[i].width += nodes[i + 1].width;
+      memmove(nodes + i + 1, nodes + i + 2,
+              sizeof(*nodes) * (a->node_count - i - 2));
+      --a->node_count;
+    } else {
+      ++i;
+    }
+  }
+}
+
+/* copy img into its cell, rows and columns past the edges repeat them */
+internal void blit_extruded(atlas *a, const image *img, const atlas_rect *rect,
+                            uint32_t cell_width, uint32_t cell_height) {
+  uint32_t cell_x = rect->x - a->border;
+  uint32_t cell_y = rect->y - a->border;
+  size_t atlas_stride = (size_t)a->pixels.width * 4;
+  size_t row_bytes = (size_t)img->width * 4;
+  uint32_t right = cell_width - a->border - img->width;
+
+  for (uint32_t dy = 0; dy < cell_height; ++dy) {
+    uint32_t sy = clamp_u32((int64_t)dy - a->border, img->height - 1);
+    const uint8_t *src = img->pixels + sy * row_bytes;
+    uint8_t *dst = a->pixels.pixels + (cell_y + dy) * atlas_stride +
+                   (size_t)cell_x * 4;
+
+    for (uint32_t x = 0; x < a->border; ++x) {
+      memcpy(dst + x * 4, src, 4);
+    }
+    memcpy(dst + (size_t)a->border * 4, src, row_bytes);
+    uint8_t *tail = dst + (size_t)(a->border + img->width) * 4;
+    for (uint32_t x = 0; x < right; ++x) {
+      memcpy(tail + x * 4, src + row_bytes - 4, 4);
+    }
+  }
+}
+
+struct atlas_order {
+  uint32_t height;
+  uint32_t index;
+};
+typedef struct atlas_order atlas_order;
+
+internal int compare_taller(const void *lhs, const void *rhs) {
+  const atlas_order *a = lhs;
+  const atlas_order *b = rhs;
+  if (a->height != b->height) {
+    return a->height > b->height ? -1 : 1;
+  }
+  return a->index < b->index ? -1 : (a->index > b->index);
+}
+
+/* ATLAS */
+
+bool atlas_init(atlas *a, uint32_t width, uint32_t height, uint32_t border,
+                uint32_t align) {
+  assert(align > 0 and (align & (align - 1)) == 0);
+  assert(width % align == 0 and height % align == 0);
+  memset(a, 0, sizeof(*a));
+  a->border = border;
+  a->align = align;
+
+  // cells are at least align wide, so that bounds the node count
+  a->node_capacity = width / align + 1;
+  a->skyline = malloc(sizeof(*a->skyline) * a->node_capacity);
+  a->pixels.width = width;
+  a->pixels.height = height;
+  a->pixels.pixels = calloc((size_t)width * height, 4);
+  if (not a->skyline or not a->pixels.pixels) {
+    fprintf(stderr, "ERROR: out of memory for %ux%u atlas\n", width, height);
+    atlas_destroy(a);
+    return false;
+  }
+
+  a->skyline[0] = (skyline_node){.x = 0, .y = 0, .width = width};
+  a->node_count = 1;
+  return true;
+}
+
+void atlas_destroy(atlas *a) {
+  free(a->skyline);
+  image_destroy(&a->pixels);
+  memset(a, 0, sizeof(*a));
+}
+
+bool atlas_place(atlas *a, uint32_t width, uint32_t height, atlas_rect *rect) {
+  uint32_t cell_width = align_up(width + a->border * 2, a->align);
+  uint32_t cell_height = align_up(height + a->border * 2, a->align);
+
+  // lowest top edge wins, then the narrowest node to waste less
+  uint32_t best = UINT32_MAX;
+  uint32_t best_top = UINT32_MAX;
+  uint32_t best_y = 0;
+  for (uint32_t i = 0; i < a->node_count; ++i) {
+    uint32_t y;
+    if (not skyline_fit(a, i, cell_width, cell_height, &y)) {
+      continue;
+    }
+    uint32_t top = y + cell_height;
+    if (top < best_top or
+        (top == best_top and a->skyline[i].width < a->skyline[best].width)) {
+      best = i;
+      best_top = top;
+      best_y = y;
+    }
+  }
+  if (best == UINT32_MAX) {
+    return false;
+  }
+
+  uint32_t x = a->skyline[best].x;
+  skyline_insert(a, best, x, best_top, cell_width);
+  a->used_area += (uint64_t)cell_width * cell_height;
+
+  rect->x = x + a->border;
+  rect->y = best_y + a->border;
+  rect->width = width;
+  rect->height = height;
+  return true;
+}
+
+bool atlas_add(atlas *a, const image *img, atlas_rect *rect) {
+  if (not atlas_place(a, img->width, img->height, rect)) {
+    return false;
+  }
+  uint32_t cell_width = align_up(img->width + a->border * 2, a->align);
+  uint32_t cell_height = align_up(img->height + a->border * 2, a->align);
+  blit_extruded(a, img, rect, cell_width, cell_height);
+  return true;
+}
+
+bool atlas_add_all(atlas *a, const image *images, uint32_t count,
+                   atlas_rect *rects) {
+  atlas_order *order = malloc(sizeof(*order) * (count ? count : 1));
+  if (not order) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    order[i] = (atlas_order){.height = images[i].height, .index = i};
+  }
+  qsort(order, count, sizeof(*order), compare_taller);
+
+  bool ok = true;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t idx = order[i].index;
+    if (not atlas_add(a, &images[idx], &rects[idx])) {
+      memset(&rects[idx], 0, sizeof(rects[idx]));
+      ok = false;
+    }
+  }
+  free(order);
+  return ok;
+}
+
+void atlas_uv_transform(const atlas *a, const atlas_rect *rect,
+                        float transform[4]) {
+  // rects count rows from the top, v counts up from the bottom
+  float width = (float)a->pixels.width;
+  float height = (float)a->pixels.height;
+  transform[0] = (float)rect->width / width;
+  transform[1] = (float)rect->height / height;
+  transform[2] = (float)rect->x / width;
+  transform[3] = (float)(a->pixels.height - rect->y - rect->height) / height;
+}
+
+int atlas_mip_levels(const atlas *a) {
+  // level n texels span 2^n pixels, a whole one has to fit in the border
+  uint32_t safe = a->border < a->align ? a->border : a->align;
+  int levels = 1;
+  while (safe >= 2) {
+    safe >>= 1;
+    ++levels;
+  }
+  return levels;
+}
+
+float atlas_occupancy(const atlas *a) {
+  return (float)((double)a->used_area /
+                 ((double)a->pixels.width * a->pixels.height));
+}
@@ -0,0 +1,76 @@
+#ifndef _ATLAS_H_
+#define _ATLAS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "image.h"
+
+/* area an image was placed at, in pixels from the top left of the atlas */
+struct atlas_rect {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+};
+typedef struct atlas_rect atlas_rect;
+
+/* top edge of the packed area over [x, x + width) */
+struct skyline_node {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+};
+typedef struct skyline_node skyline_node;
+
+/* *
+ * skyline packed texture atlas
+ *
+ * every image gets a cell of its size plus border on each side, rounded
+ * up to align, and the cell is filled by repeating the image edges. cells
+ * start on multiples of align, so down to atlas_mip_levels the mips of one
+ * cell never blend with a neighbour.
+ *
+ * images are placed bottom left first along the skyline, one at a time
+ * for online use or sorted tallest first by atlas_add_all.
+ * */
+struct atlas {
+  uint32_t border;
+  uint32_t align;
+  skyline_node *skyline;
+  uint32_t node_count;
+  uint32_t node_capacity;
+  uint64_t used_area;
+  // rgba8, top row first like decoded images
+  image pixels;
+};
+typedef struct atlas atlas;
+
+/* align is a power of two, pixels start cleared */
+bool atlas_init(atlas *a, uint32_t width, uint32_t height, uint32_t border,
+                uint32_t align);
+void atlas_destroy(atlas *a);
+
+/* reserve a cell for a width x height image, false when it does not fit */
+bool atlas_place(atlas *a, uint32_t width, uint32_t height, atlas_rect *rect);
+/* place img and copy it in with extruded borders */
+bool atlas_add(atlas *a, const image *img, atlas_rect *rect);
+/* *
+ * add count images, tallest first for a tighter fit, rects are in the
+ * order of images. false if any did not fit, the rest are still added
+ * */
+bool atlas_add_all(atlas *a, const image *images, uint32_t count,
+                   atlas_rect *rects);
+
+/* *
+ * uv scale in xy and offset in zw mapping 0..1 texture coordinates of an
+ * image onto its rect, uv = uv * xy + zw
+ * */
+void atlas_uv_transform(const atlas *a, const atlas_rect *rect,
+                        float transform[4]);
+/* mip levels that stay inside each cell border */
+int atlas_mip_levels(const atlas *a);
+/* fraction of the atlas covered by cells */
+float atlas_occupancy(const atlas *a);
+
+#endif /* _ATLAS_H_ */
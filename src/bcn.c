@@ -0,0 +1,616 @@
+/* *
+ * bc1, bc3 and bc7 block encoders
+ * */
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bcn.h"
+#include "jobs.h"
+#include "utils.h"
+
+// block rows per parallel_for batch
+#define ENCODE_BATCH 4
+#define POWER_ITERATIONS 8
+
+// bc7 4 bit index weights out of 64
+global_var const int bc7_weights[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                        34, 38, 43, 47, 51, 55, 60, 64};
+
+/* HELPERS */
+
+internal int clamp_int(int value, int min, int max) {
+  return value < min ? min : (value > max ? max : value);
+}
+
+internal float clamp_float(float value, float min, float max) {
+  return value < min ? min : (value > max ? max : value);
+}
+
+internal void put_bits(uint8_t *block, uint32_t *pos, uint32_t value,
+                       uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i, ++*pos) {
+    if (value >> i & 1) {
+      block[*pos / 8] |= (uint8_t)(1 << (*pos % 8));
+    }
+  }
+}
+
+internal uint32_t get_bits(const uint8_t *block, uint32_t *pos,
+                           uint32_t count) {
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < count; ++i, ++*pos) {
+    value |= (uint32_t)(block[*pos / 8] >> (*pos % 8) & 1) << i;
+  }
+  return value;
+}
+
+/* *
+ * end points of the line through the texels along their main axis of
+ * variance, found by power iteration on the covariance
+ * */
+internal void fit_line(const float px[16][4], int channels, float lo[4],
+                       float hi[4]) {
+  float mean[4] = {0};
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < channels; ++c) {
+      mean[c] += px[i][c] / 16.0f;
+    }
+  }
+
+  float cov[4][4] = {{0}};
+  for (int i = 0; i < 16; ++i) {
+    for (int a = 0; a < channels; ++a) {
+      for (int b = 0; b < channels; ++b) {
+        cov[a][b] += (px[i][a] - mean[a]) * (px[i][b] - mean[b]);
+      }
+    }
+  }
+
+  // start from the widest channel so flat blocks still get an axis
+  float axis[4] = {0};
+  int widest = 0;
+  for (int c = 1; c < channels; ++c) {
+    if (cov[c][c] > cov[widest][widest]) {
+      widest = c;
+    }
+  }
+  axis[widest] = 1.0f;
+  for (int it = 0; it < POWER_ITERATIONS; ++it) {
+    float next[4] = {0};
+    float length = 0.0f;
+    for (int a = 0; a < channels; ++a) {
+      for (int b = 0; b < channels; ++b) {
+        next[a] += cov[a][b] * axis[b];
+      }
+      length += next[a] * next[a];
+    }
+    if (length < 1e-12f) {
+      break;
+    }
+    length = sqrtf(length);
+    for (int c = 0; c < channels; ++c) {
+      axis[c] = next[c] / length;
+    }
+  }
+
+  float t_min = 0.0f;
+  float t_max = 0.0f;
+  for (int i = 0; i < 16; ++i) {
+    float t = 0.0f;
+    for (int c = 0; c < channels; ++c) {
+      t += (px[i][c] - mean[c]) * axis[c];
+    }
+    t_min = t < t_min ? t : t_min;
+    t_max = t > t_max ? t : t_max;
+  }
+  for (int c = 0; c < channels; ++c) {
+    lo[c] = clamp_float(mean[c] + axis[c] * t_min, 0.0f, 255.0f);
+    hi[c] = clamp_float(mean[c] + axis[c] * t_max, 0.0f, 255.0f);
+  }
+}
+
+/* *
+ * least squares end points for fixed weights, weight[i] is how far texel
+ * i sits from lo to hi. false when every texel uses the same weight
+ * */
+internal bool refit_line(const float px[16][4], int channels,
+                         const float weight[16], float lo[4], float hi[4]) {
+  float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+  float ax[4] = {0}, bx[4] = {0};
+  for (int i = 0; i < 16; ++i) {
+    float b = weight[i];
+    float a = 1.0f - b;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (int c = 0; c < channels; ++c) {
+      ax[c] += a * px[i][c];
+      bx[c] += b * px[i][c];
+    }
+  }
+  float det = aa * bb - ab * ab;
+  if (fabsf(det) < 1e-6f) {
+    return false;
+  }
+  for (int c = 0; c < channels; ++c) {
+    lo[c] = clamp_float((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+    hi[c] = clamp_float((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+/* BC1 */
+
+internal uint16_t pack_565(const float c[3]) {
+  int r = clamp_int((int)lroundf(c[0] * 31.0f / 255.0f), 0, 31);
+  int g = clamp_int((int)lroundf(c[1] * 63.0f / 255.0f), 0, 63);
+  int b = clamp_int((int)lroundf(c[2] * 31.0f / 255.0f), 0, 31);
+  return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+internal void unpack_565(uint16_t value, int c[3]) {
+  int r = value >> 11;
+  int g = value >> 5 & 63;
+  int b = value & 31;
+  c[0] = r << 3 | r >> 2;
+  c[1] = g << 2 | g >> 4;
+  c[2] = b << 3 | b >> 2;
+}
+
+/* *
+ * four colour palette, or three and transparent black when c0 <= c1.
+ * the colour half of bc3 is always four colours
+ * */
+internal void bc1_palette(uint16_t c0, uint16_t c1, bool four,
+                          int palette[4][4]) {
+  four = four or c0 > c1;
+  unpack_565(c0, palette[0]);
+  unpack_565(c1, palette[1]);
+  palette[0][3] = palette[1][3] = palette[2][3] = 255;
+  for (int c = 0; c < 3; ++c) {
+    if (four) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    } else {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+  }
+  palette[3][3] = four ? 255 : 0;
+}
+
+/* nearest palette entry of each texel, returns the squared error */
+internal uint32_t bc1_indices(uint16_t c0, uint16_t c1,
+                              const float px[16][4], uint32_t *indices) {
+  // the encoder only writes four colour blocks, equal ends use index 0
+  int palette[4][4];
+  bc1_palette(c0 > c1 ? c0 : c1, c0 > c1 ? c1 : c0, false, palette);
+  if (c0 < c1) {
+    for (int c = 0; c < 3; ++c) {
+      int swap = palette[0][c];
+      palette[0][c] = palette[1][c];
+      palette[1][c] = swap;
+      swap = palette[2][c];
+      palette[2][c] = palette[3][c];
+      palette[3][c] = swap;
+    }
+  }
+  int count = c0 == c1 ? 1 : 4;
+
+  uint32_t error = 0;
+  *indices = 0;
+  for (int i = 0; i < 16; ++i) {
+    uint32_t best = UINT32_MAX;
+    uint32_t best_index = 0;
+    for (int k = 0; k < count; ++k) {
+      uint32_t e = 0;
+      for (int c = 0; c < 3; ++c) {
+        int d = (int)px[i][c] - palette[k][c];
+        e += (uint32_t)(d * d);
+      }
+      if (e < best) {
+        best = e;
+        best_index = (uint32_t)k;
+      }
+    }
+    *indices |= best_index << (i * 2);
+    error += best;
+  }
+  return error;
+}
+
+internal void bc1_encode(const float px[16][4], uint8_t *block) {
+  float lo[4], hi[4];
+  fit_line(px, 3, lo, hi);
+  uint16_t c0 = pack_565(hi);
+  uint16_t c1 = pack_565(lo);
+  uint32_t indices;
+  uint32_t error = bc1_indices(c0, c1, px, &indices);
+
+  // one refit against the chosen indices pulls the ends onto the texels
+  local_persist const float weights[4] = {0.0f, 1.0f, 1.0f / 3.0f,
+                                          2.0f / 3.0f};
+  float weight[16];
+  for (int i = 0; i < 16; ++i) {
+    weight[i] = weights[indices >> (i * 2) & 3];
+  }
+  if (c0 != c1 and refit_line(px, 3, weight, hi, lo)) {
+    uint16_t r0 = pack_565(hi);
+    uint16_t r1 = pack_565(lo);
+    uint32_t refit_indices;
+    uint32_t refit_error = bc1_indices(r0, r1, px, &refit_indices);
+    if (refit_error < error) {
+      c0 = r0;
+      c1 = r1;
+      indices = refit_indices;
+    }
+  }
+
+  // c0 > c1 selects four colours, swapping the ends flips index bit 0
+  if (c0 < c1) {
+    uint16_t swap = c0;
+    c0 = c1;
+    c1 = swap;
+    indices ^= 0x55555555u;
+  } else if (c0 == c1) {
+    indices = 0;
+  }
+  block[0] = (uint8_t)c0;
+  block[1] = (uint8_t)(c0 >> 8);
+  block[2] = (uint8_t)c1;
+  block[3] = (uint8_t)(c1 >> 8);
+  for (int i = 0; i < 4; ++i) {
+    block[4 + i] = (uint8_t)(indices >> (i * 8));
+  }
+}
+
+internal void bc1_decode(const uint8_t *block, bool four,
+                        uint8_t texels[64]) {
+  uint16_t c0 = (uint16_t)(block[0] | block[1] << 8);
+  uint16_t c1 = (uint16_t)(block[2] | block[3] << 8);
+  int palette[4][4];
+  bc1_palette(c0, c1, four, palette);
+  for (int i = 0; i < 16; ++i) {
+    int k = block[4 + i / 4] >> (i % 4 * 2) & 3;
+    for (int c = 0; c < 4; ++c) {
+      texels[i * 4 + c] = (uint8_t)palette[k][c];
+    }
+  }
+}
+
+/* BC3 */
+
+/* eight step alpha ramp between max and min, bc4 layout */
+internal void alpha_encode(const float px[16][4], uint8_t *block) {
+  int a0 = 0, a1 = 255;
+  for (int i = 0; i < 16; ++i) {
+    a0 = (int)px[i][3] > a0 ? (int)px[i][3] : a0;
+    a1 = (int)px[i][3] < a1 ? (int)px[i][3] : a1;
+  }
+  memset(block, 0, 8);
+  block[0] = (uint8_t)a0;
+  block[1] = (uint8_t)a1;
+  if (a0 == a1) {
+    return;
+  }
+
+  int ramp[8] = {a0, a1};
+  for (int k = 2; k < 8; ++k) {
+    ramp[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+  }
+  uint32_t pos = 16;
+  for (int i = 0; i < 16; ++i) {
+    int best = 0;
+    for (int k = 1; k < 8; ++k) {
+      if (abs((int)px[i][3] - ramp[k]) < abs((int)px[i][3] - ramp[best])) {
+        best = k;
+      }
+    }
+    put_bits(block, &pos, (uint32_t)best, 3);
+  }
+}
+
+internal void alpha_decode(const uint8_t *block, uint8_t texels[64]) {
+  int a0 = block[0];
+  int a1 = block[1];
+  int ramp[8] = {a0, a1};
+  for (int k = 2; k < 8; ++k) {
+    if (a0 > a1) {
+      ramp[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+    } else {
+      ramp[k] = k < 6 ? ((6 - k) * a0 + (k - 1) * a1) / 5 : (k - 6) * 255;
+    }
+  }
+  uint32_t pos = 16;
+  for (int i = 0; i < 16; ++i) {
+    texels[i * 4 + 3] = (uint8_t)ramp[get_bits(block, &pos, 3)];
+  }
+}
+
+/* BC7 */
+
+/* 7 bit ends plus a shared low bit, whichever p fits e better */
+internal void bc7_quantize(const float e[4], int q[4], int *p) {
+  float best = INFINITY;
+  for (int bit = 0; bit < 2; ++bit) {
+    int value[4];
+    float error = 0.0f;
+    for (int c = 0; c < 4; ++c) {
+      value[c] = clamp_int((int)lroundf((e[c] - (float)bit) / 2.0f), 0, 127);
+      float d = (float)(value[c] << 1 | bit) - e[c];
+      error += d * d;
+    }
+    if (error < best) {
+      best = error;
+      memcpy(q, value, sizeof(value));
+      *p = bit;
+    }
+  }
+}
+
+/* nearest of the 16 weights per texel, returns the squared error */
+internal uint32_t bc7_indices(const int e0[4], const int e1[4],
+                              const float px[16][4], uint8_t indices[16]) {
+  int palette[16][4];
+  for (int k = 0; k < 16; ++k) {
+    for (int c = 0; c < 4; ++c) {
+      palette[k][c] =
+          ((64 - bc7_weights[k]) * e0[c] + bc7_weights[k] * e1[c] + 32) >> 6;
+    }
+  }
+
+  float d[4];
+  float dd = 0.0f;
+  for (int c = 0; c < 4; ++c) {
+    d[c] = (float)(e1[c] - e0[c]);
+    dd += d[c] * d[c];
+  }
+
+  // weights are close to even, so only the projection's neighbours count
+  uint32_t error = 0;
+  for (int i = 0; i < 16; ++i) {
+    int guess = 0;
+    if (dd > 0.0f) {
+      float t = 0.0f;
+      for (int c = 0; c < 4; ++c) {
+        t += (px[i][c] - (float)e0[c]) * d[c];
+      }
+      guess = clamp_int((int)lroundf(t / dd * 15.0f), 0, 15);
+    }
+    uint32_t best = UINT32_MAX;
+    for (int k = clamp_int(guess - 1, 0, 15); k <= clamp_int(guess + 1, 0, 15);
+         ++k) {
+      uint32_t e = 0;
+      for (int c = 0; c < 4; ++c) {
+        int diff = (int)px[i][c] - palette[k][c];
+        e += (uint32_t)(diff * diff);
+      }
+      if (e < best) {
+        best = e;
+        indices[i] = (uint8_t)k;
+      }
+    }
+    error += best;
+  }
+  return error;
+}
+
+struct bc7_ends {
+  int q[2][4];
+  int p[2];
+  uint8_t indices[16];
+  uint32_t error;
+};
+typedef struct bc7_ends bc7_ends;
+
+internal void bc7_try(const float lo[4], const float hi[4],
+                      const float px[16][4], bc7_ends *out) {
+  bc7_quantize(lo, out->q[0], &out->p[0]);
+  bc7_quantize(hi, out->q[1], &out->p[1]);
+  int e[2][4];
+  for (int j = 0; j < 2; ++j) {
+    for (int c = 0; c < 4; ++c) {
+      e[j][c] = out->q[j][c] << 1 | out->p[j];
+    }
+  }
+  out->error = bc7_indices(e[0], e[1], px, out->indices);
+}
+
+/* mode 6, one subset of 7777.1 rgba ends and 4 bit indices */
+internal void bc7_encode(const float px[16][4], uint8_t *block) {
+  float lo[4], hi[4];
+  fit_line(px, 4, lo, hi);
+  bc7_ends best;
+  bc7_try(lo, hi, px, &best);
+
+  float weight[16];
+  for (int i = 0; i < 16; ++i) {
+    weight[i] = (float)bc7_weights[best.indices[i]] / 64.0f;
+  }
+  if (refit_line(px, 4, weight, lo, hi)) {
+    bc7_ends refit;
+    bc7_try(lo, hi, px, &refit);
+    if (refit.error < best.error) {
+      best = refit;
+    }
+  }
+
+  // the first index drops its top bit, so it must point at end 0's half
+  if (best.indices[0] & 8) {
+    for (int c = 0; c < 4; ++c) {
+      int swap = best.q[0][c];
+      best.q[0][c] = best.q[1][c];
+      best.q[1][c] = swap;
+    }
+    int swap = best.p[0];
+    best.p[0] = best.p[1];
+    best.p[1] = swap;
+    for (int i = 0; i < 16; ++i) {
+      best.indices[i] = (uint8_t)(15 - best.indices[i]);
+    }
+  }
+
+  memset(block, 0, 16);
+  uint32_t pos = 0;
+  put_bits(block, &pos, 1 << 6, 7);
+  for (int c = 0; c < 4; ++c) {
+    put_bits(block, &pos, (uint32_t)best.q[0][c], 7);
+    put_bits(block, &pos, (uint32_t)best.q[1][c], 7);
+  }
+  put_bits(block, &pos, (uint32_t)best.p[0], 1);
+  put_bits(block, &pos, (uint32_t)best.p[1], 1);
+  put_bits(block, &pos, best.indices[0], 3);
+  for (int i = 1; i < 16; ++i) {
+    put_bits(block, &pos, best.indices[i], 4);
+  }
+  assert(pos == 128);
+}
+
+internal bool bc7_decode(const uint8_t *block, uint8_t texels[64]) {
+  if ((block[0] & 0x7f) != 0x40) {
+    return false;
+  }
+  uint32_t pos = 7;
+  int e[2][4];
+  for (int c = 0; c < 4; ++c) {
+    e[0][c] = (int)get_bits(block, &pos, 7) << 1;
+    e[1][c] = (int)get_bits(block, &pos, 7) << 1;
+  }
+  int p0 = (int)get_bits(block, &pos, 1);
+  int p1 = (int)get_bits(block, &pos, 1);
+  for (int c = 0; c < 4; ++c) {
+    e[0][c] |= p0;
+    e[1][c] |= p1;
+  }
+  for (int i = 0; i < 16; ++i) {
+    int w = bc7_weights[get_bits(block, &pos, i == 0 ? 3 : 4)];
+    for (int c = 0; c < 4; ++c) {
+      texels[i * 4 + c] =
+          (uint8_t)(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+    }
+  }
+  return true;
+}
+
+/* ENCODE */
+
+struct encode_job {
+  bc_format format;
+  const image *img;
+  uint8_t *out;
+  uint32_t blocks_x;
+};
+typedef struct encode_job encode_job;
+
+internal void encode_rows(void *data, uint32_t start, uint32_t end) {
+  const encode_job *job = data;
+  const image *img = job->img;
+  size_t block_bytes = bc_block_bytes(job->format);
+
+  uint8_t texels[64];
+  for (uint32_t by = start; by < end; ++by) {
+    for (uint32_t bx = 0; bx < job->blocks_x; ++bx) {
+      // gl row 0 is the last image row
+      for (uint32_t r = 0; r < 4; ++r) {
+        uint32_t row = by * 4 + r;
+        row = row < img->height ? row : img->height - 1;
+        const uint8_t *src =
+            img->pixels + (size_t)(img->height - 1 - row) * img->width * 4;
+        for (uint32_t c = 0; c < 4; ++c) {
+          uint32_t x = bx * 4 + c;
+          x = x < img->width ? x : img->width - 1;
+          memcpy(texels + (r * 4 + c) * 4, src + (size_t)x * 4, 4);
+        }
+      }
+      uint8_t *block =
+          job->out + ((size_t)by * job->blocks_x + bx) * block_bytes;
+      bc_encode_block(job->format, texels, block);
+    }
+  }
+}
+
+/* BCN */
+
+size_t bc_block_bytes(bc_format format) {
+  return format == BC_FORMAT_BC1 ? 8 : 16;
+}
+
+size_t bc_level_bytes(bc_format format, uint32_t width, uint32_t height) {
+  return (size_t)((width + 3) / 4) * ((height + 3) / 4) *
+         bc_block_bytes(format);
+}
+
+const char *bc_format_name(bc_format format) {
+  switch (format) {
+  case BC_FORMAT_BC1:
+    return "bc1";
+  case BC_FORMAT_BC3:
+    return "bc3";
+  case BC_FORMAT_BC7:
+    return "bc7";
+  }
+  return "unknown";
+}
+
+bool bc_format_parse(const char *name, bc_format *format) {
+  local_persist const bc_format formats[] = {BC_FORMAT_BC1, BC_FORMAT_BC3,
+                                             BC_FORMAT_BC7};
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+    if (strcmp(name, bc_format_name(formats[i])) == 0) {
+      *format = formats[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+void bc_encode_block(bc_format format, const uint8_t texels[64],
+                     uint8_t *block) {
+  float px[16][4];
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      px[i][c] = (float)texels[i * 4 + c];
+    }
+  }
+
+  switch (format) {
+  case BC_FORMAT_BC1:
+    bc1_encode(px, block);
+    break;
+  case BC_FORMAT_BC3:
+    alpha_encode(px, block);
+    bc1_encode(px, block + 8);
+    break;
+  case BC_FORMAT_BC7:
+    bc7_encode(px, block);
+    break;
+  }
+}
+
+bool bc_decode_block(bc_format format, const uint8_t *block,
+                     uint8_t texels[64]) {
+  switch (format) {
+  case BC_FORMAT_BC1:
+    bc1_decode(block, false, texels);
+    return true;
+  case BC_FORMAT_BC3:
+    bc1_decode(block + 8, true, texels);
+    alpha_decode(block, texels);
+    return true;
+  case BC_FORMAT_BC7:
+    return bc7_decode(block, texels);
+  }
+  return false;
+}
+
+void bc_encode_image(bc_format format, const image *img, uint8_t *out) {
+  encode_job job = {
+      .format = format,
+      .img = img,
+      .out = out,
+      .blocks_x = (img->width + 3) / 4,
+  };
+  parallel_for((img->height + 3) / 4, ENCODE_BATCH, encode_rows, &job);
+}
@@ -0,0 +1,48 @@
+#ifndef _BCN_H_
+#define _BCN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+
+/* *
+ * block compressed formats, 4x4 texels per block
+ *
+ * bc1 is 8 bytes of opaque rgb, bc3 adds 8 bytes of alpha and bc7 packs
+ * rgba in 16 bytes with far less banding. bc7 is encoded with mode 6 only,
+ * one endpoint pair per block.
+ * */
+enum bc_format {
+  BC_FORMAT_BC1 = 1,
+  BC_FORMAT_BC3 = 3,
+  BC_FORMAT_BC7 = 7,
+};
+typedef enum bc_format bc_format;
+
+/* bytes in one 4x4 block of format */
+size_t bc_block_bytes(bc_format format);
+/* bytes of a whole width x height level, partial blocks round up */
+size_t bc_level_bytes(bc_format format, uint32_t width, uint32_t height);
+/* "bc1", "bc3" or "bc7" */
+const char *bc_format_name(bc_format format);
+/* parse a name from bc_format_name, false if unknown */
+bool bc_format_parse(const char *name, bc_format *format);
+
+/* encode 16 rgba texels, row by row, into one block */
+void bc_encode_block(bc_format format, const uint8_t texels[64],
+                     uint8_t *block);
+/* decode one block to 16 rgba texels, false for unsupported bc7 modes */
+bool bc_decode_block(bc_format format, const uint8_t *block,
+                     uint8_t texels[64]);
+
+/* *
+ * encode img into bc_level_bytes of out across the job system
+ *
+ * blocks are written bottom row first to match gl, edges of images that
+ * are not a multiple of 4 repeat into the padding.
+ * */
+void bc_encode_image(bc_format format, const image *img, uint8_t *out);
+
+#endif /* _BCN_H_ */
@@ -0,0 +1,41 @@
+/* *
+ * small integer helpers shared by the file formats and mip chains
+ * */
+#include "bits.h"
+
+/* ALIGN */
+
+uint64_t align_up(uint64_t value, uint64_t align) {
+  return (value + align - 1) & ~(align - 1);
+}
+
+/* HASH */
+
+uint64_t fnv_byte(uint64_t hash, uint8_t byte) {
+  return (hash ^ byte) * FNV_PRIME;
+}
+
+uint64_t fnv_bytes(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < size; ++i) {
+    hash = fnv_byte(hash, bytes[i]);
+  }
+  return hash;
+}
+
+/* MIPS */
+
+uint32_t level_extent(uint32_t size, int level) {
+  uint32_t extent = size >> level;
+  return extent ? extent : 1;
+}
+
+int full_chain(uint32_t width, uint32_t height) {
+  uint32_t size = width > height ? width : height;
+  int levels = 1;
+  while (size > 1) {
+    size >>= 1;
+    ++levels;
+  }
+  return levels;
+}
@@ -0,0 +1,24 @@
+#ifndef _BITS_H_
+#define _BITS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64 bit fnv-1a, hashes of cache keys and pack paths
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+/* value rounded up to a multiple of align, a power of two */
+uint64_t align_up(uint64_t value, uint64_t align);
+
+/* hash with one more byte mixed in, start from FNV_OFFSET */
+uint64_t fnv_byte(uint64_t hash, uint8_t byte);
+/* hash with size bytes of data mixed in */
+uint64_t fnv_bytes(uint64_t hash, const void *data, size_t size);
+
+/* width or height of mip level, never below 1 */
+uint32_t level_extent(uint32_t size, int level);
+/* levels in a chain from width x height down to 1x1 */
+int full_chain(uint32_t width, uint32_t height);
+
+#endif
@@ -0,0 +1,533 @@
+/* *
+ * bounding volume hierarchy
+ * */
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bvh.h"
+#include "utils.h"
+
+#define BVH_BINS 12
+#define BVH_LEAF_MAX 8
+#define BVH_STACK_SIZE 64
+#define BVH_MAX_DEPTH 48
+
+/* HELPERS */
+
+internal void node_set_bounds(bvh_node *node, const aabb *box) {
+  node->min[0] = box->min.x;
+  node->min[1] = box->min.y;
+  node->min[2] = box->min.z;
+  node->max[0] = box->max.x;
+  node->max[1] = box->max.y;
+  node->max[2] = box->max.z;
+}
+
+internal aabb node_bounds(const bvh_node *node) {
+  aabb box;
+  box.min = vec3_new(node->min[0], node->min[1], node->min[2]);
+  box.max = vec3_new(node->max[0], node->max[1], node->max[2]);
+  return box;
+}
+
+internal aabb aabb_empty(void) {
+  aabb box;
+  box.min = vec3_new(FLT_MAX, FLT_MAX, FLT_MAX);
+  box.max = vec3_new(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  return box;
+}
+
+/* grow box to cover other, no calls in hot build loops */
+internal void aabb_grow(aabb *box, const aabb *other) {
+  box->min.x = fminf(box->min.x, other->min.x);
+  box->min.y = fminf(box->min.y, other->min.y);
+  box->min.z = fminf(box->min.z, other->min.z);
+  box->max.x = fmaxf(box->max.x, other->max.x);
+  box->max.y = fmaxf(box->max.y, other->max.y);
+  box->max.z = fmaxf(box->max.z, other->max.z);
+}
+
+internal float aabb_area(const aabb *box) {
+  float x = box->max.x - box->min.x;
+  float y = box->max.y - box->min.y;
+  float z = box->max.z - box->min.z;
+  if (x < 0.0f or y < 0.0f or z < 0.0f) {
+    return 0.0f;
+  }
+  return 2.0f * (x * y + y * z + z * x);
+}
+
+internal inline float vec3_axis(const vec3 *v3, int axis) {
+  return axis == 0 ? v3->x : (axis == 1 ? v3->y : v3->z);
+}
+
+/* bounds of every object inside a node, leaf or not */
+internal aabb range_bounds(const bvh *tree, uint32_t first, uint32_t count) {
+  aabb box = aabb_empty();
+  for (uint32_t i = first; i < first + count; ++i) {
+    aabb_grow(&box, &tree->boxes[tree->indices[i]]);
+  }
+  return box;
+}
+
+internal void node_refit(bvh *tree, uint32_t idx) {
+  bvh_node *node = &tree->nodes[idx];
+  aabb box;
+  if (node->count > 0) {
+    box = range_bounds(tree, node->left_first, node->count);
+  } else {
+    aabb left = node_bounds(&tree->nodes[node->left_first]);
+    aabb right = node_bounds(&tree->nodes[node->left_first + 1]);
+    box = aabb_merge(&left, &right);
+  }
+  node_set_bounds(node, &box);
+}
+
+/* *
+ * find best binned sah split of a node
+ * returns false if keeping the node as a leaf is cheaper
+ * */
+internal bool find_split(const bvh *tree, const vec3 *centroids,
+                         uint32_t first, uint32_t count,
+                         const aabb *node_box, int *dest_axis,
+                         float *dest_pos) {
+  aabb cbox = aabb_empty();
+  for (uint32_t i = first; i < first + count; ++i) {
+    const vec3 *c = &centroids[tree->indices[i]];
+    aabb point = {.min = *c, .max = *c};
+    aabb_grow(&cbox, &point);
+  }
+
+  float best_cost = FLT_MAX;
+  for (int axis = 0; axis < 3; ++axis) {
+    float lo = vec3_axis(&cbox.min, axis);
+    float hi = vec3_axis(&cbox.max, axis);
+    if (hi <= lo) {
+      continue;
+    }
+
+    aabb bin_box[BVH_BINS];
+    uint32_t bin_count[BVH_BINS] = {0};
+    for (int b = 0; b < BVH_BINS; ++b) {
+      bin_box[b] = aabb_empty();
+    }
+
+    float scale = (float)BVH_BINS / (hi - lo);
+    for (uint32_t i = first; i < first + count; ++i) {
+      uint32_t obj = tree->indices[i];
+      int b = (int)((vec3_axis(&centroids[obj], axis) - lo) * scale);
+      b = b < BVH_BINS ? b : BVH_BINS - 1;
+      ++bin_count[b];
+      aabb_grow(&bin_box[b], &tree->boxes[obj]);
+    }
+
+    // sweep from the right, then from the left
+    float right_area[BVH_BINS - 1];
+    uint32_t right_count[BVH_BINS - 1];
+    aabb acc = aabb_empty();
+    uint32_t n = 0;
+    for (int b = BVH_BINS - 1; b > 0; --b) {
+      aabb_grow(&acc, &bin_box[b]);
+      n += bin_count[b];
+      right_area[b - 1] = aabb_area(&acc);
+      right_count[b - 1] = n;
+    }
+
+    acc = aabb_empty();
+    n = 0;
+    for (int b = 0; b < BVH_BINS - 1; ++b) {
+      aabb_grow(&acc, &bin_box[b]);
+      n += bin_count[b];
+      if (n == 0 or right_count[b] == 0) {
+        continue;
+      }
+      float cost = (float)n * aabb_area(&acc) +
+                   (float)right_count[b] * right_area[b];
+      if (cost < best_cost) {
+        best_cost = cost;
+        *dest_axis = axis;
+        *dest_pos = lo + (float)(b + 1) / scale;
+      }
+    }
+  }
+
+  if (best_cost == FLT_MAX) {
+    return false;
+  }
+
+  // node traversal costs about one object test
+  float leaf_cost = (float)count * aabb_area(node_box);
+  float split_cost = aabb_area(node_box) + best_cost;
+  return split_cost < leaf_cost or count > BVH_LEAF_MAX;
+}
+
+internal void emit_range(const bvh *tree, uint32_t node, uint32_t *out,
+                         uint32_t capacity, uint32_t *n) {
+  uint32_t first = tree->node_first[node];
+  uint32_t total = tree->node_total[node];
+  for (uint32_t i = first; i < first + total and *n < capacity; ++i) {
+    out[(*n)++] = tree->indices[i];
+  }
+}
+
+/* *
+ * test box against planes left in mask
+ * returns -1 outside, otherwise the planes still crossing the box
+ * */
+internal int planes_test(const frustum *f, const float *min, const float *max,
+                         int mask) {
+  float cx = (min[0] + max[0]) * 0.5f;
+  float cy = (min[1] + max[1]) * 0.5f;
+  float cz = (min[2] + max[2]) * 0.5f;
+  float ex = (max[0] - min[0]) * 0.5f;
+  float ey = (max[1] - min[1]) * 0.5f;
+  float ez = (max[2] - min[2]) * 0.5f;
+
+  for (int p = 0; p < 6; ++p) {
+    if (not(mask & (1 << p))) {
+      continue;
+    }
+    const plane *pl = &f->planes[p];
+    float dist = pl->x * cx + pl->y * cy + pl->z * cz + pl->d;
+    float r = fabsf(pl->x) * ex + fabsf(pl->y) * ey + fabsf(pl->z) * ez;
+    if (dist < -r) {
+      return -1;
+    }
+    if (dist >= r) {
+      mask &= ~(1 << p);
+    }
+  }
+  return mask;
+}
+
+/* slab test, writes entry distance to *dest_t on hit */
+internal bool ray_box(const float *min, const float *max, const vec3 *origin,
+                      const vec3 *inv_dir, float t_max, float *dest_t) {
+  float tx1 = (min[0] - origin->x) * inv_dir->x;
+  float tx2 = (max[0] - origin->x) * inv_dir->x;
+  float t_near = fminf(tx1, tx2);
+  float t_far = fmaxf(tx1, tx2);
+
+  float ty1 = (min[1] - origin->y) * inv_dir->y;
+  float ty2 = (max[1] - origin->y) * inv_dir->y;
+  t_near = fmaxf(t_near, fminf(ty1, ty2));
+  t_far = fminf(t_far, fmaxf(ty1, ty2));
+
+  float tz1 = (min[2] - origin->z) * inv_dir->z;
+  float tz2 = (max[2] - origin->z) * inv_dir->z;
+  t_near = fmaxf(t_near, fminf(tz1, tz2));
+  t_far = fminf(t_far, fmaxf(tz1, tz2));
+
+  if (t_far < t_near or t_far < 0.0f or t_near > t_max) {
+    return false;
+  }
+  *dest_t = fmaxf(t_near, 0.0f);
+  return true;
+}
+
+/* BUILD */
+
+bool bvh_build(bvh *tree, const aabb *boxes, uint32_t count) {
+  assert(count > 0);
+  memset(tree, 0, sizeof(*tree));
+
+  uint32_t max_nodes = 2 * count - 1;
+  tree->nodes = malloc(sizeof(*tree->nodes) * max_nodes);
+  tree->node_first = malloc(sizeof(*tree->node_first) * max_nodes);
+  tree->node_total = malloc(sizeof(*tree->node_total) * max_nodes);
+  tree->node_parent = malloc(sizeof(*tree->node_parent) * max_nodes);
+  tree->indices = malloc(sizeof(*tree->indices) * count);
+  tree->object_leaf = malloc(sizeof(*tree->object_leaf) * count);
+  tree->boxes = malloc(sizeof(*tree->boxes) * count);
+  vec3 *centroids = malloc(sizeof(*centroids) * count);
+
+  if (not tree->nodes or not tree->node_first or not tree->node_total or
+      not tree->node_parent or not tree->indices or not tree->object_leaf or
+      not tree->boxes or not centroids) {
+    fprintf(stderr, "ERROR: bvh failed to allocate %u objects\n", count);
+    free(centroids);
+    bvh_destroy(tree);
+    return false;
+  }
+
+  tree->count = count;
+  memcpy(tree->boxes, boxes, sizeof(*boxes) * count);
+  for (uint32_t i = 0; i < count; ++i) {
+    tree->indices[i] = i;
+    centroids[i] = aabb_center(&boxes[i]);
+  }
+
+  tree->node_count = 1;
+  tree->node_first[0] = 0;
+  tree->node_total[0] = count;
+  tree->node_parent[0] = BVH_NONE;
+
+  // children always land after their parent, so a stack of pending
+  // nodes keeps the parent before child order
+  uint32_t stack[BVH_STACK_SIZE];
+  int depths[BVH_STACK_SIZE];
+  int top = 0;
+  stack[top] = 0;
+  depths[top++] = 0;
+
+  while (top > 0) {
+    --top;
+    uint32_t idx = stack[top];
+    int depth = depths[top];
+    uint32_t first = tree->node_first[idx];
+    uint32_t total = tree->node_total[idx];
+
+    aabb box = range_bounds(tree, first, total);
+    node_set_bounds(&tree->nodes[idx], &box);
+
+    int axis = 0;
+    float pos = 0.0f;
+    // depth limit keeps every traversal inside its fixed stack
+    bool split = total > 1 and depth < BVH_MAX_DEPTH and
+                 find_split(tree, centroids, first, total, &box, &axis, &pos);
+
+    // partition entries around the split plane
+    uint32_t mid = first;
+    if (split) {
+      uint32_t last = first + total;
+      while (mid < last) {
+        uint32_t obj = tree->indices[mid];
+        if (vec3_axis(&centroids[obj], axis) < pos) {
+          ++mid;
+        } else {
+          tree->indices[mid] = tree->indices[--last];
+          tree->indices[last] = obj;
+        }
+      }
+      split = mid != first and mid != first + total;
+    }
+
+    if (not split) {
+      tree->nodes[idx].left_first = first;
+      tree->nodes[idx].count = total;
+      for (uint32_t i = first; i < first + total; ++i) {
+        tree->object_leaf[tree->indices[i]] = idx;
+      }
+      continue;
+    }
+
+    uint32_t left = tree->node_count;
+    tree->node_count += 2;
+
+    tree->nodes[idx].left_first = left;
+    tree->nodes[idx].count = 0;
+
+    tree->node_first[left] = first;
+    tree->node_total[left] = mid - first;
+    tree->node_parent[left] = idx;
+
+    tree->node_first[left + 1] = mid;
+    tree->node_total[left + 1] = first + total - mid;
+    tree->node_parent[left + 1] = idx;
+
+    stack[top] = left + 1;
+    depths[top++] = depth + 1;
+    stack[top] = left;
+    depths[top++] = depth + 1;
+  }
+
+  free(centroids);
+  return true;
+}
+
+void bvh_destroy(bvh *tree) {
+  free(tree->nodes);
+  free(tree->node_first);
+  free(tree->node_total);
+  free(tree->node_parent);
+  free(tree->indices);
+  free(tree->object_leaf);
+  free(tree->boxes);
+  memset(tree, 0, sizeof(*tree));
+}
+
+/* REFIT */
+
+void bvh_refit(bvh *tree, const aabb *boxes) {
+  memcpy(tree->boxes, boxes, sizeof(*boxes) * tree->count);
+  for (uint32_t i = tree->node_count; i-- > 0;) {
+    node_refit(tree, i);
+  }
+}
+
+void bvh_update(bvh *tree, uint32_t object, const aabb *box) {
+  assert(object < tree->count);
+  tree->boxes[object] = *box;
+
+  uint32_t idx = tree->object_leaf[object];
+  while (idx != BVH_NONE) {
+    bvh_node before = tree->nodes[idx];
+    node_refit(tree, idx);
+    if (memcmp(&before, &tree->nodes[idx], sizeof(before)) == 0) {
+      break;
+    }
+    idx = tree->node_parent[idx];
+  }
+}
+
+/* QUERIES */
+
+uint32_t bvh_query_frustum(const bvh *tree, const frustum *f, uint32_t *out,
+                           uint32_t capacity, cull_stats *stats) {
+  uint32_t n = 0;
+  unsigned tested = 0;
+
+  uint32_t stack[BVH_STACK_SIZE];
+  int masks[BVH_STACK_SIZE];
+  int top = 0;
+  stack[top] = 0;
+  masks[top++] = 0x3F;
+
+  while (top > 0 and n < capacity) {
+    --top;
+    uint32_t idx = stack[top];
+    const bvh_node *node = &tree->nodes[idx];
+
+    int mask = planes_test(f, node->min, node->max, masks[top]);
+    if (mask < 0) {
+      continue;
+    }
+
+    // fully inside, whole range is visible without more tests
+    if (mask == 0) {
+      emit_range(tree, idx, out, capacity, &n);
+      continue;
+    }
+
+    if (node->count > 0) {
+      for (uint32_t i = node->left_first;
+           i < node->left_first + node->count and n < capacity; ++i) {
+        uint32_t obj = tree->indices[i];
+        const aabb *box = &tree->boxes[obj];
+        float min[3] = {box->min.x, box->min.y, box->min.z};
+        float max[3] = {box->max.x, box->max.y, box->max.z};
+        ++tested;
+        if (planes_test(f, min, max, mask) >= 0) {
+          out[n++] = obj;
+        }
+      }
+      continue;
+    }
+
+    stack[top] = node->left_first + 1;
+    masks[top++] = mask;
+    stack[top] = node->left_first;
+    masks[top++] = mask;
+  }
+
+  if (stats) {
+    stats->tested += tested;
+    stats->visible += n;
+    stats->culled += tree->count - n;
+  }
+
+  return n;
+}
+
+uint32_t bvh_query_overlap(const bvh *tree, const aabb *box, uint32_t *out,
+                           uint32_t capacity) {
+  uint32_t n = 0;
+
+  uint32_t stack[BVH_STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0 and n < capacity) {
+    uint32_t idx = stack[--top];
+    const bvh_node *node = &tree->nodes[idx];
+
+    aabb bounds = node_bounds(node);
+    if (not aabb_overlap(&bounds, box)) {
+      continue;
+    }
+
+    if (node->count > 0) {
+      for (uint32_t i = node->left_first;
+           i < node->left_first + node->count and n < capacity; ++i) {
+        uint32_t obj = tree->indices[i];
+        if (aabb_overlap(&tree->boxes[obj], box)) {
+          out[n++] = obj;
+        }
+      }
+      continue;
+    }
+
+    stack[top++] = node->left_first + 1;
+    stack[top++] = node->left_first;
+  }
+
+  return n;
+}
+
+uint32_t bvh_raycast(const bvh *tree, const vec3 *origin, const vec3 *dir,
+                     float t_max, float *dest_t) {
+  vec3 inv_dir = vec3_new(1.0f / dir->x, 1.0f / dir->y, 1.0f / dir->z);
+
+  uint32_t hit = BVH_NONE;
+  float best = t_max;
+  float t = 0.0f;
+
+  uint32_t stack[BVH_STACK_SIZE];
+  int top = 0;
+  if (ray_box(tree->nodes[0].min, tree->nodes[0].max, origin, &inv_dir, best,
+              &t)) {
+    stack[top++] = 0;
+  }
+
+  while (top > 0) {
+    const bvh_node *node = &tree->nodes[stack[--top]];
+
+    if (node->count > 0) {
+      for (uint32_t i = node->left_first;
+           i < node->left_first + node->count; ++i) {
+        uint32_t obj = tree->indices[i];
+        const aabb *box = &tree->boxes[obj];
+        float min[3] = {box->min.x, box->min.y, box->min.z};
+        float max[3] = {box->max.x, box->max.y, box->max.z};
+        if (ray_box(min, max, origin, &inv_dir, best, &t) and
+            (hit == BVH_NONE or t < best)) {
+          best = t;
+          hit = obj;
+        }
+      }
+      continue;
+    }
+
+    // nearest child on top of the stack
+    uint32_t a = node->left_first;
+    uint32_t b = node->left_first + 1;
+    float ta = 0.0f;
+    float tb = 0.0f;
+    bool hit_a = ray_box(tree->nodes[a].min, tree->nodes[a].max, origin,
+                         &inv_dir, best, &ta);
+    bool hit_b = ray_box(tree->nodes[b].min, tree->nodes[b].max, origin,
+                         &inv_dir, best, &tb);
+    if (hit_a and hit_b) {
+      if (ta > tb) {
+        stack[top++] = a;
+        stack[top++] = b;
+      } else {
+        stack[top++] = b;
+        stack[top++] = a;
+      }
+    } else if (hit_a) {
+      stack[top++] = a;
+    } else if (hit_b) {
+      stack[top++] = b;
+    }
+  }
+
+  if (hit != BVH_NONE and dest_t) {
+    *dest_t = best;
+  }
+  return hit;
+}
@@ -0,0 +1,77 @@
+#ifndef _BVH_H_
+#define _BVH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frustum.h"
+#include "vec.h"
+
+#define BVH_NONE 0xFFFFFFFFu
+
+/* *
+ * flattened node, 32 bytes so two share a cache line
+ *
+ * leaf when count > 0, left_first is the first entry in bvh.indices.
+ * otherwise left_first is the left child, right child is left_first + 1.
+ * */
+struct bvh_node {
+  float min[3];
+  uint32_t left_first;
+  float max[3];
+  uint32_t count;
+};
+typedef struct bvh_node bvh_node;
+
+/* *
+ * bounding volume hierarchy over object boxes
+ *
+ * nodes are stored parent before child, so a reverse sweep refits the
+ * whole tree. every node covers a contiguous range of indices, a node
+ * fully inside a query emits its range without further tests.
+ * */
+struct bvh {
+  bvh_node *nodes;
+  uint32_t node_count;
+
+  // per node, first entry in indices and number of objects below it
+  uint32_t *node_first;
+  uint32_t *node_total;
+  uint32_t *node_parent;
+
+  // object index per entry, sorted so subtrees are contiguous
+  uint32_t *indices;
+  // leaf holding each object
+  uint32_t *object_leaf;
+
+  aabb *boxes;
+  uint32_t count;
+};
+typedef struct bvh bvh;
+
+/* build tree over count boxes with binned surface area heuristic */
+bool bvh_build(bvh *tree, const aabb *boxes, uint32_t count);
+/* free tree */
+void bvh_destroy(bvh *tree);
+/* replace all boxes and refit every node, topology is kept */
+void bvh_refit(bvh *tree, const aabb *boxes);
+/* replace box of one object and refit only its path to the root */
+void bvh_update(bvh *tree, uint32_t object, const aabb *box);
+
+/* *
+ * objects at least partly inside f, writes up to capacity object indices
+ * into out and returns how many, stats may be NULL
+ * */
+uint32_t bvh_query_frustum(const bvh *tree, const frustum *f, uint32_t *out,
+                           uint32_t capacity, cull_stats *stats);
+/* objects overlapping box, returns how many were written to out */
+uint32_t bvh_query_overlap(const bvh *tree, const aabb *box, uint32_t *out,
+                           uint32_t capacity);
+/* *
+ * nearest object box hit by ray origin + t * dir for t in [0, t_max]
+ * returns object index or BVH_NONE, hit distance is written to *dest_t
+ * */
+uint32_t bvh_raycast(const bvh *tree, const vec3 *origin, const vec3 *dir,
+                     float t_max, float *dest_t);
+
+#endif /* _BVH_H_ */
@@ -0,0 +1,323 @@
+/* *
+ * clustered light lists
+ * */
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clusters.h"
+#include "glstate.h"
+#include "pacer.h"
+#include "utils.h"
+
+#if defined(__SSE__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CLUSTERS_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// lights are read in groups of 4, the tail is padded with culled spheres
+#define LIGHT_GROUP 4
+#define INITIAL_INDICES 4096
+
+/* HELPERS */
+
+/* *
+ * cells between planes whose normals point towards higher cells, the
+ * sphere covers lo..hi, empty when lo > hi
+ * */
+internal void sphere_span(const float *plane_a, const float *plane_z,
+                          uint32_t planes, float a, float z, float radius,
+                          int *lo, int *hi) {
+  *lo = 0;
+  *hi = (int)planes - 2;
+  bool found = false;
+  for (uint32_t p = 0; p < planes; ++p) {
+    float dist = a * plane_a[p] + z * plane_z[p];
+    // wholly past plane p, or wholly before it
+    if (dist >= radius) {
+      *lo = (int)p;
+    }
+    if (dist <= -radius and not found) {
+      *hi = (int)p - 1;
+      found = true;
+    }
+  }
+}
+
+#ifdef CLUSTERS_SSE
+internal __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/* sphere_span of lights first..first + 3 */
+internal void sphere_span4(const float *plane_a, const float *plane_z,
+                           uint32_t planes, const float *a, const float *z,
+                           const float *radius, float *lo, float *hi) {
+  __m128 va = _mm_loadu_ps(a);
+  __m128 vz = _mm_loadu_ps(z);
+  __m128 r = _mm_loadu_ps(radius);
+  __m128 minus_r = _mm_sub_ps(_mm_setzero_ps(), r);
+  __m128 vlo = _mm_setzero_ps();
+  __m128 vhi = _mm_set1_ps((float)planes - 2.0f);
+  __m128 found = _mm_setzero_ps();
+
+  for (uint32_t p = 0; p < planes; ++p) {
+    __m128 dist = _mm_add_ps(_mm_mul_ps(va, _mm_set1_ps(plane_a[p])),
+                             _mm_mul_ps(vz, _mm_set1_ps(plane_z[p])));
+    __m128 past = _mm_cmpge_ps(dist, r);
+    __m128 before = _mm_andnot_ps(found, _mm_cmple_ps(dist, minus_r));
+    vlo = select_ps(past, _mm_set1_ps((float)p), vlo);
+    vhi = select_ps(before, _mm_set1_ps((float)p - 1.0f), vhi);
+    found = _mm_or_ps(found, before);
+  }
+  _mm_storeu_ps(lo, vlo);
+  _mm_storeu_ps(hi, vhi);
+}
+#endif
+
+/* z cell of view depth, clamped to the grid */
+internal int depth_cell(const cluster_grid *g, float depth) {
+  if (depth <= g->near) {
+    return 0;
+  }
+  int cell = (int)(logf(depth) * g->slice_scale + g->slice_bias);
+  return cell < (int)g->size_z ? cell : (int)g->size_z - 1;
+}
+
+/* planes through the eye at ndc -1..1, normals facing +ndc */
+internal bool build_planes(uint32_t cells, float scale, float **plane_a,
+                           float **plane_z) {
+  *plane_a = malloc(sizeof(float) * (cells + 1));
+  *plane_z = malloc(sizeof(float) * (cells + 1));
+  if (not *plane_a or not *plane_z) {
+    return false;
+  }
+  for (uint32_t i = 0; i <= cells; ++i) {
+    float ndc = -1.0f + 2.0f * (float)i / (float)cells;
+    float len = sqrtf(scale * scale + ndc * ndc);
+    (*plane_a)[i] = scale / len;
+    (*plane_z)[i] = ndc / len;
+  }
+  return true;
+}
+
+internal void grow_storage(GLuint buffer, GLsizeiptr *capacity,
+                           GLsizeiptr size) {
+  glstate_bind_buffer(GL_SHADER_STORAGE_BUFFER, buffer);
+  while (*capacity < size) {
+    *capacity *= 2;
+  }
+  // orphan so last frames draws can still read the old copy
+  glad_glBufferData(GL_SHADER_STORAGE_BUFFER, *capacity, NULL,
+                    GL_DYNAMIC_DRAW);
+}
+
+/* CLUSTERS */
+
+bool clusters_init(cluster_grid *g, uint32_t x, uint32_t y, uint32_t z,
+                   float fov, float aspect, float near, float far) {
+  assert(x > 0 and y > 0 and z > 0);
+  assert(near > 0.0f and far > near);
+  memset(g, 0, sizeof(*g));
+  g->size_x = x;
+  g->size_y = y;
+  g->size_z = z;
+  g->near = near;
+  g->far = far;
+
+  // log spaced slices, z cell k starts at near * (far / near)^(k / z)
+  float log_range = logf(far / near);
+  g->slice_scale = (float)z / log_range;
+  g->slice_bias = -(float)z * logf(near) / log_range;
+
+  // same scales as perspective()
+  float range = 1.0f / tanf(fov * 0.5f);
+  if (not build_planes(x, range / aspect, &g->column_x, &g->column_z) or
+      not build_planes(y, range, &g->row_y, &g->row_z)) {
+    fprintf(stderr, "ERROR: cluster planes failed to allocate\n");
+    clusters_destroy(g);
+    return false;
+  }
+
+  g->range_capacity =
+      sizeof(cluster_header) + sizeof(uint32_t) * 2 * x * y * z;
+  g->index_capacity = sizeof(uint32_t) * INITIAL_INDICES;
+  glad_glGenBuffers(1, &g->ranges);
+  glad_glGenBuffers(1, &g->indices);
+  grow_storage(g->ranges, &g->range_capacity, 0);
+  grow_storage(g->indices, &g->index_capacity, 0);
+
+  return g->ranges != 0 and g->indices != 0;
+}
+
+void clusters_destroy(cluster_grid *g) {
+  free(g->column_x);
+  free(g->column_z);
+  free(g->row_y);
+  free(g->row_z);
+  glstate_forget_buffer(g->ranges);
+  glstate_forget_buffer(g->indices);
+  glad_glDeleteBuffers(1, &g->ranges);
+  glad_glDeleteBuffers(1, &g->indices);
+  memset(g, 0, sizeof(*g));
+}
+
+bool clusters_assign(const cluster_grid *g, const point_light *lights,
+                     uint32_t count, const mat4 *view, arena *scratch,
+                     cluster_lists *lists, cluster_stats *stats) {
+  double start = pacer_now_ms();
+  memset(lists, 0, sizeof(*lists));
+  memset(stats, 0, sizeof(*stats));
+  lists->header = (cluster_header){
+      .size = {g->size_x, g->size_y, g->size_z, 0},
+      .slice = {g->slice_scale, g->slice_bias, 0.0f, 0.0f},
+  };
+  lists->cell_count = g->size_x * g->size_y * g->size_z;
+  stats->lights = count;
+
+  uint32_t padded = (count + LIGHT_GROUP - 1) / LIGHT_GROUP * LIGHT_GROUP;
+  uint32_t *ranges = arena_push_array(scratch, uint32_t, lists->cell_count * 2);
+  float *cx = arena_push_array(scratch, float, padded);
+  float *cy = arena_push_array(scratch, float, padded);
+  float *cz = arena_push_array(scratch, float, padded);
+  float *radius = arena_push_array(scratch, float, padded);
+  // cell box of each light, x lo, x hi, y lo, y hi
+  float *span = arena_push_array(scratch, float, padded * 4);
+  if (not ranges or not cx or not cy or not cz or not radius or not span) {
+    return false;
+  }
+  memset(ranges, 0, sizeof(*ranges) * lists->cell_count * 2);
+  lists->ranges = ranges;
+
+  // view space spheres, the padding sits behind the eye
+  for (uint32_t i = 0; i < padded; ++i) {
+    if (i >= count) {
+      cx[i] = 0.0f;
+      cy[i] = 0.0f;
+      cz[i] = 1.0f;
+      radius[i] = 0.0f;
+      continue;
+    }
+    const float *p = lights[i].position;
+    cx[i] = p[0] * view->_11 + p[1] * view->_21 + p[2] * view->_31 + view->_41;
+    cy[i] = p[0] * view->_12 + p[1] * view->_22 + p[2] * view->_32 + view->_42;
+    cz[i] = p[0] * view->_13 + p[1] * view->_23 + p[2] * view->_33 + view->_43;
+    radius[i] = p[3];
+  }
+
+  uint32_t i = 0;
+#ifdef CLUSTERS_SSE
+  for (; i + LIGHT_GROUP <= padded; i += LIGHT_GROUP) {
+    float lo[4], hi[4];
+    sphere_span4(g->column_x, g->column_z, g->size_x + 1, cx + i, cz + i,
+                 radius + i, lo, hi);
+    float row_lo[4], row_hi[4];
+    sphere_span4(g->row_y, g->row_z, g->size_y + 1, cy + i, cz + i,
+                 radius + i, row_lo, row_hi);
+    for (int k = 0; k < 4; ++k) {
+      span[(i + k) * 4 + 0] = lo[k];
+      span[(i + k) * 4 + 1] = hi[k];
+      span[(i + k) * 4 + 2] = row_lo[k];
+      span[(i + k) * 4 + 3] = row_hi[k];
+    }
+  }
+#endif
+  for (; i < padded; ++i) {
+    int lo, hi, row_lo, row_hi;
+    sphere_span(g->column_x, g->column_z, g->size_x + 1, cx[i], cz[i],
+                radius[i], &lo, &hi);
+    sphere_span(g->row_y, g->row_z, g->size_y + 1, cy[i], cz[i], radius[i],
+                &row_lo, &row_hi);
+    span[i * 4 + 0] = (float)lo;
+    span[i * 4 + 1] = (float)hi;
+    span[i * 4 + 2] = (float)row_lo;
+    span[i * 4 + 3] = (float)row_hi;
+  }
+
+  // count, then offsets, then fill, every pass walks the same boxes
+  for (int pass = 0; pass < 2; ++pass) {
+    for (uint32_t l = 0; l < count; ++l) {
+      float depth = -cz[l];
+      float r = radius[l];
+      if (depth + r < g->near or depth - r > g->far) {
+        continue;
+      }
+      int z0 = depth_cell(g, depth - r);
+      int z1 = depth_cell(g, depth + r);
+      int x0 = (int)span[l * 4 + 0];
+      int x1 = (int)span[l * 4 + 1];
+      int y0 = (int)span[l * 4 + 2];
+      int y1 = (int)span[l * 4 + 3];
+      for (int z = z0; z <= z1; ++z) {
+        for (int y = y0; y <= y1; ++y) {
+          uint32_t row = ((uint32_t)z * g->size_y + (uint32_t)y) * g->size_x;
+          for (int x = x0; x <= x1; ++x) {
+            uint32_t *range = ranges + (row + (uint32_t)x) * 2;
+            if (pass == 1) {
+              lists->indices[range[0] + range[1]] = l;
+            }
+            ++range[1];
+          }
+        }
+      }
+    }
+
+    if (pass == 0) {
+      uint32_t total = 0;
+      uint32_t occupied = 0;
+      for (uint32_t c = 0; c < lists->cell_count; ++c) {
+        ranges[c * 2] = total;
+        total += ranges[c * 2 + 1];
+        occupied += ranges[c * 2 + 1] > 0;
+        ranges[c * 2 + 1] = 0;
+      }
+      lists->indices = arena_push_array(scratch, uint32_t, total ? total : 1);
+      if (not lists->indices) {
+        memset(ranges, 0, sizeof(*ranges) * lists->cell_count * 2);
+        return false;
+      }
+      lists->index_count = total;
+      stats->references = total;
+      stats->cell_lights = occupied ? (float)total / (float)occupied : 0.0f;
+    }
+  }
+
+  stats->assign_ms = pacer_now_ms() - start;
+  return true;
+}
+
+void clusters_upload(cluster_grid *g, const cluster_lists *lists) {
+  GLsizeiptr range_size =
+      sizeof(cluster_header) + sizeof(uint32_t) * 2 * lists->cell_count;
+  grow_storage(g->ranges, &g->range_capacity, range_size);
+  // the header is set even when assigning failed, the shader clamps to it
+  glad_glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(cluster_header),
+                       &lists->header);
+  if (lists->ranges) {
+    glad_glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(cluster_header),
+                         range_size - sizeof(cluster_header), lists->ranges);
+  } else {
+    // no lists this frame, every cell reads as empty
+    glad_glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI,
+                              sizeof(cluster_header),
+                              range_size - sizeof(cluster_header),
+                              GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+  }
+
+  if (lists->index_count > 0) {
+    GLsizeiptr index_size = sizeof(uint32_t) * lists->index_count;
+    grow_storage(g->indices, &g->index_capacity, index_size);
+    glad_glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, index_size,
+                         lists->indices);
+  }
+}
+
+void clusters_bind(const cluster_grid *g) {
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, CLUSTER_RANGE_BINDING,
+                           g->ranges);
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, CLUSTER_INDEX_BINDING,
+                           g->indices);
+}
@@ -0,0 +1,116 @@
+#ifndef _CLUSTERS_H_
+#define _CLUSTERS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "glad/glad.h"
+#include "lights.h"
+#include "matrix.h"
+
+// binding points shared with forward_plus.frag, after those of deferred.h
+#define CLUSTER_RANGE_BINDING 10
+#define CLUSTER_INDEX_BINDING 11
+
+/* *
+ * grid size and depth slicing, std430, ahead of the ranges
+ *
+ * layout(std430, binding = 10) readonly buffer clusters {
+ *     uvec4 size;      // x, y and z cells
+ *     vec4 slice;      // z cell = log(view depth) * slice.x + slice.y
+ *     uvec2 range[];   // first index and light count per cell
+ * };
+ * */
+struct cluster_header {
+  uint32_t size[4];
+  float slice[4];
+};
+typedef struct cluster_header cluster_header;
+
+_Static_assert(sizeof(cluster_header) == 32, "std430 cluster ranges offset");
+
+/* *
+ * froxel grid of a perspective projection
+ *
+ * x and y split the screen evenly, z splits near..far exponentially so
+ * cells stay roughly cube shaped with distance. the side planes of every
+ * column and row are kept as view space normals through the eye, shared
+ * by all the cells along them.
+ * */
+struct cluster_grid {
+  uint32_t size_x;
+  uint32_t size_y;
+  uint32_t size_z;
+  float near;
+  float far;
+  // log(view depth) * slice_scale + slice_bias is the z cell
+  float slice_scale;
+  float slice_bias;
+
+  // x and z of the size_x + 1 column planes, y and z of the row planes
+  float *column_x;
+  float *column_z;
+  float *row_y;
+  float *row_z;
+
+  GLuint ranges;
+  GLuint indices;
+  GLsizeiptr range_capacity;
+  GLsizeiptr index_capacity;
+};
+typedef struct cluster_grid cluster_grid;
+
+/* *
+ * light lists of one frame, built on the cpu in a frame arena
+ *
+ * ranges holds a first index and a count per cell, in x, then y, then z
+ * order, indexing into indices.
+ * */
+struct cluster_lists {
+  cluster_header header;
+  uint32_t *ranges;
+  uint32_t *indices;
+  uint32_t cell_count;
+  uint32_t index_count;
+};
+typedef struct cluster_lists cluster_lists;
+
+/* *
+ * lights assigned by the last clusters_assign and the time it took
+ *
+ * cell_lights is the mean list length of the cells with any light.
+ * */
+struct cluster_stats {
+  unsigned lights;
+  unsigned references;
+  float cell_lights;
+  double assign_ms;
+};
+typedef struct cluster_stats cluster_stats;
+
+/* *
+ * build an x * y * z grid over the frustum of perspective(fov, aspect,
+ * near, far), fov in radians
+ * */
+bool clusters_init(cluster_grid *g, uint32_t x, uint32_t y, uint32_t z,
+                   float fov, float aspect, float near, float far);
+/* free planes and gpu storage */
+void clusters_destroy(cluster_grid *g);
+
+/* *
+ * assign count lights to the cells their spheres touch, the lists are
+ * pushed onto scratch. every sphere is tested against the shared column
+ * and row planes four lights at a time. false if scratch is full, lists
+ * are then empty.
+ * */
+bool clusters_assign(const cluster_grid *g, const point_light *lights,
+                     uint32_t count, const mat4 *view, arena *scratch,
+                     cluster_lists *lists, cluster_stats *stats);
+/* upload lists, grows storage if needed */
+void clusters_upload(cluster_grid *g, const cluster_lists *lists);
+/* bind ranges and indices to their binding points */
+void clusters_bind(const cluster_grid *g);
+
+#endif /* _CLUSTERS_H_ */
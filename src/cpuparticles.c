@@ -0,0 +1,215 @@
+/* *
+ * cpu particles
+ * */
+#include <assert.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpuparticles.h"
+#include "glstate.h"
+#include "jobs.h"
+#include "pacer.h"
+#include "utils.h"
+
+// particles per parallel_for range, a multiple of 4 keeps ranges on simd
+#define UPDATE_BATCH 4096
+#define GRAVITY -2.5f
+#define DRAG 0.4f
+// uniform location in particle_cpu.vert
+#define DRAW_SIZE 1
+
+/* HELPERS */
+
+internal uint32_t xorshift(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+internal float random01(uint32_t *state) {
+  return (float)(xorshift(state) >> 8) / 16777216.0f;
+}
+
+/* start particle i at the emitter, same distribution as particle_emit.comp */
+internal void spawn(cpu_particle_system *ps, uint32_t i,
+                    const particle_emitter *emitter) {
+  float angle = random01(&ps->seed) * 6.2831853f;
+  float radius = sqrtf(random01(&ps->seed)) * emitter->spread;
+  vec3 direction =
+      vec3_new(cosf(angle) * radius, 1.0f, sinf(angle) * radius);
+  direction = vec3_normal(&direction);
+  float speed = emitter->speed * (0.75f + 0.5f * random01(&ps->seed));
+  float lifetime = emitter->lifetime * (0.5f + 0.5f * random01(&ps->seed));
+
+  ps->position.x[i] = emitter->origin[0];
+  ps->position.y[i] = emitter->origin[1];
+  ps->position.z[i] = emitter->origin[2];
+  ps->velocity.x[i] = direction.x * speed;
+  ps->velocity.y[i] = direction.y * speed;
+  ps->velocity.z[i] = direction.z * speed;
+  ps->age[i] = 0.0f;
+  ps->inverse_lifetime[i] = lifetime > 0.0f ? 1.0f / lifetime : 1.0f;
+}
+
+struct update_task {
+  cpu_particle_system *ps;
+  float dt;
+  vec3 gravity;
+  float damping;
+  float *out;
+  atomic_uint alive;
+};
+typedef struct update_task update_task;
+
+internal void update_range(void *data, uint32_t start, uint32_t end) {
+  update_task *task = data;
+  cpu_particle_system *ps = task->ps;
+
+  unsigned alive = 0;
+  for (uint32_t i = start; i < end; ++i) {
+    ps->age[i] += task->dt;
+    ps->fraction[i] = ps->age[i] * ps->inverse_lifetime[i];
+    alive += ps->fraction[i] < 1.0f;
+  }
+  vec3_soa_scale_add(&ps->velocity, task->damping, &task->gravity, start,
+                     end);
+  vec3_soa_add_scaled(&ps->position, &ps->velocity, task->dt, start, end);
+  vec3_soa_store_vec4(&ps->position, ps->fraction, task->out + start * 4,
+                      start, end);
+
+  atomic_fetch_add(&task->alive, alive);
+}
+
+/* CPU PARTICLES */
+
+bool cpu_particles_init(cpu_particle_system *ps, uint32_t count, int regions,
+                        GLuint program) {
+  assert(count > 0 and regions > 0);
+  memset(ps, 0, sizeof(*ps));
+  ps->count = count;
+  ps->regions = regions;
+  ps->program = program;
+  ps->seed = 0x9e3779b9u;
+
+  float **streams[] = {&ps->position.x, &ps->position.y,
+                       &ps->position.z, &ps->velocity.x,
+                       &ps->velocity.y, &ps->velocity.z,
+                       &ps->age,        &ps->inverse_lifetime,
+                       &ps->fraction};
+  for (size_t i = 0; i < sizeof(streams) / sizeof(*streams); ++i) {
+    *streams[i] = calloc(count, sizeof(float));
+    if (not *streams[i]) {
+      fprintf(stderr, "ERROR: cpu particles failed to allocate %u\n", count);
+      cpu_particles_destroy(ps);
+      return false;
+    }
+  }
+  // dead until the ring reaches them
+  for (uint32_t i = 0; i < count; ++i) {
+    ps->age[i] = 1.0f;
+    ps->inverse_lifetime[i] = 1.0f;
+  }
+
+  GLsizeiptr size = (GLsizeiptr)sizeof(float) * 4 * count * regions;
+  GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glad_glGenBuffers(1, &ps->vbo);
+  glstate_bind_buffer(GL_ARRAY_BUFFER, ps->vbo);
+  glad_glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+  ps->vertices = glad_glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+  if (not ps->vertices) {
+    fprintf(stderr, "ERROR: could not map cpu particle vertices\n");
+    cpu_particles_destroy(ps);
+    return false;
+  }
+
+  // 0 = xyz position and age over lifetime, one per instance
+  glad_glGenVertexArrays(1, &ps->vao);
+  glstate_bind_vertex_array(ps->vao);
+  glad_glEnableVertexAttribArray(0);
+  glad_glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 4,
+                             NULL);
+  glad_glVertexAttribDivisor(0, 1);
+  glstate_bind_vertex_array(0);
+  return true;
+}
+
+void cpu_particles_destroy(cpu_particle_system *ps) {
+  if (ps->vertices) {
+    glstate_bind_buffer(GL_ARRAY_BUFFER, ps->vbo);
+    glad_glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  glstate_forget_buffer(ps->vbo);
+  glstate_forget_vertex_array(ps->vao);
+  glad_glDeleteBuffers(1, &ps->vbo);
+  glad_glDeleteVertexArrays(1, &ps->vao);
+
+  free(ps->position.x);
+  free(ps->position.y);
+  free(ps->position.z);
+  free(ps->velocity.x);
+  free(ps->velocity.y);
+  free(ps->velocity.z);
+  free(ps->age);
+  free(ps->inverse_lifetime);
+  free(ps->fraction);
+  memset(ps, 0, sizeof(*ps));
+}
+
+int cpu_particles_update(cpu_particle_system *ps,
+                         const particle_emitter *emitter, float dt,
+                         cpu_particle_stats *stats) {
+  double start = pacer_now_ms();
+
+  // whole particles per frame replace the oldest
+  ps->emit_carry += emitter->rate * dt;
+  uint32_t emit = ps->emit_carry < (float)ps->count
+                      ? (uint32_t)ps->emit_carry
+                      : ps->count;
+  ps->emit_carry -= (float)emit;
+  for (uint32_t n = 0; n < emit; ++n) {
+    spawn(ps, ps->spawn_cursor, emitter);
+    ps->spawn_cursor = (ps->spawn_cursor + 1) % ps->count;
+  }
+
+  ps->region = (ps->region + 1) % ps->regions;
+  ps->size = emitter->size;
+  update_task task = {
+      .ps = ps,
+      .dt = dt,
+      .gravity = vec3_new(0.0f, GRAVITY * dt, 0.0f),
+      .damping = 1.0f - DRAG * dt,
+      .out = ps->vertices + (size_t)ps->region * ps->count * 4,
+  };
+  atomic_init(&task.alive, 0);
+  parallel_for(ps->count, UPDATE_BATCH, update_range, &task);
+
+  stats->simulated = ps->count;
+  stats->alive = atomic_load(&task.alive);
+  stats->update_ms = pacer_now_ms() - start;
+  return ps->region;
+}
+
+void cpu_particles_draw(const cpu_particle_system *ps, int region) {
+  assert(region >= 0 and region < ps->regions);
+
+  glstate_use_program(ps->program);
+  glad_glProgramUniform1f(ps->program, DRAW_SIZE, ps->size);
+
+  // additive, tested against the scene but never hiding each other
+  glstate_enable(GL_BLEND);
+  glad_glBlendFunc(GL_ONE, GL_ONE);
+  glstate_depth_mask(GL_FALSE);
+  glstate_bind_vertex_array(ps->vao);
+  glad_glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4,
+                                         (GLsizei)ps->count,
+                                         (GLuint)region * ps->count);
+  glstate_depth_mask(GL_TRUE);
+  glstate_disable(GL_BLEND);
+}
@@ -0,0 +1,80 @@
+#ifndef _CPUPARTICLES_H_
+#define _CPUPARTICLES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "glad/glad.h"
+#include "particles.h"
+#include "vec.h"
+
+/* *
+ * particles simulated and alive after the last update
+ * */
+struct cpu_particle_stats {
+  unsigned simulated;
+  unsigned alive;
+  double update_ms;
+};
+typedef struct cpu_particle_stats cpu_particle_stats;
+
+/* *
+ * particles simulated on the cpu, for contexts without fast compute
+ *
+ * positions and velocities are vec3 streams integrated four at a time by
+ * the vec3_soa kernels, split across the job system. each job writes its
+ * range straight into a persistently mapped vertex buffer, one vec4 of
+ * position and age over lifetime per particle, drawn as instanced sprites.
+ *
+ * the buffer holds regions copies of every particle, one per frame in
+ * flight. a region is written again regions updates after it was drawn,
+ * the caller picks enough that the gpu is done with it by then. new
+ * particles replace the oldest in a ring, dead ones are drawn empty.
+ * */
+struct cpu_particle_system {
+  uint32_t count;
+  vec3_soa position;
+  vec3_soa velocity;
+  float *age;
+  float *inverse_lifetime;
+  // age over lifetime, written out as w
+  float *fraction;
+
+  uint32_t spawn_cursor;
+  float emit_carry;
+  uint32_t seed;
+
+  GLuint vbo;
+  GLuint vao;
+  GLuint program;
+  float *vertices;
+  int regions;
+  // region the last update wrote
+  int region;
+  float size;
+};
+typedef struct cpu_particle_system cpu_particle_system;
+
+/* *
+ * allocate count particles, all dead, and a mapped buffer of regions
+ * copies of them
+ *
+ * program is linked from particle_cpu.vert and particle.frag, the caller
+ * keeps it. needs the context current.
+ * */
+bool cpu_particles_init(cpu_particle_system *ps, uint32_t count, int regions,
+                        GLuint program);
+/* free streams and gl objects, needs the context current */
+void cpu_particles_destroy(cpu_particle_system *ps);
+
+/* *
+ * emit, simulate dt seconds and write the next region, from any job
+ * worker thread, returns the region to draw
+ * */
+int cpu_particles_update(cpu_particle_system *ps,
+                         const particle_emitter *emitter, float dt,
+                         cpu_particle_stats *stats);
+/* draw region additively, needs the camera block bound */
+void cpu_particles_draw(const cpu_particle_system *ps, int region);
+
+#endif /* _CPUPARTICLES_H_ */
@@ -0,0 +1,50 @@
+/* *
+ * damage tracking
+ * */
+#include <string.h>
+
+#include "damage.h"
+#include "utils.h"
+
+void damage_init(damage_tracker *d) {
+  memset(d, 0, sizeof(*d));
+  atomic_init(&d->pending, DAMAGE_INPUT | DAMAGE_WINDOW | DAMAGE_RESOURCE);
+  atomic_init(&d->waiting, false);
+}
+
+void damage_set_wake(damage_tracker *d, void (*wake)(void)) {
+  d->wake = wake;
+}
+
+void damage_mark(damage_tracker *d, unsigned flags) {
+  // sequentially consistent against damage_wait_begin, either the loop
+  // sees these flags or this sees it waiting
+  atomic_fetch_or(&d->pending, flags);
+  if (d->wake and atomic_load(&d->waiting)) {
+    d->wake();
+  }
+}
+
+bool damage_pending(damage_tracker *d) {
+  return atomic_load_explicit(&d->pending, memory_order_acquire) != 0;
+}
+
+unsigned damage_take(damage_tracker *d) {
+  ++d->frames_drawn;
+  return atomic_exchange_explicit(&d->pending, DAMAGE_NONE,
+                                  memory_order_acq_rel);
+}
+
+bool damage_wait_begin(damage_tracker *d) {
+  atomic_store(&d->waiting, true);
+  return atomic_load(&d->pending) == 0;
+}
+
+void damage_wait_end(damage_tracker *d) {
+  atomic_store(&d->waiting, false);
+}
+
+void damage_skip(damage_tracker *d, double idle_ms) {
+  ++d->frames_skipped;
+  d->idle_ms += idle_ms;
+}
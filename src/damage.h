@@ -0,0 +1,60 @@
+#ifndef _DAMAGE_H_
+#define _DAMAGE_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/* reasons the next frame has to be drawn */
+enum damage_flags {
+  DAMAGE_NONE = 0,
+  DAMAGE_INPUT = 1 << 0,
+  // resized, exposed or refocused
+  DAMAGE_WINDOW = 1 << 1,
+  DAMAGE_ANIMATION = 1 << 2,
+  // gpu data changed, uploads and reloads
+  DAMAGE_RESOURCE = 1 << 3,
+};
+typedef enum damage_flags damage_flags;
+
+/* *
+ * tracks whether anything visible changed since the last drawn frame
+ *
+ * any thread may mark damage, the main loop takes it once per drawn
+ * frame and waits for events instead of drawing while nothing is pending.
+ * a mark made while it waits calls wake, so marks from other threads are
+ * drawn without waiting out the timeout.
+ * */
+struct damage_tracker {
+  atomic_uint pending;
+  atomic_bool waiting;
+  // wakes the main loop from any thread, glfwPostEmptyEvent
+  void (*wake)(void);
+
+  // totals since init
+  unsigned frames_drawn;
+  unsigned frames_skipped;
+  double idle_ms;
+};
+typedef struct damage_tracker damage_tracker;
+
+/* start with everything damaged so the first frame is drawn */
+void damage_init(damage_tracker *d);
+/* called by marks made while the main loop waits, may be NULL */
+void damage_set_wake(damage_tracker *d, void (*wake)(void));
+/* mark flags as changed, safe from any thread, wakes a waiting loop */
+void damage_mark(damage_tracker *d, unsigned flags);
+/* true if a frame has to be drawn */
+bool damage_pending(damage_tracker *d);
+/* clear and return pending flags, counts a drawn frame */
+unsigned damage_take(damage_tracker *d);
+/* *
+ * before waiting for events, false if damage was marked meanwhile and
+ * the wait should be skipped. always paired with damage_wait_end.
+ * */
+bool damage_wait_begin(damage_tracker *d);
+/* after waiting for events */
+void damage_wait_end(damage_tracker *d);
+/* count a frame that was not drawn, idle_ms spent waiting for events */
+void damage_skip(damage_tracker *d, double idle_ms);
+
+#endif /* _DAMAGE_H_ */
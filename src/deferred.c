@@ -0,0 +1,175 @@
+/* *
+ * deferred shading
+ * */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "deferred.h"
+#include "glstate.h"
+#include "readback.h"
+#include "utils.h"
+
+// uniform locations in deferred_light.comp
+#define LIGHT_COUNT 0
+#define LIGHT_COUNTER 1
+
+/* HELPERS */
+
+internal GLuint create_target(GLenum format, GLsizei width, GLsizei height) {
+  GLuint texture = 0;
+  glad_glGenTextures(1, &texture);
+  glstate_bind_texture(0, GL_TEXTURE_2D, texture);
+  glad_glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+  glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  return texture;
+}
+
+internal GLuint tile_count(GLsizei size) {
+  return (GLuint)((size + DEFERRED_TILE_SIZE - 1) / DEFERRED_TILE_SIZE);
+}
+
+internal double elapsed_ms(GLuint from, GLuint to) {
+  GLuint64 start = 0;
+  GLuint64 end = 0;
+  glad_glGetQueryObjectui64v(from, GL_QUERY_RESULT, &start);
+  glad_glGetQueryObjectui64v(to, GL_QUERY_RESULT, &end);
+  return (double)(end - start) / 1000000.0;
+}
+
+/* keep the results of the frame that last wrote the current slot */
+internal void read_slot(deferred_renderer *d) {
+  int slot = d->counters.slot;
+  const GLuint *counts = readback_begin(&d->counters);
+  if (not counts) {
+    return;
+  }
+
+  // sky tiles skip the cull and count for neither
+  GLuint lights = counts[0];
+  GLuint tiles = counts[1];
+  d->stats.lights = d->lights[slot];
+  d->stats.tile_lights = tiles > 0 ? (float)lights / (float)tiles : 0.0f;
+  d->stats.geometry_ms =
+      elapsed_ms(d->queries[slot][0], d->queries[slot][1]);
+  d->stats.lighting_ms =
+      elapsed_ms(d->queries[slot][1], d->queries[slot][2]);
+}
+
+/* DEFERRED */
+
+bool deferred_init(deferred_renderer *d, GLsizei width, GLsizei height,
+                   GLuint light_program) {
+  assert(width > 0 and height > 0);
+  memset(d, 0, sizeof(*d));
+  d->width = width;
+  d->height = height;
+  d->light_program = light_program;
+
+  // normals are octahedral, two signed channels hold a unit vector
+  d->albedo = create_target(GL_RGBA8, width, height);
+  d->normal = create_target(GL_RG16_SNORM, width, height);
+  d->lit = create_target(GL_RGBA8, width, height);
+  d->depth = create_target(GL_DEPTH24_STENCIL8, width, height);
+
+  glad_glGenFramebuffers(1, &d->framebuffer);
+  glstate_bind_framebuffer(GL_FRAMEBUFFER, d->framebuffer);
+  glad_glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_TEXTURE_2D, d->albedo, 0);
+  glad_glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+                              GL_TEXTURE_2D, d->normal, 0);
+  glad_glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2,
+                              GL_TEXTURE_2D, d->lit, 0);
+  glad_glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_TEXTURE_2D, d->depth, 0);
+  // draws write albedo and normal, the blit reads the lit image
+  const GLenum draw_buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glad_glDrawBuffers(2, draw_buffers);
+  glad_glReadBuffer(GL_COLOR_ATTACHMENT2);
+  GLenum status = glad_glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glstate_bind_framebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "ERROR: g-buffer incomplete 0x%x\n", status);
+    deferred_destroy(d);
+    return false;
+  }
+
+  glad_glGenQueries(DEFERRED_READBACK_FRAMES * 3, d->queries[0]);
+
+  // reset by the cpu before each light pass, read a few frames later. a
+  // slot is the lights that passed the cull and the tiles that culled
+  if (not readback_init(&d->counters, sizeof(GLuint) * 2, true)) {
+    deferred_destroy(d);
+    return false;
+  }
+  return true;
+}
+
+void deferred_destroy(deferred_renderer *d) {
+  readback_destroy(&d->counters);
+  if (d->queries[0][0]) {
+    glad_glDeleteQueries(DEFERRED_READBACK_FRAMES * 3, d->queries[0]);
+  }
+
+  GLuint textures[4] = {d->albedo, d->normal, d->lit, d->depth};
+  for (int i = 0; i < 4; ++i) {
+    glstate_forget_texture(textures[i]);
+  }
+  glstate_forget_framebuffer(d->framebuffer);
+  glad_glDeleteTextures(4, textures);
+  glad_glDeleteFramebuffers(1, &d->framebuffer);
+  memset(d, 0, sizeof(*d));
+}
+
+void deferred_begin(deferred_renderer *d, deferred_stats *stats) {
+  read_slot(d);
+  *stats = d->stats;
+
+  glad_glQueryCounter(d->queries[d->counters.slot][0], GL_TIMESTAMP);
+
+  // cleared to the clear colour, which the light pass keeps where there is
+  // no geometry
+  glstate_bind_framebuffer(GL_FRAMEBUFFER, d->framebuffer);
+  glstate_viewport(0, 0, d->width, d->height);
+  glad_glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void deferred_end(deferred_renderer *d, const light_buffer *lb) {
+  int slot = d->counters.slot;
+  glad_glQueryCounter(d->queries[slot][1], GL_TIMESTAMP);
+
+  GLuint tiles_x = tile_count(d->width);
+  GLuint tiles_y = tile_count(d->height);
+  GLuint *counts = readback_slot(&d->counters);
+  counts[0] = 0;
+  counts[1] = 0;
+  d->lights[slot] = (unsigned)lb->count;
+
+  // the g-buffer is read as textures while nothing is bound to draw to it
+  glstate_bind_framebuffer(GL_FRAMEBUFFER, 0);
+  glstate_use_program(d->light_program);
+  glad_glProgramUniform1ui(d->light_program, LIGHT_COUNT, (GLuint)lb->count);
+  glad_glProgramUniform1ui(d->light_program, LIGHT_COUNTER, (GLuint)slot);
+  glstate_bind_texture(0, GL_TEXTURE_2D, d->albedo);
+  glstate_bind_texture(1, GL_TEXTURE_2D, d->normal);
+  glstate_bind_texture(2, GL_TEXTURE_2D, d->depth);
+  glad_glBindImageTexture(0, d->lit, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+  light_buffer_bind(lb);
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, DEFERRED_COUNTER_BINDING,
+                           d->counters.buffer);
+  glad_glDispatchCompute(tiles_x, tiles_y, 1);
+
+  // the blit reads the lit image through the framebuffer, the cpu the count
+  glad_glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT |
+                       GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+  glad_glQueryCounter(d->queries[slot][2], GL_TIMESTAMP);
+
+  glstate_bind_framebuffer(GL_READ_FRAMEBUFFER, d->framebuffer);
+  glad_glBlitFramebuffer(0, 0, d->width, d->height, 0, 0, d->width, d->height,
+                         GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+                         GL_NEAREST);
+  glstate_bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+
+  readback_end(&d->counters);
+}
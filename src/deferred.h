@@ -0,0 +1,84 @@
+#ifndef _DEFERRED_H_
+#define _DEFERRED_H_
+
+#include <stdbool.h>
+
+#include "glad/glad.h"
+#include "lights.h"
+#include "readback.h"
+
+// binding of the tile counters in deferred_light.comp, after LIGHT_BINDING
+#define DEFERRED_COUNTER_BINDING 9
+// pixels per side of a light tile, the work group size of the light pass
+#define DEFERRED_TILE_SIZE 16
+// timings and tile counts are read back this many frames later
+#define DEFERRED_READBACK_FRAMES READBACK_FRAMES
+
+/* *
+ * lights and the gpu time of each pass, DEFERRED_READBACK_FRAMES old
+ *
+ * tile_lights is the mean count of lights that passed the cull of a tile
+ * holding geometry, the number each of its pixels evaluates.
+ * */
+struct deferred_stats {
+  unsigned lights;
+  float tile_lights;
+  double geometry_ms;
+  double lighting_ms;
+};
+typedef struct deferred_stats deferred_stats;
+
+/* *
+ * deferred shading with tiled light culling
+ *
+ * the opaque draws fill a g-buffer of albedo and an octahedral encoded
+ * normal in two channels, with depth giving back the position. one
+ * compute pass then works on 16x16 pixel tiles, finds the depth range of
+ * each, culls every light against the tile frustum into a list in shared
+ * memory and shades the tile from that list alone, so a pixel only pays
+ * for the lights that can reach it. the lit image and the depth are then
+ * blitted to the default framebuffer, later forward passes draw over it
+ * as before.
+ * */
+struct deferred_renderer {
+  GLsizei width;
+  GLsizei height;
+  GLuint light_program;
+
+  // albedo, normal, lit result and depth, all in one framebuffer
+  GLuint framebuffer;
+  GLuint albedo;
+  GLuint normal;
+  GLuint lit;
+  GLuint depth;
+
+  // culled lights and tiles, one pair per readback frame
+  readback_ring counters;
+  // timestamps around the geometry and light passes
+  GLuint queries[DEFERRED_READBACK_FRAMES][3];
+  unsigned lights[DEFERRED_READBACK_FRAMES];
+  deferred_stats stats;
+};
+typedef struct deferred_renderer deferred_renderer;
+
+/* *
+ * create a width x height g-buffer, light_program is linked from
+ * deferred_light.comp and stays with the caller
+ * */
+bool deferred_init(deferred_renderer *d, GLsizei width, GLsizei height,
+                   GLuint light_program);
+/* delete the g-buffer, counters, queries and pending fences */
+void deferred_destroy(deferred_renderer *d);
+
+/* *
+ * bind and clear the g-buffer, the opaque draws that follow write to it
+ * with gbuffer.vert + gbuffer.frag. stats receive an earlier frame.
+ * */
+void deferred_begin(deferred_renderer *d, deferred_stats *stats);
+/* *
+ * light the g-buffer with the lights of lb and blit colour and depth to
+ * the default framebuffer, which is left bound. needs the camera block.
+ * */
+void deferred_end(deferred_renderer *d, const light_buffer *lb);
+
+#endif /* _DEFERRED_H_ */
@@ -0,0 +1,172 @@
+/* *
+ * draw list
+ * */
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "drawlist.h"
+#include "glstate.h"
+#include "utils.h"
+
+/* HELPERS */
+
+/* fill draw id buffer with 0 .. instances - 1, false if out of memory */
+internal bool draw_id_buffer_resize(GLuint buffer, GLuint instances) {
+  GLuint *ids = malloc(sizeof(*ids) * instances);
+  if (not ids) {
+    fprintf(stderr, "ERROR: draw list failed to allocate %u draw ids\n",
+            instances);
+    return false;
+  }
+
+  for (GLuint i = 0; i < instances; ++i) {
+    ids[i] = i;
+  }
+
+  glstate_bind_buffer(GL_ARRAY_BUFFER, buffer);
+  glad_glBufferData(GL_ARRAY_BUFFER, sizeof(*ids) * instances, ids,
+                    GL_STATIC_DRAW);
+
+  free(ids);
+  return true;
+}
+
+/* DRAW LIST */
+
+bool draw_list_init(draw_list *dl, GLsizei capacity) {
+  assert(capacity > 0);
+
+  dl->commands = malloc(sizeof(*dl->commands) * capacity);
+  if (not dl->commands) {
+    fprintf(stderr, "ERROR: draw list failed to allocate %d commands\n",
+            capacity);
+    return false;
+  }
+
+  dl->count = 0;
+  dl->capacity = capacity;
+  dl->instances = 0;
+
+  glad_glGenBuffers(1, &dl->indirect_buffer);
+  glstate_bind_buffer(GL_DRAW_INDIRECT_BUFFER, dl->indirect_buffer);
+  glad_glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                    sizeof(*dl->commands) * capacity, NULL, GL_STREAM_DRAW);
+  dl->gpu_capacity = capacity;
+
+  glad_glGenBuffers(1, &dl->draw_id_buffer);
+  if (not draw_id_buffer_resize(dl->draw_id_buffer, (GLuint)capacity)) {
+    draw_list_destroy(dl);
+    return false;
+  }
+  dl->gpu_instances = (GLuint)capacity;
+
+  return true;
+}
+
+void draw_list_destroy(draw_list *dl) {
+  glstate_forget_buffer(dl->indirect_buffer);
+  glstate_forget_buffer(dl->draw_id_buffer);
+  glad_glDeleteBuffers(1, &dl->indirect_buffer);
+  glad_glDeleteBuffers(1, &dl->draw_id_buffer);
+  free(dl->commands);
+
+  dl->commands = NULL;
+  dl->count = 0;
+  dl->capacity = 0;
+  dl->instances = 0;
+}
+
+void draw_list_clear(draw_list *dl) {
+  dl->count = 0;
+  dl->instances = 0;
+}
+
+bool draw_list_push(draw_list *dl, GLuint count, GLuint first_index,
+                    GLint base_vertex, GLuint instance_count,
+                    GLuint *draw_id) {
+  if (dl->count == dl->capacity) {
+    GLsizei capacity = dl->capacity * 2;
+    draw_command *commands =
+        realloc(dl->commands, sizeof(*commands) * capacity);
+    // the old commands are still valid and owned by dl
+    if (not commands) {
+      fprintf(stderr, "ERROR: draw list failed to grow to %d commands\n",
+              capacity);
+      return false;
+    }
+    dl->commands = commands;
+    dl->capacity = capacity;
+  }
+
+  draw_command *cmd = &dl->commands[dl->count++];
+  cmd->count = count;
+  cmd->instance_count = instance_count;
+  cmd->first_index = first_index;
+  cmd->base_vertex = base_vertex;
+  cmd->base_instance = dl->instances;
+
+  if (draw_id) {
+    *draw_id = dl->instances;
+  }
+  dl->instances += instance_count;
+
+  return true;
+}
+
+void draw_list_bind_draw_id(const draw_list *dl, GLuint attrib) {
+  glstate_bind_buffer(GL_ARRAY_BUFFER, dl->draw_id_buffer);
+  glad_glEnableVertexAttribArray(attrib);
+  glad_glVertexAttribIPointer(attrib, 1, GL_UNSIGNED_INT, 0, NULL);
+  glad_glVertexAttribDivisor(attrib, 1);
+}
+
+bool draw_list_upload(draw_list *dl) {
+  glstate_bind_buffer(GL_DRAW_INDIRECT_BUFFER, dl->indirect_buffer);
+
+  // orphan old storage so the driver does not wait on last frames draws
+  if (dl->capacity > dl->gpu_capacity) {
+    dl->gpu_capacity = dl->capacity;
+  }
+  glad_glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                    sizeof(*dl->commands) * dl->gpu_capacity, NULL,
+                    GL_STREAM_DRAW);
+  glad_glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+                       sizeof(*dl->commands) * dl->count, dl->commands);
+
+  // buffer name is kept so vaos pointing at it stay valid
+  if (dl->instances > dl->gpu_instances) {
+    GLuint instances = dl->gpu_instances;
+    while (instances < dl->instances) {
+      instances *= 2;
+    }
+    if (not draw_id_buffer_resize(dl->draw_id_buffer, instances)) {
+      return false;
+    }
+    dl->gpu_instances = instances;
+  }
+  return true;
+}
+
+void draw_list_submit_range(const draw_list *dl, GLenum mode, GLsizei first,
+                            GLsizei count) {
+  if (count <= 0) {
+    return;
+  }
+
+  assert(first + count <= dl->count);
+
+  glstate_bind_buffer(GL_DRAW_INDIRECT_BUFFER, dl->indirect_buffer);
+  glad_glMultiDrawElementsIndirect(
+      mode, GL_UNSIGNED_INT,
+      (const void *)(uintptr_t)(sizeof(draw_command) * first), count, 0);
+}
+
+bool draw_list_submit(draw_list *dl, GLenum mode) {
+  if (not draw_list_upload(dl)) {
+    return false;
+  }
+  draw_list_submit_range(dl, mode, 0, dl->count);
+  return true;
+}
@@ -0,0 +1,67 @@
+#ifndef _DRAWLIST_H_
+#define _DRAWLIST_H_
+
+#include <stdbool.h>
+
+#include "glad/glad.h"
+
+/* *
+ * one indirect draw, layout is fixed by glMultiDrawElementsIndirect
+ * */
+struct draw_command {
+  GLuint count;
+  GLuint instance_count;
+  GLuint first_index;
+  GLint base_vertex;
+  GLuint base_instance;
+};
+typedef struct draw_command draw_command;
+
+/* *
+ * list of indirect draws submitted with a single glMultiDrawElementsIndirect
+ *
+ * every draw gets a unique base_instance, an instanced vertex attribute
+ * fed from draw_id_buffer (0, 1, 2, ...) turns that into a per draw index
+ * the shader can use to look up per draw data.
+ * */
+struct draw_list {
+  draw_command *commands;
+  GLsizei count;
+  GLsizei capacity;
+
+  GLuint instances;
+
+  GLuint indirect_buffer;
+  GLuint draw_id_buffer;
+  GLsizei gpu_capacity;
+  GLuint gpu_instances;
+};
+typedef struct draw_list draw_list;
+
+/* create draw list able to hold capacity draws before growing */
+bool draw_list_init(draw_list *dl, GLsizei capacity);
+/* free cpu and gpu storage */
+void draw_list_destroy(draw_list *dl);
+/* remove all draws, keeps storage */
+void draw_list_clear(draw_list *dl);
+/* *
+ * append a draw, draw_id is set to the id of its first instance and may be
+ * NULL. false if the list could not grow, it is left as it was.
+ * */
+bool draw_list_push(draw_list *dl, GLuint count, GLuint first_index,
+                    GLint base_vertex, GLuint instance_count,
+                    GLuint *draw_id);
+/* bind draw id stream to attrib of the currently bound vao */
+void draw_list_bind_draw_id(const draw_list *dl, GLuint attrib);
+/* *
+ * copy recorded draws into the indirect buffer, false if the draw ids
+ * could not grow to cover them, they must not be drawn then
+ * */
+bool draw_list_upload(draw_list *dl);
+/* draw count uploaded commands starting at first */
+void draw_list_submit_range(const draw_list *dl, GLenum mode, GLsizei first,
+                            GLsizei count);
+/* upload and draw every recorded command, false if nothing was drawn */
+bool draw_list_submit(draw_list *dl, GLenum mode);
+
+#endif /* _DRAWLIST_H_ */
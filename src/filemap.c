@@ -0,0 +1,132 @@
+/* *
+ * memory mapped files
+ * */
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "filemap.h"
+#include "utils.h"
+
+#ifdef _WIN32
+
+bool file_map_open(file_map *fm, const char *path) {
+  memset(fm, 0, sizeof(*fm));
+
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (not GetFileSizeEx(file, &size)) {
+    fprintf(stderr, "ERROR: could not get size of %s\n", path);
+    CloseHandle(file);
+    return false;
+  }
+
+  fm->file = file;
+  fm->size = (size_t)size.QuadPart;
+  if (fm->size == 0) {
+    return true;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (not mapping) {
+    fprintf(stderr, "ERROR: could not map %s\n", path);
+    CloseHandle(file);
+    return false;
+  }
+
+  fm->mapping = mapping;
+  fm->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (not fm->data) {
+    fprintf(stderr, "ERROR: could not view %s\n", path);
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  return true;
+}
+
+void file_map_close(file_map *fm) {
+  if (fm->data) {
+    UnmapViewOfFile(fm->data);
+  }
+  if (fm->mapping) {
+    CloseHandle(fm->mapping);
+  }
+  if (fm->file) {
+    CloseHandle(fm->file);
+  }
+  memset(fm, 0, sizeof(*fm));
+}
+
+#else
+
+bool file_map_open(file_map *fm, const char *path) {
+  memset(fm, 0, sizeof(*fm));
+  fm->fd = -1;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    fprintf(stderr, "ERROR: could not get size of %s\n", path);
+    close(fd);
+    return false;
+  }
+
+  fm->fd = fd;
+  fm->size = (size_t)st.st_size;
+  if (fm->size == 0) {
+    return true;
+  }
+
+  void *data = mmap(NULL, fm->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "ERROR: could not map %s\n", path);
+    close(fd);
+    fm->fd = -1;
+    return false;
+  }
+
+  fm->data = data;
+  return true;
+}
+
+void file_map_close(file_map *fm) {
+  if (fm->data) {
+    munmap((void *)fm->data, fm->size);
+  }
+  if (fm->fd >= 0) {
+    close(fm->fd);
+  }
+  memset(fm, 0, sizeof(*fm));
+  fm->fd = -1;
+}
+
+#endif
+
+bool file_info_get(const char *path, file_info *info) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return false;
+  }
+  info->size = (uint64_t)st.st_size;
+  info->modified = (int64_t)st.st_mtime;
+  return true;
+}
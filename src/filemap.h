@@ -0,0 +1,40 @@
+#ifndef _FILEMAP_H_
+#define _FILEMAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* *
+ * read only view of a whole file mapped into memory
+ *
+ * pages are loaded by the os on first touch, nothing is copied until the
+ * data is read.
+ * */
+struct file_map {
+  const void *data;
+  size_t size;
+#ifdef _WIN32
+  void *file;
+  void *mapping;
+#else
+  int fd;
+#endif
+};
+typedef struct file_map file_map;
+
+/* size and modification time, used to spot stale caches */
+struct file_info {
+  uint64_t size;
+  int64_t modified;
+};
+typedef struct file_info file_info;
+
+/* map path read only, empty files map to NULL data and size 0 */
+bool file_map_open(file_map *fm, const char *path);
+/* unmap, data is invalid afterwards */
+void file_map_close(file_map *fm);
+/* fill info for path, false if it does not exist */
+bool file_info_get(const char *path, file_info *info);
+
+#endif /* _FILEMAP_H_ */
@@ -0,0 +1,372 @@
+/* *
+ * frustum culling
+ * */
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frustum.h"
+#include "jobs.h"
+#include "utils.h"
+
+// objects per parallel cull chunk, at least this many
+#define CULL_CHUNK_MIN 1024
+#define CULL_MAX_CHUNKS 256
+
+#if defined(__SSE__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+/* HELPERS */
+
+internal plane plane_normalize(float x, float y, float z, float d) {
+  float len = sqrtf(x * x + y * y + z * z);
+  assert(len != 0.0f);
+  float by = 1.0f / len;
+  return (plane){.x = x * by, .y = y * by, .z = z * by, .d = d * by};
+}
+
+internal float plane_distance(const plane *p, const vec3 *v3) {
+  return p->x * v3->x + p->y * v3->y + p->z * v3->z + p->d;
+}
+
+/* radius of box projected onto plane normal */
+internal float plane_box_radius(const plane *p, const vec3 *extent) {
+  return fabsf(p->x) * extent->x + fabsf(p->y) * extent->y +
+         fabsf(p->z) * extent->z;
+}
+
+/* test single object idx against all planes */
+internal bool cull_one(const frustum *f, const bounds_soa *b, uint32_t idx) {
+  vec3 c = vec3_new(b->center_x[idx], b->center_y[idx], b->center_z[idx]);
+  vec3 e = vec3_new(b->extent_x[idx], b->extent_y[idx], b->extent_z[idx]);
+
+  for (int p = 0; p < 6; ++p) {
+    const plane *pl = &f->planes[p];
+    float r = fminf(plane_box_radius(pl, &e), b->radius[idx]);
+    if (plane_distance(pl, &c) < -r) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* FRUSTUM */
+
+frustum frustum_from_mat4(const mat4 *vp) {
+  /* *
+   * row order, clip = v * vp so column j of vp gives clip component j
+   * -w <= x, y, z <= w becomes col4 +- col1, col4 +- col2, col4 +- col3
+   * */
+  frustum f;
+  f.planes[0] = plane_normalize(vp->_14 + vp->_11, vp->_24 + vp->_21,
+                                vp->_34 + vp->_31, vp->_44 + vp->_41);
+  f.planes[1] = plane_normalize(vp->_14 - vp->_11, vp->_24 - vp->_21,
+                                vp->_34 - vp->_31, vp->_44 - vp->_41);
+  f.planes[2] = plane_normalize(vp->_14 + vp->_12, vp->_24 + vp->_22,
+                                vp->_34 + vp->_32, vp->_44 + vp->_42);
+  f.planes[3] = plane_normalize(vp->_14 - vp->_12, vp->_24 - vp->_22,
+                                vp->_34 - vp->_32, vp->_44 - vp->_42);
+  f.planes[4] = plane_normalize(vp->_14 + vp->_13, vp->_24 + vp->_23,
+                                vp->_34 + vp->_33, vp->_44 + vp->_43);
+  f.planes[5] = plane_normalize(vp->_14 - vp->_13, vp->_24 - vp->_23,
+                                vp->_34 - vp->_33, vp->_44 - vp->_43);
+  return f;
+}
+
+bool frustum_test_sphere(const frustum *f, const sphere *s) {
+  for (int p = 0; p < 6; ++p) {
+    if (plane_distance(&f->planes[p], &s->center) < -s->radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool frustum_test_aabb(const frustum *f, const aabb *box) {
+  vec3 c = aabb_center(box);
+  vec3 e = aabb_extent(box);
+  for (int p = 0; p < 6; ++p) {
+    const plane *pl = &f->planes[p];
+    if (plane_distance(pl, &c) < -plane_box_radius(pl, &e)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* AABB */
+
+aabb aabb_new(const vec3 *min, const vec3 *max) {
+  aabb box = {.min = *min, .max = *max};
+  return box;
+}
+
+aabb aabb_transform(const aabb *box, const mat4 *m4) {
+  vec3 c = aabb_center(box);
+  vec3 e = aabb_extent(box);
+
+  // row order, p' = p * m4
+  vec3 tc = vec3_new(c.x * m4->_11 + c.y * m4->_21 + c.z * m4->_31 + m4->_41,
+                     c.x * m4->_12 + c.y * m4->_22 + c.z * m4->_32 + m4->_42,
+                     c.x * m4->_13 + c.y * m4->_23 + c.z * m4->_33 + m4->_43);
+
+  vec3 te = vec3_new(
+      e.x * fabsf(m4->_11) + e.y * fabsf(m4->_21) + e.z * fabsf(m4->_31),
+      e.x * fabsf(m4->_12) + e.y * fabsf(m4->_22) + e.z * fabsf(m4->_32),
+      e.x * fabsf(m4->_13) + e.y * fabsf(m4->_23) + e.z * fabsf(m4->_33));
+
+  aabb result;
+  result.min = vec3_sub(&tc, &te);
+  result.max = vec3_add(&tc, &te);
+  return result;
+}
+
+aabb aabb_merge(const aabb *a, const aabb *b) {
+  aabb result;
+  result.min = vec3_new(fminf(a->min.x, b->min.x), fminf(a->min.y, b->min.y),
+                        fminf(a->min.z, b->min.z));
+  result.max = vec3_new(fmaxf(a->max.x, b->max.x), fmaxf(a->max.y, b->max.y),
+                        fmaxf(a->max.z, b->max.z));
+  return result;
+}
+
+vec3 aabb_center(const aabb *box) {
+  vec3 sum = vec3_add(&box->min, &box->max);
+  return vec3_mul(&sum, 0.5f);
+}
+
+vec3 aabb_extent(const aabb *box) {
+  vec3 size = vec3_sub(&box->max, &box->min);
+  return vec3_mul(&size, 0.5f);
+}
+
+bool aabb_overlap(const aabb *a, const aabb *b) {
+  return a->min.x <= b->max.x and a->max.x >= b->min.x and
+         a->min.y <= b->max.y and a->max.y >= b->min.y and
+         a->min.z <= b->max.z and a->max.z >= b->min.z;
+}
+
+sphere sphere_from_aabb(const aabb *box) {
+  vec3 e = aabb_extent(box);
+  sphere s;
+  s.center = aabb_center(box);
+  s.radius = sqrtf(vec3_dot(&e, &e));
+  return s;
+}
+
+/* BOUNDS SOA */
+
+bool bounds_soa_init(bounds_soa *b, uint32_t capacity) {
+  assert(capacity > 0);
+  memset(b, 0, sizeof(*b));
+
+  float **streams[] = {&b->center_x, &b->center_y, &b->center_z, &b->extent_x,
+                       &b->extent_y, &b->extent_z, &b->radius};
+  for (size_t i = 0; i < sizeof(streams) / sizeof(*streams); ++i) {
+    *streams[i] = malloc(sizeof(float) * capacity);
+    if (not *streams[i]) {
+      fprintf(stderr, "ERROR: bounds failed to allocate %u objects\n",
+              capacity);
+      bounds_soa_destroy(b);
+      return false;
+    }
+  }
+
+  b->capacity = capacity;
+  return true;
+}
+
+void bounds_soa_destroy(bounds_soa *b) {
+  free(b->center_x);
+  free(b->center_y);
+  free(b->center_z);
+  free(b->extent_x);
+  free(b->extent_y);
+  free(b->extent_z);
+  free(b->radius);
+  memset(b, 0, sizeof(*b));
+}
+
+void bounds_soa_clear(bounds_soa *b) { b->count = 0; }
+
+uint32_t bounds_soa_push(bounds_soa *b, const aabb *box, const sphere *s) {
+  if (b->count == b->capacity) {
+    uint32_t capacity = b->capacity * 2;
+    float **streams[] = {&b->center_x, &b->center_y, &b->center_z,
+                         &b->extent_x, &b->extent_y, &b->extent_z,
+                         &b->radius};
+    for (size_t i = 0; i < sizeof(streams) / sizeof(*streams); ++i) {
+      float *grown = realloc(*streams[i], sizeof(float) * capacity);
+      assert(grown);
+      *streams[i] = grown;
+    }
+    b->capacity = capacity;
+  }
+
+  uint32_t idx = b->count++;
+  bounds_soa_set(b, idx, box, s);
+  return idx;
+}
+
+void bounds_soa_set(bounds_soa *b, uint32_t idx, const aabb *box,
+                    const sphere *s) {
+  assert(idx < b->count);
+
+  vec3 c = aabb_center(box);
+  vec3 e = aabb_extent(box);
+  b->center_x[idx] = c.x;
+  b->center_y[idx] = c.y;
+  b->center_z[idx] = c.z;
+  b->extent_x[idx] = e.x;
+  b->extent_y[idx] = e.y;
+  b->extent_z[idx] = e.z;
+
+  // sphere has to share the box center, grow it to cover any offset
+  if (s) {
+    vec3 offset = vec3_sub(&s->center, &c);
+    b->radius[idx] = s->radius + sqrtf(vec3_dot(&offset, &offset));
+  } else {
+    b->radius[idx] = sqrtf(vec3_dot(&e, &e));
+  }
+}
+
+/* CULL */
+
+uint32_t frustum_cull(const frustum *f, const bounds_soa *b, uint32_t first,
+                      uint32_t count, uint32_t *visible, cull_stats *stats) {
+  assert(first + count <= b->count);
+
+  uint32_t n = 0;
+  uint32_t i = first;
+  uint32_t end = first + count;
+
+#ifdef FRUSTUM_SSE
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  const __m128 zero = _mm_setzero_ps();
+
+  __m128 px[6], py[6], pz[6], pd[6];
+  __m128 ax[6], ay[6], az[6];
+  for (int p = 0; p < 6; ++p) {
+    px[p] = _mm_set1_ps(f->planes[p].x);
+    py[p] = _mm_set1_ps(f->planes[p].y);
+    pz[p] = _mm_set1_ps(f->planes[p].z);
+    pd[p] = _mm_set1_ps(f->planes[p].d);
+    ax[p] = _mm_andnot_ps(sign, px[p]);
+    ay[p] = _mm_andnot_ps(sign, py[p]);
+    az[p] = _mm_andnot_ps(sign, pz[p]);
+  }
+
+  for (; i + 4 <= end; i += 4) {
+    __m128 cx = _mm_loadu_ps(b->center_x + i);
+    __m128 cy = _mm_loadu_ps(b->center_y + i);
+    __m128 cz = _mm_loadu_ps(b->center_z + i);
+    __m128 ex = _mm_loadu_ps(b->extent_x + i);
+    __m128 ey = _mm_loadu_ps(b->extent_y + i);
+    __m128 ez = _mm_loadu_ps(b->extent_z + i);
+    __m128 radius = _mm_loadu_ps(b->radius + i);
+
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; ++p) {
+      __m128 dist = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(cx, px[p]), _mm_mul_ps(cy, py[p])),
+          _mm_add_ps(_mm_mul_ps(cz, pz[p]), pd[p]));
+      __m128 box_r = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(ex, ax[p]), _mm_mul_ps(ey, ay[p])),
+          _mm_mul_ps(ez, az[p]));
+      __m128 r = _mm_min_ps(box_r, radius);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(dist, r), zero));
+    }
+
+    // compact without branching on visibility
+    int mask = _mm_movemask_ps(inside);
+    visible[n] = i;
+    n += mask & 1;
+    visible[n] = i + 1;
+    n += (mask >> 1) & 1;
+    visible[n] = i + 2;
+    n += (mask >> 2) & 1;
+    visible[n] = i + 3;
+    n += (mask >> 3) & 1;
+  }
+#endif
+
+  for (; i < end; ++i) {
+    if (cull_one(f, b, i)) {
+      visible[n++] = i;
+    }
+  }
+
+  if (stats) {
+    stats->tested += count;
+    stats->visible += n;
+    stats->culled += count - n;
+  }
+
+  return n;
+}
+
+/* PARALLEL */
+
+struct cull_task {
+  const frustum *f;
+  const bounds_soa *b;
+  uint32_t first;
+  uint32_t count;
+  uint32_t chunk;
+  uint32_t *visible;
+  uint32_t *chunk_visible;
+};
+typedef struct cull_task cull_task;
+
+internal void cull_chunks(void *data, uint32_t start, uint32_t end) {
+  cull_task *task = data;
+  for (uint32_t c = start; c < end; ++c) {
+    uint32_t offset = c * task->chunk;
+    uint32_t n = task->count - offset < task->chunk ? task->count - offset
+                                                    : task->chunk;
+    task->chunk_visible[c] =
+        frustum_cull(task->f, task->b, task->first + offset, n,
+                     task->visible + offset, NULL);
+  }
+}
+
+uint32_t frustum_cull_parallel(const frustum *f, const bounds_soa *b,
+                               uint32_t first, uint32_t count,
+                               uint32_t *visible, cull_stats *stats) {
+  assert(first + count <= b->count);
+
+  // chunks grow with count so the per chunk totals fit on the stack
+  uint32_t chunk = (count + CULL_MAX_CHUNKS - 1) / CULL_MAX_CHUNKS;
+  if (chunk < CULL_CHUNK_MIN) {
+    chunk = CULL_CHUNK_MIN;
+  }
+  uint32_t chunk_count = (count + chunk - 1) / chunk;
+  if (chunk_count <= 1) {
+    return frustum_cull(f, b, first, count, visible, stats);
+  }
+
+  uint32_t chunk_visible[CULL_MAX_CHUNKS];
+  cull_task task = {f, b, first, count, chunk, visible, chunk_visible};
+  parallel_for(chunk_count, 1, cull_chunks, &task);
+
+  // chunk 0 is already in place
+  uint32_t n = chunk_visible[0];
+  for (uint32_t c = 1; c < chunk_count; ++c) {
+    memmove(visible + n, visible + c * chunk,
+            chunk_visible[c] * sizeof(*visible));
+    n += chunk_visible[c];
+  }
+
+  if (stats) {
+    stats->tested += count;
+    stats->visible += n;
+    stats->culled += count - n;
+  }
+
+  return n;
+}
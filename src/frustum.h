@@ -0,0 +1,118 @@
+#ifndef _FRUSTUM_H_
+#define _FRUSTUM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "matrix.h"
+#include "vec.h"
+
+/* *
+ * plane x*px + y*py + z*pz + d = 0, normal points into the frustum
+ * */
+struct plane {
+  float x, y, z, d;
+};
+typedef struct plane plane;
+
+/* *
+ * left, right, bottom, top, near, far
+ * */
+struct frustum {
+  plane planes[6];
+};
+typedef struct frustum frustum;
+
+/* *
+ * axis aligned bounding box
+ * */
+struct aabb {
+  vec3 min;
+  vec3 max;
+};
+typedef struct aabb aabb;
+
+/* *
+ * bounding sphere
+ * */
+struct sphere {
+  vec3 center;
+  float radius;
+};
+typedef struct sphere sphere;
+
+/* *
+ * bounds stored as streams so 4 objects test at once
+ *
+ * each object has a box (center + half extents) and a sphere radius
+ * around the same center, it is culled if either is outside.
+ * */
+struct bounds_soa {
+  float *center_x;
+  float *center_y;
+  float *center_z;
+  float *extent_x;
+  float *extent_y;
+  float *extent_z;
+  float *radius;
+  uint32_t count;
+  uint32_t capacity;
+};
+typedef struct bounds_soa bounds_soa;
+
+struct cull_stats {
+  unsigned tested;
+  unsigned visible;
+  unsigned culled;
+};
+typedef struct cull_stats cull_stats;
+
+/* extract normalized planes from a row order view projection matrix */
+frustum frustum_from_mat4(const mat4 *view_projection);
+/* true if sphere is at least partly inside */
+bool frustum_test_sphere(const frustum *f, const sphere *s);
+/* true if box is at least partly inside */
+bool frustum_test_aabb(const frustum *f, const aabb *box);
+
+/* create aabb from min and max corners */
+aabb aabb_new(const vec3 *min, const vec3 *max);
+/* box enclosing box transformed by row order matrix m4 */
+aabb aabb_transform(const aabb *box, const mat4 *m4);
+/* box enclosing a and b */
+aabb aabb_merge(const aabb *a, const aabb *b);
+/* center of box */
+vec3 aabb_center(const aabb *box);
+/* half size of box */
+vec3 aabb_extent(const aabb *box);
+/* true if a and b overlap */
+bool aabb_overlap(const aabb *a, const aabb *b);
+/* sphere enclosing box */
+sphere sphere_from_aabb(const aabb *box);
+
+/* allocate streams for capacity objects */
+bool bounds_soa_init(bounds_soa *b, uint32_t capacity);
+/* free streams */
+void bounds_soa_destroy(bounds_soa *b);
+/* remove all objects */
+void bounds_soa_clear(bounds_soa *b);
+/* append object, s may be NULL to use the sphere around box */
+uint32_t bounds_soa_push(bounds_soa *b, const aabb *box, const sphere *s);
+/* replace bounds of object idx */
+void bounds_soa_set(bounds_soa *b, uint32_t idx, const aabb *box,
+                    const sphere *s);
+
+/* *
+ * test objects first .. first + count, write indices of visible objects
+ * to visible and return how many, stats may be NULL
+ * */
+uint32_t frustum_cull(const frustum *f, const bounds_soa *b, uint32_t first,
+                      uint32_t count, uint32_t *visible, cull_stats *stats);
+/* *
+ * frustum_cull split over the job system, same result and order,
+ * each chunk culls into its own part of visible before compacting
+ * */
+uint32_t frustum_cull_parallel(const frustum *f, const bounds_soa *b,
+                               uint32_t first, uint32_t count,
+                               uint32_t *visible, cull_stats *stats);
+
+#endif /* _FRUSTUM_H_ */
@@ -0,0 +1,138 @@
+/* *
+ * gl resources
+ * */
+#include <stdio.h>
+
+#include "glresource.h"
+#include "glstate.h"
+#include "utils.h"
+
+/* HELPERS */
+
+internal const char *type_name(gl_resource_type type) {
+  switch (type) {
+  case GL_RESOURCE_BUFFER:
+    return "buffer";
+  case GL_RESOURCE_VERTEX_ARRAY:
+    return "vertex array";
+  case GL_RESOURCE_PROGRAM:
+    return "program";
+  case GL_RESOURCE_TEXTURE:
+    return "texture";
+  case GL_RESOURCE_FRAMEBUFFER:
+    return "framebuffer";
+  }
+  return "unknown";
+}
+
+internal void delete_object(const gl_resource *r) {
+  GLuint name = r->name;
+  switch (r->type) {
+  case GL_RESOURCE_BUFFER:
+    glstate_forget_buffer(name);
+    glad_glDeleteBuffers(1, &name);
+    break;
+  case GL_RESOURCE_VERTEX_ARRAY:
+    glstate_forget_vertex_array(name);
+    glad_glDeleteVertexArrays(1, &name);
+    break;
+  case GL_RESOURCE_PROGRAM:
+    glstate_forget_program(name);
+    glad_glDeleteProgram(name);
+    break;
+  case GL_RESOURCE_TEXTURE:
+    glstate_forget_texture(name);
+    glad_glDeleteTextures(1, &name);
+    break;
+  case GL_RESOURCE_FRAMEBUFFER:
+    glstate_forget_framebuffer(name);
+    glad_glDeleteFramebuffers(1, &name);
+    break;
+  }
+}
+
+internal handle resource_add(gl_resources *res, gl_resource_type type,
+                             GLuint name, const char *label) {
+  if (name == 0) {
+    fprintf(stderr, "ERROR: failed to create %s %s\n", type_name(type),
+            label);
+    return HANDLE_NONE;
+  }
+
+  handle h = pool_alloc(&res->pool);
+  gl_resource *r = pool_get(&res->pool, h);
+  if (not r) {
+    fprintf(stderr, "ERROR: gl resource pool full, dropping %s %s\n",
+            type_name(type), label);
+    gl_resource tmp = {.type = type, .name = name, .label = label};
+    delete_object(&tmp);
+    return HANDLE_NONE;
+  }
+
+  r->type = type;
+  r->name = name;
+  r->label = label;
+  return h;
+}
+
+/* RESOURCES */
+
+bool gl_resources_init(gl_resources *res, uint32_t capacity) {
+  return pool_init(&res->pool, sizeof(gl_resource), capacity);
+}
+
+void gl_resources_shutdown(gl_resources *res) {
+  uint32_t leaks = res->pool.count;
+  if (leaks > 0) {
+    fprintf(stderr, "WARNING: %u gl resources still alive at shutdown\n",
+            leaks);
+  }
+
+  for (uint32_t i = 0; i < res->pool.count; ++i) {
+    const gl_resource *r = pool_at(&res->pool, i);
+    fprintf(stderr, "  leaked %s %u \"%s\"\n", type_name(r->type), r->name,
+            r->label);
+    delete_object(r);
+  }
+
+  pool_destroy(&res->pool);
+}
+
+handle gl_resource_create(gl_resources *res, gl_resource_type type,
+                          const char *label) {
+  GLuint name = 0;
+  switch (type) {
+  case GL_RESOURCE_BUFFER:
+    glad_glGenBuffers(1, &name);
+    break;
+  case GL_RESOURCE_VERTEX_ARRAY:
+    glad_glGenVertexArrays(1, &name);
+    break;
+  case GL_RESOURCE_PROGRAM:
+    name = glad_glCreateProgram();
+    break;
+  case GL_RESOURCE_TEXTURE:
+    glad_glGenTextures(1, &name);
+    break;
+  case GL_RESOURCE_FRAMEBUFFER:
+    glad_glGenFramebuffers(1, &name);
+    break;
+  }
+  return resource_add(res, type, name, label);
+}
+
+bool gl_resource_destroy(gl_resources *res, handle h) {
+  const gl_resource *r = pool_get(&res->pool, h);
+  if (not r) {
+    fprintf(stderr, "ERROR: destroy of stale gl resource handle %08x\n", h);
+    return false;
+  }
+
+  delete_object(r);
+  return pool_free(&res->pool, h);
+}
+
+GLuint gl_resource_name(const gl_resources *res, handle h) {
+  const gl_resource *r = pool_get(&res->pool, h);
+  return r ? r->name : 0;
+}
@@ -0,0 +1,50 @@
+#ifndef _GLRESOURCE_H_
+#define _GLRESOURCE_H_
+
+#include <stdbool.h>
+
+#include "glad/glad.h"
+#include "pool.h"
+
+enum gl_resource_type {
+  GL_RESOURCE_BUFFER,
+  GL_RESOURCE_VERTEX_ARRAY,
+  GL_RESOURCE_PROGRAM,
+  GL_RESOURCE_TEXTURE,
+  GL_RESOURCE_FRAMEBUFFER,
+};
+typedef enum gl_resource_type gl_resource_type;
+
+/* *
+ * gl object owned by the resource pool
+ * */
+struct gl_resource {
+  gl_resource_type type;
+  GLuint name;
+  // static string, shown when the resource leaks
+  const char *label;
+};
+typedef struct gl_resource gl_resource;
+
+/* *
+ * every gl object of the app, referred to by generational handles
+ * */
+struct gl_resources {
+  pool pool;
+};
+typedef struct gl_resources gl_resources;
+
+/* create pool for capacity gl objects */
+bool gl_resources_init(gl_resources *res, uint32_t capacity);
+/* report and delete every live object, then free the pool */
+void gl_resources_shutdown(gl_resources *res);
+
+/* create gl object of type, HANDLE_NONE on failure */
+handle gl_resource_create(gl_resources *res, gl_resource_type type,
+                          const char *label);
+/* delete gl object, false if h is stale */
+bool gl_resource_destroy(gl_resources *res, handle h);
+/* gl name of h, 0 if h is stale */
+GLuint gl_resource_name(const gl_resources *res, handle h);
+
+#endif /* _GLRESOURCE_H_ */
@@ -0,0 +1,430 @@
+/* *
+ * gl state cache
+ * */
+#include <string.h>
+
+#include "glstate.h"
+#include "utils.h"
+
+#define UNKNOWN 0xFFFFFFFFu
+
+/* buffer targets with a tracked binding */
+enum {
+  SLOT_ARRAY_BUFFER,
+  SLOT_ELEMENT_ARRAY_BUFFER,
+  SLOT_DRAW_INDIRECT_BUFFER,
+  SLOT_UNIFORM_BUFFER,
+  SLOT_SHADER_STORAGE_BUFFER,
+  SLOT_PIXEL_UNPACK_BUFFER,
+  SLOT_DISPATCH_INDIRECT_BUFFER,
+  SLOT_COUNT,
+};
+
+/* texture targets with a tracked binding per unit */
+enum {
+  TEX_2D,
+  TEX_2D_ARRAY,
+  TEX_CUBE_MAP,
+  TEX_3D,
+  TEX_COUNT,
+};
+
+struct gl_state {
+  GLuint program;
+  GLuint vao;
+  GLuint buffers[SLOT_COUNT];
+  GLuint uniform_bases[GLSTATE_MAX_BUFFER_BASES];
+  GLuint storage_bases[GLSTATE_MAX_BUFFER_BASES];
+
+  GLuint active_unit;
+  GLuint textures[GLSTATE_MAX_TEXTURE_UNITS][TEX_COUNT];
+
+  GLuint draw_framebuffer;
+  GLuint read_framebuffer;
+
+  GLint viewport[4];
+
+  // bit set when value of enable bit is known
+  unsigned enabled_known;
+  unsigned enabled;
+
+  GLenum cull_face;
+  GLenum front_face;
+  GLenum depth_func;
+  GLuint depth_mask;
+
+  bool clear_color_known;
+  GLfloat clear_color[4];
+
+  gl_state_stats frame;
+  gl_state_stats last_frame;
+};
+typedef struct gl_state gl_state;
+
+global_var gl_state state;
+global_var bool state_valid = false;
+
+/* HELPERS */
+
+internal void ensure_valid(void) {
+  if (not state_valid) {
+    glstate_invalidate();
+  }
+}
+
+/* true if call should be dropped, updates counters */
+internal bool filter(bool same) {
+  if (same) {
+    ++state.frame.filtered;
+    return true;
+  }
+  ++state.frame.issued;
+  return false;
+}
+
+internal int buffer_slot(GLenum target) {
+  switch (target) {
+  case GL_ARRAY_BUFFER:
+    return SLOT_ARRAY_BUFFER;
+  case GL_ELEMENT_ARRAY_BUFFER:
+    return SLOT_ELEMENT_ARRAY_BUFFER;
+  case GL_DRAW_INDIRECT_BUFFER:
+    return SLOT_DRAW_INDIRECT_BUFFER;
+  case GL_UNIFORM_BUFFER:
+    return SLOT_UNIFORM_BUFFER;
+  case GL_SHADER_STORAGE_BUFFER:
+    return SLOT_SHADER_STORAGE_BUFFER;
+  case GL_PIXEL_UNPACK_BUFFER:
+    return SLOT_PIXEL_UNPACK_BUFFER;
+  case GL_DISPATCH_INDIRECT_BUFFER:
+    return SLOT_DISPATCH_INDIRECT_BUFFER;
+  default:
+    return -1;
+  }
+}
+
+internal int texture_slot(GLenum target) {
+  switch (target) {
+  case GL_TEXTURE_2D:
+    return TEX_2D;
+  case GL_TEXTURE_2D_ARRAY:
+    return TEX_2D_ARRAY;
+  case GL_TEXTURE_CUBE_MAP:
+    return TEX_CUBE_MAP;
+  case GL_TEXTURE_3D:
+    return TEX_3D;
+  default:
+    return -1;
+  }
+}
+
+internal int enable_bit(GLenum cap) {
+  switch (cap) {
+  case GL_DEPTH_TEST:
+    return 0;
+  case GL_CULL_FACE:
+    return 1;
+  case GL_BLEND:
+    return 2;
+  case GL_SCISSOR_TEST:
+    return 3;
+  case GL_STENCIL_TEST:
+    return 4;
+  case GL_POLYGON_OFFSET_FILL:
+    return 5;
+  case GL_MULTISAMPLE:
+    return 6;
+  case GL_FRAMEBUFFER_SRGB:
+    return 7;
+  case GL_PROGRAM_POINT_SIZE:
+    return 8;
+  case GL_DEPTH_CLAMP:
+    return 9;
+  default:
+    return -1;
+  }
+}
+
+/* STATE */
+
+void glstate_invalidate(void) {
+  gl_state_stats frame = state.frame;
+  gl_state_stats last_frame = state.last_frame;
+
+  memset(&state, 0xFF, sizeof(state));
+
+  state.enabled_known = 0;
+  state.enabled = 0;
+  state.clear_color_known = false;
+  state.frame = state_valid ? frame : (gl_state_stats){0};
+  state.last_frame = state_valid ? last_frame : (gl_state_stats){0};
+
+  state_valid = true;
+}
+
+void glstate_begin_frame(void) {
+  ensure_valid();
+  state.last_frame = state.frame;
+  state.frame = (gl_state_stats){0};
+}
+
+gl_state_stats glstate_frame_stats(void) {
+  ensure_valid();
+  return state.last_frame;
+}
+
+void glstate_use_program(GLuint program) {
+  ensure_valid();
+  if (filter(state.program == program)) {
+    return;
+  }
+  state.program = program;
+  glad_glUseProgram(program);
+}
+
+void glstate_bind_vertex_array(GLuint vao) {
+  ensure_valid();
+  if (filter(state.vao == vao)) {
+    return;
+  }
+  state.vao = vao;
+  // element array binding belongs to the vao
+  state.buffers[SLOT_ELEMENT_ARRAY_BUFFER] = UNKNOWN;
+  glad_glBindVertexArray(vao);
+}
+
+void glstate_bind_buffer(GLenum target, GLuint buffer) {
+  ensure_valid();
+  int slot = buffer_slot(target);
+  if (slot < 0) {
+    ++state.frame.issued;
+    glad_glBindBuffer(target, buffer);
+    return;
+  }
+
+  if (filter(state.buffers[slot] == buffer)) {
+    return;
+  }
+  state.buffers[slot] = buffer;
+  glad_glBindBuffer(target, buffer);
+}
+
+void glstate_bind_buffer_base(GLenum target, GLuint index, GLuint buffer) {
+  ensure_valid();
+  GLuint *bases = NULL;
+  if (target == GL_UNIFORM_BUFFER) {
+    bases = state.uniform_bases;
+  } else if (target == GL_SHADER_STORAGE_BUFFER) {
+    bases = state.storage_bases;
+  }
+
+  if (not bases or index >= GLSTATE_MAX_BUFFER_BASES) {
+    ++state.frame.issued;
+    glad_glBindBufferBase(target, index, buffer);
+    return;
+  }
+
+  if (filter(bases[index] == buffer)) {
+    return;
+  }
+  bases[index] = buffer;
+  // glBindBufferBase also binds the generic target
+  int slot = buffer_slot(target);
+  state.buffers[slot] = buffer;
+  glad_glBindBufferBase(target, index, buffer);
+}
+
+void glstate_bind_texture(GLuint unit, GLenum target, GLuint texture) {
+  ensure_valid();
+  int slot = texture_slot(target);
+  bool tracked = slot >= 0 and unit < GLSTATE_MAX_TEXTURE_UNITS;
+
+  if (tracked and filter(state.textures[unit][slot] == texture)) {
+    return;
+  }
+
+  if (state.active_unit != unit) {
+    ++state.frame.issued;
+    state.active_unit = unit;
+    glad_glActiveTexture(GL_TEXTURE0 + unit);
+  }
+
+  if (tracked) {
+    state.textures[unit][slot] = texture;
+  } else {
+    ++state.frame.issued;
+  }
+  glad_glBindTexture(target, texture);
+}
+
+void glstate_bind_framebuffer(GLenum target, GLuint framebuffer) {
+  ensure_valid();
+  bool draw = target == GL_FRAMEBUFFER or target == GL_DRAW_FRAMEBUFFER;
+  bool read = target == GL_FRAMEBUFFER or target == GL_READ_FRAMEBUFFER;
+
+  bool same = (not draw or state.draw_framebuffer == framebuffer) and
+              (not read or state.read_framebuffer == framebuffer);
+  if (filter(same)) {
+    return;
+  }
+
+  if (draw) {
+    state.draw_framebuffer = framebuffer;
+  }
+  if (read) {
+    state.read_framebuffer = framebuffer;
+  }
+  glad_glBindFramebuffer(target, framebuffer);
+}
+
+void glstate_viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  ensure_valid();
+  bool same = state.viewport[0] == x and state.viewport[1] == y and
+              state.viewport[2] == width and state.viewport[3] == height;
+  if (filter(same)) {
+    return;
+  }
+  state.viewport[0] = x;
+  state.viewport[1] = y;
+  state.viewport[2] = width;
+  state.viewport[3] = height;
+  glad_glViewport(x, y, width, height);
+}
+
+void glstate_set_enabled(GLenum cap, bool enabled) {
+  ensure_valid();
+  int bit = enable_bit(cap);
+  if (bit < 0) {
+    ++state.frame.issued;
+  } else {
+    unsigned mask = 1u << bit;
+    bool known = state.enabled_known & mask;
+    bool current = state.enabled & mask;
+    if (filter(known and current == enabled)) {
+      return;
+    }
+    state.enabled_known |= mask;
+    state.enabled = enabled ? (state.enabled | mask) : (state.enabled & ~mask);
+  }
+
+  if (enabled) {
+    glad_glEnable(cap);
+  } else {
+    glad_glDisable(cap);
+  }
+}
+
+void glstate_enable(GLenum cap) { glstate_set_enabled(cap, true); }
+
+void glstate_disable(GLenum cap) { glstate_set_enabled(cap, false); }
+
+void glstate_cull_face(GLenum mode) {
+  ensure_valid();
+  if (filter(state.cull_face == mode)) {
+    return;
+  }
+  state.cull_face = mode;
+  glad_glCullFace(mode);
+}
+
+void glstate_front_face(GLenum mode) {
+  ensure_valid();
+  if (filter(state.front_face == mode)) {
+    return;
+  }
+  state.front_face = mode;
+  glad_glFrontFace(mode);
+}
+
+void glstate_depth_func(GLenum func) {
+  ensure_valid();
+  if (filter(state.depth_func == func)) {
+    return;
+  }
+  state.depth_func = func;
+  glad_glDepthFunc(func);
+}
+
+void glstate_depth_mask(GLboolean flag) {
+  ensure_valid();
+  if (filter(state.depth_mask == flag)) {
+    return;
+  }
+  state.depth_mask = flag;
+  glad_glDepthMask(flag);
+}
+
+void glstate_clear_color(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+  ensure_valid();
+  bool same = state.clear_color_known and state.clear_color[0] == r and
+              state.clear_color[1] == g and state.clear_color[2] == b and
+              state.clear_color[3] == a;
+  if (filter(same)) {
+    return;
+  }
+  state.clear_color_known = true;
+  state.clear_color[0] = r;
+  state.clear_color[1] = g;
+  state.clear_color[2] = b;
+  state.clear_color[3] = a;
+  glad_glClearColor(r, g, b, a);
+}
+
+/* FORGET */
+
+void glstate_forget_program(GLuint program) {
+  if (state_valid and state.program == program) {
+    state.program = UNKNOWN;
+  }
+}
+
+void glstate_forget_vertex_array(GLuint vao) {
+  if (state_valid and state.vao == vao) {
+    state.vao = UNKNOWN;
+    state.buffers[SLOT_ELEMENT_ARRAY_BUFFER] = UNKNOWN;
+  }
+}
+
+void glstate_forget_buffer(GLuint buffer) {
+  if (not state_valid) {
+    return;
+  }
+  for (int i = 0; i < SLOT_COUNT; ++i) {
+    if (state.buffers[i] == buffer) {
+      state.buffers[i] = UNKNOWN;
+    }
+  }
+  for (int i = 0; i < GLSTATE_MAX_BUFFER_BASES; ++i) {
+    if (state.uniform_bases[i] == buffer) {
+      state.uniform_bases[i] = UNKNOWN;
+    }
+    if (state.storage_bases[i] == buffer) {
+      state.storage_bases[i] = UNKNOWN;
+    }
+  }
+}
+
+void glstate_forget_texture(GLuint texture) {
+  if (not state_valid) {
+    return;
+  }
+  for (int u = 0; u < GLSTATE_MAX_TEXTURE_UNITS; ++u) {
+    for (int t = 0; t < TEX_COUNT; ++t) {
+      if (state.textures[u][t] == texture) {
+        state.textures[u][t] = UNKNOWN;
+      }
+    }
+  }
+}
+
+void glstate_forget_framebuffer(GLuint framebuffer) {
+  if (not state_valid) {
+    return;
+  }
+  if (state.draw_framebuffer == framebuffer) {
+    state.draw_framebuffer = UNKNOWN;
+  }
+  if (state.read_framebuffer == framebuffer) {
+    state.read_framebuffer = UNKNOWN;
+  }
+}
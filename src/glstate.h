@@ -0,0 +1,73 @@
+#ifndef _GLSTATE_H_
+#define _GLSTATE_H_
+
+#include <stdbool.h>
+
+#include "glad/glad.h"
+
+#define GLSTATE_MAX_TEXTURE_UNITS 16
+#define GLSTATE_MAX_BUFFER_BASES 16
+
+/* *
+ * calls issued to gl vs calls dropped because nothing changed
+ * */
+struct gl_state_stats {
+  unsigned issued;
+  unsigned filtered;
+};
+typedef struct gl_state_stats gl_state_stats;
+
+/* *
+ * shadow copy of the gl state for the current context
+ *
+ * every tracked call compares against the shadow first and only reaches
+ * the driver when the value changes. anything that touches gl directly
+ * behind the cache must call glstate_invalidate.
+ * */
+
+/* forget all shadowed state, next call of each kind always reaches gl */
+void glstate_invalidate(void);
+/* start a new frame, last frames counters become readable */
+void glstate_begin_frame(void);
+/* counters for the last completed frame */
+gl_state_stats glstate_frame_stats(void);
+
+/* glUseProgram */
+void glstate_use_program(GLuint program);
+/* glBindVertexArray */
+void glstate_bind_vertex_array(GLuint vao);
+/* glBindBuffer */
+void glstate_bind_buffer(GLenum target, GLuint buffer);
+/* glBindBufferBase for uniform and shader storage buffers */
+void glstate_bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+/* glActiveTexture + glBindTexture */
+void glstate_bind_texture(GLuint unit, GLenum target, GLuint texture);
+/* glBindFramebuffer */
+void glstate_bind_framebuffer(GLenum target, GLuint framebuffer);
+/* glViewport */
+void glstate_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+/* glEnable / glDisable */
+void glstate_set_enabled(GLenum cap, bool enabled);
+/* glEnable */
+void glstate_enable(GLenum cap);
+/* glDisable */
+void glstate_disable(GLenum cap);
+/* glCullFace */
+void glstate_cull_face(GLenum mode);
+/* glFrontFace */
+void glstate_front_face(GLenum mode);
+/* glDepthFunc */
+void glstate_depth_func(GLenum func);
+/* glDepthMask */
+void glstate_depth_mask(GLboolean flag);
+/* glClearColor */
+void glstate_clear_color(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+
+/* drop shadowed bindings of deleted objects so reused names rebind */
+void glstate_forget_program(GLuint program);
+void glstate_forget_vertex_array(GLuint vao);
+void glstate_forget_buffer(GLuint buffer);
+void glstate_forget_texture(GLuint texture);
+void glstate_forget_framebuffer(GLuint framebuffer);
+
+#endif /* _GLSTATE_H_ */
@@ -0,0 +1,141 @@
+/* *
+ * hierarchical z occlusion culling
+ * */
+#include <assert.h>
+#include <string.h>
+
+#include "bits.h"
+#include "glstate.h"
+#include "hiz.h"
+#include "readback.h"
+#include "utils.h"
+
+// work group sizes of hiz_build.comp and hiz_cull.comp
+#define BUILD_GROUP_SIZE 8
+#define CULL_GROUP_SIZE 64
+
+// uniform locations
+#define BUILD_SOURCE_SIZE 0
+#define BUILD_SOURCE_LEVEL 1
+#define CULL_DRAW_COUNT 0
+#define CULL_COUNTER 1
+#define CULL_SCREEN_SIZE 2
+#define CULL_PYRAMID_LEVELS 3
+
+/* HELPERS */
+
+internal GLuint group_count(GLsizei size, GLsizei group) {
+  return (GLuint)((size + group - 1) / group);
+}
+
+/* HIZ */
+
+bool hiz_init(hiz *h, GLsizei width, GLsizei height, GLuint build_program,
+              GLuint cull_program) {
+  assert(width > 1 and height > 1);
+  memset(h, 0, sizeof(*h));
+  h->width = width;
+  h->height = height;
+  h->build_program = build_program;
+  h->cull_program = cull_program;
+
+  // depth is fetched texel by texel, no mips
+  glad_glGenTextures(1, &h->depth);
+  glstate_bind_texture(0, GL_TEXTURE_2D, h->depth);
+  glad_glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width, height);
+  glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  // level 0 is half size, down to 1x1
+  h->levels = full_chain(width / 2, height / 2);
+  glad_glGenTextures(1, &h->pyramid);
+  glstate_bind_texture(0, GL_TEXTURE_2D, h->pyramid);
+  glad_glTexStorage2D(GL_TEXTURE_2D, h->levels, GL_R32F, width / 2,
+                      height / 2);
+  glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                       GL_NEAREST_MIPMAP_NEAREST);
+  glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  // reset by the cpu before each cull, read a few frames later
+  if (not readback_init(&h->counters, sizeof(GLuint), true)) {
+    hiz_destroy(h);
+    return false;
+  }
+  return true;
+}
+
+void hiz_destroy(hiz *h) {
+  readback_destroy(&h->counters);
+  glstate_forget_texture(h->depth);
+  glstate_forget_texture(h->pyramid);
+  glad_glDeleteTextures(1, &h->depth);
+  glad_glDeleteTextures(1, &h->pyramid);
+  h->depth = 0;
+  h->pyramid = 0;
+  h->valid = false;
+}
+
+void hiz_cull(hiz *h, const draw_list *dl, hiz_stats *stats) {
+  const GLuint *count = readback_begin(&h->counters);
+  if (count) {
+    h->occluded = *count;
+  }
+  stats->occluded = h->occluded;
+  stats->tested = 0;
+  if (not h->valid or dl->count == 0) {
+    return;
+  }
+  stats->tested = (unsigned)dl->count;
+
+  *(GLuint *)readback_slot(&h->counters) = 0;
+  glstate_use_program(h->cull_program);
+  glad_glProgramUniform1ui(h->cull_program, CULL_DRAW_COUNT,
+                           (GLuint)dl->count);
+  glad_glProgramUniform1ui(h->cull_program, CULL_COUNTER,
+                           (GLuint)h->counters.slot);
+  glad_glProgramUniform2i(h->cull_program, CULL_SCREEN_SIZE, h->width,
+                          h->height);
+  glad_glProgramUniform1i(h->cull_program, CULL_PYRAMID_LEVELS, h->levels);
+  glstate_bind_texture(0, GL_TEXTURE_2D, h->pyramid);
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, HIZ_COMMAND_BINDING,
+                           dl->indirect_buffer);
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, HIZ_COUNTER_BINDING,
+                           h->counters.buffer);
+  glad_glDispatchCompute(group_count(dl->count, CULL_GROUP_SIZE), 1, 1);
+
+  // commands are read by the draws, the counter by the cpu
+  glad_glMemoryBarrier(GL_COMMAND_BARRIER_BIT |
+                       GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+  readback_end(&h->counters);
+}
+
+void hiz_build(hiz *h) {
+  glstate_bind_texture(0, GL_TEXTURE_2D, h->depth);
+  glad_glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, h->width, h->height);
+
+  // each level reads the one above it, level 0 reads the depth copy
+  glstate_use_program(h->build_program);
+  GLsizei source_width = h->width;
+  GLsizei source_height = h->height;
+  for (int level = 0; level < h->levels; ++level) {
+    GLsizei width = level_extent(h->width / 2, level);
+    GLsizei height = level_extent(h->height / 2, level);
+
+    glad_glProgramUniform2i(h->build_program, BUILD_SOURCE_SIZE, source_width,
+                            source_height);
+    glad_glProgramUniform1i(h->build_program, BUILD_SOURCE_LEVEL,
+                            level > 0 ? level - 1 : 0);
+    if (level == 1) {
+      glstate_bind_texture(0, GL_TEXTURE_2D, h->pyramid);
+    }
+    glad_glBindImageTexture(0, h->pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY,
+                            GL_R32F);
+    glad_glDispatchCompute(group_count(width, BUILD_GROUP_SIZE),
+                           group_count(height, BUILD_GROUP_SIZE), 1);
+    glad_glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    source_width = width;
+    source_height = height;
+  }
+  h->valid = true;
+}
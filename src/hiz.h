@@ -0,0 +1,83 @@
+#ifndef _HIZ_H_
+#define _HIZ_H_
+
+#include <stdbool.h>
+
+#include "drawlist.h"
+#include "glad/glad.h"
+#include "readback.h"
+
+// binding points shared with hiz_cull.comp, after the blocks of uniforms.h
+#define HIZ_COMMAND_BINDING 2
+#define HIZ_COUNTER_BINDING 3
+// occluded counts are read back this many frames after the cull
+#define HIZ_READBACK_FRAMES READBACK_FRAMES
+
+/* *
+ * draws tested by the last cull and draws it found occluded
+ *
+ * occluded lags HIZ_READBACK_FRAMES frames behind tested, the count is
+ * read without waiting on the gpu.
+ * */
+struct hiz_stats {
+  unsigned tested;
+  unsigned occluded;
+};
+typedef struct hiz_stats hiz_stats;
+
+/* *
+ * hierarchical z occlusion culling
+ *
+ * after the draws of a frame its depth is copied and reduced into a
+ * pyramid of max depths, level 0 at half the screen size. the next frame
+ * tests the world bounds of every draw against it before drawing and
+ * zeroes the instance count of the draws that are hidden, so the indirect
+ * buffer keeps its layout and batch ranges stay valid.
+ *
+ * the pyramid is one frame old, an object coming out from behind another
+ * shows a frame late.
+ * */
+struct hiz {
+  GLsizei width;
+  GLsizei height;
+  int levels;
+
+  // copy of the depth buffer and its max reduction
+  GLuint depth;
+  GLuint pyramid;
+  GLuint build_program;
+  GLuint cull_program;
+  // false until a frame has been built into the pyramid
+  bool valid;
+
+  // one occluded count per readback frame
+  readback_ring counters;
+  unsigned occluded;
+};
+typedef struct hiz hiz;
+
+/* *
+ * create depth copy and pyramid for a width x height depth buffer
+ *
+ * programs are linked from hiz_build.comp and hiz_cull.comp, the caller
+ * keeps ownership.
+ * */
+bool hiz_init(hiz *h, GLsizei width, GLsizei height, GLuint build_program,
+              GLuint cull_program);
+/* delete textures, counters and pending fences */
+void hiz_destroy(hiz *h);
+
+/* *
+ * test the uploaded commands of dl against the pyramid
+ *
+ * needs the camera and object blocks bound with bounds of every draw.
+ * a barrier makes the result visible to the indirect draws that follow.
+ * */
+void hiz_cull(hiz *h, const draw_list *dl, hiz_stats *stats);
+/* *
+ * copy the depth of the bound read framebuffer and build the pyramid,
+ * after the draws of a frame
+ * */
+void hiz_build(hiz *h);
+
+#endif /* _HIZ_H_ */
@@ -0,0 +1,593 @@
+/* *
+ * png, tga and raw image decoders
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "inflate.h"
+#include "utils.h"
+
+#define PNG_GREY 0
+#define PNG_RGB 2
+#define PNG_PALETTE 3
+#define PNG_GREY_ALPHA 4
+#define PNG_RGBA 6
+
+#define TGA_HEADER_SIZE 18
+#define TGA_RGB 2
+#define TGA_GREY 3
+#define TGA_RLE_RGB 10
+#define TGA_RLE_GREY 11
+// descriptor bit set when the first row is the top one
+#define TGA_TOP_ORIGIN 0x20
+
+// png chunk crc-32, reversed polynomial 0xEDB88320, four bits at a time
+global_var const uint32_t crc_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+    0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+/* HELPERS */
+
+internal uint32_t read_be32(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+         (uint32_t)p[3];
+}
+
+internal uint32_t read_le16(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+internal bool image_alloc(image *img, uint32_t width, uint32_t height) {
+  if (width == 0 or height == 0 or width > IMAGE_MAX_SIZE or
+      height > IMAGE_MAX_SIZE) {
+    fprintf(stderr, "ERROR: image size %ux%u not supported\n", width, height);
+    return false;
+  }
+  img->width = width;
+  img->height = height;
+  img->pixels = malloc((size_t)width * height * 4);
+  if (not img->pixels) {
+    fprintf(stderr, "ERROR: out of memory for %ux%u image\n", width, height);
+    return false;
+  }
+  return true;
+}
+
+/* expand 1 to 4 channel 8 bit pixels to rgba */
+internal void expand_row(uint8_t *dst, const uint8_t *src, uint32_t width,
+                         uint32_t channels) {
+  switch (channels) {
+  case 1:
+    for (uint32_t x = 0; x < width; ++x, dst += 4) {
+      dst[0] = dst[1] = dst[2] = src[x];
+      dst[3] = 255;
+    }
+    break;
+  case 2:
+    for (uint32_t x = 0; x < width; ++x, dst += 4, src += 2) {
+      dst[0] = dst[1] = dst[2] = src[0];
+      dst[3] = src[1];
+    }
+    break;
+  case 3:
+    for (uint32_t x = 0; x < width; ++x, dst += 4, src += 3) {
+      dst[0] = src[0];
+      dst[1] = src[1];
+      dst[2] = src[2];
+      dst[3] = 255;
+    }
+    break;
+  default:
+    memcpy(dst, src, (size_t)width * 4);
+    break;
+  }
+}
+
+/* PNG */
+
+struct png_info {
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t colour;
+  uint32_t channels;
+
+  uint8_t palette[256][4];
+  uint32_t palette_count;
+  // colour key from tRNS for grey and rgb images
+  bool has_key;
+  uint32_t key[3];
+};
+typedef struct png_info png_info;
+
+/* crc of a chunk type and body, as stored after the body */
+internal uint32_t png_crc(const uint8_t *data, size_t size) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < size; ++i) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ crc_table[crc & 15];
+    crc = (crc >> 4) ^ crc_table[crc & 15];
+  }
+  return ~crc;
+}
+
+internal uint8_t paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  if (pa <= pb and pa <= pc) {
+    return (uint8_t)a;
+  }
+  return (uint8_t)(pb <= pc ? b : c);
+}
+
+/* undo row filters in place, each row is a filter byte then stride bytes */
+internal bool png_unfilter(uint8_t *raw, uint32_t height, size_t stride,
+                           uint32_t bpp) {
+  const uint8_t *prev = NULL;
+  for (uint32_t y = 0; y < height; ++y) {
+    uint8_t *row = raw + y * (stride + 1);
+    uint8_t filter = row[0];
+    uint8_t *cur = row + 1;
+
+    switch (filter) {
+    case 0:
+      break;
+    case 1:
+      for (size_t i = bpp; i < stride; ++i) {
+        cur[i] += cur[i - bpp];
+      }
+      break;
+    case 2:
+      if (prev) {
+        for (size_t i = 0; i < stride; ++i) {
+          cur[i] += prev[i];
+        }
+      }
+      break;
+    case 3:
+      for (size_t i = 0; i < stride; ++i) {
+        int left = i >= bpp ? cur[i - bpp] : 0;
+        int up = prev ? prev[i] : 0;
+        cur[i] += (uint8_t)((left + up) >> 1);
+      }
+      break;
+    case 4:
+      for (size_t i = 0; i < stride; ++i) {
+        int left = i >= bpp ? cur[i - bpp] : 0;
+        int up = prev ? prev[i] : 0;
+        int up_left = prev and i >= bpp ? prev[i - bpp] : 0;
+        cur[i] += paeth(left, up, up_left);
+      }
+      break;
+    default:
+      fprintf(stderr, "ERROR: png filter %u not supported\n", filter);
+      return false;
+    }
+    prev = cur;
+  }
+  return true;
+}
+
+/* sample c of pixel x at the image bit depth */
+internal uint32_t png_sample(const png_info *info, const uint8_t *row,
+                             uint32_t x, uint32_t c) {
+  uint32_t index = x * info->channels + c;
+  switch (info->depth) {
+  case 16:
+    return (uint32_t)row[index * 2] << 8 | row[index * 2 + 1];
+  case 8:
+    return row[index];
+  default: {
+    // packed msb first, only single channel images use these depths
+    uint32_t bit = index * info->depth;
+    uint32_t shift = 8 - info->depth - bit % 8;
+    return (uint32_t)(row[bit / 8] >> shift) & ((1u << info->depth) - 1);
+  }
+  }
+}
+
+internal void png_convert_row(const png_info *info, uint8_t *dst,
+                              const uint8_t *row) {
+  // common case, nothing to scale or look up
+  if (info->depth == 8 and info->colour != PNG_PALETTE and
+      not info->has_key) {
+    expand_row(dst, row, info->width, info->channels);
+    return;
+  }
+
+  uint32_t max = (1u << info->depth) - 1;
+  for (uint32_t x = 0; x < info->width; ++x, dst += 4) {
+    if (info->colour == PNG_PALETTE) {
+      uint32_t index = png_sample(info, row, x, 0);
+      if (index < info->palette_count) {
+        memcpy(dst, info->palette[index], 4);
+      } else {
+        memset(dst, 0, 4);
+      }
+      continue;
+    }
+
+    uint32_t values[4] = {0};
+    for (uint32_t c = 0; c < info->channels; ++c) {
+      values[c] = png_sample(info, row, x, c);
+    }
+
+    uint32_t colours = info->colour == PNG_RGB or info->colour == PNG_RGBA
+                           ? 3
+                           : 1;
+    bool keyed = info->has_key;
+    for (uint32_t c = 0; keyed and c < colours; ++c) {
+      keyed = values[c] == info->key[c];
+    }
+
+    for (uint32_t c = 0; c < info->channels; ++c) {
+      values[c] = info->depth == 16 ? values[c] >> 8 : values[c] * 255 / max;
+    }
+    if (colours == 1) {
+      dst[0] = dst[1] = dst[2] = (uint8_t)values[0];
+    } else {
+      dst[0] = (uint8_t)values[0];
+      dst[1] = (uint8_t)values[1];
+      dst[2] = (uint8_t)values[2];
+    }
+    if (info->channels == colours + 1) {
+      dst[3] = (uint8_t)values[colours];
+    } else {
+      dst[3] = keyed ? 0 : 255;
+    }
+  }
+}
+
+internal bool png_read_header(png_info *info, const uint8_t *data,
+                              uint32_t length) {
+  if (length != 13) {
+    return false;
+  }
+  info->width = read_be32(data);
+  info->height = read_be32(data + 4);
+  info->depth = data[8];
+  info->colour = data[9];
+  uint32_t compression = data[10];
+  uint32_t filter = data[11];
+  uint32_t interlace = data[12];
+
+  if (compression != 0 or filter != 0) {
+    return false;
+  }
+  if (interlace != 0) {
+    fprintf(stderr, "ERROR: interlaced png not supported\n");
+    return false;
+  }
+
+  // grey and palette may pack several pixels per byte
+  uint32_t depth = info->depth;
+  bool low_depth = depth == 1 or depth == 2 or depth == 4 or depth == 8;
+  switch (info->colour) {
+  case PNG_GREY:
+    info->channels = 1;
+    return low_depth or depth == 16;
+  case PNG_PALETTE:
+    info->channels = 1;
+    return low_depth;
+  case PNG_RGB:
+    info->channels = 3;
+    break;
+  case PNG_GREY_ALPHA:
+    info->channels = 2;
+    break;
+  case PNG_RGBA:
+    info->channels = 4;
+    break;
+  default:
+    return false;
+  }
+  return depth == 8 or depth == 16;
+}
+
+bool image_decode_png(image *img, const uint8_t *data, size_t size) {
+  local_persist const uint8_t signature[8] = {0x89, 'P',  'N',  'G',
+                                              '\r', '\n', 0x1A, '\n'};
+  memset(img, 0, sizeof(*img));
+  if (size < 8 or memcmp(data, signature, 8) != 0) {
+    return false;
+  }
+
+  png_info info = {0};
+  bool has_header = false;
+
+  // image data may be split over any number of IDAT chunks
+  uint8_t *idat = NULL;
+  size_t idat_size = 0;
+  size_t idat_capacity = 0;
+
+  bool ok = true;
+  size_t pos = 8;
+  while (ok) {
+    if (size - pos < 12) {
+      ok = false;
+      break;
+    }
+    uint32_t length = read_be32(data + pos);
+    const uint8_t *type = data + pos + 4;
+    const uint8_t *body = data + pos + 8;
+    if (length > size - pos - 12 or
+        png_crc(type, 4 + (size_t)length) != read_be32(body + length)) {
+      ok = false;
+      break;
+    }
+    pos += 12 + (size_t)length;
+
+    if (memcmp(type, "IHDR", 4) == 0) {
+      ok = png_read_header(&info, body, length);
+      has_header = ok;
+    } else if (not has_header) {
+      ok = false;
+    } else if (memcmp(type, "PLTE", 4) == 0) {
+      ok = length % 3 == 0 and length / 3 <= 256;
+      info.palette_count = length / 3;
+      for (uint32_t i = 0; ok and i < info.palette_count; ++i) {
+        memcpy(info.palette[i], body + i * 3, 3);
+        info.palette[i][3] = 255;
+      }
+    } else if (memcmp(type, "tRNS", 4) == 0) {
+      if (info.colour == PNG_PALETTE) {
+        for (uint32_t i = 0; i < length and i < info.palette_count; ++i) {
+          info.palette[i][3] = body[i];
+        }
+      } else if (info.colour == PNG_GREY and length >= 2) {
+        info.has_key = true;
+        info.key[0] = (uint32_t)body[0] << 8 | body[1];
+      } else if (info.colour == PNG_RGB and length >= 6) {
+        info.has_key = true;
+        for (int c = 0; c < 3; ++c) {
+          info.key[c] = (uint32_t)body[c * 2] << 8 | body[c * 2 + 1];
+        }
+      }
+    } else if (memcmp(type, "IDAT", 4) == 0) {
+      if (idat_size + length > idat_capacity) {
+        size_t capacity = idat_capacity ? idat_capacity : 4096;
+        while (capacity < idat_size + length) {
+          capacity *= 2;
+        }
+        uint8_t *grown = realloc(idat, capacity);
+        if (not grown) {
+          ok = false;
+          break;
+        }
+        idat = grown;
+        idat_capacity = capacity;
+      }
+      memcpy(idat + idat_size, body, length);
+      idat_size += length;
+    } else if (memcmp(type, "IEND", 4) == 0) {
+      break;
+    }
+  }
+
+  if (not ok or not has_header or idat_size == 0 or
+      (info.colour == PNG_PALETTE and info.palette_count == 0)) {
+    fprintf(stderr, "ERROR: png is damaged or not supported\n");
+    free(idat);
+    return false;
+  }
+
+  if (not image_alloc(img, info.width, info.height)) {
+    free(idat);
+    return false;
+  }
+
+  uint32_t bits = info.channels * info.depth;
+  size_t stride = ((size_t)info.width * bits + 7) / 8;
+  uint32_t bpp = bits >= 8 ? bits / 8 : 1;
+  size_t raw_size = (stride + 1) * info.height;
+  uint8_t *raw = malloc(raw_size);
+
+  size_t written = 0;
+  ok = raw and inflate_zlib(idat, idat_size, raw, raw_size, &written) and
+       written == raw_size and png_unfilter(raw, info.height, stride, bpp);
+  free(idat);
+
+  if (ok) {
+    for (uint32_t y = 0; y < info.height; ++y) {
+      png_convert_row(&info, img->pixels + (size_t)y * info.width * 4,
+                      raw + y * (stride + 1) + 1);
+    }
+  } else {
+    fprintf(stderr, "ERROR: png image data is damaged\n");
+    image_destroy(img);
+  }
+  free(raw);
+  return ok;
+}
+
+/* TGA */
+
+bool image_decode_tga(image *img, const uint8_t *data, size_t size) {
+  memset(img, 0, sizeof(*img));
+  if (size < TGA_HEADER_SIZE) {
+    return false;
+  }
+
+  uint32_t id_length = data[0];
+  uint32_t map_type = data[1];
+  uint32_t type = data[2];
+  uint32_t map_length = read_le16(data + 5);
+  uint32_t map_depth = data[7];
+  uint32_t width = read_le16(data + 12);
+  uint32_t height = read_le16(data + 14);
+  uint32_t depth = data[16];
+  uint32_t descriptor = data[17];
+
+  bool grey = type == TGA_GREY or type == TGA_RLE_GREY;
+  bool rle = type == TGA_RLE_RGB or type == TGA_RLE_GREY;
+  bool colour = type == TGA_RGB or type == TGA_RLE_RGB;
+  if (not(grey or colour) or (grey and depth != 8) or
+      (colour and depth != 24 and depth != 32)) {
+    fprintf(stderr, "ERROR: tga type %u at %u bits not supported\n", type,
+            depth);
+    return false;
+  }
+
+  // a colour map may be present even when pixels do not use it
+  size_t pos = TGA_HEADER_SIZE + id_length;
+  if (map_type) {
+    pos += (size_t)map_length * ((map_depth + 7) / 8);
+  }
+  if (pos > size or not image_alloc(img, width, height)) {
+    return false;
+  }
+
+  uint32_t bpp = depth / 8;
+  bool top = descriptor & TGA_TOP_ORIGIN;
+  uint32_t total = width * height;
+  uint32_t i = 0;
+  while (i < total) {
+    // raw files are one long run of literal pixels
+    uint32_t count = total - i;
+    bool repeat = false;
+    if (rle) {
+      if (pos >= size) {
+        break;
+      }
+      uint8_t packet = data[pos++];
+      count = (packet & 127u) + 1;
+      repeat = packet & 128;
+      if (count > total - i) {
+        break;
+      }
+    }
+
+    size_t needed = (size_t)(repeat ? 1 : count) * bpp;
+    if (needed > size - pos) {
+      break;
+    }
+
+    for (uint32_t n = 0; n < count; ++n, ++i) {
+      const uint8_t *src = data + pos + (repeat ? 0 : (size_t)n * bpp);
+      uint32_t x = i % width;
+      uint32_t y = top ? i / width : height - 1 - i / width;
+      uint8_t *dst = img->pixels + ((size_t)y * width + x) * 4;
+      if (grey) {
+        dst[0] = dst[1] = dst[2] = src[0];
+        dst[3] = 255;
+      } else {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = bpp == 4 ? src[3] : 255;
+      }
+    }
+    pos += needed;
+  }
+
+  if (i < total) {
+    fprintf(stderr, "ERROR: tga pixel data is truncated\n");
+    image_destroy(img);
+    return false;
+  }
+  return true;
+}
+
+/* RAW */
+
+bool image_decode_raw(image *img, const uint8_t *data, size_t size) {
+  memset(img, 0, sizeof(*img));
+
+  image_raw_header header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, "RAW8", 4) != 0 or header.channels == 0 or
+      header.channels > 4 or not image_alloc(img, header.width, header.height)) {
+    return false;
+  }
+
+  size_t stride = (size_t)header.width * header.channels;
+  if (stride * header.height > size - sizeof(header)) {
+    fprintf(stderr, "ERROR: raw pixel data is truncated\n");
+    image_destroy(img);
+    return false;
+  }
+
+  const uint8_t *src = data + sizeof(header);
+  for (uint32_t y = 0; y < header.height; ++y) {
+    expand_row(img->pixels + (size_t)y * header.width * 4, src + y * stride,
+               header.width, header.channels);
+  }
+  return true;
+}
+
+/* IMAGE */
+
+bool image_decode(image *img, const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  if (size >= 8 and memcmp(bytes, "\x89PNG", 4) == 0) {
+    return image_decode_png(img, bytes, size);
+  }
+  if (size >= 4 and memcmp(bytes, "RAW8", 4) == 0) {
+    return image_decode_raw(img, bytes, size);
+  }
+  // tga has no signature
+  return image_decode_tga(img, bytes, size);
+}
+
+bool image_write_raw(const image *img, const char *path) {
+  image_raw_header header = {
+      .magic = {'R', 'A', 'W', '8'},
+      .width = img->width,
+      .height = img->height,
+      .channels = 4,
+  };
+
+  FILE *fp = fopen(path, "wb");
+  if (not fp) {
+    fprintf(stderr, "ERROR: could not write %s\n", path);
+    return false;
+  }
+  size_t bytes = (size_t)img->width * img->height * 4;
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 and
+            fwrite(img->pixels, 1, bytes, fp) == bytes;
+  ok = fclose(fp) == 0 and ok;
+
+  if (not ok) {
+    fprintf(stderr, "ERROR: failed writing %s\n", path);
+    remove(path);
+  }
+  return ok;
+}
+
+bool image_downsample(const image *src, image *dst) {
+  uint32_t width = src->width > 1 ? src->width / 2 : 1;
+  uint32_t height = src->height > 1 ? src->height / 2 : 1;
+  if (not image_alloc(dst, width, height)) {
+    return false;
+  }
+
+  // 2x2 box, odd last rows and columns are dropped like gl does
+  size_t stride = (size_t)src->width * 4;
+  size_t dx = src->width > 1 ? 4 : 0;
+  size_t dy = src->height > 1 ? stride : 0;
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t *row = src->pixels + (size_t)y * 2 * stride;
+    uint8_t *out = dst->pixels + (size_t)y * width * 4;
+    for (uint32_t x = 0; x < width; ++x) {
+      const uint8_t *p = row + (size_t)x * 8;
+      for (int c = 0; c < 4; ++c) {
+        out[x * 4 + c] =
+            (uint8_t)((p[c] + p[dx + c] + p[dy + c] + p[dy + dx + c] + 2) / 4);
+      }
+    }
+  }
+  return true;
+}
+
+void image_destroy(image *img) {
+  free(img->pixels);
+  memset(img, 0, sizeof(*img));
+}
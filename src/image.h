@@ -0,0 +1,52 @@
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// larger images are rejected before any size math can overflow
+#define IMAGE_MAX_SIZE 16384
+
+/* *
+ * header of a .raw image, magic is "RAW8" and rows of width * channels
+ * bytes follow it top to bottom with no padding
+ * */
+struct image_raw_header {
+  char magic[4];
+  uint32_t width;
+  uint32_t height;
+  uint32_t channels;
+};
+typedef struct image_raw_header image_raw_header;
+
+/* *
+ * decoded 8 bit rgba pixels, rows top to bottom
+ * */
+struct image {
+  uint32_t width;
+  uint32_t height;
+  uint8_t *pixels;
+};
+typedef struct image image;
+
+/* *
+ * png, 8 and 16 bit colour, 1 to 8 bit grey and palette, not interlaced
+ * */
+bool image_decode_png(image *img, const uint8_t *data, size_t size);
+/* tga, uncompressed or rle, 8 bit grey and 24 / 32 bit colour */
+bool image_decode_tga(image *img, const uint8_t *data, size_t size);
+/* raw, see image_raw_header */
+bool image_decode_raw(image *img, const uint8_t *data, size_t size);
+/* *
+ * decode by signature, png and raw are recognised from their first
+ * bytes and anything else is read as tga
+ * */
+bool image_decode(image *img, const void *data, size_t size);
+/* write img as a 4 channel raw file */
+bool image_write_raw(const image *img, const char *path);
+/* half size copy of src for the next mip level, dst is allocated */
+bool image_downsample(const image *src, image *dst);
+void image_destroy(image *img);
+
+#endif /* _IMAGE_H_ */
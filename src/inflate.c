@@ -0,0 +1,399 @@
+/* *
+ * deflate decoder
+ * */
+#include <string.h>
+
+#include "inflate.h"
+#include "utils.h"
+
+// codes up to this length decode with one table lookup
+#define FAST_BITS 10
+#define FAST_SIZE (1 << FAST_BITS)
+#define FAST_MASK (FAST_SIZE - 1)
+#define MAX_CODE_BITS 15
+#define MAX_LIT_CODES 288
+#define MAX_DIST_CODES 32
+
+/* *
+ * canonical huffman table
+ *
+ * fast holds (length << 9 | symbol) for codes of FAST_BITS or less, 0 when
+ * the code is longer and has to be searched by length.
+ * */
+struct huffman {
+  uint16_t fast[FAST_SIZE];
+  uint32_t first_code[MAX_CODE_BITS + 1];
+  uint32_t max_code[MAX_CODE_BITS + 2];
+  uint16_t first_symbol[MAX_CODE_BITS + 1];
+  uint8_t size[MAX_LIT_CODES];
+  uint16_t value[MAX_LIT_CODES];
+};
+typedef struct huffman huffman;
+
+/* *
+ * lsb first bit reader
+ *
+ * reading past the end shifts in zero bytes, counted so running out of
+ * input can be detected once they are consumed.
+ * */
+struct bit_reader {
+  const uint8_t *p;
+  const uint8_t *end;
+  uint64_t bits;
+  int count;
+  size_t zeros;
+};
+typedef struct bit_reader bit_reader;
+
+global_var const uint16_t length_base[29] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+global_var const uint8_t length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                             1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                             4, 4, 4, 4, 5, 5, 5, 5, 0};
+global_var const uint16_t dist_base[30] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+global_var const uint8_t dist_extra[30] = {0, 0, 0,  0,  1,  1,  2,  2,
+                                           3, 3, 4,  4,  5,  5,  6,  6,
+                                           7, 7, 8,  8,  9,  9,  10, 10,
+                                           11, 11, 12, 12, 13, 13};
+// order code length code lengths are stored in
+global_var const uint8_t length_order[19] = {16, 17, 18, 0, 8,  7, 9,
+                                             6,  10, 5,  11, 4, 12, 3,
+                                             13, 2,  14, 1,  15};
+
+/* BITS */
+
+internal void refill(bit_reader *br) {
+  while (br->count <= 56) {
+    uint64_t byte = 0;
+    if (br->p < br->end) {
+      byte = *br->p++;
+    } else {
+      ++br->zeros;
+    }
+    br->bits |= byte << br->count;
+    br->count += 8;
+  }
+}
+
+/* n <= 32 */
+internal uint32_t get_bits(bit_reader *br, int n) {
+  if (br->count < n) {
+    refill(br);
+  }
+  uint32_t value = (uint32_t)(br->bits & ((1ull << n) - 1));
+  br->bits >>= n;
+  br->count -= n;
+  return value;
+}
+
+/* padding sits above the real bits, so it was read once count drops below */
+internal bool overrun(const bit_reader *br) {
+  return (uint64_t)br->count < br->zeros * 8;
+}
+
+internal uint32_t reverse16(uint32_t v) {
+  v = ((v & 0xAAAA) >> 1) | ((v & 0x5555) << 1);
+  v = ((v & 0xCCCC) >> 2) | ((v & 0x3333) << 2);
+  v = ((v & 0xF0F0) >> 4) | ((v & 0x0F0F) << 4);
+  v = ((v & 0xFF00) >> 8) | ((v & 0x00FF) << 8);
+  return v;
+}
+
+/* HUFFMAN */
+
+internal bool huffman_build(huffman *h, const uint8_t *lengths, int n) {
+  int count[MAX_CODE_BITS + 1] = {0};
+  memset(h->fast, 0, sizeof(h->fast));
+  for (int i = 0; i < n; ++i) {
+    if (lengths[i] > MAX_CODE_BITS) {
+      return false;
+    }
+    ++count[lengths[i]];
+  }
+  count[0] = 0;
+
+  // more codes of a length than fit is invalid, fewer is allowed
+  int left = 1;
+  for (int len = 1; len <= MAX_CODE_BITS; ++len) {
+    left = (left << 1) - count[len];
+    if (left < 0) {
+      return false;
+    }
+  }
+
+  uint32_t next_code[MAX_CODE_BITS + 1];
+  uint32_t code = 0;
+  int symbols = 0;
+  for (int len = 1; len <= MAX_CODE_BITS; ++len) {
+    next_code[len] = code;
+    h->first_code[len] = code;
+    h->first_symbol[len] = (uint16_t)symbols;
+    code += (uint32_t)count[len];
+    symbols += count[len];
+    h->max_code[len] = code << (16 - len);
+    code <<= 1;
+  }
+  h->max_code[MAX_CODE_BITS + 1] = 0x10000;
+
+  for (int i = 0; i < n; ++i) {
+    int len = lengths[i];
+    if (len == 0) {
+      continue;
+    }
+    uint32_t c = next_code[len] - h->first_code[len] + h->first_symbol[len];
+    h->size[c] = (uint8_t)len;
+    h->value[c] = (uint16_t)i;
+    if (len <= FAST_BITS) {
+      // codes are read lsb first, every index ending in the code matches
+      uint32_t j = reverse16(next_code[len]) >> (16 - len);
+      for (; j < FAST_SIZE; j += 1u << len) {
+        h->fast[j] = (uint16_t)((len << 9) | i);
+      }
+    }
+    ++next_code[len];
+  }
+  return true;
+}
+
+/* next symbol, -1 for a code not in the table */
+internal int huffman_decode(bit_reader *br, const huffman *h) {
+  if (br->count < 16) {
+    refill(br);
+  }
+
+  uint32_t fast = h->fast[br->bits & FAST_MASK];
+  if (fast) {
+    int len = (int)(fast >> 9);
+    br->bits >>= len;
+    br->count -= len;
+    return (int)(fast & 511);
+  }
+
+  // longer codes, compare against the last code of each length
+  uint32_t k = reverse16((uint32_t)(br->bits & 0xFFFF));
+  int len = FAST_BITS + 1;
+  while (len <= MAX_CODE_BITS and k >= h->max_code[len]) {
+    ++len;
+  }
+  if (len > MAX_CODE_BITS) {
+    return -1;
+  }
+
+  uint32_t c = (k >> (16 - len)) - h->first_code[len] + h->first_symbol[len];
+  if (c >= MAX_LIT_CODES or h->size[c] != len) {
+    return -1;
+  }
+  br->bits >>= len;
+  br->count -= len;
+  return h->value[c];
+}
+
+/* BLOCKS */
+
+struct inflate_state {
+  bit_reader br;
+  uint8_t *out;
+  size_t size;
+  size_t pos;
+};
+typedef struct inflate_state inflate_state;
+
+internal bool inflate_stored(inflate_state *s) {
+  // stored data starts on a byte boundary
+  get_bits(&s->br, s->br.count & 7);
+  uint32_t length = get_bits(&s->br, 16);
+  uint32_t inverse = get_bits(&s->br, 16);
+  if (length != (~inverse & 0xFFFF) or length > s->size - s->pos) {
+    return false;
+  }
+  for (uint32_t i = 0; i < length; ++i) {
+    s->out[s->pos++] = (uint8_t)get_bits(&s->br, 8);
+  }
+  return not overrun(&s->br);
+}
+
+internal bool inflate_codes(inflate_state *s, const huffman *lit,
+                            const huffman *dist) {
+  for (;;) {
+    int sym = huffman_decode(&s->br, lit);
+    if (sym < 0) {
+      return false;
+    }
+    if (sym < 256) {
+      if (s->pos == s->size) {
+        return false;
+      }
+      s->out[s->pos++] = (uint8_t)sym;
+      continue;
+    }
+    if (sym == 256) {
+      return not overrun(&s->br);
+    }
+
+    sym -= 257;
+    if (sym >= 29) {
+      return false;
+    }
+    size_t length = length_base[sym] + get_bits(&s->br, length_extra[sym]);
+
+    sym = huffman_decode(&s->br, dist);
+    if (sym < 0 or sym >= 30) {
+      return false;
+    }
+    size_t distance = dist_base[sym] + get_bits(&s->br, dist_extra[sym]);
+    if (distance > s->pos or length > s->size - s->pos) {
+      return false;
+    }
+
+    // copies may overlap their own output
+    uint8_t *dst = s->out + s->pos;
+    const uint8_t *src = dst - distance;
+    if (distance >= length) {
+      memcpy(dst, src, length);
+    } else if (distance == 1) {
+      memset(dst, *src, length);
+    } else {
+      for (size_t i = 0; i < length; ++i) {
+        dst[i] = src[i];
+      }
+    }
+    s->pos += length;
+  }
+}
+
+internal bool inflate_fixed(inflate_state *s) {
+  uint8_t lengths[MAX_LIT_CODES + MAX_DIST_CODES];
+  memset(lengths, 8, 144);
+  memset(lengths + 144, 9, 256 - 144);
+  memset(lengths + 256, 7, 280 - 256);
+  memset(lengths + 280, 8, MAX_LIT_CODES - 280);
+  memset(lengths + MAX_LIT_CODES, 5, MAX_DIST_CODES);
+
+  huffman lit;
+  huffman dist;
+  huffman_build(&lit, lengths, MAX_LIT_CODES);
+  huffman_build(&dist, lengths + MAX_LIT_CODES, MAX_DIST_CODES);
+  return inflate_codes(s, &lit, &dist);
+}
+
+internal bool inflate_dynamic(inflate_state *s) {
+  int lit_count = (int)get_bits(&s->br, 5) + 257;
+  int dist_count = (int)get_bits(&s->br, 5) + 1;
+  int code_count = (int)get_bits(&s->br, 4) + 4;
+  if (lit_count > 286 or dist_count > 30) {
+    return false;
+  }
+
+  uint8_t code_lengths[19] = {0};
+  for (int i = 0; i < code_count; ++i) {
+    code_lengths[length_order[i]] = (uint8_t)get_bits(&s->br, 3);
+  }
+  huffman codes;
+  if (not huffman_build(&codes, code_lengths, 19)) {
+    return false;
+  }
+
+  // literal and distance lengths are one run, repeats may cross between
+  uint8_t lengths[286 + 30];
+  int total = lit_count + dist_count;
+  int n = 0;
+  while (n < total) {
+    int sym = huffman_decode(&s->br, &codes);
+    if (sym < 0 or sym > 18) {
+      return false;
+    }
+    if (sym < 16) {
+      lengths[n++] = (uint8_t)sym;
+      continue;
+    }
+
+    uint8_t value = 0;
+    int repeat = 0;
+    if (sym == 16) {
+      if (n == 0) {
+        return false;
+      }
+      value = lengths[n - 1];
+      repeat = 3 + (int)get_bits(&s->br, 2);
+    } else if (sym == 17) {
+      repeat = 3 + (int)get_bits(&s->br, 3);
+    } else {
+      repeat = 11 + (int)get_bits(&s->br, 7);
+    }
+    if (n + repeat > total) {
+      return false;
+    }
+    memset(lengths + n, value, (size_t)repeat);
+    n += repeat;
+  }
+
+  // a block has to be able to end
+  if (lengths[256] == 0) {
+    return false;
+  }
+
+  huffman lit;
+  huffman dist;
+  if (not huffman_build(&lit, lengths, lit_count) or
+      not huffman_build(&dist, lengths + lit_count, dist_count)) {
+    return false;
+  }
+  return inflate_codes(s, &lit, &dist);
+}
+
+/* INFLATE */
+
+bool inflate_raw(const uint8_t *in, size_t in_size, uint8_t *out,
+                 size_t out_size, size_t *written) {
+  inflate_state s = {
+      .br = {.p = in, .end = in + in_size},
+      .out = out,
+      .size = out_size,
+  };
+
+  bool final = false;
+  while (not final) {
+    if (overrun(&s.br)) {
+      return false;
+    }
+    final = get_bits(&s.br, 1);
+    uint32_t type = get_bits(&s.br, 2);
+
+    bool ok = false;
+    if (type == 0) {
+      ok = inflate_stored(&s);
+    } else if (type == 1) {
+      ok = inflate_fixed(&s);
+    } else if (type == 2) {
+      ok = inflate_dynamic(&s);
+    }
+    if (not ok) {
+      return false;
+    }
+  }
+
+  if (written) {
+    *written = s.pos;
+  }
+  return true;
+}
+
+bool inflate_zlib(const uint8_t *in, size_t in_size, uint8_t *out,
+                  size_t out_size, size_t *written) {
+  if (in_size < 2) {
+    return false;
+  }
+
+  // deflate with a window of at most 32k and no preset dictionary
+  uint32_t cmf = in[0];
+  uint32_t flg = in[1];
+  if ((cmf * 256 + flg) % 31 != 0 or (cmf & 15) != 8 or (cmf >> 4) > 7 or
+      (flg & 32)) {
+    return false;
+  }
+  return inflate_raw(in + 2, in_size - 2, out, out_size, written);
+}
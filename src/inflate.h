@@ -0,0 +1,20 @@
+#ifndef _INFLATE_H_
+#define _INFLATE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* *
+ * decompress a raw deflate stream (rfc 1951) into out
+ *
+ * out must be large enough for the whole result, decoding fails instead
+ * of growing it. written may be NULL.
+ * */
+bool inflate_raw(const uint8_t *in, size_t in_size, uint8_t *out,
+                 size_t out_size, size_t *written);
+/* same for a zlib wrapped stream (rfc 1950), the checksum is not verified */
+bool inflate_zlib(const uint8_t *in, size_t in_size, uint8_t *out,
+                  size_t out_size, size_t *written);
+
+#endif /* _INFLATE_H_ */
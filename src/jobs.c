@@ -0,0 +1,410 @@
+/* *
+ * work stealing job system
+ * */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "jobs.h"
+#include "utils.h"
+
+// per worker, power of two
+#define DEQUE_SIZE 4096
+#define DEQUE_MASK (DEQUE_SIZE - 1)
+#define PARALLEL_FOR_MAX_JOBS 256
+#define SPIN_BEFORE_SLEEP 64
+
+struct queued_job {
+  job_fn fn;
+  void *data;
+  job_counter *counter;
+};
+typedef struct queued_job queued_job;
+
+/* *
+ * deque slot, fields are atomic because a thief may read a slot the
+ * owner is refilling, the thief then loses its cas and drops the copy
+ * */
+struct job_slot {
+  _Atomic(job_fn) fn;
+  _Atomic(void *) data;
+  _Atomic(job_counter *) counter;
+};
+typedef struct job_slot job_slot;
+
+/* *
+ * chase-lev deque, owner pushes and takes at bottom, thieves steal at top
+ * */
+struct deque {
+  _Atomic int64_t top;
+  char pad0[64 - sizeof(int64_t)];
+  _Atomic int64_t bottom;
+  char pad1[64 - sizeof(int64_t)];
+  job_slot buffer[DEQUE_SIZE];
+};
+typedef struct deque deque;
+
+struct job_system {
+  deque *deques;
+  thrd_t threads[JOBS_MAX_WORKERS];
+  int thread_count;
+
+  atomic_bool running;
+  // jobs pushed and not yet taken, workers sleep while it is 0
+  atomic_int queued;
+
+  mtx_t lock;
+  cnd_t wake;
+  atomic_int sleeping;
+};
+typedef struct job_system job_system;
+
+global_var job_system system_jobs;
+global_var _Thread_local int thread_index = -1;
+global_var _Thread_local uint32_t steal_seed = 1;
+
+/* DEQUE */
+
+internal void slot_store(job_slot *slot, const queued_job *j) {
+  atomic_store_explicit(&slot->fn, j->fn, memory_order_relaxed);
+  atomic_store_explicit(&slot->data, j->data, memory_order_relaxed);
+  atomic_store_explicit(&slot->counter, j->counter, memory_order_relaxed);
+}
+
+internal queued_job slot_load(job_slot *slot) {
+  queued_job j;
+  j.fn = atomic_load_explicit(&slot->fn, memory_order_relaxed);
+  j.data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+  j.counter = atomic_load_explicit(&slot->counter, memory_order_relaxed);
+  return j;
+}
+
+internal bool deque_push(deque *d, const queued_job *j) {
+  int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+  int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+  if (b - t >= DEQUE_SIZE) {
+    return false;
+  }
+
+  slot_store(&d->buffer[b & DEQUE_MASK], j);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  return true;
+}
+
+internal bool deque_take(deque *d, queued_job *dest) {
+  int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+  if (t > b) {
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return false;
+  }
+
+  *dest = slot_load(&d->buffer[b & DEQUE_MASK]);
+  if (t == b) {
+    // last job, race thieves for it
+    bool won = atomic_compare_exchange_strong_explicit(
+        &d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return won;
+  }
+  return true;
+}
+
+internal bool deque_steal(deque *d, queued_job *dest) {
+  int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+  if (t >= b) {
+    return false;
+  }
+
+  // copy before the cas, the slot may be refilled once top moves on
+  *dest = slot_load(&d->buffer[t & DEQUE_MASK]);
+  return atomic_compare_exchange_strong_explicit(
+      &d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+/* HELPERS */
+
+internal uint32_t next_random(void) {
+  // xorshift, only used to spread steals
+  uint32_t x = steal_seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  steal_seed = x;
+  return x;
+}
+
+internal void execute(const queued_job *j) {
+  job_fn fn = j->fn;
+  void *data = j->data;
+  job_counter *counter = j->counter;
+
+  fn(data);
+
+  if (counter) {
+    atomic_fetch_sub_explicit(&counter->value, 1, memory_order_release);
+  }
+}
+
+/* take from own deque, otherwise steal from a random victim */
+internal bool find_job(int self, queued_job *dest) {
+  job_system *js = &system_jobs;
+
+  bool found = deque_take(&js->deques[self], dest);
+  if (not found) {
+    int start = (int)(next_random() % (uint32_t)js->thread_count);
+    for (int i = 0; i < js->thread_count and not found; ++i) {
+      int victim = (start + i) % js->thread_count;
+      if (victim != self) {
+        found = deque_steal(&js->deques[victim], dest);
+      }
+    }
+  }
+
+  if (found) {
+    atomic_fetch_sub_explicit(&js->queued, 1, memory_order_relaxed);
+  }
+  return found;
+}
+
+internal void wake_workers(void) {
+  job_system *js = &system_jobs;
+  // orders the relaxed queued increments before the sleeping load, a
+  // worker that bumps sleeping then reads queued either sees the jobs or
+  // is seen here and woken
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load(&js->sleeping) > 0) {
+    mtx_lock(&js->lock);
+    cnd_broadcast(&js->wake);
+    mtx_unlock(&js->lock);
+  }
+}
+
+internal int worker_main(void *arg) {
+  job_system *js = &system_jobs;
+  thread_index = (int)(intptr_t)arg;
+  steal_seed = 0x9E3779B9u * (uint32_t)(thread_index + 1);
+
+  int idle = 0;
+  while (atomic_load(&js->running)) {
+    queued_job j;
+    if (find_job(thread_index, &j)) {
+      execute(&j);
+      idle = 0;
+      continue;
+    }
+
+    if (++idle < SPIN_BEFORE_SLEEP) {
+      thrd_yield();
+      continue;
+    }
+
+    // queued is checked under the lock, pushers broadcast under it
+    mtx_lock(&js->lock);
+    atomic_fetch_add(&js->sleeping, 1);
+    while (atomic_load(&js->running) and atomic_load(&js->queued) == 0) {
+      cnd_wait(&js->wake, &js->lock);
+    }
+    atomic_fetch_sub(&js->sleeping, 1);
+    mtx_unlock(&js->lock);
+    idle = 0;
+  }
+
+  return 0;
+}
+
+/* JOBS */
+
+int jobs_cpu_count(void) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
+
+bool jobs_init(int worker_count) {
+  job_system *js = &system_jobs;
+  assert(js->thread_count == 0);
+
+  if (worker_count < 0) {
+    worker_count = 0;
+  }
+  if (worker_count > JOBS_MAX_WORKERS - 1) {
+    worker_count = JOBS_MAX_WORKERS - 1;
+  }
+
+  js->deques = calloc((size_t)worker_count + 1, sizeof(*js->deques));
+  if (not js->deques) {
+    fprintf(stderr, "ERROR: jobs failed to allocate %d deques\n",
+            worker_count + 1);
+    return false;
+  }
+
+  atomic_init(&js->running, true);
+  atomic_init(&js->queued, 0);
+  atomic_init(&js->sleeping, 0);
+  mtx_init(&js->lock, mtx_plain);
+  cnd_init(&js->wake);
+
+  // calling thread is worker 0
+  thread_index = 0;
+  js->thread_count = 1;
+
+  for (int i = 1; i <= worker_count; ++i) {
+    if (thrd_create(&js->threads[i], worker_main, (void *)(intptr_t)i) !=
+        thrd_success) {
+      fprintf(stderr, "ERROR: jobs failed to start worker %d\n", i);
+      break;
+    }
+    ++js->thread_count;
+  }
+
+  return true;
+}
+
+void jobs_shutdown(void) {
+  job_system *js = &system_jobs;
+  if (js->thread_count == 0) {
+    return;
+  }
+
+  mtx_lock(&js->lock);
+  atomic_store(&js->running, false);
+  cnd_broadcast(&js->wake);
+  mtx_unlock(&js->lock);
+
+  for (int i = 1; i < js->thread_count; ++i) {
+    thrd_join(js->threads[i], NULL);
+  }
+
+  mtx_destroy(&js->lock);
+  cnd_destroy(&js->wake);
+  free(js->deques);
+  memset(js, 0, sizeof(*js));
+  thread_index = -1;
+}
+
+int jobs_thread_count(void) {
+  return system_jobs.thread_count > 0 ? system_jobs.thread_count : 1;
+}
+
+void jobs_run(const job *jobs, int count, job_counter *counter) {
+  job_system *js = &system_jobs;
+
+  if (counter) {
+    atomic_fetch_add_explicit(&counter->value, count, memory_order_relaxed);
+  }
+
+  int self = thread_index;
+  if (self < 0 or js->thread_count == 0) {
+    for (int i = 0; i < count; ++i) {
+      queued_job inline_job = {jobs[i].fn, jobs[i].data, counter};
+      execute(&inline_job);
+    }
+    return;
+  }
+
+  deque *d = &js->deques[self];
+  for (int i = 0; i < count; ++i) {
+    queued_job j = {jobs[i].fn, jobs[i].data, counter};
+
+    atomic_fetch_add_explicit(&js->queued, 1, memory_order_relaxed);
+    if (not deque_push(d, &j)) {
+      // deque full, do the work here instead
+      atomic_fetch_sub_explicit(&js->queued, 1, memory_order_relaxed);
+      execute(&j);
+    }
+  }
+
+  wake_workers();
+}
+
+void jobs_wait(job_counter *counter) {
+  bool worker = thread_index >= 0 and system_jobs.thread_count > 0;
+
+  while (atomic_load_explicit(&counter->value, memory_order_acquire) > 0) {
+    queued_job j;
+    if (worker and find_job(thread_index, &j)) {
+      execute(&j);
+    } else {
+      thrd_yield();
+    }
+  }
+}
+
+/* PARALLEL FOR */
+
+struct parallel_range {
+  parallel_for_fn fn;
+  void *data;
+  uint32_t start;
+  uint32_t end;
+};
+typedef struct parallel_range parallel_range;
+
+internal void parallel_range_job(void *data) {
+  parallel_range *range = data;
+  range->fn(range->data, range->start, range->end);
+}
+
+void parallel_for(uint32_t count, uint32_t batch, parallel_for_fn fn,
+                  void *data) {
+  if (count == 0) {
+    return;
+  }
+  if (batch == 0) {
+    batch = 1;
+  }
+
+  // a few ranges per thread balances load without tiny jobs
+  uint32_t threads = (uint32_t)jobs_thread_count();
+  uint32_t max_jobs = threads * 4;
+  if (max_jobs > PARALLEL_FOR_MAX_JOBS) {
+    max_jobs = PARALLEL_FOR_MAX_JOBS;
+  }
+  uint32_t min_batch = (count + max_jobs - 1) / max_jobs;
+  if (batch < min_batch) {
+    batch = min_batch;
+  }
+
+  uint32_t job_count = (count + batch - 1) / batch;
+  if (job_count == 1 or threads == 1) {
+    fn(data, 0, count);
+    return;
+  }
+
+  parallel_range ranges[PARALLEL_FOR_MAX_JOBS];
+  job jobs[PARALLEL_FOR_MAX_JOBS];
+  for (uint32_t i = 0; i < job_count; ++i) {
+    ranges[i].fn = fn;
+    ranges[i].data = data;
+    ranges[i].start = i * batch;
+    ranges[i].end = i * batch + batch < count ? i * batch + batch : count;
+    jobs[i].fn = parallel_range_job;
+    jobs[i].data = &ranges[i];
+  }
+
+  job_counter counter;
+  atomic_init(&counter.value, 0);
+  jobs_run(jobs, (int)job_count, &counter);
+  jobs_wait(&counter);
+}
@@ -0,0 +1,59 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define JOBS_MAX_WORKERS 32
+
+/* *
+ * number of jobs still running, jobs_wait returns once it reaches 0
+ *
+ * a job that depends on others waits on their counter, the waiting
+ * thread keeps running queued jobs meanwhile so nothing blocks.
+ * */
+struct job_counter {
+  atomic_int value;
+};
+typedef struct job_counter job_counter;
+
+typedef void (*job_fn)(void *data);
+
+struct job {
+  job_fn fn;
+  void *data;
+};
+typedef struct job job;
+
+/* called with a sub range start .. end of a parallel_for */
+typedef void (*parallel_for_fn)(void *data, uint32_t start, uint32_t end);
+
+/* logical cpu count of the machine */
+int jobs_cpu_count(void);
+/* *
+ * start worker_count background threads, the calling thread becomes
+ * worker 0 and takes part in jobs_wait
+ * */
+bool jobs_init(int worker_count);
+/* stop and join workers */
+void jobs_shutdown(void);
+/* threads taking jobs including the main thread, 1 if not started */
+int jobs_thread_count(void);
+
+/* *
+ * queue count jobs on the calling worker, counter may be NULL
+ * threads that are not workers run the jobs inline
+ * */
+void jobs_run(const job *jobs, int count, job_counter *counter);
+/* run or steal jobs until counter reaches 0 */
+void jobs_wait(job_counter *counter);
+
+/* *
+ * split 0 .. count into ranges of at least batch items, run them across
+ * all workers and return once every range is done
+ * */
+void parallel_for(uint32_t count, uint32_t batch, parallel_for_fn fn,
+                  void *data);
+
+#endif /* _JOBS_H_ */
@@ -0,0 +1,265 @@
+/* *
+ * minimal json reader
+ * */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+#include "utils.h"
+
+#define JSON_MAX_DEPTH 64
+#define JSON_NUMBER_SIZE 64
+
+struct json_parser {
+  json_doc *doc;
+  const char *p;
+  const char *end;
+  int depth;
+};
+typedef struct json_parser json_parser;
+
+/* HELPERS */
+
+internal void skip_space(json_parser *ps) {
+  while (ps->p < ps->end and (*ps->p == ' ' or *ps->p == '\t' or
+                              *ps->p == '\n' or *ps->p == '\r')) {
+    ++ps->p;
+  }
+}
+
+/* strchr would also match the terminating '\0' */
+internal bool is_number_char(char c) {
+  return (c >= '0' and c <= '9') or c == '+' or c == '-' or c == '.' or
+         c == 'e' or c == 'E';
+}
+
+internal bool expect(json_parser *ps, char c) {
+  skip_space(ps);
+  if (ps->p < ps->end and *ps->p == c) {
+    ++ps->p;
+    return true;
+  }
+  return false;
+}
+
+internal int push_node(json_parser *ps, json_type type) {
+  json_doc *doc = ps->doc;
+  if (doc->count == doc->capacity) {
+    uint32_t capacity = doc->capacity ? doc->capacity * 2 : 64;
+    json_node *nodes = realloc(doc->nodes, sizeof(*nodes) * capacity);
+    if (not nodes) {
+      return JSON_NONE;
+    }
+    doc->nodes = nodes;
+    doc->capacity = capacity;
+  }
+
+  int idx = (int)doc->count++;
+  json_node *node = &doc->nodes[idx];
+  node->type = type;
+  node->start = (uint32_t)(ps->p - doc->text);
+  node->length = 0;
+  node->count = 0;
+  node->next = 0;
+  return idx;
+}
+
+internal bool parse_value(json_parser *ps);
+
+internal bool parse_string(json_parser *ps) {
+  if (not expect(ps, '"')) {
+    return false;
+  }
+
+  int idx = push_node(ps, JSON_STRING);
+  if (idx == JSON_NONE) {
+    return false;
+  }
+
+  while (ps->p < ps->end and *ps->p != '"') {
+    // escaped character, including an escaped quote
+    ps->p += *ps->p == '\\' ? 2 : 1;
+  }
+  if (ps->p >= ps->end) {
+    return false;
+  }
+
+  json_node *node = &ps->doc->nodes[idx];
+  node->length = (uint32_t)(ps->p - ps->doc->text) - node->start;
+  node->next = ps->doc->count;
+  ++ps->p;
+  return true;
+}
+
+internal bool parse_literal(json_parser *ps, const char *word,
+                            json_type type) {
+  size_t length = strlen(word);
+  if ((size_t)(ps->end - ps->p) < length or
+      memcmp(ps->p, word, length) != 0) {
+    return false;
+  }
+
+  int idx = push_node(ps, type);
+  if (idx == JSON_NONE) {
+    return false;
+  }
+  ps->p += length;
+  ps->doc->nodes[idx].length = (uint32_t)length;
+  ps->doc->nodes[idx].next = ps->doc->count;
+  return true;
+}
+
+internal bool parse_number(json_parser *ps) {
+  int idx = push_node(ps, JSON_NUMBER);
+  if (idx == JSON_NONE) {
+    return false;
+  }
+
+  const char *start = ps->p;
+  while (ps->p < ps->end and is_number_char(*ps->p)) {
+    ++ps->p;
+  }
+  if (ps->p == start) {
+    return false;
+  }
+
+  ps->doc->nodes[idx].length = (uint32_t)(ps->p - start);
+  ps->doc->nodes[idx].next = ps->doc->count;
+  return true;
+}
+
+/* array when close is ']', object when '}' */
+internal bool parse_container(json_parser *ps, json_type type, char close) {
+  if (++ps->depth > JSON_MAX_DEPTH) {
+    return false;
+  }
+
+  int idx = push_node(ps, type);
+  if (idx == JSON_NONE) {
+    return false;
+  }
+  ++ps->p;
+
+  uint32_t count = 0;
+  if (not expect(ps, close)) {
+    do {
+      if (type == JSON_OBJECT and
+          not(parse_string(ps) and expect(ps, ':'))) {
+        return false;
+      }
+      if (not parse_value(ps)) {
+        return false;
+      }
+      ++count;
+    } while (expect(ps, ','));
+
+    if (not expect(ps, close)) {
+      return false;
+    }
+  }
+
+  json_node *node = &ps->doc->nodes[idx];
+  node->count = count;
+  node->length = (uint32_t)(ps->p - ps->doc->text) - node->start;
+  node->next = ps->doc->count;
+  --ps->depth;
+  return true;
+}
+
+internal bool parse_value(json_parser *ps) {
+  skip_space(ps);
+  if (ps->p >= ps->end) {
+    return false;
+  }
+
+  switch (*ps->p) {
+  case '{':
+    return parse_container(ps, JSON_OBJECT, '}');
+  case '[':
+    return parse_container(ps, JSON_ARRAY, ']');
+  case '"':
+    return parse_string(ps);
+  case 't':
+    return parse_literal(ps, "true", JSON_TRUE);
+  case 'f':
+    return parse_literal(ps, "false", JSON_FALSE);
+  case 'n':
+    return parse_literal(ps, "null", JSON_NULL);
+  default:
+    return parse_number(ps);
+  }
+}
+
+/* JSON */
+
+bool json_parse(json_doc *doc, const char *text, size_t length) {
+  memset(doc, 0, sizeof(*doc));
+  doc->text = text;
+
+  json_parser ps = {.doc = doc, .p = text, .end = text + length};
+  if (not parse_value(&ps)) {
+    fprintf(stderr, "ERROR: json parse failed at byte %zu\n",
+            (size_t)(ps.p - text));
+    json_destroy(doc);
+    return false;
+  }
+  return true;
+}
+
+void json_destroy(json_doc *doc) {
+  free(doc->nodes);
+  memset(doc, 0, sizeof(*doc));
+}
+
+int json_get(const json_doc *doc, int object, const char *key) {
+  if (object == JSON_NONE or doc->nodes[object].type != JSON_OBJECT) {
+    return JSON_NONE;
+  }
+
+  int child = object + 1;
+  for (uint32_t i = 0; i < doc->nodes[object].count; ++i) {
+    int value = child + 1;
+    if (json_string_equals(doc, child, key)) {
+      return value;
+    }
+    child = (int)doc->nodes[value].next;
+  }
+  return JSON_NONE;
+}
+
+int json_at(const json_doc *doc, int array, uint32_t index) {
+  if (array == JSON_NONE or doc->nodes[array].type != JSON_ARRAY or
+      index >= doc->nodes[array].count) {
+    return JSON_NONE;
+  }
+
+  int child = array + 1;
+  for (uint32_t i = 0; i < index; ++i) {
+    child = (int)doc->nodes[child].next;
+  }
+  return child;
+}
+
+double json_number(const json_doc *doc, int node, double fallback) {
+  if (node == JSON_NONE or doc->nodes[node].type != JSON_NUMBER or
+      doc->nodes[node].length >= JSON_NUMBER_SIZE) {
+    return fallback;
+  }
+
+  // source text is not terminated after the number
+  char buffer[JSON_NUMBER_SIZE];
+  memcpy(buffer, doc->text + doc->nodes[node].start, doc->nodes[node].length);
+  buffer[doc->nodes[node].length] = '\0';
+  return strtod(buffer, NULL);
+}
+
+bool json_string_equals(const json_doc *doc, int node, const char *value) {
+  if (node == JSON_NONE or doc->nodes[node].type != JSON_STRING) {
+    return false;
+  }
+  size_t length = strlen(value);
+  return doc->nodes[node].length == length and
+         memcmp(doc->text + doc->nodes[node].start, value, length) == 0;
+}
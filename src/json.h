@@ -0,0 +1,61 @@
+#ifndef _JSON_H_
+#define _JSON_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_NONE -1
+
+enum json_type {
+  JSON_NULL,
+  JSON_FALSE,
+  JSON_TRUE,
+  JSON_NUMBER,
+  JSON_STRING,
+  JSON_ARRAY,
+  JSON_OBJECT,
+};
+typedef enum json_type json_type;
+
+/* *
+ * one value of a parsed document
+ *
+ * nodes are stored depth first, the children of a node follow it and
+ * next is the index after its whole subtree. object members are a key
+ * string node followed by its value. strings point into the source text
+ * with escapes left in place.
+ * */
+struct json_node {
+  json_type type;
+  uint32_t start;
+  uint32_t length;
+  // values in an array, members in an object
+  uint32_t count;
+  uint32_t next;
+};
+typedef struct json_node json_node;
+
+struct json_doc {
+  const char *text;
+  json_node *nodes;
+  uint32_t count;
+  uint32_t capacity;
+};
+typedef struct json_doc json_doc;
+
+/* parse text of length bytes, root is node 0 */
+bool json_parse(json_doc *doc, const char *text, size_t length);
+/* free nodes, text is not owned */
+void json_destroy(json_doc *doc);
+
+/* value of key in object node, JSON_NONE if missing */
+int json_get(const json_doc *doc, int object, const char *key);
+/* value at index of array node, JSON_NONE if out of range */
+int json_at(const json_doc *doc, int array, uint32_t index);
+/* number value of node, fallback when missing or not a number */
+double json_number(const json_doc *doc, int node, double fallback);
+/* true if node is a string equal to value */
+bool json_string_equals(const json_doc *doc, int node, const char *value);
+
+#endif /* _JSON_H_ */
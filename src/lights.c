@@ -0,0 +1,105 @@
+/* *
+ * point lights
+ * */
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+
+#include "glstate.h"
+#include "lights.h"
+#include "utils.h"
+
+/* HELPERS */
+
+/* 0..1 from the bits of index mixed with salt */
+internal float hash01(uint32_t index, uint32_t salt) {
+  uint32_t x = index * 0x9e3779b9u ^ salt;
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return (float)(x >> 8) / 16777216.0f;
+}
+
+/* LIGHT BUFFER */
+
+bool light_buffer_init(light_buffer *lb, GLsizei capacity) {
+  assert(capacity > 0);
+
+  glad_glGenBuffers(1, &lb->buffer);
+  glstate_bind_buffer(GL_SHADER_STORAGE_BUFFER, lb->buffer);
+  glad_glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(point_light) * capacity,
+                    NULL, GL_DYNAMIC_DRAW);
+  lb->capacity = capacity;
+  lb->count = 0;
+
+  return lb->buffer != 0;
+}
+
+void light_buffer_destroy(light_buffer *lb) {
+  glstate_forget_buffer(lb->buffer);
+  glad_glDeleteBuffers(1, &lb->buffer);
+  lb->buffer = 0;
+  lb->capacity = 0;
+  lb->count = 0;
+}
+
+void light_buffer_upload(light_buffer *lb, const point_light *lights,
+                         GLsizei count) {
+  lb->count = count;
+  if (count <= 0) {
+    return;
+  }
+
+  glstate_bind_buffer(GL_SHADER_STORAGE_BUFFER, lb->buffer);
+
+  while (lb->capacity < count) {
+    lb->capacity *= 2;
+  }
+
+  // orphan so last frames passes can still read the old copy
+  glad_glBufferData(GL_SHADER_STORAGE_BUFFER,
+                    sizeof(*lights) * lb->capacity, NULL, GL_DYNAMIC_DRAW);
+  glad_glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(*lights) * count,
+                       lights);
+}
+
+void light_buffer_bind(const light_buffer *lb) {
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING,
+                           lb->buffer);
+}
+
+/* LIGHTS */
+
+void lights_animate(point_light *lights, uint32_t count, const aabb *area,
+                    float radius, float time) {
+  vec3 centre = vec3_add(&area->min, &area->max);
+  centre = vec3_mul(&centre, 0.5f);
+  vec3 half = vec3_sub(&area->max, &area->min);
+  half = vec3_mul(&half, 0.5f);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    // an ellipse around the centre, tilted and phased per light
+    float speed = 0.2f + 0.6f * hash01(i, 1);
+    float phase = hash01(i, 2) * 6.2831853f;
+    float angle = phase + time * speed * (i % 2 ? 1.0f : -1.0f);
+    float reach = 0.3f + 0.7f * hash01(i, 3);
+    float height = 2.0f * hash01(i, 4) - 1.0f;
+
+    lights[i].position[0] = centre.x + half.x * reach * cosf(angle);
+    lights[i].position[1] = centre.y + half.y * reach * sinf(angle);
+    lights[i].position[2] = centre.z + half.z * height;
+    lights[i].position[3] = radius * (0.75f + 0.5f * hash01(i, 5));
+
+    // saturated hues, so overlapping lights stay told apart
+    float hue = hash01(i, 6) * 6.0f;
+    float r = fabsf(hue - 3.0f) - 1.0f;
+    float g = 2.0f - fabsf(hue - 2.0f);
+    float b = 2.0f - fabsf(hue - 4.0f);
+    lights[i].colour[0] = fminf(fmaxf(r, 0.0f), 1.0f);
+    lights[i].colour[1] = fminf(fmaxf(g, 0.0f), 1.0f);
+    lights[i].colour[2] = fminf(fmaxf(b, 0.0f), 1.0f);
+    lights[i].colour[3] = 1.0f;
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef _LIGHTS_H_
+#define _LIGHTS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frustum.h"
+#include "glad/glad.h"
+
+// binding point shared with the lighting shaders, after those of particles.h
+#define LIGHT_BINDING 8
+
+/* *
+ * one point light, std430
+ *
+ * struct point_light {
+ *     vec4 position;   // w is the radius it reaches zero at
+ *     vec4 colour;     // w unused
+ * };
+ * */
+struct point_light {
+  float position[4];
+  float colour[4];
+};
+typedef struct point_light point_light;
+
+_Static_assert(sizeof(point_light) == 32, "std430 point_light stride");
+
+/* *
+ * lights of the frame in shader storage, regrown and orphaned like the
+ * object block so frames in flight keep their copy
+ * */
+struct light_buffer {
+  GLuint buffer;
+  GLsizei capacity;
+  GLsizei count;
+};
+typedef struct light_buffer light_buffer;
+
+/* create storage for capacity lights */
+bool light_buffer_init(light_buffer *lb, GLsizei capacity);
+/* delete storage */
+void light_buffer_destroy(light_buffer *lb);
+/* upload count lights, grows storage if needed */
+void light_buffer_upload(light_buffer *lb, const point_light *lights,
+                         GLsizei count);
+/* bind the lights to LIGHT_BINDING */
+void light_buffer_bind(const light_buffer *lb);
+
+/* *
+ * place count lights drifting around inside area at time seconds
+ *
+ * each light has its own fixed colour, radius and orbit picked from its
+ * index, so the same count and time always give the same lights.
+ * */
+void lights_animate(point_light *lights, uint32_t count, const aabb *area,
+                    float radius, float time);
+
+#endif /* _LIGHTS_H_ */
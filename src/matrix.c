@@ -880,6 +880,47 @@ mat4 mat4_rotate_z(const mat4 *m4, float by) {
   return mat4_mul(m4, &m);
 }
 
+mat4 mat4_orthographic(float left, float right, float bottom, float top,
+                       float near, float far) {
+  /* *
+   * row order, looks down -z, depth maps near..far to -1..1
+   * | sx  0  0  0 |
+   * |  0 sy  0  0 |
+   * |  0  0 sz  0 |
+   * | px py pz  1 |
+   * */
+  mat4 m = mat4_identity();
+
+  m._11 = 2.0f / (right - left);
+  m._22 = 2.0f / (top - bottom);
+  m._33 = -2.0f / (far - near);
+  m._41 = -(right + left) / (right - left);
+  m._42 = -(top + bottom) / (top - bottom);
+  m._43 = -(far + near) / (far - near);
+
+  return m;
+}
+
+mat4 mat4_look_at(const vec3 *eye, const vec3 *target, const vec3 *up) {
+  /* *
+   * row order, side s, up u and forward f of the eye as columns
+   * |      sx      ux    -fx  0 |
+   * |      sy      uy    -fy  0 |
+   * |      sz      uz    -fz  0 |
+   * | -s.eye  -u.eye  f.eye  1 |
+   * */
+  vec3 forward = vec3_sub(target, eye);
+  forward = vec3_normal(&forward);
+  vec3 side = vec3_cross(&forward, up);
+  side = vec3_normal(&side);
+  vec3 above = vec3_cross(&side, &forward);
+
+  return mat4_new(side.x, above.x, -forward.x, 0.0f, side.y, above.y,
+                  -forward.y, 0.0f, side.z, above.z, -forward.z, 0.0f,
+                  -vec3_dot(&side, eye), -vec3_dot(&above, eye),
+                  vec3_dot(&forward, eye), 1.0f);
+}
+
 // TODO
 internal mat4 mat4_rotate(const mat4 *m4, float by, const vec3 *v3) {
   /* https://en.wikipedia.org/wiki/Rotation_matrix
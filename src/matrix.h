@@ -179,6 +179,11 @@ mat4 mat4_rotate_x(const mat4 *m4, float by);
 mat4 mat4_rotate_y(const mat4 *m4, float by);
 /* rotate matrix 4x4 on z axis */
 mat4 mat4_rotate_z(const mat4 *m4, float by);
+/* orthographic projection, near and far are distances down -z */
+mat4 mat4_orthographic(float left, float right, float bottom, float top,
+                       float near, float far);
+/* view matrix of an eye at eye looking at target, up need not be exact */
+mat4 mat4_look_at(const vec3 *eye, const vec3 *target, const vec3 *up);
 /* rotate matrix 4x4 by pitch yaw and roll */
 // void mat4_rotation(mat4 *dest, float pitch, float yaw, float roll);
 /* print matrix 4x4 to console */
@@ -0,0 +1,1571 @@
+/* *
+ * mesh import and binary cache
+ * */
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bits.h"
+#include "glstate.h"
+#include "jobs.h"
+#include "json.h"
+#include "mesh.h"
+#include "pacer.h"
+#include "utils.h"
+
+// obj files are split into chunks parsed on the job system
+#define OBJ_CHUNK_MIN (256 * 1024)
+#define OBJ_MAX_CHUNKS 256
+#define OBJ_MISSING -1
+
+#define GLB_MAGIC 0x46546C67u
+#define GLB_CHUNK_JSON 0x4E4F534Au
+#define GLB_CHUNK_BIN 0x004E4942u
+#define GLTF_TRIANGLES 4
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+
+#define CACHE_ALIGN 16
+
+/* *
+ * cache file layout, data follows the header
+ * | header | vertices | pad | indices |
+ * */
+struct mesh_cache_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t vertex_size;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t lod_count;
+  uint64_t source_size;
+  int64_t source_modified;
+  float bounds_min[3];
+  float bounds_max[3];
+  uint64_t vertex_offset;
+  uint64_t index_offset;
+  mesh_lod lods[MESH_MAX_LODS];
+};
+typedef struct mesh_cache_header mesh_cache_header;
+
+_Static_assert(sizeof(mesh_vertex) == 32, "mesh_vertex is tightly packed");
+_Static_assert(sizeof(mesh_cache_header) % CACHE_ALIGN == 0,
+               "cache data starts aligned");
+
+/* HELPERS */
+
+internal bool mesh_alloc(mesh_data *m, uint32_t vertex_count,
+                         uint32_t index_count) {
+  memset(m, 0, sizeof(*m));
+  m->vertices = calloc(vertex_count ? vertex_count : 1, sizeof(*m->vertices));
+  m->indices = malloc(sizeof(*m->indices) * (index_count ? index_count : 1));
+  if (not m->vertices or not m->indices) {
+    free(m->vertices);
+    free(m->indices);
+    memset(m, 0, sizeof(*m));
+    return false;
+  }
+  m->vertex_count = vertex_count;
+  m->index_count = index_count;
+  return true;
+}
+
+internal void mesh_compute_bounds(mesh_data *m) {
+  float min[3] = {0.0f, 0.0f, 0.0f};
+  float max[3] = {0.0f, 0.0f, 0.0f};
+  for (uint32_t i = 0; i < m->vertex_count; ++i) {
+    const float *p = m->vertices[i].position;
+    for (int k = 0; k < 3; ++k) {
+      min[k] = i == 0 or p[k] < min[k] ? p[k] : min[k];
+      max[k] = i == 0 or p[k] > max[k] ? p[k] : max[k];
+    }
+  }
+
+  vec3 lo = vec3_new(min[0], min[1], min[2]);
+  vec3 hi = vec3_new(max[0], max[1], max[2]);
+  m->bounds = aabb_new(&lo, &hi);
+}
+
+/* level 0 only, the whole index list */
+internal void mesh_single_lod(mesh_data *m) {
+  memset(m->lods, 0, sizeof(m->lods));
+  m->lods[0].index_count = m->index_count;
+  m->lod_count = 1;
+}
+
+/* *
+ * area weighted smooth normals for vertices flagged in missing, NULL for
+ * every vertex
+ * */
+internal void mesh_generate_normals(mesh_data *m, const uint8_t *missing) {
+  for (uint32_t i = 0; i < m->vertex_count; ++i) {
+    if (not missing or missing[i]) {
+      memset(m->vertices[i].normal, 0, sizeof(m->vertices[i].normal));
+    }
+  }
+
+  for (uint32_t i = 0; i + 2 < m->index_count; i += 3) {
+    mesh_vertex *v[3];
+    for (int k = 0; k < 3; ++k) {
+      v[k] = &m->vertices[m->indices[i + k]];
+    }
+
+    float e1[3], e2[3];
+    for (int k = 0; k < 3; ++k) {
+      e1[k] = v[1]->position[k] - v[0]->position[k];
+      e2[k] = v[2]->position[k] - v[0]->position[k];
+    }
+    // cross product length is twice the area, larger faces weigh more
+    float n[3] = {
+        e1[1] * e2[2] - e1[2] * e2[1],
+        e1[2] * e2[0] - e1[0] * e2[2],
+        e1[0] * e2[1] - e1[1] * e2[0],
+    };
+
+    for (int k = 0; k < 3; ++k) {
+      uint32_t idx = m->indices[i + k];
+      if (missing and not missing[idx]) {
+        continue;
+      }
+      v[k]->normal[0] += n[0];
+      v[k]->normal[1] += n[1];
+      v[k]->normal[2] += n[2];
+    }
+  }
+
+  for (uint32_t i = 0; i < m->vertex_count; ++i) {
+    if (missing and not missing[i]) {
+      continue;
+    }
+    float *n = m->vertices[i].normal;
+    float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (len > 0.0f) {
+      n[0] /= len;
+      n[1] /= len;
+      n[2] /= len;
+    } else {
+      n[2] = 1.0f;
+    }
+  }
+}
+
+/* OBJ */
+
+struct obj_corner {
+  int32_t v;
+  int32_t t;
+  int32_t n;
+};
+typedef struct obj_corner obj_corner;
+
+struct obj_chunk {
+  const char *begin;
+  const char *end;
+
+  // first pass counts
+  uint32_t positions;
+  uint32_t uvs;
+  uint32_t normals;
+  uint32_t triangles;
+
+  // first slot of this chunk in the shared arrays
+  uint32_t position_base;
+  uint32_t uv_base;
+  uint32_t normal_base;
+  uint32_t triangle_base;
+
+  bool failed;
+};
+typedef struct obj_chunk obj_chunk;
+
+struct obj_parse {
+  obj_chunk chunks[OBJ_MAX_CHUNKS];
+  uint32_t chunk_count;
+
+  float *positions;
+  float *uvs;
+  float *normals;
+  obj_corner *corners;
+
+  uint32_t position_count;
+  uint32_t uv_count;
+  uint32_t normal_count;
+  uint32_t triangle_count;
+};
+typedef struct obj_parse obj_parse;
+
+internal bool is_space(char c) { return c == ' ' or c == '\t' or c == '\r'; }
+
+internal const char *skip_spaces(const char *p, const char *end) {
+  while (p < end and is_space(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+internal const char *next_line(const char *p, const char *end) {
+  const char *newline = memchr(p, '\n', (size_t)(end - p));
+  return newline ? newline + 1 : end;
+}
+
+/* directive at the start of a line, 0 for lines that are skipped */
+internal char line_kind(const char *p, const char *end) {
+  if (end - p >= 2 and (p[0] == 'v' or p[0] == 'f') and is_space(p[1])) {
+    return p[0];
+  }
+  if (end - p >= 3 and p[0] == 'v' and (p[1] == 't' or p[1] == 'n') and
+      is_space(p[2])) {
+    return p[1];
+  }
+  return 0;
+}
+
+/* *
+ * locale independent float parser, good to a few ulp which is all a mesh
+ * needs, strtof is the slow part of most obj loaders
+ * */
+internal const char *parse_float(const char *p, const char *end, float *out) {
+  local_persist const double powers[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+
+  p = skip_spaces(p, end);
+  const char *start = p;
+
+  bool negative = false;
+  if (p < end and (*p == '-' or *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+  for (; p < end and *p >= '0' and *p <= '9'; ++p) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+      digits += mantissa > 0;
+    } else {
+      ++exponent;
+    }
+  }
+  if (p < end and *p == '.') {
+    for (++p; p < end and *p >= '0' and *p <= '9'; ++p) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        digits += mantissa > 0;
+        --exponent;
+      }
+    }
+  }
+  if (p < end and (*p == 'e' or *p == 'E')) {
+    const char *e = p + 1;
+    bool e_negative = false;
+    if (e < end and (*e == '-' or *e == '+')) {
+      e_negative = *e == '-';
+      ++e;
+    }
+    int value = 0;
+    const char *e_start = e;
+    for (; e < end and *e >= '0' and *e <= '9'; ++e) {
+      value = value < 10000 ? value * 10 + (*e - '0') : value;
+    }
+    if (e != e_start) {
+      exponent += e_negative ? -value : value;
+      p = e;
+    }
+  }
+
+  if (p == start) {
+    return NULL;
+  }
+
+  double value = (double)mantissa;
+  int scale = exponent < 0 ? -exponent : exponent;
+  double factor = 1.0;
+  while (scale > 22) {
+    factor *= 1e22;
+    scale -= 22;
+  }
+  factor *= powers[scale];
+  value = exponent < 0 ? value / factor : value * factor;
+
+  *out = (float)(negative ? -value : value);
+  return p;
+}
+
+internal const char *parse_int(const char *p, const char *end, int64_t *out) {
+  bool negative = false;
+  if (p < end and (*p == '-' or *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+
+  const char *start = p;
+  int64_t value = 0;
+  for (; p < end and *p >= '0' and *p <= '9'; ++p) {
+    value = value < INT32_MAX ? value * 10 + (*p - '0') : value;
+  }
+  if (p == start) {
+    return NULL;
+  }
+
+  *out = negative ? -value : value;
+  return p;
+}
+
+/* 1 based or negative relative obj index to 0 based, OBJ_MISSING if bad */
+internal int32_t resolve_index(int64_t raw, uint32_t seen, uint32_t total) {
+  int64_t idx = raw > 0 ? raw - 1 : (int64_t)seen + raw;
+  return raw != 0 and idx >= 0 and idx < (int64_t)total ? (int32_t)idx
+                                                         : OBJ_MISSING;
+}
+
+internal void obj_count_chunks(void *data, uint32_t start, uint32_t end) {
+  obj_parse *parse = data;
+  for (uint32_t c = start; c < end; ++c) {
+    obj_chunk *chunk = &parse->chunks[c];
+    for (const char *line = chunk->begin; line < chunk->end;) {
+      const char *stop = next_line(line, chunk->end);
+      const char *p = skip_spaces(line, stop);
+
+      switch (line_kind(p, stop)) {
+      case 'v':
+        ++chunk->positions;
+        break;
+      case 't':
+        ++chunk->uvs;
+        break;
+      case 'n':
+        ++chunk->normals;
+        break;
+      case 'f': {
+        // a polygon of k corners fans into k - 2 triangles
+        uint32_t corners = 0;
+        for (p += 1; p < stop;) {
+          p = skip_spaces(p, stop);
+          if (p >= stop or *p == '\n') {
+            break;
+          }
+          ++corners;
+          while (p < stop and not is_space(*p) and *p != '\n') {
+            ++p;
+          }
+        }
+        chunk->triangles += corners > 2 ? corners - 2 : 0;
+      } break;
+      default:
+        break;
+      }
+
+      line = stop;
+    }
+  }
+}
+
+internal const char *parse_corner(const char *p, const char *end,
+                                  const obj_parse *parse, uint32_t seen_v,
+                                  uint32_t seen_t, uint32_t seen_n,
+                                  obj_corner *corner) {
+  int64_t raw = 0;
+  p = parse_int(p, end, &raw);
+  if (not p) {
+    return NULL;
+  }
+  corner->v = resolve_index(raw, seen_v, parse->position_count);
+  corner->t = OBJ_MISSING;
+  corner->n = OBJ_MISSING;
+  if (corner->v == OBJ_MISSING) {
+    return NULL;
+  }
+
+  // v, v/t, v//n or v/t/n
+  if (p < end and *p == '/') {
+    ++p;
+    if (p < end and *p != '/') {
+      p = parse_int(p, end, &raw);
+      if (not p) {
+        return NULL;
+      }
+      corner->t = resolve_index(raw, seen_t, parse->uv_count);
+      if (corner->t == OBJ_MISSING) {
+        return NULL;
+      }
+    }
+    if (p < end and *p == '/') {
+      p = parse_int(p + 1, end, &raw);
+      if (not p) {
+        return NULL;
+      }
+      corner->n = resolve_index(raw, seen_n, parse->normal_count);
+      if (corner->n == OBJ_MISSING) {
+        return NULL;
+      }
+    }
+  }
+  return p;
+}
+
+internal void obj_parse_chunks(void *data, uint32_t start, uint32_t end) {
+  obj_parse *parse = data;
+  for (uint32_t c = start; c < end; ++c) {
+    obj_chunk *chunk = &parse->chunks[c];
+    float *positions = parse->positions + (size_t)chunk->position_base * 3;
+    float *uvs = parse->uvs + (size_t)chunk->uv_base * 2;
+    float *normals = parse->normals + (size_t)chunk->normal_base * 3;
+    obj_corner *corners = parse->corners + (size_t)chunk->triangle_base * 3;
+
+    uint32_t v = 0, t = 0, n = 0, tri = 0;
+    for (const char *line = chunk->begin; line < chunk->end and
+                                          not chunk->failed;) {
+      const char *stop = next_line(line, chunk->end);
+      const char *p = skip_spaces(line, stop);
+      char kind = line_kind(p, stop);
+
+      switch (kind) {
+      case 'v':
+        p += 1;
+        for (int k = 0; k < 3 and p; ++k) {
+          p = parse_float(p, stop, &positions[v * 3 + k]);
+        }
+        chunk->failed = not p;
+        ++v;
+        break;
+      case 't':
+        p += 2;
+        for (int k = 0; k < 2 and p; ++k) {
+          p = parse_float(p, stop, &uvs[t * 2 + k]);
+        }
+        chunk->failed = not p;
+        ++t;
+        break;
+      case 'n':
+        p += 2;
+        for (int k = 0; k < 3 and p; ++k) {
+          p = parse_float(p, stop, &normals[n * 3 + k]);
+        }
+        chunk->failed = not p;
+        ++n;
+        break;
+      case 'f': {
+        // relative indices count back from this line
+        uint32_t seen_v = chunk->position_base + v;
+        uint32_t seen_t = chunk->uv_base + t;
+        uint32_t seen_n = chunk->normal_base + n;
+
+        obj_corner first = {0}, previous = {0}, corner;
+        uint32_t count = 0;
+        for (p += 1; p and p < stop;) {
+          p = skip_spaces(p, stop);
+          if (p >= stop or *p == '\n') {
+            break;
+          }
+          p = parse_corner(p, stop, parse, seen_v, seen_t, seen_n, &corner);
+          if (not p) {
+            break;
+          }
+
+          if (count == 0) {
+            first = corner;
+          } else if (count >= 2) {
+            corners[tri * 3 + 0] = first;
+            corners[tri * 3 + 1] = previous;
+            corners[tri * 3 + 2] = corner;
+            ++tri;
+          }
+          previous = corner;
+          ++count;
+        }
+        chunk->failed = not p;
+      } break;
+      default:
+        break;
+      }
+
+      line = stop;
+    }
+
+    if (chunk->failed) {
+      fprintf(stderr, "ERROR: obj parse failed in bytes %zu..%zu\n",
+              (size_t)(chunk->begin - parse->chunks[0].begin),
+              (size_t)(chunk->end - parse->chunks[0].begin));
+    }
+  }
+}
+
+internal uint32_t hash_corner(const obj_corner *c) {
+  uint32_t h = (uint32_t)c->v * 0x9E3779B1u;
+  h ^= (uint32_t)c->t * 0x85EBCA77u;
+  h ^= (uint32_t)c->n * 0xC2B2AE3Du;
+  h ^= h >> 15;
+  h *= 0x2C1B3C6Du;
+  h ^= h >> 13;
+  return h;
+}
+
+/* merge identical corners into shared vertices and fill m */
+internal bool obj_build_mesh(mesh_data *m, const obj_parse *parse) {
+  uint32_t corner_count = parse->triangle_count * 3;
+
+  uint32_t table_size = 16;
+  while (table_size < corner_count * 2) {
+    table_size *= 2;
+  }
+  uint32_t *table = malloc(sizeof(*table) * table_size);
+  obj_corner *unique = malloc(sizeof(*unique) * (corner_count ? corner_count : 1));
+  uint8_t *missing = NULL;
+  if (not table or not unique or not mesh_alloc(m, 0, corner_count)) {
+    free(table);
+    free(unique);
+    return false;
+  }
+  memset(table, 0xFF, sizeof(*table) * table_size);
+
+  uint32_t vertex_count = 0;
+  for (uint32_t i = 0; i < corner_count; ++i) {
+    const obj_corner *c = &parse->corners[i];
+    uint32_t slot = hash_corner(c) & (table_size - 1);
+    for (;;) {
+      uint32_t idx = table[slot];
+      if (idx == UINT32_MAX) {
+        idx = vertex_count++;
+        unique[idx] = *c;
+        table[slot] = idx;
+      } else if (memcmp(&unique[idx], c, sizeof(*c)) != 0) {
+        slot = (slot + 1) & (table_size - 1);
+        continue;
+      }
+      m->indices[i] = idx;
+      break;
+    }
+  }
+  free(table);
+
+  mesh_vertex *vertices = calloc(vertex_count ? vertex_count : 1,
+                                 sizeof(*vertices));
+  missing = calloc(vertex_count ? vertex_count : 1, sizeof(*missing));
+  if (not vertices or not missing) {
+    free(vertices);
+    free(missing);
+    free(unique);
+    mesh_destroy(m);
+    return false;
+  }
+  free(m->vertices);
+  m->vertices = vertices;
+  m->vertex_count = vertex_count;
+
+  bool any_missing = false;
+  for (uint32_t i = 0; i < vertex_count; ++i) {
+    const obj_corner *c = &unique[i];
+    mesh_vertex *out = &m->vertices[i];
+    memcpy(out->position, parse->positions + (size_t)c->v * 3,
+           sizeof(out->position));
+    if (c->t != OBJ_MISSING) {
+      memcpy(out->uv, parse->uvs + (size_t)c->t * 2, sizeof(out->uv));
+    }
+    if (c->n != OBJ_MISSING) {
+      memcpy(out->normal, parse->normals + (size_t)c->n * 3,
+             sizeof(out->normal));
+    } else {
+      missing[i] = 1;
+      any_missing = true;
+    }
+  }
+
+  if (any_missing) {
+    mesh_generate_normals(m, missing);
+  }
+  mesh_compute_bounds(m);
+  mesh_single_lod(m);
+
+  free(missing);
+  free(unique);
+  return true;
+}
+
+bool mesh_import_obj(mesh_data *m, const char *path) {
+  memset(m, 0, sizeof(*m));
+
+  file_map map;
+  if (not file_map_open(&map, path)) {
+    fprintf(stderr, "ERROR: could not open %s\n", path);
+    return false;
+  }
+
+  obj_parse *parse = calloc(1, sizeof(*parse));
+  if (not parse) {
+    file_map_close(&map);
+    return false;
+  }
+
+  // a few chunks per thread, each ending on a line break
+  const char *text = map.data;
+  const char *text_end = text + map.size;
+  size_t chunk_size = map.size / ((size_t)jobs_thread_count() * 4) + 1;
+  if (chunk_size < OBJ_CHUNK_MIN) {
+    chunk_size = OBJ_CHUNK_MIN;
+  }
+  if (chunk_size < map.size / OBJ_MAX_CHUNKS + 1) {
+    chunk_size = map.size / OBJ_MAX_CHUNKS + 1;
+  }
+  for (const char *p = text; p < text_end;) {
+    assert(parse->chunk_count < OBJ_MAX_CHUNKS);
+    obj_chunk *chunk = &parse->chunks[parse->chunk_count++];
+    chunk->begin = p;
+    p = (size_t)(text_end - p) > chunk_size ? next_line(p + chunk_size, text_end)
+                                            : text_end;
+    chunk->end = p;
+  }
+
+  // first pass counts so the second writes straight into final arrays
+  parallel_for(parse->chunk_count, 1, obj_count_chunks, parse);
+  for (uint32_t c = 0; c < parse->chunk_count; ++c) {
+    obj_chunk *chunk = &parse->chunks[c];
+    chunk->position_base = parse->position_count;
+    chunk->uv_base = parse->uv_count;
+    chunk->normal_base = parse->normal_count;
+    chunk->triangle_base = parse->triangle_count;
+    parse->position_count += chunk->positions;
+    parse->uv_count += chunk->uvs;
+    parse->normal_count += chunk->normals;
+    parse->triangle_count += chunk->triangles;
+  }
+
+  bool ok = false;
+  parse->positions = malloc(sizeof(float) * 3 * (parse->position_count + 1));
+  parse->uvs = malloc(sizeof(float) * 2 * (parse->uv_count + 1));
+  parse->normals = malloc(sizeof(float) * 3 * (parse->normal_count + 1));
+  parse->corners =
+      malloc(sizeof(obj_corner) * 3 * ((size_t)parse->triangle_count + 1));
+  if (parse->positions and parse->uvs and parse->normals and parse->corners) {
+    parallel_for(parse->chunk_count, 1, obj_parse_chunks, parse);
+
+    ok = true;
+    for (uint32_t c = 0; c < parse->chunk_count; ++c) {
+      ok = ok and not parse->chunks[c].failed;
+    }
+    ok = ok and obj_build_mesh(m, parse);
+  } else {
+    fprintf(stderr, "ERROR: out of memory importing %s\n", path);
+  }
+
+  free(parse->positions);
+  free(parse->uvs);
+  free(parse->normals);
+  free(parse->corners);
+  free(parse);
+  file_map_close(&map);
+  return ok;
+}
+
+/* GLB */
+
+struct glb_accessor {
+  const uint8_t *data;
+  uint32_t count;
+  uint32_t stride;
+  uint32_t component_type;
+};
+typedef struct glb_accessor glb_accessor;
+
+internal uint32_t read_u32(const uint8_t *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+internal uint32_t component_size(uint32_t component_type) {
+  switch (component_type) {
+  case GLTF_UNSIGNED_BYTE:
+    return 1;
+  case GLTF_UNSIGNED_SHORT:
+    return 2;
+  case GLTF_UNSIGNED_INT:
+  case GLTF_FLOAT:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+internal uint32_t type_components(const json_doc *doc, int type) {
+  if (json_string_equals(doc, type, "SCALAR")) {
+    return 1;
+  }
+  if (json_string_equals(doc, type, "VEC2")) {
+    return 2;
+  }
+  if (json_string_equals(doc, type, "VEC3")) {
+    return 3;
+  }
+  if (json_string_equals(doc, type, "VEC4")) {
+    return 4;
+  }
+  return 0;
+}
+
+/* resolve accessor index into a pointer into the bin chunk */
+internal bool glb_get_accessor(const json_doc *doc, int index,
+                               uint32_t components, const uint8_t *bin,
+                               size_t bin_size, glb_accessor *out) {
+  int accessor = json_at(doc, json_get(doc, 0, "accessors"), (uint32_t)index);
+  int view_index = (int)json_number(doc, json_get(doc, accessor, "bufferView"), -1);
+  int view = json_at(doc, json_get(doc, 0, "bufferViews"), (uint32_t)view_index);
+  if (accessor == JSON_NONE or view == JSON_NONE or
+      json_number(doc, json_get(doc, view, "buffer"), 0) != 0 or
+      type_components(doc, json_get(doc, accessor, "type")) != components) {
+    return false;
+  }
+
+  out->component_type =
+      (uint32_t)json_number(doc, json_get(doc, accessor, "componentType"), 0);
+  out->count = (uint32_t)json_number(doc, json_get(doc, accessor, "count"), 0);
+  uint32_t element = component_size(out->component_type) * components;
+  if (element == 0) {
+    return false;
+  }
+
+  uint64_t view_offset =
+      (uint64_t)json_number(doc, json_get(doc, view, "byteOffset"), 0);
+  uint64_t view_length =
+      (uint64_t)json_number(doc, json_get(doc, view, "byteLength"), 0);
+  uint64_t offset =
+      (uint64_t)json_number(doc, json_get(doc, accessor, "byteOffset"), 0);
+  out->stride = (uint32_t)json_number(doc, json_get(doc, view, "byteStride"),
+                                      element);
+
+  // every element must sit inside the view and the view inside the chunk
+  uint64_t used = out->count > 0
+                      ? offset + (uint64_t)(out->count - 1) * out->stride + element
+                      : 0;
+  if (view_offset + view_length > bin_size or used > view_length) {
+    return false;
+  }
+
+  out->data = bin + view_offset + offset;
+  return true;
+}
+
+internal void read_floats(const glb_accessor *a, uint32_t i, float *out,
+                          uint32_t n) {
+  memcpy(out, a->data + (size_t)i * a->stride, sizeof(float) * n);
+}
+
+internal uint32_t read_index(const glb_accessor *a, uint32_t i) {
+  const uint8_t *p = a->data + (size_t)i * a->stride;
+  switch (a->component_type) {
+  case GLTF_UNSIGNED_BYTE:
+    return *p;
+  case GLTF_UNSIGNED_SHORT: {
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+  }
+  default:
+    return read_u32(p);
+  }
+}
+
+bool mesh_import_glb(mesh_data *m, const char *path) {
+  memset(m, 0, sizeof(*m));
+
+  file_map map;
+  if (not file_map_open(&map, path)) {
+    fprintf(stderr, "ERROR: could not open %s\n", path);
+    return false;
+  }
+
+  // | header 12 | json chunk | bin chunk |, chunks are | length | type |
+  const uint8_t *bytes = map.data;
+  if (map.size < 20 or read_u32(bytes) != GLB_MAGIC or
+      read_u32(bytes + 4) != 2 or read_u32(bytes + 16) != GLB_CHUNK_JSON) {
+    fprintf(stderr, "ERROR: %s is not a gltf 2.0 binary\n", path);
+    file_map_close(&map);
+    return false;
+  }
+
+  uint64_t json_size = read_u32(bytes + 12);
+  const uint8_t *bin = NULL;
+  size_t bin_size = 0;
+  uint64_t bin_header = 20 + align_up(json_size, 4);
+  if (20 + json_size > map.size) {
+    fprintf(stderr, "ERROR: %s json chunk is truncated\n", path);
+    file_map_close(&map);
+    return false;
+  }
+  if (bin_header + 8 <= map.size and
+      read_u32(bytes + bin_header + 4) == GLB_CHUNK_BIN) {
+    bin = bytes + bin_header + 8;
+    bin_size = read_u32(bytes + bin_header);
+    if (bin_header + 8 + bin_size > map.size) {
+      bin_size = 0;
+    }
+  }
+
+  json_doc doc;
+  if (not json_parse(&doc, (const char *)bytes + 20, (size_t)json_size)) {
+    fprintf(stderr, "ERROR: %s has invalid json\n", path);
+    file_map_close(&map);
+    return false;
+  }
+
+  bool ok = false;
+  int mesh = json_at(&doc, json_get(&doc, 0, "meshes"), 0);
+  int primitive = json_at(&doc, json_get(&doc, mesh, "primitives"), 0);
+  int attributes = json_get(&doc, primitive, "attributes");
+  int position = (int)json_number(&doc, json_get(&doc, attributes, "POSITION"), -1);
+  int normal = (int)json_number(&doc, json_get(&doc, attributes, "NORMAL"), -1);
+  int uv = (int)json_number(&doc, json_get(&doc, attributes, "TEXCOORD_0"), -1);
+  int index = (int)json_number(&doc, json_get(&doc, primitive, "indices"), -1);
+  int mode = (int)json_number(&doc, json_get(&doc, primitive, "mode"),
+                              GLTF_TRIANGLES);
+
+  glb_accessor positions, normals, uvs, indices;
+  bool has_normals = normal >= 0 and
+                     glb_get_accessor(&doc, normal, 3, bin, bin_size, &normals) and
+                     normals.component_type == GLTF_FLOAT;
+  bool has_uvs = uv >= 0 and glb_get_accessor(&doc, uv, 2, bin, bin_size, &uvs) and
+                 uvs.component_type == GLTF_FLOAT;
+  bool has_indices =
+      index >= 0 and glb_get_accessor(&doc, index, 1, bin, bin_size, &indices);
+
+  if (mode != GLTF_TRIANGLES or position < 0 or
+      not glb_get_accessor(&doc, position, 3, bin, bin_size, &positions) or
+      positions.component_type != GLTF_FLOAT or
+      (index >= 0 and not has_indices) or
+      (has_indices and indices.component_type == GLTF_FLOAT)) {
+    fprintf(stderr, "ERROR: %s has no supported triangle primitive\n", path);
+  } else if (not mesh_alloc(m, positions.count,
+                            has_indices ? indices.count : positions.count)) {
+    fprintf(stderr, "ERROR: out of memory importing %s\n", path);
+  } else {
+    ok = true;
+    for (uint32_t i = 0; i < m->vertex_count; ++i) {
+      mesh_vertex *v = &m->vertices[i];
+      read_floats(&positions, i, v->position, 3);
+      if (has_normals and i < normals.count) {
+        read_floats(&normals, i, v->normal, 3);
+      }
+      if (has_uvs and i < uvs.count) {
+        read_floats(&uvs, i, v->uv, 2);
+        // gltf has v pointing down the image, obj and gl up
+        v->uv[1] = 1.0f - v->uv[1];
+      }
+    }
+    for (uint32_t i = 0; i < m->index_count and ok; ++i) {
+      m->indices[i] = has_indices ? read_index(&indices, i) : i;
+      ok = m->indices[i] < m->vertex_count;
+    }
+    // drop a trailing partial triangle
+    m->index_count -= m->index_count % 3;
+
+    if (not ok) {
+      fprintf(stderr, "ERROR: %s has indices out of range\n", path);
+      mesh_destroy(m);
+    } else {
+      if (not has_normals) {
+        mesh_generate_normals(m, NULL);
+      }
+      mesh_compute_bounds(m);
+      mesh_single_lod(m);
+    }
+  }
+
+  json_destroy(&doc);
+  file_map_close(&map);
+  return ok;
+}
+
+bool mesh_import(mesh_data *m, const char *path) {
+  const char *dot = strrchr(path, '.');
+  if (dot and (strcmp(dot, ".glb") == 0 or strcmp(dot, ".GLB") == 0)) {
+    return mesh_import_glb(m, path);
+  }
+  return mesh_import_obj(m, path);
+}
+
+/* LOD */
+
+/* *
+ * symmetric 4x4 plane quadric, upper triangle of sum w * p p^T for planes
+ * p = (a, b, c, d), weight sums w so errors can be averaged
+ * */
+struct quadric {
+  double q[10];
+  double weight;
+};
+typedef struct quadric quadric;
+
+/* a collapse of vertex from into vertex to */
+struct lod_collapse {
+  uint32_t from;
+  uint32_t to;
+  float cost;
+};
+typedef struct lod_collapse lod_collapse;
+
+/* *
+ * working state of mesh_build_lods, indices shrinks as vertices collapse.
+ * quadrics and positions are per welded position, vertices that share a
+ * position are locked so only vertices alone at theirs ever move
+ * */
+struct lod_builder {
+  const mesh_data *m;
+  uint32_t *indices;
+  uint32_t index_count;
+
+  uint32_t *position_of;
+  uint32_t position_count;
+  quadric *quadrics;
+  uint8_t *locked;
+  uint32_t *remap;
+
+  // vertex to triangle fans, rebuilt every pass
+  uint32_t *fan_offsets;
+  uint32_t *fan_triangles;
+  uint8_t *touched;
+  lod_collapse *collapses;
+};
+typedef struct lod_builder lod_builder;
+
+internal void quadric_add(quadric *q, const quadric *other) {
+  for (int i = 0; i < 10; ++i) {
+    q->q[i] += other->q[i];
+  }
+  q->weight += other->weight;
+}
+
+internal void quadric_add_plane(quadric *q, double a, double b, double c,
+                                double d, double w) {
+  double p[4] = {a, b, c, d};
+  int k = 0;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = i; j < 4; ++j) {
+      q->q[k++] += w * p[i] * p[j];
+    }
+  }
+  q->weight += w;
+}
+
+/* mean squared distance of p from the planes in q */
+internal double quadric_error(const quadric *q, const float p[3]) {
+  double v[4] = {p[0], p[1], p[2], 1.0};
+  double sum = 0.0;
+  int k = 0;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = i; j < 4; ++j) {
+      sum += (i == j ? 1.0 : 2.0) * q->q[k++] * v[i] * v[j];
+    }
+  }
+  return q->weight > 0.0 ? fabs(sum) / q->weight : 0.0;
+}
+
+internal uint32_t hash_bytes(const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+internal const float *lod_position(const lod_builder *b, uint32_t vertex) {
+  return b->m->vertices[vertex].position;
+}
+
+internal vec3 triangle_normal(const float *p0, const float *p1,
+                              const float *p2) {
+  vec3 a = vec3_new(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]);
+  vec3 c = vec3_new(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]);
+  return vec3_cross(&a, &c);
+}
+
+/* *
+ * weld equal positions, then lock vertices sharing one with another
+ * vertex (seams) or sitting on an edge used by a single triangle (borders)
+ * */
+internal bool lod_weld(lod_builder *b) {
+  const mesh_data *m = b->m;
+  uint32_t table_size = 16;
+  while (table_size < m->vertex_count * 2 or table_size < m->index_count * 2) {
+    table_size *= 2;
+  }
+  uint32_t *table = malloc(sizeof(*table) * table_size);
+  uint32_t *first = malloc(sizeof(*first) * (m->vertex_count + 1));
+  uint32_t *shared = calloc(m->vertex_count + 1, sizeof(*shared));
+  uint64_t *edges = malloc(sizeof(*edges) * table_size);
+  uint32_t *edge_uses = malloc(sizeof(*edge_uses) * table_size);
+  if (not table or not first or not shared or not edges or not edge_uses) {
+    free(table);
+    free(first);
+    free(shared);
+    free(edges);
+    free(edge_uses);
+    return false;
+  }
+
+  memset(table, 0xFF, sizeof(*table) * table_size);
+  b->position_count = 0;
+  for (uint32_t v = 0; v < m->vertex_count; ++v) {
+    const float *p = m->vertices[v].position;
+    uint32_t slot = hash_bytes(p, sizeof(float) * 3) & (table_size - 1);
+    for (;;) {
+      uint32_t id = table[slot];
+      if (id == UINT32_MAX) {
+        id = b->position_count++;
+        first[id] = v;
+        table[slot] = id;
+      } else if (memcmp(m->vertices[first[id]].position, p,
+                        sizeof(float) * 3) != 0) {
+        slot = (slot + 1) & (table_size - 1);
+        continue;
+      }
+      b->position_of[v] = id;
+      ++shared[id];
+      break;
+    }
+  }
+
+  // welded edges and how many triangles use each
+  memset(edges, 0xFF, sizeof(*edges) * table_size);
+  memset(edge_uses, 0, sizeof(*edge_uses) * table_size);
+  for (uint32_t i = 0; i < m->index_count; ++i) {
+    uint32_t a = b->position_of[m->indices[i]];
+    uint32_t c = b->position_of[m->indices[i % 3 == 2 ? i - 2 : i + 1]];
+    uint64_t key = a < c ? (uint64_t)a << 32 | c : (uint64_t)c << 32 | a;
+    uint32_t slot = hash_bytes(&key, sizeof(key)) & (table_size - 1);
+    while (edges[slot] != UINT64_MAX and edges[slot] != key) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+    edges[slot] = key;
+    ++edge_uses[slot];
+  }
+  for (uint32_t slot = 0; slot < table_size; ++slot) {
+    if (edges[slot] != UINT64_MAX and edge_uses[slot] == 1) {
+      // a count that can never be 1, so border positions lock too
+      shared[edges[slot] >> 32] = UINT32_MAX;
+      shared[edges[slot] & UINT32_MAX] = UINT32_MAX;
+    }
+  }
+  for (uint32_t v = 0; v < m->vertex_count; ++v) {
+    b->locked[v] = shared[b->position_of[v]] != 1;
+  }
+
+  free(table);
+  free(first);
+  free(shared);
+  free(edges);
+  free(edge_uses);
+  return true;
+}
+
+/* area weighted planes of every triangle, summed per welded position */
+internal void lod_quadrics(lod_builder *b) {
+  const mesh_data *m = b->m;
+  memset(b->quadrics, 0, sizeof(*b->quadrics) * b->position_count);
+  for (uint32_t i = 0; i + 2 < m->index_count; i += 3) {
+    const float *p0 = lod_position(b, m->indices[i]);
+    const float *p1 = lod_position(b, m->indices[i + 1]);
+    const float *p2 = lod_position(b, m->indices[i + 2]);
+    vec3 n = triangle_normal(p0, p1, p2);
+    float length = vec3_len(&n);
+    if (length <= 0.0f) {
+      continue;
+    }
+    double area = length * 0.5;
+    double a = n.x / length, bn = n.y / length, c = n.z / length;
+    double d = -(a * p0[0] + bn * p0[1] + c * p0[2]);
+    for (int k = 0; k < 3; ++k) {
+      quadric *q = &b->quadrics[b->position_of[m->indices[i + k]]];
+      quadric_add_plane(q, a, bn, c, d, area);
+    }
+  }
+}
+
+/* triangles around each vertex of the current index list */
+internal void lod_fans(lod_builder *b) {
+  uint32_t vertex_count = b->m->vertex_count;
+  memset(b->fan_offsets, 0, sizeof(*b->fan_offsets) * (vertex_count + 1));
+  for (uint32_t i = 0; i < b->index_count; ++i) {
+    ++b->fan_offsets[b->indices[i] + 1];
+  }
+  for (uint32_t v = 0; v < vertex_count; ++v) {
+    b->fan_offsets[v + 1] += b->fan_offsets[v];
+  }
+  for (uint32_t i = 0; i < b->index_count; ++i) {
+    uint32_t v = b->indices[i];
+    // offsets are shifted back by one while filling
+    b->fan_triangles[b->fan_offsets[v]++] = i / 3;
+  }
+  for (uint32_t v = vertex_count; v > 0; --v) {
+    b->fan_offsets[v] = b->fan_offsets[v - 1];
+  }
+  b->fan_offsets[0] = 0;
+}
+
+/* true if moving from onto to keeps every remaining triangle facing out */
+internal bool lod_keeps_winding(const lod_builder *b, uint32_t from,
+                                uint32_t to) {
+  const float *target = lod_position(b, to);
+  for (uint32_t f = b->fan_offsets[from]; f < b->fan_offsets[from + 1]; ++f) {
+    const uint32_t *tri = b->indices + b->fan_triangles[f] * 3;
+    if (tri[0] == to or tri[1] == to or tri[2] == to) {
+      continue;
+    }
+    const float *before[3];
+    const float *after[3];
+    for (int k = 0; k < 3; ++k) {
+      before[k] = lod_position(b, tri[k]);
+      after[k] = tri[k] == from ? target : before[k];
+    }
+    vec3 n0 = triangle_normal(before[0], before[1], before[2]);
+    vec3 n1 = triangle_normal(after[0], after[1], after[2]);
+    if (vec3_dot(&n0, &n1) <= 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+internal int compare_collapse(const void *lhs, const void *rhs) {
+  const lod_collapse *a = lhs;
+  const lod_collapse *b = rhs;
+  return (a->cost > b->cost) - (a->cost < b->cost);
+}
+
+/* *
+ * collapse the cheapest edges until target indices remain, every vertex
+ * moves at most once per pass. error is the largest squared error taken
+ * so far, returns it updated
+ * */
+internal float lod_simplify(lod_builder *b, uint32_t target, float max_error,
+                            float error) {
+  uint32_t vertex_count = b->m->vertex_count;
+  float max_cost = max_error * max_error;
+
+  while (b->index_count > target) {
+    lod_fans(b);
+
+    // both directions of every edge whose start may move
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < b->index_count; ++i) {
+      uint32_t from = b->indices[i];
+      uint32_t to = b->indices[i % 3 == 2 ? i - 2 : i + 1];
+      for (int dir = 0; dir < 2; ++dir) {
+        if (not b->locked[from]) {
+          quadric q = b->quadrics[b->position_of[from]];
+          quadric_add(&q, &b->quadrics[b->position_of[to]]);
+          float cost = (float)quadric_error(&q, lod_position(b, to));
+          if (cost <= max_cost) {
+            b->collapses[count++] =
+                (lod_collapse){.from = from, .to = to, .cost = cost};
+          }
+        }
+        uint32_t swap = from;
+        from = to;
+        to = swap;
+      }
+    }
+    if (count == 0) {
+      break;
+    }
+    qsort(b->collapses, count, sizeof(*b->collapses), compare_collapse);
+
+    memset(b->touched, 0, vertex_count);
+    uint32_t remaining = b->index_count / 3;
+    uint32_t collapsed = 0;
+    for (uint32_t c = 0; c < count and remaining * 3 > target; ++c) {
+      const lod_collapse *col = &b->collapses[c];
+      if (b->touched[col->from] or b->touched[col->to] or
+          not lod_keeps_winding(b, col->from, col->to)) {
+        continue;
+      }
+
+      // the fan of from changes shape, keep its other vertices still
+      for (uint32_t f = b->fan_offsets[col->from];
+           f < b->fan_offsets[col->from + 1]; ++f) {
+        const uint32_t *tri = b->indices + b->fan_triangles[f] * 3;
+        for (int k = 0; k < 3; ++k) {
+          b->touched[tri[k]] = 1;
+        }
+        remaining -= tri[0] == col->to or tri[1] == col->to or
+                     tri[2] == col->to;
+      }
+      b->remap[col->from] = col->to;
+      quadric_add(&b->quadrics[b->position_of[col->to]],
+                  &b->quadrics[b->position_of[col->from]]);
+      error = col->cost > error ? col->cost : error;
+      ++collapsed;
+    }
+    if (collapsed == 0) {
+      break;
+    }
+
+    // move indices onto their targets and drop collapsed triangles
+    uint32_t out = 0;
+    for (uint32_t i = 0; i + 2 < b->index_count; i += 3) {
+      uint32_t tri[3];
+      for (int k = 0; k < 3; ++k) {
+        tri[k] = b->remap[b->indices[i + k]];
+      }
+      uint32_t p0 = b->position_of[tri[0]];
+      uint32_t p1 = b->position_of[tri[1]];
+      uint32_t p2 = b->position_of[tri[2]];
+      if (p0 == p1 or p1 == p2 or p0 == p2) {
+        continue;
+      }
+      memcpy(b->indices + out, tri, sizeof(tri));
+      out += 3;
+    }
+    b->index_count = out;
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+      b->remap[v] = v;
+    }
+  }
+  return error;
+}
+
+internal void lod_builder_destroy(lod_builder *b) {
+  free(b->indices);
+  free(b->position_of);
+  free(b->quadrics);
+  free(b->locked);
+  free(b->remap);
+  free(b->fan_offsets);
+  free(b->fan_triangles);
+  free(b->touched);
+  free(b->collapses);
+  memset(b, 0, sizeof(*b));
+}
+
+internal bool lod_builder_init(lod_builder *b, const mesh_data *m) {
+  memset(b, 0, sizeof(*b));
+  b->m = m;
+  size_t vertices = m->vertex_count ? m->vertex_count : 1;
+  size_t indices = m->lods[0].index_count ? m->lods[0].index_count : 1;
+  b->indices = malloc(sizeof(*b->indices) * indices);
+  b->position_of = malloc(sizeof(*b->position_of) * vertices);
+  b->quadrics = malloc(sizeof(*b->quadrics) * vertices);
+  b->locked = malloc(vertices);
+  b->remap = malloc(sizeof(*b->remap) * vertices);
+  b->fan_offsets = malloc(sizeof(*b->fan_offsets) * (vertices + 1));
+  b->fan_triangles = malloc(sizeof(*b->fan_triangles) * indices);
+  b->touched = malloc(vertices);
+  b->collapses = malloc(sizeof(*b->collapses) * indices * 2);
+  if (not b->indices or not b->position_of or not b->quadrics or
+      not b->locked or not b->remap or not b->fan_offsets or
+      not b->fan_triangles or not b->touched or not b->collapses or
+      not lod_weld(b)) {
+    lod_builder_destroy(b);
+    return false;
+  }
+
+  memcpy(b->indices, m->indices, sizeof(*b->indices) * m->lods[0].index_count);
+  b->index_count = m->lods[0].index_count;
+  for (uint32_t v = 0; v < m->vertex_count; ++v) {
+    b->remap[v] = v;
+  }
+  lod_quadrics(b);
+  return true;
+}
+
+uint32_t mesh_build_lods(mesh_data *m, float max_error) {
+  assert(not m->mapped);
+  mesh_single_lod(m);
+
+  lod_builder b;
+  if (not lod_builder_init(&b, m)) {
+    fprintf(stderr, "ERROR: out of memory building mesh lods\n");
+    return m->lod_count;
+  }
+
+  // levels are simplified from the one before, errors only grow
+  uint32_t *levels[MESH_MAX_LODS] = {0};
+  float cost = 0.0f;
+  while (m->lod_count < MESH_MAX_LODS) {
+    uint32_t previous = m->lods[m->lod_count - 1].index_count;
+    uint32_t target = previous / 6 * 3;
+    cost = lod_simplify(&b, target, max_error, cost);
+    if (b.index_count == 0 or b.index_count > previous - previous / 5) {
+      break;
+    }
+
+    uint32_t *level = malloc(sizeof(*level) * b.index_count);
+    if (not level) {
+      break;
+    }
+    memcpy(level, b.indices, sizeof(*level) * b.index_count);
+    levels[m->lod_count] = level;
+    m->lods[m->lod_count] = (mesh_lod){
+        .first_index = m->lods[m->lod_count - 1].first_index + previous,
+        .index_count = b.index_count,
+        .error = sqrtf(cost),
+    };
+    ++m->lod_count;
+  }
+  lod_builder_destroy(&b);
+
+  // append the levels after the full index list
+  const mesh_lod *last = &m->lods[m->lod_count - 1];
+  uint32_t total = last->first_index + last->index_count;
+  uint32_t *indices = realloc(m->indices, sizeof(*indices) * total);
+  if (not indices) {
+    fprintf(stderr, "ERROR: out of memory building mesh lods\n");
+    for (uint32_t i = 1; i < m->lod_count; ++i) {
+      free(levels[i]);
+    }
+    mesh_single_lod(m);
+    return m->lod_count;
+  }
+  for (uint32_t i = 1; i < m->lod_count; ++i) {
+    memcpy(indices + m->lods[i].first_index, levels[i],
+           sizeof(*indices) * m->lods[i].index_count);
+    free(levels[i]);
+  }
+  m->indices = indices;
+  m->index_count = total;
+  return m->lod_count;
+}
+
+uint32_t mesh_select_lod(const mesh_lod *lods, uint32_t lod_count,
+                         float pixels_per_unit, float max_pixels,
+                         float hysteresis, uint32_t current) {
+  assert(lod_count > 0);
+  if (current >= lod_count) {
+    current = lod_count - 1;
+  }
+
+  // coarser levels need to clear the threshold by the margin, the
+  // current one is kept until it misses it by the margin
+  float coarser = max_pixels * (1.0f - hysteresis);
+  float keep = max_pixels * (1.0f + hysteresis);
+  uint32_t level = current;
+  while (level > 0 and lods[level].error * pixels_per_unit > keep) {
+    --level;
+  }
+  while (level + 1 < lod_count and
+         lods[level + 1].error * pixels_per_unit <= coarser) {
+    ++level;
+  }
+  return level;
+}
+
+/* CACHE */
+
+bool mesh_cache_write(const mesh_data *m, const char *cache_path,
+                      const file_info *source) {
+  mesh_cache_header header = {
+      .magic = {'M', 'E', 'S', 'H'},
+      .version = MESH_CACHE_VERSION,
+      .vertex_size = sizeof(mesh_vertex),
+      .vertex_count = m->vertex_count,
+      .index_count = m->index_count,
+      .lod_count = m->lod_count,
+      .source_size = source ? source->size : 0,
+      .source_modified = source ? source->modified : 0,
+      .bounds_min = {m->bounds.min.x, m->bounds.min.y, m->bounds.min.z},
+      .bounds_max = {m->bounds.max.x, m->bounds.max.y, m->bounds.max.z},
+  };
+  memcpy(header.lods, m->lods, sizeof(header.lods));
+  uint64_t vertex_bytes = sizeof(mesh_vertex) * (uint64_t)m->vertex_count;
+  header.vertex_offset = sizeof(header);
+  header.index_offset =
+      align_up(header.vertex_offset + vertex_bytes, CACHE_ALIGN);
+
+  FILE *fp = fopen(cache_path, "wb");
+  if (not fp) {
+    fprintf(stderr, "ERROR: could not write %s\n", cache_path);
+    return false;
+  }
+
+  local_persist const uint8_t zeros[CACHE_ALIGN] = {0};
+  size_t pad = (size_t)(header.index_offset - header.vertex_offset -
+                        vertex_bytes);
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 and
+            fwrite(m->vertices, 1, (size_t)vertex_bytes, fp) == vertex_bytes and
+            fwrite(zeros, 1, pad, fp) == pad and
+            fwrite(m->indices, sizeof(*m->indices), m->index_count, fp) ==
+                m->index_count;
+  ok = fclose(fp) == 0 and ok;
+
+  if (not ok) {
+    fprintf(stderr, "ERROR: failed writing %s\n", cache_path);
+    remove(cache_path);
+  }
+  return ok;
+}
+
+bool mesh_cache_load(mesh_data *m, const char *cache_path,
+                     const file_info *source) {
+  memset(m, 0, sizeof(*m));
+
+  file_map map;
+  if (not file_map_open(&map, cache_path)) {
+    return false;
+  }
+
+  mesh_cache_header header;
+  bool ok = map.size >= sizeof(header);
+  if (ok) {
+    memcpy(&header, map.data, sizeof(header));
+    ok = memcmp(header.magic, "MESH", 4) == 0 and
+         header.version == MESH_CACHE_VERSION and
+         header.vertex_size == sizeof(mesh_vertex) and
+         header.vertex_offset % CACHE_ALIGN == 0 and
+         header.index_offset % CACHE_ALIGN == 0 and
+         header.vertex_offset <= map.size and
+         header.index_offset <= map.size and header.lod_count > 0 and
+         header.lod_count <= MESH_MAX_LODS;
+  }
+  // both offsets are inside the file, adding the counts can not wrap
+  if (ok) {
+    uint64_t vertex_end = header.vertex_offset +
+                          (uint64_t)header.vertex_count * sizeof(mesh_vertex);
+    uint64_t index_end = header.index_offset +
+                         (uint64_t)header.index_count * sizeof(uint32_t);
+    ok = vertex_end <= map.size and index_end <= map.size and
+         header.index_offset >= vertex_end;
+  }
+  for (uint32_t i = 0; ok and i < header.lod_count; ++i) {
+    const mesh_lod *lod = &header.lods[i];
+    ok = lod->first_index <= header.index_count and
+         lod->index_count <= header.index_count - lod->first_index;
+  }
+  // stale when the source changed since the cache was written
+  if (ok and source) {
+    ok = header.source_size == source->size and
+         header.source_modified == source->modified;
+  }
+  if (not ok) {
+    file_map_close(&map);
+    return false;
+  }
+
+  const uint8_t *bytes = map.data;
+  m->vertices = (mesh_vertex *)(bytes + header.vertex_offset);
+  m->vertex_count = header.vertex_count;
+  m->indices = (uint32_t *)(bytes + header.index_offset);
+  m->index_count = header.index_count;
+  vec3 min = vec3_new(header.bounds_min[0], header.bounds_min[1],
+                      header.bounds_min[2]);
+  vec3 max = vec3_new(header.bounds_max[0], header.bounds_max[1],
+                      header.bounds_max[2]);
+  m->bounds = aabb_new(&min, &max);
+  memcpy(m->lods, header.lods, sizeof(m->lods));
+  m->lod_count = header.lod_count;
+  m->map = map;
+  m->mapped = true;
+  return true;
+}
+
+bool mesh_load(mesh_data *m, const char *path, const char *cache_path,
+               mesh_load_stats *stats) {
+  mesh_load_stats local = {0};
+
+  // a cache shipped without its source is used as is
+  file_info source;
+  bool has_source = file_info_get(path, &source);
+
+  double start = pacer_now_ms();
+  if (mesh_cache_load(m, cache_path, has_source ? &source : NULL)) {
+    local.from_cache = true;
+    local.cache_load_ms = pacer_now_ms() - start;
+  } else if (not has_source) {
+    fprintf(stderr, "ERROR: no mesh at %s or cache at %s\n", path,
+            cache_path);
+    return false;
+  } else {
+    if (not mesh_import(m, path)) {
+      return false;
+    }
+    local.import_ms = pacer_now_ms() - start;
+
+    start = pacer_now_ms();
+    vec3 extent = vec3_sub(&m->bounds.max, &m->bounds.min);
+    mesh_build_lods(m, vec3_len(&extent) * MESH_LOD_MAX_ERROR);
+    local.lod_ms = pacer_now_ms() - start;
+
+    start = pacer_now_ms();
+    bool written = mesh_cache_write(m, cache_path, &source);
+    local.cache_write_ms = pacer_now_ms() - start;
+
+    // use the fresh cache so both paths upload the same mapped data
+    mesh_data cached;
+    start = pacer_now_ms();
+    if (written and mesh_cache_load(&cached, cache_path, &source)) {
+      local.cache_load_ms = pacer_now_ms() - start;
+      mesh_destroy(m);
+      *m = cached;
+    }
+  }
+
+  if (stats) {
+    *stats = local;
+  }
+  return true;
+}
+
+void mesh_destroy(mesh_data *m) {
+  if (m->mapped) {
+    file_map_close(&m->map);
+  } else {
+    free(m->vertices);
+    free(m->indices);
+  }
+  memset(m, 0, sizeof(*m));
+}
+
+uint32_t mesh_remap_uvs(mesh_data *m, const float transform[4]) {
+  assert(not m->mapped);
+  uint32_t clamped = 0;
+  for (uint32_t i = 0; i < m->vertex_count; ++i) {
+    float *uv = m->vertices[i].uv;
+    for (int c = 0; c < 2; ++c) {
+      float value = uv[c];
+      if (value < 0.0f or value > 1.0f) {
+        value = value < 0.0f ? 0.0f : 1.0f;
+        ++clamped;
+      }
+      uv[c] = value * transform[c] + transform[c + 2];
+    }
+  }
+  return clamped;
+}
+
+/* GL */
+
+void mesh_upload(const mesh_data *m, GLuint vbo, GLuint ebo) {
+  // mapped caches go straight from the page cache to the driver
+  glstate_bind_buffer(GL_ARRAY_BUFFER, vbo);
+  glad_glBufferData(GL_ARRAY_BUFFER,
+                    sizeof(*m->vertices) * (GLsizeiptr)m->vertex_count,
+                    m->vertices, GL_STATIC_DRAW);
+
+  glstate_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+  glad_glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                    sizeof(*m->indices) * (GLsizeiptr)m->index_count,
+                    m->indices, GL_STATIC_DRAW);
+}
+
+void mesh_bind_attributes(GLuint vbo, GLuint position, GLuint normal,
+                          GLuint uv) {
+  GLsizei stride = sizeof(mesh_vertex);
+  glstate_bind_buffer(GL_ARRAY_BUFFER, vbo);
+
+  glad_glEnableVertexAttribArray(position);
+  glad_glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE, stride,
+                             (void *)offsetof(mesh_vertex, position));
+  glad_glEnableVertexAttribArray(normal);
+  glad_glVertexAttribPointer(normal, 3, GL_FLOAT, GL_FALSE, stride,
+                             (void *)offsetof(mesh_vertex, normal));
+  glad_glEnableVertexAttribArray(uv);
+  glad_glVertexAttribPointer(uv, 2, GL_FLOAT, GL_FALSE, stride,
+                             (void *)offsetof(mesh_vertex, uv));
+}
@@ -0,0 +1,134 @@
+#ifndef _MESH_H_
+#define _MESH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "glad/glad.h"
+
+#include "filemap.h"
+#include "frustum.h"
+
+// bump whenever mesh_vertex or the cache layout changes
+#define MESH_CACHE_VERSION 2
+// full detail plus up to three simplified levels
+#define MESH_MAX_LODS 4
+// simplification stops once the surface would move by this fraction of
+// the bounds diagonal
+#define MESH_LOD_MAX_ERROR 0.02f
+
+struct mesh_vertex {
+  float position[3];
+  float normal[3];
+  float uv[2];
+};
+typedef struct mesh_vertex mesh_vertex;
+
+/* *
+ * range of indices drawing one level of detail, error is how far the
+ * surface moved from the full mesh in mesh units
+ * */
+struct mesh_lod {
+  uint32_t first_index;
+  uint32_t index_count;
+  float error;
+};
+typedef struct mesh_lod mesh_lod;
+
+/* *
+ * indexed triangle list
+ *
+ * imported meshes own their arrays, meshes loaded from a cache point
+ * straight into the mapped file and must not be written to.
+ *
+ * every level indexes the same vertices, their index ranges follow each
+ * other in indices with level 0 first.
+ * */
+struct mesh_data {
+  mesh_vertex *vertices;
+  uint32_t vertex_count;
+  uint32_t *indices;
+  uint32_t index_count;
+  aabb bounds;
+  mesh_lod lods[MESH_MAX_LODS];
+  uint32_t lod_count;
+
+  file_map map;
+  bool mapped;
+};
+typedef struct mesh_data mesh_data;
+
+/* where a mesh_load came from and how long each step took */
+struct mesh_load_stats {
+  bool from_cache;
+  double import_ms;
+  double lod_ms;
+  double cache_write_ms;
+  double cache_load_ms;
+};
+typedef struct mesh_load_stats mesh_load_stats;
+
+/* parse wavefront obj, faces are fan triangulated, chunks parse in parallel */
+bool mesh_import_obj(mesh_data *m, const char *path);
+/* *
+ * read first primitive of the first mesh in a binary gltf 2.0 file,
+ * node transforms are ignored
+ * */
+bool mesh_import_glb(mesh_data *m, const char *path);
+/* import by extension, .obj or .glb */
+bool mesh_import(mesh_data *m, const char *path);
+
+/* *
+ * append simplified levels to an imported mesh, each with about half the
+ * triangles of the one before. edges are collapsed by quadric error and
+ * the chain stops once a level would move the surface further than
+ * max_error or barely gets smaller. vertices on open borders and uv or
+ * normal seams never move. returns the level count
+ * */
+uint32_t mesh_build_lods(mesh_data *m, float max_error);
+/* *
+ * level to draw, the coarsest whose error projects to at most max_pixels.
+ * pixels_per_unit is how many pixels one mesh unit covers on screen,
+ * current the level drawn before. a level only changes once its error is
+ * hysteresis, as a fraction, past max_pixels so objects near the
+ * threshold do not flicker between levels
+ * */
+uint32_t mesh_select_lod(const mesh_lod *lods, uint32_t lod_count,
+                         float pixels_per_unit, float max_pixels,
+                         float hysteresis, uint32_t current);
+
+/* write m to cache_path, source is the file it was imported from */
+bool mesh_cache_write(const mesh_data *m, const char *cache_path,
+                      const file_info *source);
+/* *
+ * map cache_path into m, false when missing, invalid or older than source,
+ * source may be NULL to skip the check
+ * */
+bool mesh_cache_load(mesh_data *m, const char *cache_path,
+                     const file_info *source);
+
+/* *
+ * load from cache_path if it is current, else import path, build its lods
+ * and rebuild the cache, stats may be NULL
+ * */
+bool mesh_load(mesh_data *m, const char *path, const char *cache_path,
+               mesh_load_stats *stats);
+/* free or unmap mesh data */
+void mesh_destroy(mesh_data *m);
+/* *
+ * move uvs into an atlas rect, uv = uv * xy + zw. a rect can not repeat so
+ * uvs are clamped to 0..1 first, returns how many were. imported meshes
+ * only, cached ones are read only
+ * */
+uint32_t mesh_remap_uvs(mesh_data *m, const float transform[4]);
+
+/* *
+ * copy vertices and indices into vbo and ebo, the ebo is bound to the
+ * current vao
+ * */
+void mesh_upload(const mesh_data *m, GLuint vbo, GLuint ebo);
+/* point attribs of the current vao at mesh_vertex fields in vbo */
+void mesh_bind_attributes(GLuint vbo, GLuint position, GLuint normal,
+                          GLuint uv);
+
+#endif /* _MESH_H_ */
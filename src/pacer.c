@@ -0,0 +1,261 @@
+/* *
+ * frame pacing
+ * */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "pacer.h"
+#include "utils.h"
+
+// starting spin margin before any oversleep has been measured
+#define SLEEP_ERROR_START_MS 1.0
+// how fast the margin shrinks back after a bad oversleep
+#define SLEEP_ERROR_DECAY 0.02
+// wait slice on a fence, the first one also flushes
+#define FENCE_WAIT_NS 1000000
+
+/* HELPERS */
+
+internal void sleep_ms(double ms) {
+  struct timespec ts;
+  ts.tv_sec = (time_t)(ms / 1000.0);
+  ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1000000.0);
+  thrd_sleep(&ts, NULL);
+}
+
+internal bool fence_done(GLenum result) {
+  return result == GL_ALREADY_SIGNALED or result == GL_CONDITION_SATISFIED;
+}
+
+/* *
+ * when the gpu finished the oldest frame on the cpu clock, now if its
+ * timestamp is missing. the fence was placed after the timestamp, so once
+ * it signalled the result is there without waiting.
+ * */
+internal double finished_ms(const frame_pacer *p, double now) {
+  GLuint query = p->queries[p->first];
+  GLuint available = GL_FALSE;
+  glad_glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (not available) {
+    return now;
+  }
+
+  GLuint64 gpu_ns = 0;
+  glad_glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpu_ns);
+  double done = (double)gpu_ns / 1000000.0 + p->clock_offset_ms;
+  // the mapping is only as good as one clock read, keep it in range
+  double input = p->input_ms[p->first];
+  return done < input ? input : (done > now ? now : done);
+}
+
+internal void retire_oldest(frame_pacer *p, double now) {
+  assert(p->count > 0);
+  glad_glDeleteSync(p->fences[p->first]);
+
+  double latency = finished_ms(p, now) - p->input_ms[p->first];
+  p->stats.latency_total_ms += latency;
+  ++p->stats.latency_frames;
+
+  p->first = (p->first + 1) % PACER_MAX_FRAMES_IN_FLIGHT;
+  --p->count;
+}
+
+/* retire every fence that has already signalled, in order */
+internal void poll_fences(frame_pacer *p) {
+  while (p->count > 0) {
+    GLenum result = glad_glClientWaitSync(p->fences[p->first], 0, 0);
+    if (not fence_done(result)) {
+      break;
+    }
+    retire_oldest(p, pacer_now_ms());
+  }
+}
+
+/* TIME */
+
+double pacer_now_ms(void) {
+#ifdef _WIN32
+  local_persist LARGE_INTEGER frequency;
+  if (frequency.QuadPart == 0) {
+    QueryPerformanceFrequency(&frequency);
+  }
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return (double)counter.QuadPart * 1000.0 / (double)frequency.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+#endif
+}
+
+const char *present_mode_name(present_mode mode) {
+  switch (mode) {
+  case PRESENT_VSYNC_OFF:
+    return "off";
+  case PRESENT_VSYNC_ON:
+    return "on";
+  case PRESENT_VSYNC_ADAPTIVE:
+    return "adaptive";
+  default:
+    return "?";
+  }
+}
+
+/* FENCES */
+
+bool pacer_wait_fence(GLsync fence) {
+  GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+  for (;;) {
+    GLenum result = glad_glClientWaitSync(fence, flags, FENCE_WAIT_NS);
+    if (fence_done(result)) {
+      return true;
+    }
+    if (result == GL_WAIT_FAILED) {
+      return false;
+    }
+    flags = 0;
+  }
+}
+
+/* LIMITER */
+
+void frame_limiter_init(frame_limiter *l, int target_fps) {
+  memset(l, 0, sizeof(*l));
+  l->sleep_error_ms = SLEEP_ERROR_START_MS;
+  frame_limiter_set_fps(l, target_fps);
+}
+
+void frame_limiter_set_fps(frame_limiter *l, int target_fps) {
+  l->target_ms = target_fps > 0 ? 1000.0 / (double)target_fps : 0.0;
+  l->deadline_ms = pacer_now_ms();
+}
+
+double frame_limiter_wait(frame_limiter *l) {
+  if (l->target_ms <= 0.0) {
+    return 0.0;
+  }
+
+  double start = pacer_now_ms();
+  // more than a frame behind, restart the schedule instead of bursting
+  if (start - l->deadline_ms > l->target_ms) {
+    l->deadline_ms = start;
+  }
+
+  // sleep while the os can not overshoot the deadline
+  double now = start;
+  while (l->deadline_ms - now > l->sleep_error_ms) {
+    double request = l->deadline_ms - now - l->sleep_error_ms;
+    sleep_ms(request);
+
+    double after = pacer_now_ms();
+    double error = (after - now) - request;
+    if (error > l->sleep_error_ms) {
+      l->sleep_error_ms = error;
+    } else {
+      l->sleep_error_ms += (error - l->sleep_error_ms) * SLEEP_ERROR_DECAY;
+    }
+    now = after;
+  }
+
+  // spin the rest
+  while (now < l->deadline_ms) {
+    now = pacer_now_ms();
+  }
+
+  l->deadline_ms += l->target_ms;
+  return now - start;
+}
+
+/* PACER */
+
+void frame_pacer_init(frame_pacer *p, present_mode mode, bool tear_supported,
+                      int max_in_flight) {
+  memset(p, 0, sizeof(*p));
+  p->mode = mode;
+  p->tear_supported = tear_supported;
+
+  if (max_in_flight < 1) {
+    max_in_flight = 1;
+  }
+  if (max_in_flight > PACER_MAX_FRAMES_IN_FLIGHT) {
+    max_in_flight = PACER_MAX_FRAMES_IN_FLIGHT;
+  }
+  p->max_in_flight = max_in_flight;
+}
+
+void frame_pacer_destroy(frame_pacer *p) {
+  while (p->count > 0) {
+    glad_glDeleteSync(p->fences[p->first]);
+    p->first = (p->first + 1) % PACER_MAX_FRAMES_IN_FLIGHT;
+    --p->count;
+  }
+  if (p->queries[0]) {
+    glad_glDeleteQueries(PACER_MAX_FRAMES_IN_FLIGHT, p->queries);
+    memset(p->queries, 0, sizeof(p->queries));
+  }
+}
+
+int frame_pacer_set_mode(frame_pacer *p, present_mode mode) {
+  p->mode = mode;
+  return frame_pacer_swap_interval(p);
+}
+
+int frame_pacer_swap_interval(const frame_pacer *p) {
+  switch (p->mode) {
+  case PRESENT_VSYNC_OFF:
+    return 0;
+  case PRESENT_VSYNC_ADAPTIVE:
+    // negative interval means adaptive, plain vsync without the extension
+    return p->tear_supported ? -1 : 1;
+  default:
+    return 1;
+  }
+}
+
+void frame_pacer_begin(frame_pacer *p) {
+  poll_fences(p);
+  if (p->count < p->max_in_flight) {
+    return;
+  }
+
+  double start = pacer_now_ms();
+  if (not pacer_wait_fence(p->fences[p->first])) {
+    fprintf(stderr, "ERROR: frame pacer fence wait failed\n");
+  }
+
+  double now = pacer_now_ms();
+  p->stats.fence_wait_ms += now - start;
+  retire_oldest(p, now);
+}
+
+void frame_pacer_end(frame_pacer *p, double input_ms) {
+  // a blocking swap may have let older frames finish
+  poll_fences(p);
+  assert(p->count < PACER_MAX_FRAMES_IN_FLIGHT);
+
+  // init may run before the context is current, queries wait for the
+  // first frame
+  if (not p->queries[0]) {
+    glad_glGenQueries(PACER_MAX_FRAMES_IN_FLIGHT, p->queries);
+  }
+
+  // remapped every frame so the two clocks never drift apart
+  GLint64 gpu_now = 0;
+  glad_glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+  p->clock_offset_ms = pacer_now_ms() - (double)gpu_now / 1000000.0;
+
+  int slot = (p->first + p->count) % PACER_MAX_FRAMES_IN_FLIGHT;
+  glad_glQueryCounter(p->queries[slot], GL_TIMESTAMP);
+  p->fences[slot] = glad_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  p->input_ms[slot] = input_ms;
+  ++p->count;
+  ++p->stats.frames;
+}
@@ -0,0 +1,108 @@
+#ifndef _PACER_H_
+#define _PACER_H_
+
+#include <stdbool.h>
+
+#include "glad/glad.h"
+
+#define PACER_MAX_FRAMES_IN_FLIGHT 4
+
+enum present_mode {
+  PRESENT_VSYNC_OFF,
+  PRESENT_VSYNC_ON,
+  // vsync, but late frames tear instead of waiting a whole refresh
+  PRESENT_VSYNC_ADAPTIVE,
+  PRESENT_MODE_COUNT,
+};
+typedef enum present_mode present_mode;
+
+/* *
+ * caps the main loop at a target rate
+ *
+ * sleeps until just before the deadline then spins the rest, the spin
+ * margin follows the worst oversleep seen so coarse os timers still hit
+ * the deadline.
+ * */
+struct frame_limiter {
+  // 0 runs unlimited
+  double target_ms;
+  double deadline_ms;
+  double sleep_error_ms;
+};
+typedef struct frame_limiter frame_limiter;
+
+/* *
+ * totals since init, readers diff two snapshots
+ *
+ * latency is from the input sampled for a frame to the gpu finishing it,
+ * taken from a timestamp written after the swap and mapped to the cpu
+ * clock, so it does not depend on when the fence is next checked.
+ * */
+struct pacer_stats {
+  unsigned frames;
+  unsigned latency_frames;
+  double latency_total_ms;
+  // render thread blocked on the oldest fence
+  double fence_wait_ms;
+};
+typedef struct pacer_stats pacer_stats;
+
+/* *
+ * gpu side pacing, runs on the thread owning the context
+ *
+ * a fence is placed after every swap, once max_in_flight frames are
+ * queued the next frame waits for the oldest, so the driver can not queue
+ * up frames of stale input.
+ * */
+struct frame_pacer {
+  present_mode mode;
+  bool tear_supported;
+  int max_in_flight;
+
+  GLsync fences[PACER_MAX_FRAMES_IN_FLIGHT];
+  GLuint queries[PACER_MAX_FRAMES_IN_FLIGHT];
+  double input_ms[PACER_MAX_FRAMES_IN_FLIGHT];
+  int first;
+  int count;
+  // pacer_now_ms minus the gpu clock, taken again every frame
+  double clock_offset_ms;
+
+  pacer_stats stats;
+};
+typedef struct frame_pacer frame_pacer;
+
+/* monotonic time in milliseconds */
+double pacer_now_ms(void);
+/* *
+ * block until fence signals, flushing once so it is sure to. false if the
+ * wait failed, the fence is left for the caller to delete either way.
+ * */
+bool pacer_wait_fence(GLsync fence);
+/* name of mode for display */
+const char *present_mode_name(present_mode mode);
+
+/* limit to target_fps frames a second, 0 for unlimited */
+void frame_limiter_init(frame_limiter *l, int target_fps);
+/* change target, 0 for unlimited */
+void frame_limiter_set_fps(frame_limiter *l, int target_fps);
+/* block until the next frame is due, returns ms spent waiting */
+double frame_limiter_wait(frame_limiter *l);
+
+/* *
+ * create pacer, tear_supported says if the context has
+ * EXT_swap_control_tear for the adaptive mode
+ * */
+void frame_pacer_init(frame_pacer *p, present_mode mode, bool tear_supported,
+                      int max_in_flight);
+/* delete fences still pending and the timestamp queries */
+void frame_pacer_destroy(frame_pacer *p);
+/* switch mode, returns the interval to pass to the swap interval call */
+int frame_pacer_set_mode(frame_pacer *p, present_mode mode);
+/* swap interval of the current mode */
+int frame_pacer_swap_interval(const frame_pacer *p);
+/* before recording gl work, waits while too many frames are in flight */
+void frame_pacer_begin(frame_pacer *p);
+/* after the swap, input_ms is when the frames input was sampled */
+void frame_pacer_end(frame_pacer *p, double input_ms);
+
+#endif /* _PACER_H_ */
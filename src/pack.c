@@ -0,0 +1,311 @@
+/* *
+ * packed asset archive
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bits.h"
+#include "pack.h"
+#include "utils.h"
+
+struct pack_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t slot_count;
+  uint64_t slot_offset;
+  uint64_t name_offset;
+};
+typedef struct pack_header pack_header;
+
+_Static_assert(sizeof(pack_header) % PACK_ALIGN == 0,
+               "slots start aligned");
+_Static_assert(sizeof(pack_slot) == 32, "pack_slot is tightly packed");
+
+/* HELPERS */
+
+/* path without any leading "./" */
+internal const char *skip_current_dir(const char *path) {
+  while (path[0] == '.' and (path[1] == '/' or path[1] == '\\')) {
+    path += 2;
+  }
+  return path;
+}
+
+internal char path_char(char c) { return c == '\\' ? '/' : c; }
+
+/* stored names are already normalized, path may not be */
+internal bool name_equals(const char *name, uint32_t length,
+                          const char *path) {
+  path = skip_current_dir(path);
+  for (uint32_t i = 0; i < length; ++i) {
+    if (path[i] == '\0' or path_char(path[i]) != name[i]) {
+      return false;
+    }
+  }
+  return path[length] == '\0';
+}
+
+internal uint32_t slot_count_for(uint32_t entries) {
+  // at most half full keeps probe chains short
+  uint32_t count = 2;
+  while (count < entries * 2) {
+    count *= 2;
+  }
+  return count;
+}
+
+/* PACK */
+
+uint64_t pack_hash(const char *path) {
+  uint64_t hash = FNV_OFFSET;
+  for (const char *c = skip_current_dir(path); *c; ++c) {
+    hash = fnv_byte(hash, (uint8_t)path_char(*c));
+  }
+  // 0 is the empty slot
+  return hash ? hash : 1;
+}
+
+bool pack_open(pack *p, const char *path) {
+  memset(p, 0, sizeof(*p));
+
+  if (not file_map_open(&p->map, path)) {
+    return false;
+  }
+
+  pack_header header;
+  const uint8_t *bytes = p->map.data;
+  uint64_t size = p->map.size;
+  bool ok = size >= sizeof(header);
+  if (ok) {
+    memcpy(&header, bytes, sizeof(header));
+    ok = memcmp(header.magic, "PACK", 4) == 0 and
+         header.version == PACK_VERSION and header.slot_count > 0 and
+         (header.slot_count & (header.slot_count - 1)) == 0 and
+         header.entry_count < header.slot_count and
+         header.slot_offset % PACK_ALIGN == 0 and
+         header.slot_offset <= size and header.name_offset <= size;
+  }
+  // both offsets are inside the file, adding the slots can not wrap
+  if (ok) {
+    uint64_t slot_end =
+        header.slot_offset + (uint64_t)header.slot_count * sizeof(pack_slot);
+    ok = slot_end <= size and header.name_offset >= slot_end;
+  }
+
+  // check every slot once so lookups can trust offsets
+  if (ok) {
+    p->slots = (const pack_slot *)(bytes + header.slot_offset);
+    p->names = (const char *)(bytes + header.name_offset);
+    uint64_t name_bytes = size - header.name_offset;
+    uint32_t used = 0;
+    for (uint32_t i = 0; ok and i < header.slot_count; ++i) {
+      const pack_slot *slot = &p->slots[i];
+      if (slot->hash == 0) {
+        continue;
+      }
+      ++used;
+      ok = slot->offset % PACK_ALIGN == 0 and slot->offset <= size and
+           slot->size < size - slot->offset and
+           bytes[slot->offset + slot->size] == '\0' and
+           (uint64_t)slot->name_offset + slot->name_length <= name_bytes;
+    }
+    ok = ok and used == header.entry_count;
+  }
+
+  if (not ok) {
+    fprintf(stderr, "ERROR: %s is not a valid pack\n", path);
+    pack_close(p);
+    return false;
+  }
+
+  p->slot_count = header.slot_count;
+  p->entry_count = header.entry_count;
+  return true;
+}
+
+void pack_close(pack *p) {
+  file_map_close(&p->map);
+  p->slots = NULL;
+  p->names = NULL;
+  p->slot_count = 0;
+  p->entry_count = 0;
+}
+
+const void *pack_find(const pack *p, const char *path, size_t *size) {
+  if (p->slot_count == 0) {
+    return NULL;
+  }
+
+  uint64_t hash = pack_hash(path);
+  uint32_t mask = p->slot_count - 1;
+  // never full, an empty slot always ends the probe
+  for (uint32_t i = (uint32_t)hash & mask;; i = (i + 1) & mask) {
+    const pack_slot *slot = &p->slots[i];
+    if (slot->hash == 0) {
+      return NULL;
+    }
+    if (slot->hash == hash and
+        name_equals(p->names + slot->name_offset, slot->name_length, path)) {
+      if (size) {
+        *size = (size_t)slot->size;
+      }
+      return (const uint8_t *)p->map.data + slot->offset;
+    }
+  }
+}
+
+/* WRITER */
+
+void pack_writer_init(pack_writer *w) { memset(w, 0, sizeof(*w)); }
+
+void pack_writer_destroy(pack_writer *w) {
+  for (uint32_t i = 0; i < w->count; ++i) {
+    free(w->entries[i].name);
+    free(w->entries[i].data);
+  }
+  free(w->entries);
+  memset(w, 0, sizeof(*w));
+}
+
+bool pack_writer_add(pack_writer *w, const char *name, const void *data,
+                     size_t size) {
+  uint64_t hash = pack_hash(name);
+  name = skip_current_dir(name);
+  size_t length = strlen(name);
+  if (length == 0) {
+    fprintf(stderr, "ERROR: pack entry has no name\n");
+    return false;
+  }
+
+  for (uint32_t i = 0; i < w->count; ++i) {
+    if (w->entries[i].hash == hash and
+        name_equals(w->entries[i].name, (uint32_t)strlen(w->entries[i].name),
+                    name)) {
+      fprintf(stderr, "ERROR: %s added to pack twice\n", name);
+      return false;
+    }
+  }
+
+  if (w->count == w->capacity) {
+    uint32_t capacity = w->capacity ? w->capacity * 2 : 16;
+    pack_writer_entry *entries =
+        realloc(w->entries, sizeof(*entries) * capacity);
+    if (not entries) {
+      fprintf(stderr, "ERROR: out of memory adding %s\n", name);
+      return false;
+    }
+    w->entries = entries;
+    w->capacity = capacity;
+  }
+
+  pack_writer_entry entry = {.hash = hash, .size = size};
+  entry.name = malloc(length + 1);
+  entry.data = malloc(size ? size : 1);
+  if (not entry.name or not entry.data) {
+    fprintf(stderr, "ERROR: out of memory adding %s\n", name);
+    free(entry.name);
+    free(entry.data);
+    return false;
+  }
+  for (size_t i = 0; i <= length; ++i) {
+    entry.name[i] = path_char(name[i]);
+  }
+  if (size) {
+    memcpy(entry.data, data, size);
+  }
+
+  w->entries[w->count++] = entry;
+  return true;
+}
+
+bool pack_writer_add_file(pack_writer *w, const char *name, const char *path) {
+  file_map map;
+  if (not file_map_open(&map, path)) {
+    fprintf(stderr, "ERROR: could not open %s\n", path);
+    return false;
+  }
+  bool ok = pack_writer_add(w, name, map.data, map.size);
+  file_map_close(&map);
+  return ok;
+}
+
+bool pack_writer_write(const pack_writer *w, const char *path) {
+  pack_header header = {
+      .magic = {'P', 'A', 'C', 'K'},
+      .version = PACK_VERSION,
+      .entry_count = w->count,
+      .slot_count = slot_count_for(w->count),
+      .slot_offset = sizeof(pack_header),
+  };
+  header.name_offset =
+      header.slot_offset + (uint64_t)header.slot_count * sizeof(pack_slot);
+
+  pack_slot *slots = calloc(header.slot_count, sizeof(*slots));
+  if (not slots) {
+    fprintf(stderr, "ERROR: out of memory writing %s\n", path);
+    return false;
+  }
+
+  // names, then blobs in the order they were added
+  uint64_t name_bytes = 0;
+  for (uint32_t i = 0; i < w->count; ++i) {
+    name_bytes += strlen(w->entries[i].name) + 1;
+  }
+  uint64_t offset = align_up(header.name_offset + name_bytes, PACK_ALIGN);
+  uint32_t name_offset = 0;
+  uint32_t mask = header.slot_count - 1;
+  for (uint32_t i = 0; i < w->count; ++i) {
+    const pack_writer_entry *entry = &w->entries[i];
+    uint32_t s = (uint32_t)entry->hash & mask;
+    while (slots[s].hash != 0) {
+      s = (s + 1) & mask;
+    }
+    uint32_t length = (uint32_t)strlen(entry->name);
+    slots[s] = (pack_slot){
+        .hash = entry->hash,
+        .offset = offset,
+        .size = entry->size,
+        .name_offset = name_offset,
+        .name_length = length,
+    };
+    name_offset += length + 1;
+    // + 1 for the terminator after each blob
+    offset = align_up(offset + entry->size + 1, PACK_ALIGN);
+  }
+
+  FILE *fp = fopen(path, "wb");
+  if (not fp) {
+    fprintf(stderr, "ERROR: could not write %s\n", path);
+    free(slots);
+    return false;
+  }
+
+  local_persist const uint8_t zeros[PACK_ALIGN] = {0};
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 and
+            fwrite(slots, sizeof(*slots), header.slot_count, fp) ==
+                header.slot_count;
+  for (uint32_t i = 0; ok and i < w->count; ++i) {
+    const char *name = w->entries[i].name;
+    ok = fwrite(name, 1, strlen(name) + 1, fp) == strlen(name) + 1;
+  }
+
+  uint64_t written = header.name_offset + name_bytes;
+  for (uint32_t i = 0; ok and i < w->count; ++i) {
+    const pack_writer_entry *entry = &w->entries[i];
+    size_t pad = (size_t)(align_up(written, PACK_ALIGN) - written);
+    ok = fwrite(zeros, 1, pad, fp) == pad and
+         fwrite(entry->data, 1, entry->size, fp) == entry->size and
+         fwrite(zeros, 1, 1, fp) == 1;
+    written += pad + entry->size + 1;
+  }
+  ok = fclose(fp) == 0 and ok;
+  free(slots);
+
+  if (not ok) {
+    fprintf(stderr, "ERROR: failed writing %s\n", path);
+    remove(path);
+  }
+  return ok;
+}
@@ -0,0 +1,91 @@
+#ifndef _PACK_H_
+#define _PACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "filemap.h"
+
+// bump whenever the pack layout changes
+#define PACK_VERSION 1
+// blobs start on this boundary so they can be read in place
+#define PACK_ALIGN 16
+
+/* *
+ * one entry of the table of contents
+ *
+ * the table is open addressed on hash with linear probing, hash 0 marks an
+ * empty slot. names are kept so a hash collision can not return the wrong
+ * blob.
+ * */
+struct pack_slot {
+  uint64_t hash;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t name_offset;
+  uint32_t name_length;
+};
+typedef struct pack_slot pack_slot;
+
+/* *
+ * read only archive mapped into memory
+ *
+ * file layout
+ * | header | slots | names | blob | pad | blob | ...
+ *
+ * every blob is followed by a zero byte so text can be used as a c string
+ * straight from the mapping.
+ * */
+struct pack {
+  file_map map;
+  const pack_slot *slots;
+  const char *names;
+  uint32_t slot_count;
+  uint32_t entry_count;
+};
+typedef struct pack pack;
+
+/* file added to a pack_writer, data is owned by the writer */
+struct pack_writer_entry {
+  char *name;
+  uint64_t hash;
+  void *data;
+  size_t size;
+};
+typedef struct pack_writer_entry pack_writer_entry;
+
+struct pack_writer {
+  pack_writer_entry *entries;
+  uint32_t count;
+  uint32_t capacity;
+};
+typedef struct pack_writer pack_writer;
+
+/* *
+ * hash of path, "./" prefixes are dropped and '\\' is read as '/' so
+ * both spellings of a path find the same entry
+ * */
+uint64_t pack_hash(const char *path);
+
+/* map and validate the pack at path */
+bool pack_open(pack *p, const char *path);
+/* unmap, pointers returned by pack_find are invalid afterwards */
+void pack_close(pack *p);
+/* *
+ * pointer into the mapping for path, NULL if missing
+ * size may be NULL
+ * */
+const void *pack_find(const pack *p, const char *path, size_t *size);
+
+void pack_writer_init(pack_writer *w);
+void pack_writer_destroy(pack_writer *w);
+/* copy size bytes of data in as name, false if name is already added */
+bool pack_writer_add(pack_writer *w, const char *name, const void *data,
+                     size_t size);
+/* add the contents of the file at path as name */
+bool pack_writer_add_file(pack_writer *w, const char *name, const char *path);
+/* write every added entry to path */
+bool pack_writer_write(const pack_writer *w, const char *path);
+
+#endif /* _PACK_H_ */
@@ -0,0 +1,212 @@
+/* *
+ * gpu particles
+ * */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glstate.h"
+#include "particles.h"
+#include "readback.h"
+#include "utils.h"
+
+// work group size of particle_emit.comp and particle_simulate.comp
+#define GROUP_SIZE 64
+
+// uniform locations
+#define EMIT_COUNT 0
+#define EMIT_SEED 1
+#define EMIT_LIST 2
+#define EMIT_ORIGIN 3
+#define EMIT_SPEED 4
+#define EMIT_SPREAD 5
+#define EMIT_LIFETIME 6
+#define SIMULATE_DT 0
+#define SIMULATE_LIST 1
+#define SIMULATE_NEXT 2
+#define DRAW_LIST 0
+#define DRAW_SIZE 1
+
+/* HELPERS */
+
+internal GLuint create_storage(GLenum target, GLsizeiptr size,
+                               const void *data) {
+  GLuint buffer = 0;
+  glad_glGenBuffers(1, &buffer);
+  glstate_bind_buffer(target, buffer);
+  glad_glBufferStorage(target, size, data, 0);
+  return buffer;
+}
+
+/* offset of alive list index into the alive buffer */
+internal GLuint list_offset(const particle_system *ps, int list) {
+  return (GLuint)list * ps->capacity;
+}
+
+/* keep the results of the frame that last wrote the current slot */
+internal void read_slot(particle_system *ps) {
+  int slot = ps->readback.slot;
+  const particle_control *control = readback_begin(&ps->readback);
+  if (not control) {
+    return;
+  }
+
+  ps->stats.alive = control->draw[1];
+  ps->stats.emitted = ps->emitted[slot];
+  if (ps->query_pending[slot]) {
+    GLuint64 elapsed = 0;
+    glad_glGetQueryObjectui64v(ps->queries[slot], GL_QUERY_RESULT, &elapsed);
+    ps->stats.gpu_ms = (double)elapsed / 1000000.0;
+    ps->query_pending[slot] = false;
+  }
+}
+
+/* PARTICLES */
+
+bool particles_init(particle_system *ps, GLuint capacity,
+                    const particle_programs *programs) {
+  assert(capacity > 0);
+  memset(ps, 0, sizeof(*ps));
+  ps->capacity = capacity;
+  ps->programs = *programs;
+
+  // every particle starts on the dead list
+  GLuint *indices = malloc(sizeof(*indices) * capacity);
+  if (not indices) {
+    fprintf(stderr, "ERROR: particles failed to allocate %u indices\n",
+            capacity);
+    return false;
+  }
+  for (GLuint i = 0; i < capacity; ++i) {
+    indices[i] = i;
+  }
+  particle_control control = {
+      .dispatch = {0, 1, 1},
+      .draw = {4, 0, 0, 0},
+      .dead_count = (GLint)capacity,
+  };
+
+  ps->state = create_storage(GL_SHADER_STORAGE_BUFFER,
+                             sizeof(particle) * capacity, NULL);
+  ps->alive = create_storage(GL_SHADER_STORAGE_BUFFER,
+                             sizeof(GLuint) * capacity * 2, NULL);
+  ps->dead = create_storage(GL_SHADER_STORAGE_BUFFER,
+                            sizeof(GLuint) * capacity, indices);
+  ps->control =
+      create_storage(GL_SHADER_STORAGE_BUFFER, sizeof(control), &control);
+  free(indices);
+  glad_glGenVertexArrays(1, &ps->vao);
+  glad_glGenQueries(PARTICLE_READBACK_FRAMES, ps->queries);
+
+  // control is copied here after each update and read a few frames later
+  if (not readback_init(&ps->readback, sizeof(particle_control), false)) {
+    particles_destroy(ps);
+    return false;
+  }
+  return true;
+}
+
+void particles_destroy(particle_system *ps) {
+  readback_destroy(&ps->readback);
+
+  GLuint buffers[4] = {ps->state, ps->alive, ps->dead, ps->control};
+  for (int i = 0; i < 4; ++i) {
+    glstate_forget_buffer(buffers[i]);
+  }
+  glad_glDeleteBuffers(4, buffers);
+  glstate_forget_vertex_array(ps->vao);
+  glad_glDeleteVertexArrays(1, &ps->vao);
+  glad_glDeleteQueries(PARTICLE_READBACK_FRAMES, ps->queries);
+  memset(ps, 0, sizeof(*ps));
+}
+
+void particles_update(particle_system *ps, const particle_emitter *emitter,
+                      float dt, particle_stats *stats) {
+  int slot = ps->readback.slot;
+  read_slot(ps);
+  *stats = ps->stats;
+
+  glad_glBeginQuery(GL_TIME_ELAPSED, ps->queries[slot]);
+  ps->query_pending[slot] = true;
+
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, PARTICLE_STATE_BINDING,
+                           ps->state);
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, PARTICLE_ALIVE_BINDING,
+                           ps->alive);
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, PARTICLE_DEAD_BINDING,
+                           ps->dead);
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, PARTICLE_CONTROL_BINDING,
+                           ps->control);
+
+  // whole particles per frame, emit fails quietly once the dead list is empty
+  ps->emit_carry += emitter->rate * dt;
+  GLuint emit = ps->emit_carry < (float)ps->capacity
+                    ? (GLuint)ps->emit_carry
+                    : ps->capacity;
+  ps->emit_carry -= (float)emit;
+  ps->emitted[slot] = emit;
+  ps->size = emitter->size;
+
+  GLuint current = list_offset(ps, ps->current);
+  GLuint next = list_offset(ps, 1 - ps->current);
+  if (emit > 0) {
+    GLuint program = ps->programs.emit;
+    glstate_use_program(program);
+    glad_glProgramUniform1ui(program, EMIT_COUNT, emit);
+    glad_glProgramUniform1ui(program, EMIT_SEED, ps->seed++);
+    glad_glProgramUniform1ui(program, EMIT_LIST, current);
+    glad_glProgramUniform3fv(program, EMIT_ORIGIN, 1, emitter->origin);
+    glad_glProgramUniform1f(program, EMIT_SPEED, emitter->speed);
+    glad_glProgramUniform1f(program, EMIT_SPREAD, emitter->spread);
+    glad_glProgramUniform1f(program, EMIT_LIFETIME, emitter->lifetime);
+    glad_glDispatchCompute((emit + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+    glad_glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  }
+
+  // current list length becomes the simulation dispatch
+  glstate_use_program(ps->programs.dispatch);
+  glad_glDispatchCompute(1, 1, 1);
+  glad_glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT |
+                       GL_COMMAND_BARRIER_BIT);
+
+  GLuint program = ps->programs.simulate;
+  glstate_use_program(program);
+  glad_glProgramUniform1f(program, SIMULATE_DT, dt);
+  glad_glProgramUniform1ui(program, SIMULATE_LIST, current);
+  glad_glProgramUniform1ui(program, SIMULATE_NEXT, next);
+  glstate_bind_buffer(GL_DISPATCH_INDIRECT_BUFFER, ps->control);
+  glad_glDispatchComputeIndirect(0);
+
+  // draws read the next list and its length, the copy feeds the readback
+  glad_glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT |
+                       GL_BUFFER_UPDATE_BARRIER_BIT);
+  glad_glBindBuffer(GL_COPY_READ_BUFFER, ps->control);
+  glad_glBindBuffer(GL_COPY_WRITE_BUFFER, ps->readback.buffer);
+  glad_glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                           readback_offset(&ps->readback),
+                           sizeof(particle_control));
+  ps->current = 1 - ps->current;
+}
+
+void particles_draw(particle_system *ps) {
+  GLuint program = ps->programs.draw;
+  glstate_use_program(program);
+  glad_glProgramUniform1ui(program, DRAW_LIST, list_offset(ps, ps->current));
+  glad_glProgramUniform1f(program, DRAW_SIZE, ps->size);
+
+  // additive, tested against the scene but never hiding each other
+  glstate_enable(GL_BLEND);
+  glad_glBlendFunc(GL_ONE, GL_ONE);
+  glstate_depth_mask(GL_FALSE);
+  glstate_bind_vertex_array(ps->vao);
+  glstate_bind_buffer(GL_DRAW_INDIRECT_BUFFER, ps->control);
+  glad_glDrawArraysIndirect(
+      GL_TRIANGLE_STRIP,
+      (const void *)offsetof(particle_control, draw));
+  glstate_depth_mask(GL_TRUE);
+  glstate_disable(GL_BLEND);
+
+  glad_glEndQuery(GL_TIME_ELAPSED);
+  readback_end(&ps->readback);
+}
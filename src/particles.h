@@ -0,0 +1,148 @@
+#ifndef _PARTICLES_H_
+#define _PARTICLES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "glad/glad.h"
+#include "readback.h"
+
+// binding points shared with the particle shaders, after those of hiz.h
+#define PARTICLE_STATE_BINDING 4
+#define PARTICLE_ALIVE_BINDING 5
+#define PARTICLE_DEAD_BINDING 6
+#define PARTICLE_CONTROL_BINDING 7
+// counts and gpu time are read back this many frames after the update
+#define PARTICLE_READBACK_FRAMES READBACK_FRAMES
+
+/* *
+ * one particle, std430
+ *
+ * struct particle {
+ *     vec4 position;   // w is age in seconds
+ *     vec4 velocity;   // w is lifetime in seconds
+ * };
+ * */
+struct particle {
+  float position[4];
+  float velocity[4];
+};
+typedef struct particle particle;
+
+_Static_assert(sizeof(particle) == 32, "std430 particle stride");
+
+/* *
+ * counters shared by every particle pass, std430
+ *
+ * the same buffer is the dispatch indirect buffer of the simulation and
+ * the draw indirect buffer of the particle draw. draw[1], the instance
+ * count, is the length of the alive list last appended to.
+ * */
+struct particle_control {
+  // glDispatchComputeIndirect groups
+  GLuint dispatch[3];
+  // glDrawArraysIndirect count, instance_count, first, base_instance
+  GLuint draw[4];
+  GLint dead_count;
+  GLuint simulate_count;
+};
+typedef struct particle_control particle_control;
+
+_Static_assert(offsetof(particle_control, draw) == 12,
+               "std430 control.draw");
+_Static_assert(offsetof(particle_control, dead_count) == 28,
+               "std430 control.dead_count");
+_Static_assert(offsetof(particle_control, simulate_count) == 32,
+               "std430 control.simulate_count");
+
+/* *
+ * where and how fast particles are born
+ * */
+struct particle_emitter {
+  float origin[3];
+  // per second, fractions carry over to the next frame
+  float rate;
+  float speed;
+  // radius of the velocity cone around +y at unit speed
+  float spread;
+  float lifetime;
+  float size;
+};
+typedef struct particle_emitter particle_emitter;
+
+/* *
+ * programs linked from particle_emit.comp, particle_dispatch.comp,
+ * particle_simulate.comp and particle.vert + particle.frag
+ * */
+struct particle_programs {
+  GLuint emit;
+  GLuint dispatch;
+  GLuint simulate;
+  GLuint draw;
+};
+typedef struct particle_programs particle_programs;
+
+/* *
+ * alive count and gpu time of update + draw, PARTICLE_READBACK_FRAMES old
+ * */
+struct particle_stats {
+  unsigned alive;
+  unsigned emitted;
+  double gpu_ms;
+};
+typedef struct particle_stats particle_stats;
+
+/* *
+ * particles that live entirely on the gpu
+ *
+ * each frame emit pops free indices off the dead list and appends them to
+ * the current alive list, dispatch turns its length into the indirect
+ * group count and simulate integrates every alive particle, pushing the
+ * dead back onto the dead list and compacting the living into the other
+ * alive list, which is what gets drawn. the cpu only sets uniforms and
+ * issues the dispatches, it never touches a particle.
+ * */
+struct particle_system {
+  GLuint capacity;
+  particle_programs programs;
+
+  GLuint state;
+  // two lists of capacity indices, current and next
+  GLuint alive;
+  GLuint dead;
+  GLuint control;
+  // attributeless draws still need a vao bound
+  GLuint vao;
+  int current;
+  float emit_carry;
+  GLuint seed;
+  // last emitter size, used by the draw
+  float size;
+
+  // ring of control copies, with a timer query per slot
+  readback_ring readback;
+  GLuint queries[PARTICLE_READBACK_FRAMES];
+  bool query_pending[PARTICLE_READBACK_FRAMES];
+  unsigned emitted[PARTICLE_READBACK_FRAMES];
+  particle_stats stats;
+};
+typedef struct particle_system particle_system;
+
+/* create gpu storage for capacity particles, all of them dead */
+bool particles_init(particle_system *ps, GLuint capacity,
+                    const particle_programs *programs);
+/* delete buffers, queries and pending fences, programs stay with the caller */
+void particles_destroy(particle_system *ps);
+
+/* *
+ * emit and simulate one step of dt seconds
+ *
+ * starts the timer query particles_draw ends, the two are called in pairs.
+ * stats receive the counts of an earlier frame.
+ * */
+void particles_update(particle_system *ps, const particle_emitter *emitter,
+                      float dt, particle_stats *stats);
+/* draw the alive particles additively, needs the camera block bound */
+void particles_draw(particle_system *ps);
+
+#endif /* _PARTICLES_H_ */
@@ -0,0 +1,139 @@
+/* *
+ * pool allocator
+ * */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "utils.h"
+
+#define SLOT_MASK (POOL_MAX_CAPACITY - 1)
+#define GENERATION_MAX ((1u << (32 - POOL_SLOT_BITS)) - 1)
+#define SLOT_END 0xFFFFFFFFu
+
+/* HELPERS */
+
+internal handle make_handle(uint32_t slot, uint32_t generation) {
+  return (generation << POOL_SLOT_BITS) | slot;
+}
+
+internal uint32_t handle_slot(handle h) { return h & SLOT_MASK; }
+
+internal uint32_t handle_generation(handle h) { return h >> POOL_SLOT_BITS; }
+
+/* POOL */
+
+bool pool_init(pool *p, size_t element_size, uint32_t capacity) {
+  assert(element_size > 0);
+  assert(capacity > 0 and capacity <= POOL_MAX_CAPACITY);
+  memset(p, 0, sizeof(*p));
+
+  p->dense = malloc(element_size * capacity);
+  p->dense_slot = malloc(sizeof(*p->dense_slot) * capacity);
+  p->slot_dense = malloc(sizeof(*p->slot_dense) * capacity);
+  p->generation = malloc(sizeof(*p->generation) * capacity);
+  if (not p->dense or not p->dense_slot or not p->slot_dense or
+      not p->generation) {
+    fprintf(stderr, "ERROR: pool failed to allocate %u elements\n",
+            capacity);
+    pool_destroy(p);
+    return false;
+  }
+
+  p->element_size = element_size;
+  p->capacity = capacity;
+
+  // chain every slot into the free list
+  for (uint32_t i = 0; i < capacity; ++i) {
+    p->slot_dense[i] = i + 1 < capacity ? i + 1 : SLOT_END;
+    p->generation[i] = 1;
+  }
+  p->free_head = 0;
+
+  return true;
+}
+
+void pool_destroy(pool *p) {
+  free(p->dense);
+  free(p->dense_slot);
+  free(p->slot_dense);
+  free(p->generation);
+  memset(p, 0, sizeof(*p));
+}
+
+handle pool_alloc(pool *p) {
+  if (p->free_head == SLOT_END or p->count == p->capacity) {
+    return HANDLE_NONE;
+  }
+
+  uint32_t slot = p->free_head;
+  p->free_head = p->slot_dense[slot];
+
+  uint32_t idx = p->count++;
+  p->slot_dense[slot] = idx;
+  p->dense_slot[idx] = slot;
+  memset(p->dense + idx * p->element_size, 0, p->element_size);
+
+  return make_handle(slot, p->generation[slot]);
+}
+
+bool pool_free(pool *p, handle h) {
+  if (not pool_valid(p, h)) {
+    return false;
+  }
+
+  uint32_t slot = handle_slot(h);
+  uint32_t idx = p->slot_dense[slot];
+  uint32_t last = --p->count;
+
+  // move last element into the hole
+  if (idx != last) {
+    memcpy(p->dense + idx * p->element_size,
+           p->dense + last * p->element_size, p->element_size);
+    uint32_t moved = p->dense_slot[last];
+    p->dense_slot[idx] = moved;
+    p->slot_dense[moved] = idx;
+  }
+
+  uint32_t generation = p->generation[slot] + 1;
+  p->generation[slot] = generation > GENERATION_MAX ? 1 : generation;
+
+  p->slot_dense[slot] = p->free_head;
+  p->free_head = slot;
+
+  return true;
+}
+
+void *pool_get(const pool *p, handle h) {
+  if (not pool_valid(p, h)) {
+    return NULL;
+  }
+  return p->dense + p->slot_dense[handle_slot(h)] * p->element_size;
+}
+
+bool pool_valid(const pool *p, handle h) {
+  uint32_t slot = handle_slot(h);
+  uint32_t generation = handle_generation(h);
+  if (generation == 0 or slot >= p->capacity) {
+    return false;
+  }
+  if (p->generation[slot] != generation) {
+    return false;
+  }
+  // a free slot keeps its generation until reused, check it is live
+  uint32_t idx = p->slot_dense[slot];
+  return idx < p->count and p->dense_slot[idx] == slot;
+}
+
+void *pool_at(const pool *p, uint32_t i) {
+  assert(i < p->count);
+  return p->dense + i * p->element_size;
+}
+
+handle pool_handle_at(const pool *p, uint32_t i) {
+  assert(i < p->count);
+  uint32_t slot = p->dense_slot[i];
+  return make_handle(slot, p->generation[slot]);
+}
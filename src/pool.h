@@ -0,0 +1,58 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* *
+ * generational handle, slot in the low bits and generation in the high
+ * bits. generation never is 0 so a zeroed handle is always invalid.
+ * */
+typedef uint32_t handle;
+
+#define HANDLE_NONE 0u
+#define POOL_SLOT_BITS 20
+#define POOL_MAX_CAPACITY (1u << POOL_SLOT_BITS)
+
+/* *
+ * fixed size pool of equally sized elements
+ *
+ * elements are kept densely packed for iteration, handles reach them
+ * through a slot table so frees are O(1) swaps with the last element.
+ * a freed slot bumps its generation, old handles to it stop resolving.
+ * */
+struct pool {
+  unsigned char *dense;
+  size_t element_size;
+
+  // slot owning each dense element
+  uint32_t *dense_slot;
+  // dense index of each used slot, next free slot for free ones
+  uint32_t *slot_dense;
+  uint16_t *generation;
+
+  uint32_t free_head;
+  uint32_t count;
+  uint32_t capacity;
+};
+typedef struct pool pool;
+
+/* allocate capacity elements of element_size bytes */
+bool pool_init(pool *p, size_t element_size, uint32_t capacity);
+/* free pool storage */
+void pool_destroy(pool *p);
+/* take a zeroed element, HANDLE_NONE if the pool is full */
+handle pool_alloc(pool *p);
+/* release element, false if h is stale */
+bool pool_free(pool *p, handle h);
+/* element of h or NULL if h is stale */
+void *pool_get(const pool *p, handle h);
+/* true if h still refers to a live element */
+bool pool_valid(const pool *p, handle h);
+/* live element at dense index i, 0 <= i < count */
+void *pool_at(const pool *p, uint32_t i);
+/* handle of live element at dense index i */
+handle pool_handle_at(const pool *p, uint32_t i);
+
+#endif /* _POOL_H_ */
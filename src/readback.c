@@ -0,0 +1,78 @@
+/* *
+ * fenced ring of gpu results read by the cpu
+ * */
+#include <stdio.h>
+#include <string.h>
+
+#include "glstate.h"
+#include "pacer.h"
+#include "readback.h"
+#include "utils.h"
+
+/* READBACK */
+
+bool readback_init(readback_ring *rb, GLsizeiptr slot_size, bool writable) {
+  memset(rb, 0, sizeof(*rb));
+  rb->slot_size = slot_size;
+
+  GLsizeiptr size = slot_size * READBACK_FRAMES;
+  GLbitfield flags =
+      GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  if (writable) {
+    flags |= GL_MAP_WRITE_BIT;
+  }
+  glad_glGenBuffers(1, &rb->buffer);
+  glstate_bind_buffer(GL_SHADER_STORAGE_BUFFER, rb->buffer);
+  glad_glBufferStorage(GL_SHADER_STORAGE_BUFFER, size, NULL, flags);
+  rb->data = glad_glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, flags);
+  if (not rb->data) {
+    fprintf(stderr, "ERROR: could not map readback buffer\n");
+    readback_destroy(rb);
+    return false;
+  }
+  return true;
+}
+
+void readback_destroy(readback_ring *rb) {
+  for (int i = 0; i < READBACK_FRAMES; ++i) {
+    if (rb->fences[i]) {
+      glad_glDeleteSync(rb->fences[i]);
+    }
+  }
+  if (rb->data) {
+    glstate_bind_buffer(GL_SHADER_STORAGE_BUFFER, rb->buffer);
+    glad_glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+  }
+  glstate_forget_buffer(rb->buffer);
+  glad_glDeleteBuffers(1, &rb->buffer);
+  memset(rb, 0, sizeof(*rb));
+}
+
+const void *readback_begin(readback_ring *rb) {
+  GLsync fence = rb->fences[rb->slot];
+  if (not fence) {
+    return NULL;
+  }
+
+  bool done = pacer_wait_fence(fence);
+  glad_glDeleteSync(fence);
+  rb->fences[rb->slot] = NULL;
+  if (not done) {
+    fprintf(stderr, "ERROR: readback fence wait failed\n");
+    return NULL;
+  }
+  return readback_slot(rb);
+}
+
+void *readback_slot(const readback_ring *rb) {
+  return rb->data + readback_offset(rb);
+}
+
+GLintptr readback_offset(const readback_ring *rb) {
+  return (GLintptr)rb->slot * rb->slot_size;
+}
+
+void readback_end(readback_ring *rb) {
+  rb->fences[rb->slot] = glad_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  rb->slot = (rb->slot + 1) % READBACK_FRAMES;
+}
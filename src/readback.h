@@ -0,0 +1,50 @@
+#ifndef _READBACK_H_
+#define _READBACK_H_
+
+#include <stdbool.h>
+
+#include "glad/glad.h"
+
+// results are read back this many frames after the gpu wrote them
+#define READBACK_FRAMES 3
+
+/* *
+ * ring of persistently mapped slots the gpu writes results into
+ *
+ * each frame writes the current slot and fences it. the slot comes round
+ * again READBACK_FRAMES frames later, by then the fence is long done and
+ * the wait before reading it almost never blocks.
+ * */
+struct readback_ring {
+  GLuint buffer;
+  unsigned char *data;
+  GLsizeiptr slot_size;
+  GLsync fences[READBACK_FRAMES];
+  int slot;
+};
+typedef struct readback_ring readback_ring;
+
+/* *
+ * create and map READBACK_FRAMES slots of slot_size bytes
+ *
+ * writable lets the cpu reset a slot before the gpu writes it.
+ * */
+bool readback_init(readback_ring *rb, GLsizeiptr slot_size, bool writable);
+/* unmap and delete the buffer and pending fences */
+void readback_destroy(readback_ring *rb);
+
+/* *
+ * wait for the frame that last wrote the current slot
+ *
+ * @return that frames results, NULL if the slot was never fenced or the
+ * wait failed.
+ * */
+const void *readback_begin(readback_ring *rb);
+/* mapped current slot, for the cpu to reset before it is written */
+void *readback_slot(const readback_ring *rb);
+/* byte offset of the current slot in buffer */
+GLintptr readback_offset(const readback_ring *rb);
+/* fence the commands writing the current slot and move to the next */
+void readback_end(readback_ring *rb);
+
+#endif
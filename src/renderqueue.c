@@ -0,0 +1,247 @@
+/* *
+ * render queue
+ * */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glstate.h"
+#include "renderqueue.h"
+#include "utils.h"
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+
+/* HELPERS */
+
+internal uint64_t mask_bits(unsigned value, int bits) {
+  return (uint64_t)value & ((1ull << bits) - 1);
+}
+
+/* *
+ * positive floats compare like their bit patterns, keep the top bits
+ * below the sign bit
+ * */
+internal uint64_t depth_bits(float depth) {
+  if (not(depth > 0.0f)) {
+    return 0;
+  }
+
+  union {
+    float f;
+    uint32_t u;
+  } bits = {.f = depth};
+
+  return (bits.u >> (31 - RENDER_DEPTH_BITS)) &
+         ((1u << RENDER_DEPTH_BITS) - 1);
+}
+
+internal bool queue_reserve(render_queue *q, uint32_t capacity) {
+  if (capacity <= q->capacity) {
+    return true;
+  }
+
+  render_item *items = realloc(q->items, sizeof(*items) * capacity);
+  render_sort_entry *sorted = realloc(q->sorted, sizeof(*sorted) * capacity);
+  render_sort_entry *scratch =
+      realloc(q->scratch, sizeof(*scratch) * capacity);
+  render_batch *batches = realloc(q->batches, sizeof(*batches) * capacity);
+  uint32_t *draw_objects =
+      realloc(q->draw_objects, sizeof(*draw_objects) * capacity);
+
+  // keep whatever succeeded so destroy can free it
+  if (items) {
+    q->items = items;
+  }
+  if (sorted) {
+    q->sorted = sorted;
+  }
+  if (scratch) {
+    q->scratch = scratch;
+  }
+  if (batches) {
+    q->batches = batches;
+  }
+  if (draw_objects) {
+    q->draw_objects = draw_objects;
+  }
+
+  if (not items or not sorted or not scratch or not batches or
+      not draw_objects) {
+    fprintf(stderr, "ERROR: render queue failed to grow to %u items\n",
+            capacity);
+    return false;
+  }
+
+  q->capacity = capacity;
+  return true;
+}
+
+/* KEYS */
+
+uint64_t render_key_opaque(unsigned pass, unsigned program, unsigned material,
+                           float depth) {
+  uint64_t key = mask_bits(pass, RENDER_PASS_BITS) << 60;
+  key |= mask_bits(program, RENDER_PROGRAM_BITS) << 48;
+  key |= mask_bits(material, RENDER_MATERIAL_BITS) << 32;
+  key |= depth_bits(depth);
+  return key;
+}
+
+uint64_t render_key_transparent(unsigned pass, unsigned program,
+                                unsigned material, float depth) {
+  uint64_t far = ((1u << RENDER_DEPTH_BITS) - 1) - depth_bits(depth);
+
+  uint64_t key = mask_bits(pass, RENDER_PASS_BITS) << 60;
+  key |= far << 36;
+  key |= mask_bits(program, RENDER_PROGRAM_BITS) << 24;
+  key |= mask_bits(material, RENDER_MATERIAL_BITS) << 8;
+  return key;
+}
+
+/* QUEUE */
+
+bool render_queue_init(render_queue *q, uint32_t capacity) {
+  assert(capacity > 0);
+  memset(q, 0, sizeof(*q));
+  return queue_reserve(q, capacity);
+}
+
+void render_queue_destroy(render_queue *q) {
+  free(q->items);
+  free(q->sorted);
+  free(q->scratch);
+  free(q->batches);
+  free(q->draw_objects);
+  memset(q, 0, sizeof(*q));
+}
+
+void render_queue_clear(render_queue *q) {
+  q->count = 0;
+  q->batch_count = 0;
+}
+
+bool render_queue_push(render_queue *q, const render_item *item) {
+  if (q->count == q->capacity and not queue_reserve(q, q->capacity * 2)) {
+    return false;
+  }
+
+  q->items[q->count] = *item;
+  q->sorted[q->count] = (render_sort_entry){.key = item->key,
+                                            .index = q->count};
+  ++q->count;
+  return true;
+}
+
+void render_queue_sort(render_queue *q) {
+  uint32_t n = q->count;
+  if (n < 2) {
+    return;
+  }
+
+  // all histograms in one read of the keys, 8KB on the stack so queues can
+  // sort on different threads
+  uint32_t histogram[RADIX_PASSES][RADIX_BUCKETS] = {0};
+
+  for (uint32_t i = 0; i < n; ++i) {
+    uint64_t key = q->sorted[i].key;
+    for (int p = 0; p < RADIX_PASSES; ++p) {
+      ++histogram[p][(key >> (p * RADIX_BITS)) & (RADIX_BUCKETS - 1)];
+    }
+  }
+
+  render_sort_entry *src = q->sorted;
+  render_sort_entry *dst = q->scratch;
+
+  for (int p = 0; p < RADIX_PASSES; ++p) {
+    uint32_t *counts = histogram[p];
+    int shift = p * RADIX_BITS;
+
+    // every key shares this byte, pass would not move anything
+    if (counts[(src[0].key >> shift) & (RADIX_BUCKETS - 1)] == n) {
+      continue;
+    }
+
+    uint32_t offset = 0;
+    for (int b = 0; b < RADIX_BUCKETS; ++b) {
+      uint32_t c = counts[b];
+      counts[b] = offset;
+      offset += c;
+    }
+
+    for (uint32_t i = 0; i < n; ++i) {
+      uint32_t b = (src[i].key >> shift) & (RADIX_BUCKETS - 1);
+      dst[counts[b]++] = src[i];
+    }
+
+    render_sort_entry *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  q->sorted = src;
+  q->scratch = dst;
+}
+
+bool render_queue_build(render_queue *q, draw_list *dl) {
+  // draw ids line up with sorted positions
+  assert(dl->count == 0);
+  q->batch_count = 0;
+
+  render_batch *batch = NULL;
+  for (uint32_t i = 0; i < q->count; ++i) {
+    const render_item *item = &q->items[q->sorted[i].index];
+
+    GLuint draw_id = 0;
+    if (not draw_list_push(dl, item->count, item->first_index,
+                           item->base_vertex, 1, &draw_id)) {
+      return false;
+    }
+    q->draw_objects[draw_id] = item->object;
+
+    bool same = batch and batch->program == item->program and
+                batch->vao == item->vao and batch->texture == item->texture;
+    if (same) {
+      ++batch->count;
+      continue;
+    }
+
+    batch = &q->batches[q->batch_count++];
+    batch->program = item->program;
+    batch->vao = item->vao;
+    batch->texture = item->texture;
+    batch->first = dl->count - 1;
+    batch->count = 1;
+  }
+  return true;
+}
+
+void render_queue_execute(render_queue *q, const draw_list *dl, GLenum mode) {
+  render_queue_stats stats = {0};
+  stats.items = q->count;
+  stats.batches = q->batch_count;
+
+  for (uint32_t i = 0; i < q->batch_count; ++i) {
+    const render_batch *batch = &q->batches[i];
+    const render_batch *prev = i > 0 ? &q->batches[i - 1] : NULL;
+
+    if (not prev or prev->program != batch->program) {
+      ++stats.program_changes;
+      glstate_use_program(batch->program);
+    }
+    if (not prev or prev->vao != batch->vao) {
+      ++stats.vao_changes;
+      glstate_bind_vertex_array(batch->vao);
+    }
+    if (not prev or prev->texture != batch->texture) {
+      ++stats.texture_changes;
+      glstate_bind_texture(0, GL_TEXTURE_2D, batch->texture);
+    }
+
+    draw_list_submit_range(dl, mode, batch->first, batch->count);
+  }
+
+  q->stats = stats;
+}
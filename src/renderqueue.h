@@ -0,0 +1,115 @@
+#ifndef _RENDERQUEUE_H_
+#define _RENDERQUEUE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "drawlist.h"
+#include "glad/glad.h"
+
+/* *
+ * sort key bit layout, most significant first
+ *
+ * opaque      | pass 4 | program 12 | material 16 | unused 8 | depth 24 |
+ * transparent | pass 4 | far depth 24 | program 12 | material 16 | unused 8 |
+ *
+ * opaque draws group by state and go front to back inside a state so
+ * early-z rejects hidden fragments, transparent draws go back to front.
+ * */
+#define RENDER_PASS_BITS 4
+#define RENDER_PROGRAM_BITS 12
+#define RENDER_MATERIAL_BITS 16
+#define RENDER_DEPTH_BITS 24
+
+enum render_pass {
+  RENDER_PASS_OPAQUE = 0,
+  RENDER_PASS_TRANSPARENT = 8,
+};
+
+/* *
+ * one draw, state it needs plus its slice of the shared index buffer
+ * */
+struct render_item {
+  uint64_t key;
+  uint32_t object;
+
+  GLuint program;
+  GLuint vao;
+  GLuint texture;
+
+  GLuint count;
+  GLuint first_index;
+  GLint base_vertex;
+};
+typedef struct render_item render_item;
+
+/* *
+ * run of sorted draws sharing program, vao and texture
+ * */
+struct render_batch {
+  GLuint program;
+  GLuint vao;
+  GLuint texture;
+  GLsizei first;
+  GLsizei count;
+};
+typedef struct render_batch render_batch;
+
+struct render_queue_stats {
+  unsigned items;
+  unsigned batches;
+  unsigned program_changes;
+  unsigned vao_changes;
+  unsigned texture_changes;
+};
+typedef struct render_queue_stats render_queue_stats;
+
+struct render_sort_entry {
+  uint64_t key;
+  uint32_t index;
+};
+typedef struct render_sort_entry render_sort_entry;
+
+struct render_queue {
+  render_item *items;
+  render_sort_entry *sorted;
+  render_sort_entry *scratch;
+  uint32_t count;
+  uint32_t capacity;
+
+  render_batch *batches;
+  uint32_t batch_count;
+
+  // object of each draw id written by render_queue_build
+  uint32_t *draw_objects;
+
+  render_queue_stats stats;
+};
+typedef struct render_queue render_queue;
+
+/* key for opaque geometry, depth is a positive view distance */
+uint64_t render_key_opaque(unsigned pass, unsigned program, unsigned material,
+                           float depth);
+/* key for blended geometry, sorted back to front */
+uint64_t render_key_transparent(unsigned pass, unsigned program,
+                                unsigned material, float depth);
+
+/* create queue able to hold capacity items before growing */
+bool render_queue_init(render_queue *q, uint32_t capacity);
+/* free queue storage */
+void render_queue_destroy(render_queue *q);
+/* remove all items */
+void render_queue_clear(render_queue *q);
+/* add a copy of item, false if the queue could not grow */
+bool render_queue_push(render_queue *q, const render_item *item);
+/* radix sort items by key */
+void render_queue_sort(render_queue *q);
+/* *
+ * record sorted items into a cleared dl and split them into state batches,
+ * false if dl could not grow
+ * */
+bool render_queue_build(render_queue *q, draw_list *dl);
+/* bind state per batch and submit its range of dl */
+void render_queue_execute(render_queue *q, const draw_list *dl, GLenum mode);
+
+#endif /* _RENDERQUEUE_H_ */
@@ -0,0 +1,177 @@
+/* *
+ * render thread
+ * */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "renderthread.h"
+#include "utils.h"
+
+/* HELPERS */
+
+internal double now_ms(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+internal int render_main(void *arg) {
+  render_thread *rt = arg;
+  rt->attach(rt->user);
+
+  mtx_lock(&rt->lock);
+  for (;;) {
+    double wait_start = now_ms();
+    while (rt->running and rt->state[rt->read] != RENDER_PACKET_READY) {
+      cnd_wait(&rt->changed, &rt->lock);
+    }
+    // stopped and everything submitted has been rendered
+    if (rt->state[rt->read] != RENDER_PACKET_READY) {
+      break;
+    }
+
+    int slot = rt->read;
+    rt->state[slot] = RENDER_PACKET_RENDERING;
+    rt->stats.render_wait_ms += now_ms() - wait_start;
+    mtx_unlock(&rt->lock);
+
+    double start = now_ms();
+    rt->frame(rt->user, rt->packets[slot]);
+    double elapsed = now_ms() - start;
+
+    mtx_lock(&rt->lock);
+    rt->stats.render_ms += elapsed;
+    ++rt->stats.frames;
+    rt->state[slot] = RENDER_PACKET_FREE;
+    rt->read = (slot + 1) % RENDER_PACKETS;
+    cnd_broadcast(&rt->changed);
+  }
+  mtx_unlock(&rt->lock);
+
+  rt->detach(rt->user);
+  return 0;
+}
+
+/* RENDER THREAD */
+
+bool render_thread_start(render_thread *rt, void *packets[RENDER_PACKETS],
+                         render_frame_fn frame, render_context_fn attach,
+                         render_context_fn detach, void *user, bool threaded) {
+  memset(rt, 0, sizeof(*rt));
+  for (int i = 0; i < RENDER_PACKETS; ++i) {
+    rt->packets[i] = packets[i];
+    rt->state[i] = RENDER_PACKET_FREE;
+  }
+  rt->frame = frame;
+  rt->attach = attach;
+  rt->detach = detach;
+  rt->user = user;
+  rt->threaded = threaded;
+  rt->stats_since = now_ms();
+
+  if (not threaded) {
+    rt->attach(rt->user);
+    return true;
+  }
+
+  if (mtx_init(&rt->lock, mtx_plain) != thrd_success) {
+    fprintf(stderr, "ERROR: render thread failed to create lock\n");
+    return false;
+  }
+  if (cnd_init(&rt->changed) != thrd_success) {
+    fprintf(stderr, "ERROR: render thread failed to create condition\n");
+    mtx_destroy(&rt->lock);
+    return false;
+  }
+
+  rt->running = true;
+  if (thrd_create(&rt->thread, render_main, rt) != thrd_success) {
+    fprintf(stderr, "ERROR: render thread failed to start\n");
+    cnd_destroy(&rt->changed);
+    mtx_destroy(&rt->lock);
+    return false;
+  }
+
+  return true;
+}
+
+void render_thread_stop(render_thread *rt) {
+  if (not rt->threaded) {
+    rt->detach(rt->user);
+    return;
+  }
+
+  mtx_lock(&rt->lock);
+  rt->running = false;
+  cnd_broadcast(&rt->changed);
+  mtx_unlock(&rt->lock);
+
+  thrd_join(rt->thread, NULL);
+  cnd_destroy(&rt->changed);
+  mtx_destroy(&rt->lock);
+  // stats stay readable without the lock
+  rt->threaded = false;
+}
+
+void *render_thread_acquire(render_thread *rt) {
+  int slot = rt->write;
+
+  if (not rt->threaded) {
+    rt->acquired_at = now_ms();
+    rt->state[slot] = RENDER_PACKET_RECORDING;
+    return rt->packets[slot];
+  }
+
+  double wait_start = now_ms();
+  mtx_lock(&rt->lock);
+  while (rt->state[slot] != RENDER_PACKET_FREE) {
+    cnd_wait(&rt->changed, &rt->lock);
+  }
+  rt->state[slot] = RENDER_PACKET_RECORDING;
+  rt->acquired_at = now_ms();
+  rt->stats.main_wait_ms += rt->acquired_at - wait_start;
+  mtx_unlock(&rt->lock);
+
+  return rt->packets[slot];
+}
+
+void render_thread_submit(render_thread *rt) {
+  int slot = rt->write;
+  assert(rt->state[slot] == RENDER_PACKET_RECORDING);
+  rt->write = (slot + 1) % RENDER_PACKETS;
+
+  if (not rt->threaded) {
+    double start = now_ms();
+    rt->stats.main_ms += start - rt->acquired_at;
+    rt->frame(rt->user, rt->packets[slot]);
+    rt->stats.render_ms += now_ms() - start;
+    ++rt->stats.frames;
+    rt->state[slot] = RENDER_PACKET_FREE;
+    return;
+  }
+
+  mtx_lock(&rt->lock);
+  rt->stats.main_ms += now_ms() - rt->acquired_at;
+  rt->state[slot] = RENDER_PACKET_READY;
+  cnd_broadcast(&rt->changed);
+  mtx_unlock(&rt->lock);
+}
+
+render_thread_stats render_thread_take_stats(render_thread *rt) {
+  if (rt->threaded) {
+    mtx_lock(&rt->lock);
+  }
+
+  double now = now_ms();
+  render_thread_stats stats = rt->stats;
+  stats.wall_ms = now - rt->stats_since;
+  memset(&rt->stats, 0, sizeof(rt->stats));
+  rt->stats_since = now;
+
+  if (rt->threaded) {
+    mtx_unlock(&rt->lock);
+  }
+  return stats;
+}
@@ -0,0 +1,94 @@
+#ifndef _RENDERTHREAD_H_
+#define _RENDERTHREAD_H_
+
+#include <stdbool.h>
+#include <threads.h>
+
+// packets in flight, the main thread records one while the other renders
+#define RENDER_PACKETS 2
+
+/* submit one recorded packet, runs on the thread owning the context */
+typedef void (*render_frame_fn)(void *user, void *packet);
+/* make the context current on, or release it from, the calling thread */
+typedef void (*render_context_fn)(void *user);
+
+/* *
+ * timings summed since the last render_thread_take_stats
+ *
+ * main and render time overlap when threaded, so
+ * (main_ms + render_ms) / wall_ms is the throughput gain over running
+ * both on one thread, 1.0 when inline.
+ * */
+struct render_thread_stats {
+  unsigned frames;
+  // main thread between acquire and submit
+  double main_ms;
+  // main thread blocked in acquire waiting for a free packet
+  double main_wait_ms;
+  // render thread inside the frame callback
+  double render_ms;
+  // render thread waiting for a packet
+  double render_wait_ms;
+  double wall_ms;
+};
+typedef struct render_thread_stats render_thread_stats;
+
+enum render_packet_state {
+  RENDER_PACKET_FREE,
+  RENDER_PACKET_RECORDING,
+  RENDER_PACKET_READY,
+  RENDER_PACKET_RENDERING,
+};
+typedef enum render_packet_state render_packet_state;
+
+/* *
+ * double buffered hand off between the main thread and a render thread
+ *
+ * the main thread acquires a packet, records a frame into it and submits
+ * it. the render thread submits packets in order while the main thread
+ * records the next one. inline mode runs the frame callback inside submit
+ * on the caller, for comparison.
+ * */
+struct render_thread {
+  void *packets[RENDER_PACKETS];
+  render_packet_state state[RENDER_PACKETS];
+  int write;
+  int read;
+
+  render_frame_fn frame;
+  render_context_fn attach;
+  render_context_fn detach;
+  void *user;
+
+  bool threaded;
+  bool running;
+  thrd_t thread;
+  mtx_t lock;
+  cnd_t changed;
+
+  double acquired_at;
+  double stats_since;
+  render_thread_stats stats;
+};
+typedef struct render_thread render_thread;
+
+/* *
+ * start rendering packets with frame, attach and detach are called on the
+ * render thread around it, the caller must not hold the context when
+ * threaded is true
+ * */
+bool render_thread_start(render_thread *rt, void *packets[RENDER_PACKETS],
+                         render_frame_fn frame, render_context_fn attach,
+                         render_context_fn detach, void *user, bool threaded);
+/* render queued packets then stop, the context is released */
+void render_thread_stop(render_thread *rt);
+
+/* wait for the next free packet and return it for recording */
+void *render_thread_acquire(render_thread *rt);
+/* hand the acquired packet to the render thread */
+void render_thread_submit(render_thread *rt);
+
+/* timings since the last call, then reset them */
+render_thread_stats render_thread_take_stats(render_thread *rt);
+
+#endif /* _RENDERTHREAD_H_ */
@@ -0,0 +1,430 @@
+/* *
+ * cascaded shadow maps
+ * */
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glstate.h"
+#include "mesh.h"
+#include "shadows.h"
+#include "utils.h"
+
+// casters this far towards the light from a cascade still shadow it
+#define CASTER_REACH 20.0f
+// 0 spaces the splits evenly, 1 logarithmically
+#define SPLIT_BLEND 0.75f
+// the bounding radius is rounded up to this, so float noise in the
+// camera matrix cannot change the size of a cascade
+#define RADIUS_STEP (1.0f / 16.0f)
+// slope scaled bias while drawing casters, against acne on lit faces
+#define OFFSET_FACTOR 2.0f
+#define OFFSET_UNITS 4.0f
+#define INITIAL_CASTERS 64
+
+// uniform location in shadow.vert
+#define CASCADE_VIEW_PROJECTION 0
+
+/* HELPERS */
+
+internal GLuint create_layers(GLsizei size, GLsizei layers) {
+  GLuint texture = 0;
+  glad_glGenTextures(1, &texture);
+  glstate_bind_texture(0, GL_TEXTURE_2D_ARRAY, texture);
+  glad_glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, size,
+                      size, layers);
+  glad_glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glad_glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  return texture;
+}
+
+/* 1 outside every cascade, lit */
+internal void compare_lookups(GLuint texture) {
+  const GLfloat far[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+  glstate_bind_texture(0, GL_TEXTURE_2D_ARRAY, texture);
+  // a linear compare filters the 2x2 nearest results
+  glad_glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glad_glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glad_glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE,
+                       GL_COMPARE_REF_TO_TEXTURE);
+  glad_glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC,
+                       GL_LEQUAL);
+  glad_glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S,
+                       GL_CLAMP_TO_BORDER);
+  glad_glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T,
+                       GL_CLAMP_TO_BORDER);
+  glad_glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, far);
+}
+
+internal void upload_block(shadow_map *sm) {
+  glstate_bind_buffer(GL_UNIFORM_BUFFER, sm->block_buffer);
+  glad_glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(sm->block), &sm->block);
+}
+
+/* keep the last pass time whose timestamps are in, without waiting */
+internal void read_slot(shadow_map *sm, int slot) {
+  if (not sm->pending[slot]) {
+    return;
+  }
+  GLuint available = GL_FALSE;
+  glad_glGetQueryObjectuiv(sm->queries[slot][1], GL_QUERY_RESULT_AVAILABLE,
+                           &available);
+  if (not available) {
+    return;
+  }
+  GLuint64 start = 0;
+  GLuint64 end = 0;
+  glad_glGetQueryObjectui64v(sm->queries[slot][0], GL_QUERY_RESULT, &start);
+  glad_glGetQueryObjectui64v(sm->queries[slot][1], GL_QUERY_RESULT, &end);
+  sm->gpu_ms = (double)(end - start) / 1000000.0;
+  sm->pending[slot] = false;
+}
+
+internal void attach_layer(GLuint texture, int layer, bool clear) {
+  glad_glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture,
+                                 0, layer);
+  if (clear) {
+    glad_glClear(GL_DEPTH_BUFFER_BIT);
+  }
+}
+
+internal bool same_caster(const shadow_caster *a, const shadow_caster *b) {
+  return a->count == b->count and a->first_index == b->first_index and
+         memcmp(&a->model, &b->model, sizeof(mat4)) == 0;
+}
+
+internal void draw_casters(shadow_map *sm, const mat4 *view_projection,
+                           GLsizei first, GLsizei count) {
+  if (count <= 0) {
+    return;
+  }
+  glad_glProgramUniformMatrix4fv(sm->program, CASCADE_VIEW_PROJECTION, 1,
+                                 GL_FALSE, &view_projection->_11);
+  draw_list_submit_range(&sm->casters, GL_TRIANGLES, first, count);
+}
+
+/* SHADOWS */
+
+bool shadow_init(shadow_map *sm, GLsizei size, GLuint program, float fov,
+                 float aspect, float near, float distance,
+                 GLuint vertex_buffer, GLuint index_buffer) {
+  assert(size > 0);
+  assert(near > 0.0f and distance > near);
+  memset(sm, 0, sizeof(*sm));
+  sm->size = size;
+  sm->program = program;
+  sm->fov = fov;
+  sm->aspect = aspect;
+  sm->near = near;
+  sm->distance = distance;
+  sm->split_blend = SPLIT_BLEND;
+
+  sm->models = malloc(sizeof(*sm->models) * INITIAL_CASTERS);
+  sm->statics = malloc(sizeof(*sm->statics) * INITIAL_CASTERS);
+  sm->model_capacity = INITIAL_CASTERS;
+  if (not sm->models or not sm->statics or
+      not draw_list_init(&sm->casters, INITIAL_CASTERS)) {
+    fprintf(stderr, "ERROR: shadow casters failed to allocate\n");
+    free(sm->models);
+    free(sm->statics);
+    sm->models = NULL;
+    sm->statics = NULL;
+    return false;
+  }
+
+  sm->depth = create_layers(size, SHADOW_CASCADES);
+  compare_lookups(sm->depth);
+  sm->cache = create_layers(size, SHADOW_CASCADES - SHADOW_CACHED_FIRST);
+
+  // depth only, nothing is read or drawn to a colour buffer
+  glad_glGenFramebuffers(1, &sm->framebuffer);
+  glstate_bind_framebuffer(GL_FRAMEBUFFER, sm->framebuffer);
+  glad_glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                 sm->depth, 0, 0);
+  glad_glDrawBuffer(GL_NONE);
+  glad_glReadBuffer(GL_NONE);
+  GLenum status = glad_glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glstate_bind_framebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "ERROR: shadow framebuffer incomplete 0x%x\n", status);
+    shadow_destroy(sm);
+    return false;
+  }
+
+  // the same mesh, its own draw ids
+  glad_glGenVertexArrays(1, &sm->vao);
+  glstate_bind_vertex_array(sm->vao);
+  glstate_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+  mesh_bind_attributes(vertex_buffer, 0, 1, 3);
+  draw_list_bind_draw_id(&sm->casters, 2);
+  glstate_bind_vertex_array(0);
+
+  sm->caster_capacity = sizeof(mat4) * INITIAL_CASTERS;
+  glad_glGenBuffers(1, &sm->caster_buffer);
+  glstate_bind_buffer(GL_SHADER_STORAGE_BUFFER, sm->caster_buffer);
+  glad_glBufferData(GL_SHADER_STORAGE_BUFFER, sm->caster_capacity, NULL,
+                    GL_DYNAMIC_DRAW);
+
+  // no cascades until the first update, every lookup is lit
+  glad_glGenBuffers(1, &sm->block_buffer);
+  glstate_bind_buffer(GL_UNIFORM_BUFFER, sm->block_buffer);
+  glad_glBufferData(GL_UNIFORM_BUFFER, sizeof(sm->block), &sm->block,
+                    GL_DYNAMIC_DRAW);
+
+  glad_glGenQueries(SHADOW_READBACK_FRAMES * 2, &sm->queries[0][0]);
+  return true;
+}
+
+void shadow_destroy(shadow_map *sm) {
+  GLuint textures[2] = {sm->depth, sm->cache};
+  for (int i = 0; i < 2; ++i) {
+    glstate_forget_texture(textures[i]);
+  }
+  glad_glDeleteTextures(2, textures);
+  glstate_forget_framebuffer(sm->framebuffer);
+  glad_glDeleteFramebuffers(1, &sm->framebuffer);
+  glstate_forget_vertex_array(sm->vao);
+  glad_glDeleteVertexArrays(1, &sm->vao);
+  glstate_forget_buffer(sm->caster_buffer);
+  glstate_forget_buffer(sm->block_buffer);
+  glad_glDeleteBuffers(1, &sm->caster_buffer);
+  glad_glDeleteBuffers(1, &sm->block_buffer);
+  glad_glDeleteQueries(SHADOW_READBACK_FRAMES * 2, &sm->queries[0][0]);
+  draw_list_destroy(&sm->casters);
+  free(sm->models);
+  free(sm->statics);
+  memset(sm, 0, sizeof(*sm));
+}
+
+void shadow_update(shadow_map *sm, const mat4 *view, const vec3 *direction,
+                   bool enabled) {
+  vec3 along = vec3_normal(direction);
+  sm->block.sun[0] = -along.x;
+  sm->block.sun[1] = -along.y;
+  sm->block.sun[2] = -along.z;
+  sm->block.sun[3] = 0.0f;
+
+  mat4 camera;
+  if (not enabled or not mat4_inverse(&camera, view)) {
+    upload_block(sm);
+    return;
+  }
+
+  // light space turns with the light alone, so a still light keeps the
+  // texel grid still
+  vec3 origin = vec3_zero();
+  vec3 up = fabsf(along.y) > 0.99f ? vec3_new(1.0f, 0.0f, 0.0f)
+                                   : vec3_new(0.0f, 1.0f, 0.0f);
+  mat4 light_view = mat4_look_at(&origin, &along, &up);
+  // light clip space to shadow map uv and depth
+  mat4 to_texture = mat4_new(0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f,
+                             0.0f, 0.0f, 0.5f, 0.0f, 0.5f, 0.5f, 0.5f, 1.0f);
+
+  // squared half diagonal of a slice of the frustum per unit of depth
+  float tan_y = tanf(sm->fov * 0.5f);
+  float tan_x = tan_y * sm->aspect;
+  float diagonal = tan_x * tan_x + tan_y * tan_y;
+
+  float previous = sm->near;
+  for (int c = 0; c < SHADOW_CASCADES; ++c) {
+    float t = (float)(c + 1) / (float)SHADOW_CASCADES;
+    float log_split = sm->near * powf(sm->distance / sm->near, t);
+    float even_split = sm->near + (sm->distance - sm->near) * t;
+    float split = sm->split_blend * log_split +
+                  (1.0f - sm->split_blend) * even_split;
+
+    // on the view axis, as far from the near corners as from the far ones
+    float centre_depth = 0.5f * (previous + split) * (1.0f + diagonal);
+    if (centre_depth > split) {
+      centre_depth = split;
+    }
+    float to_far = split - centre_depth;
+    float to_near = centre_depth - previous;
+    float radius =
+        sqrtf(fmaxf(to_far * to_far + split * split * diagonal,
+                    to_near * to_near + previous * previous * diagonal));
+    radius = ceilf(radius / RADIUS_STEP) * RADIUS_STEP;
+
+    // view axis point to world, then to light space
+    float wx = -centre_depth * camera._31 + camera._41;
+    float wy = -centre_depth * camera._32 + camera._42;
+    float wz = -centre_depth * camera._33 + camera._43;
+    float lx = wx * light_view._11 + wy * light_view._21 +
+               wz * light_view._31 + light_view._41;
+    float ly = wx * light_view._12 + wy * light_view._22 +
+               wz * light_view._32 + light_view._42;
+    float lz = wx * light_view._13 + wy * light_view._23 +
+               wz * light_view._33 + light_view._43;
+
+    // whole texels only, the box slides under the scene without the
+    // rasterised edges changing
+    float texel = 2.0f * radius / (float)sm->size;
+    lx = floorf(lx / texel) * texel;
+    ly = floorf(ly / texel) * texel;
+    lz = floorf(lz / texel) * texel;
+
+    mat4 ortho = mat4_orthographic(lx - radius, lx + radius, ly - radius,
+                                   ly + radius, -lz - radius - CASTER_REACH,
+                                   -lz + radius);
+    sm->view_projection[c] = mat4_mul(&light_view, &ortho);
+    sm->block.cascade[c] = mat4_mul(&sm->view_projection[c], &to_texture);
+    sm->block.split[c] = split;
+    sm->block.texel[c] = texel;
+    previous = split;
+  }
+  sm->block.sun[3] = (float)SHADOW_CASCADES;
+  upload_block(sm);
+}
+
+/* *
+ * static casters first, so each kind is one range of draws. false if out
+ * of memory, nothing is to be drawn then.
+ * */
+internal bool record_casters(shadow_map *sm, const shadow_caster *casters,
+                             uint32_t count, GLsizei *statics) {
+  if (sm->model_capacity < count) {
+    uint32_t capacity = sm->model_capacity;
+    while (capacity < count) {
+      capacity *= 2;
+    }
+    mat4 *models = realloc(sm->models, sizeof(*models) * capacity);
+    if (models) {
+      sm->models = models;
+    }
+    shadow_caster *statics =
+        realloc(sm->statics, sizeof(*statics) * capacity);
+    if (statics) {
+      sm->statics = statics;
+    }
+    if (not models or not statics) {
+      fprintf(stderr, "ERROR: shadow casters failed to grow to %u\n",
+              capacity);
+      return false;
+    }
+    sm->model_capacity = capacity;
+  }
+
+  // the caches hold the statics they were drawn from, any change to those
+  // draws them again. a dropped cache stays dropped until it is drawn
+  uint32_t static_count = 0;
+  bool changed = false;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (not casters[i].is_static) {
+      continue;
+    }
+    changed = changed or static_count >= sm->static_count or
+              not same_caster(&sm->statics[static_count], &casters[i]);
+    sm->statics[static_count++] = casters[i];
+  }
+  if (changed or static_count != sm->static_count) {
+    shadow_invalidate(sm);
+  }
+  sm->static_count = static_count;
+
+  draw_list_clear(&sm->casters);
+  for (int pass = 0; pass < 2; ++pass) {
+    for (uint32_t i = 0; i < count; ++i) {
+      if (casters[i].is_static != (pass == 0)) {
+        continue;
+      }
+      GLuint id = 0;
+      if (not draw_list_push(&sm->casters, casters[i].count,
+                             casters[i].first_index, 0, 1, &id)) {
+        return false;
+      }
+      sm->models[id] = casters[i].model;
+    }
+    if (pass == 0) {
+      *statics = sm->casters.count;
+    }
+  }
+  return draw_list_upload(&sm->casters);
+}
+
+void shadow_render(shadow_map *sm, const shadow_caster *casters,
+                   uint32_t count, shadow_stats *stats) {
+  // the cascades of the last pass are kept
+  GLsizei statics = 0;
+  if (not record_casters(sm, casters, count, &statics)) {
+    draw_list_clear(&sm->casters);
+    *stats = (shadow_stats){.gpu_ms = sm->gpu_ms};
+    return;
+  }
+  GLsizei dynamics = sm->casters.count - statics;
+
+  int slot = sm->slot;
+  read_slot(sm, slot);
+  glad_glQueryCounter(sm->queries[slot][0], GL_TIMESTAMP);
+
+  GLsizeiptr size = sizeof(mat4) * count;
+  glstate_bind_buffer(GL_SHADER_STORAGE_BUFFER, sm->caster_buffer);
+  while (sm->caster_capacity < size) {
+    sm->caster_capacity *= 2;
+  }
+  // orphan so last frames pass can still read the old copy
+  glad_glBufferData(GL_SHADER_STORAGE_BUFFER, sm->caster_capacity, NULL,
+                    GL_DYNAMIC_DRAW);
+  glad_glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, sm->models);
+
+  glstate_bind_framebuffer(GL_FRAMEBUFFER, sm->framebuffer);
+  glstate_viewport(0, 0, sm->size, sm->size);
+  glstate_use_program(sm->program);
+  glstate_bind_vertex_array(sm->vao);
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, SHADOW_CASTER_BINDING,
+                           sm->caster_buffer);
+  glstate_enable(GL_DEPTH_TEST);
+  glstate_depth_mask(GL_TRUE);
+  glstate_enable(GL_POLYGON_OFFSET_FILL);
+  glad_glPolygonOffset(OFFSET_FACTOR, OFFSET_UNITS);
+
+  unsigned updates = 0;
+  for (int c = 0; c < SHADOW_CASCADES; ++c) {
+    const mat4 *view_projection = &sm->view_projection[c];
+    if (c < SHADOW_CACHED_FIRST) {
+      attach_layer(sm->depth, c, true);
+      draw_casters(sm, view_projection, 0, sm->casters.count);
+      continue;
+    }
+
+    // a moved box sees other static casters at other depths
+    int layer = c - SHADOW_CACHED_FIRST;
+    if (not sm->cache_valid[c] or
+        memcmp(&sm->cached[c], view_projection, sizeof(mat4)) != 0) {
+      attach_layer(sm->cache, layer, true);
+      draw_casters(sm, view_projection, 0, statics);
+      sm->cached[c] = *view_projection;
+      sm->cache_valid[c] = true;
+      ++updates;
+    }
+    glad_glCopyImageSubData(sm->cache, GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer,
+                            sm->depth, GL_TEXTURE_2D_ARRAY, 0, 0, 0, c,
+                            sm->size, sm->size, 1);
+    attach_layer(sm->depth, c, false);
+    draw_casters(sm, view_projection, statics, dynamics);
+  }
+
+  glstate_disable(GL_POLYGON_OFFSET_FILL);
+  glstate_bind_framebuffer(GL_FRAMEBUFFER, 0);
+  glad_glQueryCounter(sm->queries[slot][1], GL_TIMESTAMP);
+  sm->pending[slot] = true;
+  sm->slot = (slot + 1) % SHADOW_READBACK_FRAMES;
+
+  stats->casters = (unsigned)sm->casters.count;
+  stats->static_casters = (unsigned)statics;
+  stats->cache_updates = updates;
+  stats->gpu_ms = sm->gpu_ms;
+}
+
+void shadow_invalidate(shadow_map *sm) {
+  for (int c = 0; c < SHADOW_CASCADES; ++c) {
+    sm->cache_valid[c] = false;
+  }
+}
+
+void shadow_bind(const shadow_map *sm) {
+  glstate_bind_buffer_base(GL_UNIFORM_BUFFER, SHADOW_BLOCK_BINDING,
+                           sm->block_buffer);
+  glstate_bind_texture(SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, sm->depth);
+}
@@ -0,0 +1,157 @@
+#ifndef _SHADOWS_H_
+#define _SHADOWS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "drawlist.h"
+#include "glad/glad.h"
+#include "matrix.h"
+
+#define SHADOW_CASCADES 4
+// cascades from this one on keep their static casters between frames
+#define SHADOW_CACHED_FIRST 2
+// uniform block after the camera block, and caster models in shadow.vert
+#define SHADOW_BLOCK_BINDING 1
+#define SHADOW_CASTER_BINDING 12
+// texture unit of the cascades in the shading programs, after the
+// g-buffer units of deferred_light.comp
+#define SHADOW_TEXTURE_UNIT 3
+// pass times are read back this many frames later
+#define SHADOW_READBACK_FRAMES 3
+
+/* *
+ * cascade matrices and splits, std140
+ *
+ * layout(std140, binding = 1) uniform shadows {
+ *     mat4 cascade[4];   // world to shadow map uv and depth
+ *     vec4 split;        // far view depth of each cascade
+ *     vec4 texel;        // world size of a texel of each cascade
+ *     vec4 sun;          // direction towards the light, w cascades in use
+ * } shadow;
+ * */
+struct shadow_block {
+  mat4 cascade[SHADOW_CASCADES];
+  float split[4];
+  float texel[4];
+  float sun[4];
+};
+typedef struct shadow_block shadow_block;
+
+_Static_assert(SHADOW_CASCADES == 4, "split and texel hold one per vec4");
+_Static_assert(sizeof(shadow_block) == 304, "std140 shadow block size");
+
+/* *
+ * one shadow casting draw, a slice of the shared index buffer
+ * */
+struct shadow_caster {
+  mat4 model;
+  GLuint count;
+  GLuint first_index;
+  // never moves, kept in the cached cascades once drawn
+  bool is_static;
+};
+typedef struct shadow_caster shadow_caster;
+
+/* *
+ * work of the last shadow pass
+ *
+ * cache_updates counts the cached cascades whose static casters were
+ * drawn again, 0 on most frames. gpu_ms is SHADOW_READBACK_FRAMES old.
+ * */
+struct shadow_stats {
+  unsigned casters;
+  unsigned static_casters;
+  unsigned cache_updates;
+  double gpu_ms;
+};
+typedef struct shadow_stats shadow_stats;
+
+/* *
+ * cascaded shadow maps of one directional light
+ *
+ * the view frustum up to distance is cut into SHADOW_CASCADES slices,
+ * spaced between even and logarithmic by split_blend. every slice is
+ * bounded by a sphere so its orthographic box keeps one size as the
+ * camera turns, and the box is moved in whole texels in light space so
+ * edges do not crawl as the camera moves.
+ *
+ * the far cascades cover the most static geometry and change the least,
+ * their static casters are drawn once into a cache and copied in every
+ * frame under the moving casters. the cache is drawn again only when the
+ * cascade box changes, when the light or camera moves far enough, or when
+ * a static caster is added, removed, moved or changes its level.
+ * */
+struct shadow_map {
+  GLsizei size;
+  GLuint program;
+  float fov;
+  float aspect;
+  float near;
+  float distance;
+  float split_blend;
+
+  // one depth layer per cascade, and the static casters of cached ones
+  GLuint depth;
+  GLuint cache;
+  GLuint framebuffer;
+  GLuint vao;
+  GLuint block_buffer;
+  GLuint caster_buffer;
+  GLsizeiptr caster_capacity;
+  draw_list casters;
+  // caster models in draw order
+  mat4 *models;
+  // static casters the caches were drawn from, model_capacity of each
+  shadow_caster *statics;
+  uint32_t static_count;
+  uint32_t model_capacity;
+
+  shadow_block block;
+  // light view projection of each cascade, and that of its cache
+  mat4 view_projection[SHADOW_CASCADES];
+  mat4 cached[SHADOW_CASCADES];
+  bool cache_valid[SHADOW_CASCADES];
+
+  GLuint queries[SHADOW_READBACK_FRAMES][2];
+  bool pending[SHADOW_READBACK_FRAMES];
+  int slot;
+  double gpu_ms;
+};
+typedef struct shadow_map shadow_map;
+
+/* *
+ * create size x size cascades for the frustum of perspective(fov, aspect,
+ * near, far) shadowed up to distance
+ *
+ * program is linked from shadow.vert and stays with the caller, the
+ * casters are drawn from vertex_buffer and index_buffer laid out by
+ * mesh_upload.
+ * */
+bool shadow_init(shadow_map *sm, GLsizei size, GLuint program, float fov,
+                 float aspect, float near, float distance,
+                 GLuint vertex_buffer, GLuint index_buffer);
+/* delete textures, buffers and queries */
+void shadow_destroy(shadow_map *sm);
+
+/* *
+ * fit the cascades to the camera of view and a light shining along
+ * direction, and upload them. a disabled map reads as fully lit.
+ * */
+void shadow_update(shadow_map *sm, const mat4 *view, const vec3 *direction,
+                   bool enabled);
+/* *
+ * draw casters into every cascade, the cached cascades only draw the
+ * dynamic ones over their cache. leaves the default framebuffer bound.
+ * */
+void shadow_render(shadow_map *sm, const shadow_caster *casters,
+                   uint32_t count, shadow_stats *stats);
+/* *
+ * drop the caches, shadow_render does this itself when the static casters
+ * it is given differ from the last ones
+ * */
+void shadow_invalidate(shadow_map *sm);
+/* bind the block and the cascades for the shading programs */
+void shadow_bind(const shadow_map *sm);
+
+#endif /* _SHADOWS_H_ */
@@ -0,0 +1,174 @@
+/* *
+ * block compressed texture cache files
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bits.h"
+#include "filemap.h"
+#include "texcache.h"
+#include "utils.h"
+
+#define CACHE_ALIGN 16
+
+/* *
+ * cache file layout, levels follow the header largest first
+ * | header | level 0 | pad | level 1 | pad | ...
+ * */
+struct texcache_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levels;
+  uint64_t key;
+  uint64_t level_offset[TEXCACHE_MAX_LEVELS];
+  uint64_t reserved;
+};
+typedef struct texcache_header texcache_header;
+
+_Static_assert(sizeof(texcache_header) % CACHE_ALIGN == 0,
+               "cache data starts aligned");
+
+/* HELPERS */
+
+internal bool valid_format(uint32_t format) {
+  return format == BC_FORMAT_BC1 or format == BC_FORMAT_BC3 or
+         format == BC_FORMAT_BC7;
+}
+
+/* TEXCACHE */
+
+uint64_t texcache_key(const image *img) {
+  uint64_t hash = FNV_OFFSET;
+  hash = fnv_bytes(hash, &img->width, sizeof(img->width));
+  hash = fnv_bytes(hash, &img->height, sizeof(img->height));
+  return fnv_bytes(hash, img->pixels, (size_t)img->width * img->height * 4);
+}
+
+bool texcache_detect(const void *data, size_t size) {
+  return size >= 4 and memcmp(data, "BCTX", 4) == 0;
+}
+
+bool texcache_parse(texcache *tc, const void *data, size_t size) {
+  memset(tc, 0, sizeof(*tc));
+
+  texcache_header header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (not texcache_detect(data, size) or
+      header.version != TEXCACHE_VERSION or
+      not valid_format(header.format) or header.width == 0 or
+      header.height == 0 or header.width > IMAGE_MAX_SIZE or
+      header.height > IMAGE_MAX_SIZE or header.levels == 0 or
+      header.levels > (uint32_t)full_chain(header.width, header.height)) {
+    return false;
+  }
+
+  tc->format = (bc_format)header.format;
+  tc->width = header.width;
+  tc->height = header.height;
+  tc->levels = (int)header.levels;
+  tc->key = header.key;
+  for (int i = 0; i < tc->levels; ++i) {
+    size_t bytes =
+        bc_level_bytes(tc->format, level_extent(tc->width, i),
+                       level_extent(tc->height, i));
+    uint64_t offset = header.level_offset[i];
+    if (offset % CACHE_ALIGN != 0 or offset < sizeof(header) or
+        offset > size or bytes > size - offset) {
+      return false;
+    }
+    tc->level_data[i] = (const uint8_t *)data + offset;
+    tc->level_size[i] = bytes;
+  }
+  return true;
+}
+
+bool texcache_current(const char *path, uint64_t key) {
+  file_map map;
+  if (not file_map_open(&map, path)) {
+    return false;
+  }
+  texcache tc;
+  bool ok = texcache_parse(&tc, map.data, map.size) and tc.key == key;
+  file_map_close(&map);
+  return ok;
+}
+
+bool texcache_write(const char *path, const image *img, bc_format format,
+                    int levels, uint64_t key) {
+  int chain = full_chain(img->width, img->height);
+  if (levels <= 0 or levels > chain) {
+    levels = chain;
+  }
+
+  texcache_header header = {
+      .magic = {'B', 'C', 'T', 'X'},
+      .version = TEXCACHE_VERSION,
+      .format = format,
+      .width = img->width,
+      .height = img->height,
+      .levels = (uint32_t)levels,
+      .key = key,
+  };
+  size_t level_bytes[TEXCACHE_MAX_LEVELS];
+  uint64_t offset = sizeof(header);
+  for (int i = 0; i < levels; ++i) {
+    level_bytes[i] = bc_level_bytes(format, level_extent(img->width, i),
+                                    level_extent(img->height, i));
+    header.level_offset[i] = offset;
+    offset = align_up(offset + level_bytes[i], CACHE_ALIGN);
+  }
+
+  uint8_t *blocks = malloc(level_bytes[0]);
+  if (not blocks) {
+    fprintf(stderr, "ERROR: out of memory compressing %s\n", path);
+    return false;
+  }
+  FILE *fp = fopen(path, "wb");
+  if (not fp) {
+    fprintf(stderr, "ERROR: could not write %s\n", path);
+    free(blocks);
+    return false;
+  }
+
+  // each level is filtered from the one before, then encoded in place
+  local_persist const uint8_t zeros[CACHE_ALIGN] = {0};
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  image level = *img;
+  image next = {0};
+  for (int i = 0; ok and i < levels; ++i) {
+    if (i > 0) {
+      ok = image_downsample(&level, &next);
+      if (level.pixels != img->pixels) {
+        image_destroy(&level);
+      }
+      level = next;
+      memset(&next, 0, sizeof(next));
+      if (not ok) {
+        break;
+      }
+    }
+    bc_encode_image(format, &level, blocks);
+    size_t pad = (size_t)(align_up(level_bytes[i], CACHE_ALIGN) -
+                          level_bytes[i]);
+    ok = fwrite(blocks, 1, level_bytes[i], fp) == level_bytes[i] and
+         fwrite(zeros, 1, pad, fp) == pad;
+  }
+  if (level.pixels != img->pixels) {
+    image_destroy(&level);
+  }
+  free(blocks);
+  ok = fclose(fp) == 0 and ok;
+
+  if (not ok) {
+    fprintf(stderr, "ERROR: failed writing %s\n", path);
+    remove(path);
+  }
+  return ok;
+}
@@ -0,0 +1,49 @@
+#ifndef _TEXCACHE_H_
+#define _TEXCACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bcn.h"
+#include "image.h"
+
+// bump whenever the header layout or an encoder changes
+#define TEXCACHE_VERSION 1
+#define TEXCACHE_MAX_LEVELS 15
+
+/* *
+ * block compressed texture with its mip chain, read from a .btx file
+ *
+ * levels point into the file data, which has to outlive this. blocks are
+ * bottom row first so each level goes to gl as is. key is whatever the
+ * writer used to identify the source, see texcache_key.
+ * */
+struct texcache {
+  bc_format format;
+  uint32_t width;
+  uint32_t height;
+  int levels;
+  uint64_t key;
+  const uint8_t *level_data[TEXCACHE_MAX_LEVELS];
+  size_t level_size[TEXCACHE_MAX_LEVELS];
+};
+typedef struct texcache texcache;
+
+/* fnv-1a of the image size and pixels */
+uint64_t texcache_key(const image *img);
+/* true if data starts like a .btx file */
+bool texcache_detect(const void *data, size_t size);
+/* point tc at the levels in data, false if it is not a valid .btx */
+bool texcache_parse(texcache *tc, const void *data, size_t size);
+/* true if path holds a valid cache written with key */
+bool texcache_current(const char *path, uint64_t key);
+
+/* *
+ * build levels mips of img, 0 for a full chain, encode them as format and
+ * write them to path
+ * */
+bool texcache_write(const char *path, const image *img, bc_format format,
+                    int levels, uint64_t key);
+
+#endif /* _TEXCACHE_H_ */
@@ -0,0 +1,538 @@
+/* *
+ * texture decoding and streaming uploads
+ * */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bits.h"
+#include "filemap.h"
+#include "glstate.h"
+#include "pacer.h"
+#include "texture.h"
+#include "utils.h"
+
+// from EXT_texture_compression_s3tc, not part of core gl
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/* HELPERS */
+
+internal GLenum compressed_format(bc_format format) {
+  switch (format) {
+  case BC_FORMAT_BC1:
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case BC_FORMAT_BC3:
+    return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  case BC_FORMAT_BC7:
+    return GL_COMPRESSED_RGBA_BPTC_UNORM;
+  }
+  return GL_NONE;
+}
+
+internal bool has_extension(const char *name) {
+  GLint count = 0;
+  glad_glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i) {
+    const char *ext = (const char *)glad_glGetStringi(GL_EXTENSIONS, (GLuint)i);
+    if (ext and strcmp(ext, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* *
+ * point the slot at the blocks of a .btx file, the mapping stays open
+ * until the upload is done
+ * */
+internal bool read_blocks(texture_streamer *ts, texture_slot *slot,
+                          const void *data, size_t size) {
+  if (not texcache_parse(&slot->blocks, data, size)) {
+    fprintf(stderr, "ERROR: %s is not a valid texture cache\n", slot->path);
+    return false;
+  }
+  if (slot->blocks.format != BC_FORMAT_BC7 and not ts->s3tc) {
+    fprintf(stderr, "ERROR: %s is %s, s3tc is not supported\n", slot->path,
+            bc_format_name(slot->blocks.format));
+    return false;
+  }
+  slot->compressed = true;
+  return true;
+}
+
+/* decode one slot, runs on the decoder thread */
+internal void decode_slot(texture_streamer *ts, texture_slot *slot) {
+  double start = pacer_now_ms();
+
+  // packed files are decoded straight from the mapping
+  const void *data = NULL;
+  size_t size = 0;
+  file_map map = {0};
+  bool mapped = false;
+  if (ts->assets) {
+    data = pack_find(ts->assets, slot->path, &size);
+  }
+  if (not data) {
+    mapped = file_map_open(&map, slot->path);
+    data = map.data;
+    size = map.size;
+  }
+
+  bool ok = false;
+  if (data and texcache_detect(data, size)) {
+    ok = read_blocks(ts, slot, data, size);
+    if (ok and mapped) {
+      slot->map = map;
+      slot->mapped = true;
+      mapped = false;
+    }
+  } else if (data) {
+    ok = image_decode(&slot->pixels, data, size);
+  }
+  if (mapped) {
+    file_map_close(&map);
+  }
+  if (not ok) {
+    fprintf(stderr, "ERROR: could not load texture %s\n", slot->path);
+  }
+
+  mtx_lock(&ts->lock);
+  ts->decode_ms += pacer_now_ms() - start;
+  mtx_unlock(&ts->lock);
+
+  atomic_store(&slot->state, ok ? TEXTURE_DECODED : TEXTURE_FAILED);
+  damage_mark(ts->damage, DAMAGE_RESOURCE);
+}
+
+internal int decoder_main(void *data) {
+  texture_streamer *ts = data;
+
+  mtx_lock(&ts->lock);
+  while (ts->running) {
+    if (ts->decoded == ts->requested) {
+      cnd_wait(&ts->wake, &ts->lock);
+      continue;
+    }
+    uint32_t id = ts->decoded++;
+    mtx_unlock(&ts->lock);
+
+    // images handed in decoded only pass through the queue
+    if (atomic_load(&ts->slots[id].state) == TEXTURE_QUEUED) {
+      decode_slot(ts, &ts->slots[id]);
+    }
+
+    mtx_lock(&ts->lock);
+  }
+  mtx_unlock(&ts->lock);
+  return 0;
+}
+
+/* block until the gpu is done copying out of region */
+internal void wait_staging(texture_streamer *ts, int region) {
+  GLsync fence = ts->fences[region];
+  if (not fence) {
+    return;
+  }
+
+  double start = pacer_now_ms();
+  if (not pacer_wait_fence(fence)) {
+    fprintf(stderr, "ERROR: texture staging fence wait failed\n");
+  }
+  ts->stats.staging_wait_ms += pacer_now_ms() - start;
+
+  glad_glDeleteSync(fence);
+  ts->fences[region] = NULL;
+}
+
+internal void begin_upload(texture_slot *slot) {
+  uint32_t width = slot->pixels.width;
+  uint32_t height = slot->pixels.height;
+  GLenum format = GL_RGBA8;
+  int levels = full_chain(width, height);
+  if (slot->compressed) {
+    width = slot->blocks.width;
+    height = slot->blocks.height;
+    format = compressed_format(slot->blocks.format);
+    levels = slot->blocks.levels;
+  } else if (slot->levels > 0 and slot->levels < levels) {
+    levels = slot->levels;
+  }
+  slot->levels = levels;
+
+  glad_glGenTextures(1, &slot->pending);
+  glstate_bind_texture(0, GL_TEXTURE_2D, slot->pending);
+  glad_glTexStorage2D(GL_TEXTURE_2D, levels, format, (GLsizei)width,
+                      (GLsizei)height);
+  glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                       GL_LINEAR_MIPMAP_LINEAR);
+  glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+  slot->rows_uploaded = 0;
+  slot->upload_level = 0;
+  atomic_store(&slot->state, TEXTURE_UPLOADING);
+}
+
+internal bool upload_done(const texture_slot *slot) {
+  if (slot->compressed) {
+    return slot->upload_level == slot->blocks.levels;
+  }
+  return slot->rows_uploaded == slot->pixels.height;
+}
+
+internal void finish_upload(texture_streamer *ts, texture_slot *slot) {
+  uint32_t width = slot->pixels.width;
+  uint32_t height = slot->pixels.height;
+  uint64_t bytes = 0;
+  if (slot->compressed) {
+    for (int i = 0; i < slot->levels; ++i) {
+      bytes += slot->blocks.level_size[i];
+    }
+  } else {
+    glstate_bind_texture(0, GL_TEXTURE_2D, slot->pending);
+    glad_glGenerateMipmap(GL_TEXTURE_2D);
+    for (int i = 0; i < slot->levels; ++i) {
+      bytes += (uint64_t)level_extent(width, i) * level_extent(height, i) * 4;
+    }
+  }
+
+  image_destroy(&slot->pixels);
+  if (slot->mapped) {
+    file_map_close(&slot->map);
+    slot->mapped = false;
+  }
+  ts->stats.resident_bytes += bytes;
+  atomic_store(&slot->name, slot->pending);
+  atomic_store(&slot->state, TEXTURE_RESIDENT);
+  slot->pending = 0;
+  ++ts->stats.resident;
+  damage_mark(ts->damage, DAMAGE_RESOURCE);
+}
+
+/* *
+ * copy as many rows as fit in the rest of the region and upload them
+ *
+ * images are top row first, gl rows start at the bottom, so each band is
+ * copied in reverse and lands at the matching rows from the top.
+ * */
+internal size_t upload_rows(texture_streamer *ts, texture_slot *slot,
+                            size_t used) {
+  const image *img = &slot->pixels;
+  size_t row_bytes = (size_t)img->width * 4;
+  uint32_t rows = (uint32_t)((ts->budget - used) / row_bytes);
+  if (rows > img->height - slot->rows_uploaded) {
+    rows = img->height - slot->rows_uploaded;
+  }
+  if (rows == 0) {
+    return 0;
+  }
+
+  size_t offset = (size_t)ts->region * ts->budget + used;
+  uint32_t first = slot->rows_uploaded;
+  for (uint32_t r = 0; r < rows; ++r) {
+    const uint8_t *src =
+        img->pixels + (size_t)(first + rows - 1 - r) * row_bytes;
+    memcpy(ts->staging_data + offset + r * row_bytes, src, row_bytes);
+  }
+
+  glstate_bind_texture(0, GL_TEXTURE_2D, slot->pending);
+  glad_glTexSubImage2D(GL_TEXTURE_2D, 0, 0,
+                       (GLint)(img->height - first - rows),
+                       (GLsizei)img->width, (GLsizei)rows, GL_RGBA,
+                       GL_UNSIGNED_BYTE, (const void *)(uintptr_t)offset);
+
+  slot->rows_uploaded += rows;
+  return rows * row_bytes;
+}
+
+/* *
+ * copy whole block rows, moving through the levels while the budget lasts.
+ * blocks are stored bottom row first so they go up unchanged
+ * */
+internal size_t upload_blocks(texture_streamer *ts, texture_slot *slot,
+                              size_t used) {
+  const texcache *tc = &slot->blocks;
+  GLenum format = compressed_format(tc->format);
+  size_t block_bytes = bc_block_bytes(tc->format);
+  size_t start = used;
+
+  glstate_bind_texture(0, GL_TEXTURE_2D, slot->pending);
+  while (slot->upload_level < tc->levels) {
+    int level = slot->upload_level;
+    uint32_t width = level_extent(tc->width, level);
+    uint32_t height = level_extent(tc->height, level);
+    size_t row_bytes = (size_t)((width + 3) / 4) * block_bytes;
+    uint32_t block_rows = (height + 3) / 4;
+    uint32_t rows = (uint32_t)((ts->budget - used) / row_bytes);
+    if (rows > block_rows - slot->rows_uploaded) {
+      rows = block_rows - slot->rows_uploaded;
+    }
+    if (rows == 0) {
+      break;
+    }
+
+    size_t offset = (size_t)ts->region * ts->budget + used;
+    size_t bytes = rows * row_bytes;
+    memcpy(ts->staging_data + offset,
+           tc->level_data[level] + slot->rows_uploaded * row_bytes, bytes);
+
+    // the last block row may hang over the top of the level
+    uint32_t y = slot->rows_uploaded * 4;
+    uint32_t rows_high = rows * 4 < height - y ? rows * 4 : height - y;
+    glad_glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, (GLint)y,
+                                   (GLsizei)width, (GLsizei)rows_high,
+                                   format, (GLsizei)bytes,
+                                   (const void *)(uintptr_t)offset);
+
+    used += bytes;
+    slot->rows_uploaded += rows;
+    if (slot->rows_uploaded == block_rows) {
+      slot->rows_uploaded = 0;
+      ++slot->upload_level;
+    }
+  }
+
+  return used - start;
+}
+
+/* TEXTURE */
+
+bool texture_streamer_init(texture_streamer *ts, size_t budget,
+                           const pack *assets, damage_tracker *damage) {
+  assert(budget >= (size_t)IMAGE_MAX_SIZE * 4);
+  memset(ts, 0, sizeof(*ts));
+  ts->budget = budget;
+  ts->assets = assets;
+  ts->damage = damage;
+
+  // written by the cpu and read by copies, never mapped again
+  GLsizeiptr size = (GLsizeiptr)(budget * TEXTURE_STAGING_FRAMES);
+  GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glad_glGenBuffers(1, &ts->staging);
+  glstate_bind_buffer(GL_PIXEL_UNPACK_BUFFER, ts->staging);
+  glad_glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+  ts->staging_data =
+      glad_glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+  glstate_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  if (not ts->staging_data) {
+    fprintf(stderr, "ERROR: could not map texture staging buffer\n");
+    glad_glDeleteBuffers(1, &ts->staging);
+    return false;
+  }
+
+  // shown in place of any texture that is not resident yet
+  const uint8_t white[4] = {255, 255, 255, 255};
+  glad_glGenTextures(1, &ts->fallback);
+  glstate_bind_texture(0, GL_TEXTURE_2D, ts->fallback);
+  glad_glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1);
+  glad_glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA,
+                       GL_UNSIGNED_BYTE, white);
+
+  // read by the decoder, so known before it starts
+  ts->s3tc = has_extension("GL_EXT_texture_compression_s3tc");
+
+  if (mtx_init(&ts->lock, mtx_plain) != thrd_success) {
+    fprintf(stderr, "ERROR: could not create texture decoder lock\n");
+    return false;
+  }
+  if (cnd_init(&ts->wake) != thrd_success) {
+    fprintf(stderr, "ERROR: could not create texture decoder condition\n");
+    mtx_destroy(&ts->lock);
+    return false;
+  }
+  ts->running = true;
+  if (thrd_create(&ts->thread, decoder_main, ts) != thrd_success) {
+    fprintf(stderr, "ERROR: could not start texture decoder\n");
+    cnd_destroy(&ts->wake);
+    mtx_destroy(&ts->lock);
+    return false;
+  }
+  return true;
+}
+
+void texture_streamer_destroy(texture_streamer *ts) {
+  mtx_lock(&ts->lock);
+  ts->running = false;
+  cnd_broadcast(&ts->wake);
+  mtx_unlock(&ts->lock);
+  thrd_join(ts->thread, NULL);
+  cnd_destroy(&ts->wake);
+  mtx_destroy(&ts->lock);
+
+  for (uint32_t i = 0; i < ts->count; ++i) {
+    texture_slot *slot = &ts->slots[i];
+    GLuint name = atomic_load(&slot->name);
+    if (name) {
+      glstate_forget_texture(name);
+      glad_glDeleteTextures(1, &name);
+    }
+    if (slot->pending) {
+      glstate_forget_texture(slot->pending);
+      glad_glDeleteTextures(1, &slot->pending);
+    }
+    image_destroy(&slot->pixels);
+    if (slot->mapped) {
+      file_map_close(&slot->map);
+    }
+  }
+
+  for (int i = 0; i < TEXTURE_STAGING_FRAMES; ++i) {
+    if (ts->fences[i]) {
+      glad_glDeleteSync(ts->fences[i]);
+    }
+  }
+  glstate_forget_texture(ts->fallback);
+  glad_glDeleteTextures(1, &ts->fallback);
+  glstate_forget_buffer(ts->staging);
+  glstate_bind_buffer(GL_PIXEL_UNPACK_BUFFER, ts->staging);
+  glad_glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  glstate_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glad_glDeleteBuffers(1, &ts->staging);
+  memset(ts, 0, sizeof(*ts));
+}
+
+/* claim the next slot, the caller sets its state */
+internal texture_slot *request_slot(texture_streamer *ts, const char *path) {
+  if (ts->count == TEXTURE_MAX or strlen(path) >= TEXTURE_PATH_SIZE) {
+    fprintf(stderr, "ERROR: can not request texture %s\n", path);
+    return NULL;
+  }
+  texture_slot *slot = &ts->slots[ts->count];
+  strcpy(slot->path, path);
+  return slot;
+}
+
+internal uint32_t queue_slot(texture_streamer *ts) {
+  uint32_t id = ts->count++;
+  mtx_lock(&ts->lock);
+  ts->requested = ts->count;
+  cnd_signal(&ts->wake);
+  mtx_unlock(&ts->lock);
+  return id;
+}
+
+uint32_t texture_request(texture_streamer *ts, const char *path) {
+  texture_slot *slot = request_slot(ts, path);
+  if (not slot) {
+    return TEXTURE_NONE;
+  }
+  atomic_store(&slot->state, TEXTURE_QUEUED);
+  return queue_slot(ts);
+}
+
+uint32_t texture_request_image(texture_streamer *ts, const char *name,
+                               image *img, int levels) {
+  texture_slot *slot = request_slot(ts, name);
+  if (not slot) {
+    return TEXTURE_NONE;
+  }
+  slot->pixels = *img;
+  slot->levels = levels;
+  memset(img, 0, sizeof(*img));
+  atomic_store(&slot->state, TEXTURE_DECODED);
+  damage_mark(ts->damage, DAMAGE_RESOURCE);
+  return queue_slot(ts);
+}
+
+GLuint texture_name(const texture_streamer *ts, uint32_t id) {
+  if (id >= TEXTURE_MAX) {
+    return ts->fallback;
+  }
+  GLuint name = atomic_load(&ts->slots[id].name);
+  return name ? name : ts->fallback;
+}
+
+bool texture_resident(const texture_streamer *ts, uint32_t id) {
+  return id < TEXTURE_MAX and
+         atomic_load(&ts->slots[id].state) == TEXTURE_RESIDENT;
+}
+
+void texture_streamer_update(texture_streamer *ts,
+                             texture_stream_stats *stats) {
+  int region = ts->region;
+  size_t used = 0;
+  bool full = false;
+  bool pending = false;
+  bool waited = false;
+
+  // slots finish in request order, so everything before first_pending is
+  // resident or failed
+  for (uint32_t i = ts->first_pending; i < TEXTURE_MAX; ++i) {
+    texture_slot *slot = &ts->slots[i];
+    texture_state state = atomic_load(&slot->state);
+    if (state == TEXTURE_EMPTY) {
+      break;
+    }
+    if (state == TEXTURE_RESIDENT or state == TEXTURE_FAILED) {
+      if (i == ts->first_pending) {
+        ++ts->first_pending;
+      }
+      continue;
+    }
+    // the decoder marks damage itself once it is done
+    if (state == TEXTURE_QUEUED) {
+      continue;
+    }
+    pending = true;
+    if (full) {
+      continue;
+    }
+
+    // the region is reused once the copies from three frames ago are done
+    if (not waited) {
+      wait_staging(ts, region);
+      glstate_bind_buffer(GL_PIXEL_UNPACK_BUFFER, ts->staging);
+      waited = true;
+    }
+    if (state == TEXTURE_DECODED) {
+      begin_upload(slot);
+    }
+
+    size_t bytes = slot->compressed ? upload_blocks(ts, slot, used)
+                                    : upload_rows(ts, slot, used);
+    used += bytes;
+    if (upload_done(slot)) {
+      finish_upload(ts, slot);
+    } else if (bytes == 0) {
+      // not even one row left in the budget, continue next frame
+      full = true;
+    }
+  }
+
+  if (waited) {
+    glstate_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  if (used > 0) {
+    ts->fences[region] = glad_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ts->region = (region + 1) % TEXTURE_STAGING_FRAMES;
+    ts->stats.uploaded_bytes += used;
+    if (used > ts->stats.peak_frame_bytes) {
+      ts->stats.peak_frame_bytes = used;
+    }
+  }
+
+  // keep frames coming while uploads are in flight, idle stops otherwise
+  if (pending) {
+    damage_mark(ts->damage, DAMAGE_RESOURCE);
+  }
+
+  if (stats) {
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < ts->first_pending; ++i) {
+      failed += atomic_load(&ts->slots[i].state) == TEXTURE_FAILED;
+    }
+    mtx_lock(&ts->lock);
+    ts->stats.requested = ts->requested;
+    ts->stats.decode_ms = ts->decode_ms;
+    mtx_unlock(&ts->lock);
+    ts->stats.failed = failed;
+    *stats = ts->stats;
+  }
+}
@@ -0,0 +1,150 @@
+#ifndef _TEXTURE_H_
+#define _TEXTURE_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include "glad/glad.h"
+
+#include "damage.h"
+#include "filemap.h"
+#include "image.h"
+#include "pack.h"
+#include "texcache.h"
+
+#define TEXTURE_MAX 64
+#define TEXTURE_PATH_SIZE 256
+#define TEXTURE_NONE UINT32_MAX
+// staging regions, one per frame the gpu may still be copying from
+#define TEXTURE_STAGING_FRAMES 3
+
+enum texture_state {
+  TEXTURE_EMPTY,
+  // waiting for or inside the decoder
+  TEXTURE_QUEUED,
+  // pixels ready for upload
+  TEXTURE_DECODED,
+  // storage allocated, rows are streaming in
+  TEXTURE_UPLOADING,
+  TEXTURE_RESIDENT,
+  TEXTURE_FAILED,
+};
+typedef enum texture_state texture_state;
+
+struct texture_slot {
+  char path[TEXTURE_PATH_SIZE];
+  atomic_int state;
+  // gl name once resident, readable from any thread
+  atomic_uint name;
+
+  // written by the decoder before the slot becomes TEXTURE_DECODED,
+  // pixels or the blocks of a .btx file mapped until it is resident
+  image pixels;
+  texcache blocks;
+  bool compressed;
+  file_map map;
+  bool mapped;
+  // mip levels to allocate, 0 for a full chain
+  int levels;
+
+  // render thread only
+  GLuint pending;
+  // rows, or block rows of upload_level for compressed textures
+  uint32_t rows_uploaded;
+  int upload_level;
+};
+typedef struct texture_slot texture_slot;
+
+/* totals since init, filled in by texture_streamer_update */
+struct texture_stream_stats {
+  unsigned requested;
+  unsigned resident;
+  unsigned failed;
+  // gpu memory of resident textures including mips
+  uint64_t resident_bytes;
+  // bytes copied to the staging buffer, overall and the most in one frame
+  uint64_t uploaded_bytes;
+  uint64_t peak_frame_bytes;
+  double decode_ms;
+  // render thread blocked on a staging region the gpu was still reading
+  double staging_wait_ms;
+};
+typedef struct texture_stream_stats texture_stream_stats;
+
+/* *
+ * textures decoded on a worker thread and streamed to gl over frames
+ *
+ * files are requested from the main thread and decoded to rgba8 in the
+ * background. each frame the render thread copies at most budget bytes of
+ * rows into a persistently mapped pixel unpack buffer and issues
+ * glTexSubImage2D from it, so a texture becomes resident over several
+ * frames instead of stalling one. storage is immutable and mips are
+ * generated once the last row is in. until then texture_name returns a
+ * 1x1 white fallback.
+ *
+ * .btx files are not decoded, their bc blocks and mips are streamed the
+ * same way and stay compressed on the gpu. bc1 and bc3 need s3tc support,
+ * bc7 is core.
+ * */
+struct texture_streamer {
+  texture_slot slots[TEXTURE_MAX];
+  // main thread
+  uint32_t count;
+
+  // decoder thread, requested is shared under lock
+  thrd_t thread;
+  mtx_t lock;
+  cnd_t wake;
+  bool running;
+  uint32_t requested;
+  uint32_t decoded;
+  double decode_ms;
+  const pack *assets;
+  damage_tracker *damage;
+
+  // render thread
+  GLuint staging;
+  uint8_t *staging_data;
+  size_t budget;
+  GLsync fences[TEXTURE_STAGING_FRAMES];
+  int region;
+  GLuint fallback;
+  bool s3tc;
+  uint32_t first_pending;
+  texture_stream_stats stats;
+};
+typedef struct texture_streamer texture_streamer;
+
+/* *
+ * create the staging buffer and fallback and start the decoder, needs a
+ * current context. budget is bytes uploaded per frame and holds at least
+ * one row of the widest image. assets may be NULL to read loose files.
+ * damage is marked while uploads are pending so idle frames keep coming.
+ * */
+bool texture_streamer_init(texture_streamer *ts, size_t budget,
+                           const pack *assets, damage_tracker *damage);
+/* stop the decoder and delete every texture, needs a current context */
+void texture_streamer_destroy(texture_streamer *ts);
+
+/* queue path for decode from the main thread, TEXTURE_NONE when full */
+uint32_t texture_request(texture_streamer *ts, const char *path);
+/* *
+ * stream pixels that are already decoded, like a generated atlas. img is
+ * moved into the streamer and cleared, levels 0 for a full mip chain
+ * */
+uint32_t texture_request_image(texture_streamer *ts, const char *name,
+                               image *img, int levels);
+/* resident gl name of id, fallback until then */
+GLuint texture_name(const texture_streamer *ts, uint32_t id);
+bool texture_resident(const texture_streamer *ts, uint32_t id);
+
+/* *
+ * upload the next budget of rows, once per frame on the thread owning
+ * the context. stats may be NULL
+ * */
+void texture_streamer_update(texture_streamer *ts,
+                             texture_stream_stats *stats);
+
+#endif /* _TEXTURE_H_ */
@@ -0,0 +1,297 @@
+/* *
+ * transform hierarchy
+ * */
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jobs.h"
+#include "transform.h"
+#include "utils.h"
+
+// levels narrower than this are updated on the calling thread
+#define TRANSFORM_PARALLEL_MIN 2048
+#define TRANSFORM_BATCH 512
+
+/* HELPERS */
+
+/* grow or shrink one parallel array, keeps old pointer on failure */
+internal bool array_resize(void **array, size_t size, uint32_t capacity) {
+  void *grown = realloc(*array, size * capacity);
+  if (not grown) {
+    return false;
+  }
+  *array = grown;
+  return true;
+}
+
+internal bool hierarchy_reserve(transform_hierarchy *th, uint32_t capacity) {
+  if (capacity <= th->capacity) {
+    return true;
+  }
+
+  bool ok = array_resize((void **)&th->position, sizeof(vec3), capacity) and
+            array_resize((void **)&th->rotation, sizeof(vec3), capacity) and
+            array_resize((void **)&th->scale, sizeof(vec3), capacity) and
+            array_resize((void **)&th->world, sizeof(mat4), capacity) and
+            array_resize((void **)&th->parent, sizeof(uint32_t), capacity) and
+            array_resize((void **)&th->depth, sizeof(uint16_t), capacity) and
+            array_resize((void **)&th->dirty, sizeof(uint8_t), capacity) and
+            array_resize((void **)&th->changed, sizeof(uint8_t), capacity) and
+            array_resize((void **)&th->id_to_index, sizeof(uint32_t),
+                         capacity) and
+            array_resize((void **)&th->index_to_id, sizeof(uint32_t),
+                         capacity);
+  if (not ok) {
+    fprintf(stderr, "ERROR: transform hierarchy failed to grow to %u\n",
+            capacity);
+    return false;
+  }
+
+  th->capacity = capacity;
+  return true;
+}
+
+/* *
+ * local matrix, row order so scale then rotate then translate
+ * */
+internal mat4 local_matrix(const vec3 *position, const vec3 *rotation,
+                           const vec3 *scale) {
+  mat4 m = mat4_identity();
+  m = mat4_scaling(&m, scale);
+  if (rotation->x != 0.0f) {
+    m = mat4_rotate_x(&m, rotation->x);
+  }
+  if (rotation->y != 0.0f) {
+    m = mat4_rotate_y(&m, rotation->y);
+  }
+  if (rotation->z != 0.0f) {
+    m = mat4_rotate_z(&m, rotation->z);
+  }
+  return mat4_translation(&m, position);
+}
+
+/* *
+ * stable counting sort of every array by depth
+ * */
+internal void hierarchy_sort(transform_hierarchy *th) {
+  uint32_t n = th->count;
+
+  uint16_t max_depth = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    max_depth = th->depth[i] > max_depth ? th->depth[i] : max_depth;
+  }
+
+  uint32_t *offsets = calloc((size_t)max_depth + 2, sizeof(*offsets));
+  uint32_t *new_index = malloc(sizeof(*new_index) * n);
+  transform_hierarchy sorted = {0};
+  if (not offsets or not new_index or not hierarchy_reserve(&sorted, n)) {
+    // arrays stay in creation order, parents still come first
+    fprintf(stderr, "ERROR: transform hierarchy sort failed\n");
+    free(offsets);
+    free(new_index);
+    transform_destroy(&sorted);
+    return;
+  }
+
+  for (uint32_t i = 0; i < n; ++i) {
+    ++offsets[th->depth[i] + 1];
+  }
+  for (uint32_t d = 1; d <= max_depth + 1u; ++d) {
+    offsets[d] += offsets[d - 1];
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    new_index[i] = offsets[th->depth[i]]++;
+  }
+
+  for (uint32_t i = 0; i < n; ++i) {
+    uint32_t j = new_index[i];
+    uint32_t p = th->parent[i];
+    sorted.position[j] = th->position[i];
+    sorted.rotation[j] = th->rotation[i];
+    sorted.scale[j] = th->scale[i];
+    sorted.world[j] = th->world[i];
+    sorted.parent[j] = p == TRANSFORM_NONE ? TRANSFORM_NONE : new_index[p];
+    sorted.depth[j] = th->depth[i];
+    sorted.dirty[j] = th->dirty[i];
+    sorted.changed[j] = th->changed[i];
+    sorted.index_to_id[j] = th->index_to_id[i];
+    sorted.id_to_index[th->index_to_id[i]] = j;
+  }
+
+  // swap storage, old arrays are freed with sorted
+  transform_hierarchy old = *th;
+  th->position = sorted.position;
+  th->rotation = sorted.rotation;
+  th->scale = sorted.scale;
+  th->world = sorted.world;
+  th->parent = sorted.parent;
+  th->depth = sorted.depth;
+  th->dirty = sorted.dirty;
+  th->changed = sorted.changed;
+  th->id_to_index = sorted.id_to_index;
+  th->index_to_id = sorted.index_to_id;
+  th->capacity = sorted.capacity;
+  transform_destroy(&old);
+
+  free(offsets);
+  free(new_index);
+}
+
+/* HIERARCHY */
+
+bool transform_init(transform_hierarchy *th, uint32_t capacity) {
+  assert(capacity > 0);
+  memset(th, 0, sizeof(*th));
+  if (not hierarchy_reserve(th, capacity)) {
+    transform_destroy(th);
+    return false;
+  }
+  return true;
+}
+
+void transform_destroy(transform_hierarchy *th) {
+  free(th->position);
+  free(th->rotation);
+  free(th->scale);
+  free(th->world);
+  free(th->parent);
+  free(th->depth);
+  free(th->dirty);
+  free(th->changed);
+  free(th->id_to_index);
+  free(th->index_to_id);
+  memset(th, 0, sizeof(*th));
+}
+
+uint32_t transform_create(transform_hierarchy *th, uint32_t parent) {
+  if (th->count == th->capacity and
+      not hierarchy_reserve(th, th->capacity * 2)) {
+    return TRANSFORM_NONE;
+  }
+
+  uint32_t id = th->count;
+  uint32_t idx = th->count++;
+
+  th->position[idx] = vec3_zero();
+  th->rotation[idx] = vec3_zero();
+  th->scale[idx] = vec3_new(1.0f, 1.0f, 1.0f);
+  th->world[idx] = mat4_identity();
+  th->dirty[idx] = 1;
+  th->changed[idx] = 0;
+  th->id_to_index[id] = idx;
+  th->index_to_id[idx] = id;
+
+  if (parent == TRANSFORM_NONE) {
+    th->parent[idx] = TRANSFORM_NONE;
+    th->depth[idx] = 0;
+  } else {
+    assert(parent < id);
+    uint32_t p = th->id_to_index[parent];
+    th->parent[idx] = p;
+    th->depth[idx] = th->depth[p] + 1;
+  }
+
+  // appended after a deeper node, depth order is broken
+  th->needs_sort |= idx > 0 and th->depth[idx - 1] > th->depth[idx];
+
+  return id;
+}
+
+void transform_set_position(transform_hierarchy *th, uint32_t id,
+                            const vec3 *position) {
+  uint32_t idx = th->id_to_index[id];
+  th->position[idx] = *position;
+  th->dirty[idx] = 1;
+}
+
+void transform_set_rotation(transform_hierarchy *th, uint32_t id,
+                            const vec3 *rotation) {
+  uint32_t idx = th->id_to_index[id];
+  th->rotation[idx] = *rotation;
+  th->dirty[idx] = 1;
+}
+
+void transform_set_scale(transform_hierarchy *th, uint32_t id,
+                         const vec3 *scale) {
+  uint32_t idx = th->id_to_index[id];
+  th->scale[idx] = *scale;
+  th->dirty[idx] = 1;
+}
+
+const mat4 *transform_world(const transform_hierarchy *th, uint32_t id) {
+  return &th->world[th->id_to_index[id]];
+}
+
+bool transform_was_updated(const transform_hierarchy *th, uint32_t id) {
+  return th->changed[th->id_to_index[id]];
+}
+
+/* update nodes start .. end, their parents must already be done */
+internal unsigned update_range(transform_hierarchy *th, uint32_t start,
+                               uint32_t end) {
+  unsigned updated = 0;
+  for (uint32_t i = start; i < end; ++i) {
+    uint32_t p = th->parent[i];
+
+    // parent was handled earlier in this sweep
+    uint8_t dirty = th->dirty[i] | (p != TRANSFORM_NONE ? th->changed[p] : 0);
+    th->changed[i] = dirty;
+    th->dirty[i] = 0;
+    if (not dirty) {
+      continue;
+    }
+
+    mat4 local = local_matrix(&th->position[i], &th->rotation[i],
+                              &th->scale[i]);
+    th->world[i] = p == TRANSFORM_NONE ? local : mat4_mul(&local, &th->world[p]);
+    ++updated;
+  }
+  return updated;
+}
+
+struct update_task {
+  transform_hierarchy *th;
+  uint32_t first;
+  atomic_uint updated;
+};
+typedef struct update_task update_task;
+
+internal void update_job(void *data, uint32_t start, uint32_t end) {
+  update_task *task = data;
+  unsigned n = update_range(task->th, task->first + start, task->first + end);
+  atomic_fetch_add_explicit(&task->updated, n, memory_order_relaxed);
+}
+
+unsigned transform_update(transform_hierarchy *th) {
+  if (th->needs_sort) {
+    hierarchy_sort(th);
+    th->needs_sort = false;
+  }
+
+  // nodes of one depth only read the level above, so each level is split
+  // across the job system once it is wide enough
+  unsigned updated = 0;
+  uint32_t first = 0;
+  while (first < th->count) {
+    uint32_t last = first + 1;
+    while (last < th->count and th->depth[last] == th->depth[first]) {
+      ++last;
+    }
+
+    if (last - first >= TRANSFORM_PARALLEL_MIN) {
+      update_task task = {.th = th, .first = first};
+      atomic_init(&task.updated, 0);
+      parallel_for(last - first, TRANSFORM_BATCH, update_job, &task);
+      updated += atomic_load(&task.updated);
+    } else {
+      updated += update_range(th, first, last);
+    }
+    first = last;
+  }
+
+  th->updated = updated;
+  return updated;
+}
@@ -0,0 +1,69 @@
+#ifndef _TRANSFORM_H_
+#define _TRANSFORM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "matrix.h"
+#include "vec.h"
+
+#define TRANSFORM_NONE 0xFFFFFFFFu
+
+/* *
+ * transform hierarchy stored as parallel arrays sorted by depth
+ *
+ * parents always sit before their children, so one forward sweep over
+ * the arrays updates every dirty node after its parent. nodes are
+ * referred to by id, ids stay valid when the arrays are re-sorted.
+ * */
+struct transform_hierarchy {
+  // local trs, rotation is euler degrees applied x then y then z
+  vec3 *position;
+  vec3 *rotation;
+  vec3 *scale;
+
+  mat4 *world;
+  uint32_t *parent;
+  uint16_t *depth;
+  // set by setters, changed holds what the last update recomputed
+  uint8_t *dirty;
+  uint8_t *changed;
+
+  uint32_t *id_to_index;
+  uint32_t *index_to_id;
+
+  uint32_t count;
+  uint32_t capacity;
+  bool needs_sort;
+
+  // nodes recomputed by the last transform_update
+  unsigned updated;
+};
+typedef struct transform_hierarchy transform_hierarchy;
+
+/* allocate room for capacity nodes */
+bool transform_init(transform_hierarchy *th, uint32_t capacity);
+/* free all nodes */
+void transform_destroy(transform_hierarchy *th);
+/* add identity node under parent id or TRANSFORM_NONE, returns its id */
+uint32_t transform_create(transform_hierarchy *th, uint32_t parent);
+
+/* set local position of node id */
+void transform_set_position(transform_hierarchy *th, uint32_t id,
+                            const vec3 *position);
+/* set local euler rotation in degrees of node id */
+void transform_set_rotation(transform_hierarchy *th, uint32_t id,
+                            const vec3 *rotation);
+/* set local scale of node id */
+void transform_set_scale(transform_hierarchy *th, uint32_t id,
+                         const vec3 *scale);
+
+/* world matrix of node id as of the last update */
+const mat4 *transform_world(const transform_hierarchy *th, uint32_t id);
+/* true if node id changed in the last update */
+bool transform_was_updated(const transform_hierarchy *th, uint32_t id);
+
+/* recompute world matrices of dirty subtrees, returns nodes updated */
+unsigned transform_update(transform_hierarchy *th);
+
+#endif /* _TRANSFORM_H_ */
@@ -0,0 +1,79 @@
+/* *
+ * uniform buffers
+ * */
+#include <assert.h>
+
+#include "glstate.h"
+#include "uniforms.h"
+#include "utils.h"
+
+void camera_block_set(camera_block *dest, const mat4 *view,
+                      const mat4 *projection, const vec3 *position) {
+  mat4_cpy(&dest->view, view);
+  mat4_cpy(&dest->projection, projection);
+  dest->view_projection = mat4_mul(view, projection);
+  dest->position[0] = position->x;
+  dest->position[1] = position->y;
+  dest->position[2] = position->z;
+  dest->position[3] = 1.0f;
+}
+
+bool uniforms_init(uniform_buffers *ub, GLsizei object_capacity) {
+  assert(object_capacity > 0);
+
+  glad_glGenBuffers(1, &ub->camera_ubo);
+  glstate_bind_buffer(GL_UNIFORM_BUFFER, ub->camera_ubo);
+  glad_glBufferData(GL_UNIFORM_BUFFER, sizeof(camera_block), NULL,
+                    GL_DYNAMIC_DRAW);
+
+  glad_glGenBuffers(1, &ub->object_ssbo);
+  glstate_bind_buffer(GL_SHADER_STORAGE_BUFFER, ub->object_ssbo);
+  glad_glBufferData(GL_SHADER_STORAGE_BUFFER,
+                    sizeof(object_block) * object_capacity, NULL,
+                    GL_DYNAMIC_DRAW);
+  ub->object_capacity = object_capacity;
+
+  return ub->camera_ubo != 0 and ub->object_ssbo != 0;
+}
+
+void uniforms_destroy(uniform_buffers *ub) {
+  glstate_forget_buffer(ub->camera_ubo);
+  glstate_forget_buffer(ub->object_ssbo);
+  glad_glDeleteBuffers(1, &ub->camera_ubo);
+  glad_glDeleteBuffers(1, &ub->object_ssbo);
+  ub->camera_ubo = 0;
+  ub->object_ssbo = 0;
+  ub->object_capacity = 0;
+}
+
+void uniforms_upload_camera(uniform_buffers *ub, const camera_block *camera) {
+  glstate_bind_buffer(GL_UNIFORM_BUFFER, ub->camera_ubo);
+  glad_glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(*camera), camera);
+}
+
+void uniforms_upload_objects(uniform_buffers *ub, const object_block *objects,
+                             GLsizei count) {
+  if (count <= 0) {
+    return;
+  }
+
+  glstate_bind_buffer(GL_SHADER_STORAGE_BUFFER, ub->object_ssbo);
+
+  while (ub->object_capacity < count) {
+    ub->object_capacity *= 2;
+  }
+
+  // orphan so last frames draws can still read the old copy
+  glad_glBufferData(GL_SHADER_STORAGE_BUFFER,
+                    sizeof(*objects) * ub->object_capacity, NULL,
+                    GL_DYNAMIC_DRAW);
+  glad_glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(*objects) * count,
+                       objects);
+}
+
+void uniforms_bind(const uniform_buffers *ub) {
+  glstate_bind_buffer_base(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING,
+                           ub->camera_ubo);
+  glstate_bind_buffer_base(GL_SHADER_STORAGE_BUFFER, OBJECT_BLOCK_BINDING,
+                           ub->object_ssbo);
+}
@@ -0,0 +1,103 @@
+#ifndef _UNIFORMS_H_
+#define _UNIFORMS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "glad/glad.h"
+#include "matrix.h"
+#include "vec.h"
+
+/* binding points shared with the shaders */
+#define CAMERA_BLOCK_BINDING 0
+#define OBJECT_BLOCK_BINDING 1
+
+/* *
+ * per frame camera data, std140 uniform block
+ *
+ * layout(std140, binding = 0) uniform camera {
+ *     mat4 view;
+ *     mat4 projection;
+ *     mat4 view_projection;
+ *     vec4 position;
+ * };
+ *
+ * vec4 is spelled out as float[4], vec3/vec4 from vec.h are not tightly
+ * packed.
+ * */
+struct camera_block {
+  mat4 view;
+  mat4 projection;
+  mat4 view_projection;
+  float position[4];
+};
+typedef struct camera_block camera_block;
+
+_Static_assert(offsetof(camera_block, view) == 0, "std140 camera.view");
+_Static_assert(offsetof(camera_block, projection) == 64,
+               "std140 camera.projection");
+_Static_assert(offsetof(camera_block, view_projection) == 128,
+               "std140 camera.view_projection");
+_Static_assert(offsetof(camera_block, position) == 192,
+               "std140 camera.position");
+_Static_assert(sizeof(camera_block) == 208, "std140 camera size");
+
+/* *
+ * per object data, std430 shader storage array indexed by draw id
+ *
+ * struct object_data {
+ *     mat4 model;
+ *     vec4 colour;
+ *     vec4 uv_transform;
+ *     vec4 bounds_min;
+ *     vec4 bounds_max;
+ * };
+ * layout(std430, binding = 1) readonly buffer objects {
+ *     object_data object[];
+ * };
+ * */
+struct object_block {
+  mat4 model;
+  float colour[4];
+  // scale xy and offset zw into the texture atlas
+  float uv_transform[4];
+  // world space aabb, read by the occlusion cull
+  float bounds_min[4];
+  float bounds_max[4];
+};
+typedef struct object_block object_block;
+
+_Static_assert(offsetof(object_block, model) == 0, "std430 object.model");
+_Static_assert(offsetof(object_block, colour) == 64, "std430 object.colour");
+_Static_assert(offsetof(object_block, uv_transform) == 80,
+               "std430 object.uv_transform");
+_Static_assert(offsetof(object_block, bounds_min) == 96,
+               "std430 object.bounds_min");
+_Static_assert(offsetof(object_block, bounds_max) == 112,
+               "std430 object.bounds_max");
+_Static_assert(sizeof(object_block) % 16 == 0, "std430 object array stride");
+
+struct uniform_buffers {
+  GLuint camera_ubo;
+  GLuint object_ssbo;
+  GLsizei object_capacity;
+};
+typedef struct uniform_buffers uniform_buffers;
+
+/* fill camera block, view_projection = view * projection */
+void camera_block_set(camera_block *dest, const mat4 *view,
+                      const mat4 *projection, const vec3 *position);
+
+/* create camera ubo and object ssbo */
+bool uniforms_init(uniform_buffers *ub, GLsizei object_capacity);
+/* delete buffers */
+void uniforms_destroy(uniform_buffers *ub);
+/* upload camera block */
+void uniforms_upload_camera(uniform_buffers *ub, const camera_block *camera);
+/* upload count objects in draw id order, grows storage if needed */
+void uniforms_upload_objects(uniform_buffers *ub, const object_block *objects,
+                             GLsizei count);
+/* bind both blocks to their binding points */
+void uniforms_bind(const uniform_buffers *ub);
+
+#endif /* _UNIFORMS_H_ */
@@ -4,6 +4,12 @@
 #include "math.h"
 #include <math.h>
 
+#if defined(__SSE__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VEC_SSE 1
+#include <xmmintrin.h>
+#endif
+
 /*
  * HELPERS
  *
@@ -230,3 +236,95 @@ vec4 vec4_mat4(const vec4 *v4, const float *mat_arr)
     float w = mat_arr[12]*v4->x + mat_arr[13]*v4->y + mat_arr[14]*v4->z + mat_arr[15]*v4->w;
     return vec4_new(x, y, z, w); 
 }
+
+/* --- VEC 3 SOA --- */
+
+void vec3_soa_scale_add(vec3_soa *dest, float by, const vec3 *add,
+                        uint32_t first, uint32_t end)
+{
+    uint32_t i = first;
+
+#ifdef VEC_SSE
+    const __m128 scale = _mm_set1_ps(by);
+    const __m128 ax = _mm_set1_ps(add->x);
+    const __m128 ay = _mm_set1_ps(add->y);
+    const __m128 az = _mm_set1_ps(add->z);
+    for(; i + 4 <= end; i += 4)
+    {
+        _mm_storeu_ps(dest->x + i,
+                      _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(dest->x + i), scale), ax));
+        _mm_storeu_ps(dest->y + i,
+                      _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(dest->y + i), scale), ay));
+        _mm_storeu_ps(dest->z + i,
+                      _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(dest->z + i), scale), az));
+    }
+#endif
+
+    for(; i < end; ++i)
+    {
+        dest->x[i] = dest->x[i] * by + add->x;
+        dest->y[i] = dest->y[i] * by + add->y;
+        dest->z[i] = dest->z[i] * by + add->z;
+    }
+}
+
+void vec3_soa_add_scaled(vec3_soa *dest, const vec3_soa *src, float by,
+                         uint32_t first, uint32_t end)
+{
+    uint32_t i = first;
+
+#ifdef VEC_SSE
+    const __m128 scale = _mm_set1_ps(by);
+    for(; i + 4 <= end; i += 4)
+    {
+        _mm_storeu_ps(dest->x + i,
+                      _mm_add_ps(_mm_loadu_ps(dest->x + i),
+                                 _mm_mul_ps(_mm_loadu_ps(src->x + i), scale)));
+        _mm_storeu_ps(dest->y + i,
+                      _mm_add_ps(_mm_loadu_ps(dest->y + i),
+                                 _mm_mul_ps(_mm_loadu_ps(src->y + i), scale)));
+        _mm_storeu_ps(dest->z + i,
+                      _mm_add_ps(_mm_loadu_ps(dest->z + i),
+                                 _mm_mul_ps(_mm_loadu_ps(src->z + i), scale)));
+    }
+#endif
+
+    for(; i < end; ++i)
+    {
+        dest->x[i] += src->x[i] * by;
+        dest->y[i] += src->y[i] * by;
+        dest->z[i] += src->z[i] * by;
+    }
+}
+
+void vec3_soa_store_vec4(const vec3_soa *src, const float *w, float *out,
+                         uint32_t first, uint32_t end)
+{
+    uint32_t i = first;
+
+#ifdef VEC_SSE
+    // 4 x rows become 4 xyzw columns
+    for(; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(src->x + i);
+        __m128 y = _mm_loadu_ps(src->y + i);
+        __m128 z = _mm_loadu_ps(src->z + i);
+        __m128 v = _mm_loadu_ps(w + i);
+        _MM_TRANSPOSE4_PS(x, y, z, v);
+        float *dest = out + (i - first) * 4;
+        _mm_storeu_ps(dest, x);
+        _mm_storeu_ps(dest + 4, y);
+        _mm_storeu_ps(dest + 8, z);
+        _mm_storeu_ps(dest + 12, v);
+    }
+#endif
+
+    for(; i < end; ++i)
+    {
+        float *dest = out + (i - first) * 4;
+        dest[0] = src->x[i];
+        dest[1] = src->y[i];
+        dest[2] = src->z[i];
+        dest[3] = w[i];
+    }
+}
@@ -1,6 +1,8 @@
 #ifndef _VEC_
 #define _VEC_
 
+#include <stdint.h>
+
 struct vec2
 {
     struct {
@@ -39,6 +41,18 @@ struct vec4
 };
 typedef struct vec4 vec4;
 
+
+/* *
+ * stream of vec3 split into one array per component
+ * */
+struct vec3_soa
+{
+    float *x;
+    float *y;
+    float *z;
+};
+typedef struct vec3_soa vec3_soa;
+
 /* --- VEC 2 --- */
 
 /* *
@@ -205,4 +219,26 @@ vec4 vec4_normal(const vec4 *v4);
  * */
 vec4 vec4_mat4(const vec4 *v4, const float *mat_arr);
 
+/* --- VEC 3 SOA --- */
+
+
+/* *
+ * dest[i] = dest[i] * by + add for i in first .. end
+ * */
+void vec3_soa_scale_add(vec3_soa *dest, float by, const vec3 *add,
+                        uint32_t first, uint32_t end);
+
+/* *
+ * dest[i] = dest[i] + src[i] * by for i in first .. end
+ * */
+void vec3_soa_add_scaled(vec3_soa *dest, const vec3_soa *src, float by,
+                         uint32_t first, uint32_t end);
+
+/* *
+ * interleave src[i] and w[i] into out as x, y, z, w for i in first .. end,
+ * out points at element first
+ * */
+void vec3_soa_store_vec4(const vec3_soa *src, const float *w, float *out,
+                         uint32_t first, uint32_t end);
+
 #endif /* _VEC_ */
@@ -0,0 +1,123 @@
+/* *
+ * pack the textures of several meshes into one atlas
+ *
+ * usage: atlaspack <out> <size> <mesh> <texture> [<mesh> <texture>]...
+ *
+ * writes the atlas as <out>.raw and each mesh as <out>_<n>.mesh with its
+ * uvs moved into its texture's rect, so all of them draw with one bind.
+ * lods are built for each mesh as mesh_load would.
+ * load the meshes with mesh_cache_load and no source, the atlas with
+ * texture_request_image or texture_request.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src/atlas.h"
+#include "src/filemap.h"
+#include "src/jobs.h"
+#include "src/mesh.h"
+#include "src/utils.h"
+
+#define ATLAS_BORDER 4
+#define ATLAS_ALIGN 4
+#define PATH_SIZE 512
+
+internal bool load_image(const char *path, image *img) {
+  file_map map;
+  if (not file_map_open(&map, path)) {
+    fprintf(stderr, "ERROR: could not open %s\n", path);
+    return false;
+  }
+  bool ok = image_decode(img, map.data, map.size);
+  file_map_close(&map);
+  if (not ok) {
+    fprintf(stderr, "ERROR: could not decode %s\n", path);
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 5 or (argc - 3) % 2 != 0) {
+    fprintf(stderr,
+            "usage: %s <out> <size> <mesh> <texture> [<mesh> <texture>]...\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const char *out = argv[1];
+  uint32_t size = (uint32_t)strtoul(argv[2], NULL, 10);
+  uint32_t count = (uint32_t)(argc - 3) / 2;
+  if (size == 0 or size % ATLAS_ALIGN != 0 or size > IMAGE_MAX_SIZE) {
+    fprintf(stderr, "ERROR: atlas size must be a multiple of %d up to %d\n",
+            ATLAS_ALIGN, IMAGE_MAX_SIZE);
+    return EXIT_FAILURE;
+  }
+
+  image *images = calloc(count, sizeof(*images));
+  atlas_rect *rects = calloc(count, sizeof(*rects));
+  if (not images or not rects) {
+    return EXIT_FAILURE;
+  }
+
+  // obj import splits across the job system
+  if (not jobs_init(jobs_cpu_count() - 1)) {
+    return EXIT_FAILURE;
+  }
+
+  bool ok = true;
+  for (uint32_t i = 0; ok and i < count; ++i) {
+    ok = load_image(argv[4 + i * 2], &images[i]);
+  }
+
+  atlas a;
+  ok = ok and atlas_init(&a, size, size, ATLAS_BORDER, ATLAS_ALIGN);
+  if (ok and not atlas_add_all(&a, images, count, rects)) {
+    fprintf(stderr, "ERROR: textures do not fit a %ux%u atlas\n", size, size);
+    atlas_destroy(&a);
+    ok = false;
+  }
+
+  char path[PATH_SIZE];
+  for (uint32_t i = 0; ok and i < count; ++i) {
+    const char *source = argv[3 + i * 2];
+    mesh_data mesh;
+    if (not mesh_import(&mesh, source)) {
+      ok = false;
+      break;
+    }
+
+    float transform[4];
+    atlas_uv_transform(&a, &rects[i], transform);
+    uint32_t clamped = mesh_remap_uvs(&mesh, transform);
+    if (clamped > 0) {
+      printf("ATLAS:: %s has %u uvs outside 0..1, clamped\n", source,
+             clamped);
+    }
+
+    // same lod chain mesh_load would build
+    vec3 extent = vec3_sub(&mesh.bounds.max, &mesh.bounds.min);
+    mesh_build_lods(&mesh, vec3_len(&extent) * MESH_LOD_MAX_ERROR);
+
+    snprintf(path, sizeof(path), "%s_%u.mesh", out, i);
+    ok = mesh_cache_write(&mesh, path, NULL);
+    mesh_destroy(&mesh);
+    printf("ATLAS:: %s -> %s at %u,%u %ux%u\n", argv[4 + i * 2], path,
+           rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+  }
+
+  if (ok) {
+    snprintf(path, sizeof(path), "%s.raw", out);
+    ok = image_write_raw(&a.pixels, path);
+    printf("ATLAS:: %s %ux%u %.0f%% used, %d mip levels\n", path, size, size,
+           atlas_occupancy(&a) * 100.0f, atlas_mip_levels(&a));
+    atlas_destroy(&a);
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    image_destroy(&images[i]);
+  }
+  free(images);
+  free(rects);
+  jobs_shutdown();
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
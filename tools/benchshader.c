@@ -0,0 +1,48 @@
+/* *
+ * shader loading shared by the bench tools
+ * */
+#include <stdio.h>
+
+#include "src/filemap.h"
+#include "src/utils.h"
+#include "tools/benchshader.h"
+
+bool bench_attach_shader(GLuint program, GLenum type, const char *path) {
+  file_map map;
+  if (not file_map_open(&map, path)) {
+    fprintf(stderr, "ERROR: could not open %s\n", path);
+    return false;
+  }
+  GLuint shader = glad_glCreateShader(type);
+  const char *source = map.data;
+  GLint length = (GLint)map.size;
+  glad_glShaderSource(shader, 1, &source, &length);
+  glad_glCompileShader(shader);
+  file_map_close(&map);
+
+  GLint check = -1;
+  glad_glGetShaderiv(shader, GL_COMPILE_STATUS, &check);
+  if (check != GL_TRUE) {
+    char log[1024];
+    glad_glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    fprintf(stderr, "ERROR: failed to compile %s\n%s\n", path, log);
+    glad_glDeleteShader(shader);
+    return false;
+  }
+  glad_glAttachShader(program, shader);
+  glad_glDeleteShader(shader);
+  return true;
+}
+
+bool bench_link_program(GLuint program) {
+  glad_glLinkProgram(program);
+  GLint check = -1;
+  glad_glGetProgramiv(program, GL_LINK_STATUS, &check);
+  if (check != GL_TRUE) {
+    char log[1024];
+    glad_glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    fprintf(stderr, "ERROR: failed to link program\n%s\n", log);
+    return false;
+  }
+  return true;
+}
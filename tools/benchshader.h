@@ -0,0 +1,17 @@
+#ifndef _BENCHSHADER_H_
+#define _BENCHSHADER_H_
+
+#include <stdbool.h>
+
+#include "glad/glad.h"
+
+/* *
+ * shader loading shared by the bench tools, loose files mapped in place
+ * */
+
+/* compile the shader at path and attach it to program */
+bool bench_attach_shader(GLuint program, GLenum type, const char *path);
+/* link program, the log is printed on failure */
+bool bench_link_program(GLuint program);
+
+#endif /* _BENCHSHADER_H_ */
@@ -0,0 +1,167 @@
+/* *
+ * frustum culling through the bvh against the linear simd cull
+ *
+ * usage: cullbench [max objects]
+ *
+ * for every object count from 1k up to max, 100k by default, scatters
+ * boxes at a fixed density around a camera and turns it through a full
+ * circle. prints the mean time of a view culled by frustum_cull on one
+ * thread, frustum_cull_parallel on the job system and bvh_query_frustum,
+ * and how many boxes each found visible. the counts can differ by a few
+ * boxes on a plane, the two test boxes stored differently.
+ * */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src/bvh.h"
+#include "src/frustum.h"
+#include "src/jobs.h"
+#include "src/pacer.h"
+#include "src/utils.h"
+
+#define MIN_OBJECTS 1024
+#define MAX_OBJECTS (100 * 1000)
+// views around the circle, each culled ROUNDS times
+#define VIEW_COUNT 16
+#define ROUNDS 20
+// boxes per unit cube and their size, about the app's grid spacing
+#define DENSITY 0.25f
+#define BOX_SIZE 0.5f
+#define FIELD_OF_VIEW DEG2RAD(67.0f)
+#define ASPECT (640.0f / 480.0f)
+#define NEAR_PLANE 0.1f
+#define FAR_PLANE 100.0f
+
+enum cull_method { CULL_LINEAR, CULL_PARALLEL, CULL_BVH, CULL_METHOD_COUNT };
+typedef enum cull_method cull_method;
+
+global_var const char *method_names[CULL_METHOD_COUNT] = {"linear",
+                                                          "parallel", "bvh"};
+
+/* same seed every run so the counts compare */
+internal float random_unit(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return (float)(*state >> 8) / (float)(1u << 24);
+}
+
+/* row order, looks down -z, as main.c */
+internal mat4 perspective(float fov, float aspect, float near, float far) {
+  float range = 1.0f / tanf(fov * 0.5f);
+  float fn = 1.0f / (far - near);
+  return mat4_new(range / aspect, 0.0f, 0.0f, 0.0f, 0.0f, range, 0.0f, 0.0f,
+                  0.0f, 0.0f, -(near + far) * fn, -1.0f, 0.0f, 0.0f,
+                  -(2.0f * far * near) * fn, 0.0f);
+}
+
+/* boxes in a cube around the origin, sized to keep DENSITY */
+internal void scatter_boxes(aabb *boxes, uint32_t count) {
+  float side = cbrtf((float)count / DENSITY);
+  uint32_t state = 1;
+  vec3 half = vec3_new(BOX_SIZE * 0.5f, BOX_SIZE * 0.5f, BOX_SIZE * 0.5f);
+  for (uint32_t i = 0; i < count; ++i) {
+    vec3 center = vec3_new((random_unit(&state) - 0.5f) * side,
+                           (random_unit(&state) - 0.5f) * side,
+                           (random_unit(&state) - 0.5f) * side);
+    vec3 min = vec3_sub(&center, &half);
+    vec3 max = vec3_add(&center, &half);
+    boxes[i] = aabb_new(&min, &max);
+  }
+}
+
+/* view turned by angle degrees about y from the origin */
+internal frustum view_frustum(float angle) {
+  mat4 view = mat4_identity();
+  view = mat4_rotate_y(&view, angle);
+  mat4 projection =
+      perspective(FIELD_OF_VIEW, ASPECT, NEAR_PLANE, FAR_PLANE);
+  mat4 view_projection = mat4_mul(&view, &projection);
+  return frustum_from_mat4(&view_projection);
+}
+
+internal uint32_t cull(cull_method method, const frustum *f,
+                       const bounds_soa *bounds, const bvh *tree,
+                       uint32_t *visible) {
+  switch (method) {
+  case CULL_LINEAR:
+    return frustum_cull(f, bounds, 0, bounds->count, visible, NULL);
+  case CULL_PARALLEL:
+    return frustum_cull_parallel(f, bounds, 0, bounds->count, visible, NULL);
+  case CULL_BVH:
+    return bvh_query_frustum(tree, f, visible, tree->count, NULL);
+  default:
+    return 0;
+  }
+}
+
+internal bool run(uint32_t count) {
+  aabb *boxes = malloc(sizeof(*boxes) * count);
+  uint32_t *visible = malloc(sizeof(*visible) * count);
+  bounds_soa bounds;
+  bvh tree;
+  if (not boxes or not visible or not bounds_soa_init(&bounds, count)) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    free(boxes);
+    free(visible);
+    return false;
+  }
+
+  scatter_boxes(boxes, count);
+  for (uint32_t i = 0; i < count; ++i) {
+    bounds_soa_push(&bounds, &boxes[i], NULL);
+  }
+  if (not bvh_build(&tree, boxes, count)) {
+    fprintf(stderr, "ERROR: could not build bvh\n");
+    bounds_soa_destroy(&bounds);
+    free(boxes);
+    free(visible);
+    return false;
+  }
+
+  printf("CULL:: %6u objects", count);
+  for (int m = 0; m < CULL_METHOD_COUNT; ++m) {
+    double total = 0.0;
+    unsigned found = 0;
+    for (int v = 0; v < VIEW_COUNT; ++v) {
+      frustum f = view_frustum(360.0f * (float)v / VIEW_COUNT);
+      found += cull((cull_method)m, &f, &bounds, &tree, visible);
+      double start = pacer_now_ms();
+      for (int r = 0; r < ROUNDS; ++r) {
+        cull((cull_method)m, &f, &bounds, &tree, visible);
+      }
+      total += pacer_now_ms() - start;
+    }
+    printf(" %s %.3fms %u", method_names[m],
+           total / (VIEW_COUNT * ROUNDS), found / VIEW_COUNT);
+  }
+  printf("\n");
+
+  bvh_destroy(&tree);
+  bounds_soa_destroy(&bounds);
+  free(boxes);
+  free(visible);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  uint32_t max_objects = MAX_OBJECTS;
+  if (argc > 1) {
+    max_objects = (uint32_t)strtoul(argv[1], NULL, 10);
+  }
+  if (not jobs_init(jobs_cpu_count() - 1)) {
+    fprintf(stderr, "ERROR: could not start job system\n");
+    return EXIT_FAILURE;
+  }
+  printf("JOBS:: %d threads\n", jobs_thread_count());
+
+  bool ok = true;
+  for (uint32_t count = MIN_OBJECTS; ok and count < max_objects; count *= 4) {
+    ok = run(count);
+  }
+  if (ok) {
+    ok = run(max_objects);
+  }
+
+  jobs_shutdown();
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
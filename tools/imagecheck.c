@@ -0,0 +1,160 @@
+/* *
+ * png and inflate decoder checks against a known good png
+ *
+ * usage: imagecheck [image.png]
+ *
+ * the png must decode, every truncation of it and every copy with one
+ * byte flipped must be rejected. its image data is then inflated cut
+ * short and into an output one byte small, which must fail, and with each
+ * byte flipped in turn, which may fail but must not write past the output.
+ * rejected copies are reported by the decoders on stderr, run with
+ * 2>/dev/null for the summary alone. defaults to checker.png.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/filemap.h"
+#include "src/image.h"
+#include "src/inflate.h"
+#include "src/pacer.h"
+#include "src/utils.h"
+
+// zlib stream trailer, not needed to inflate the data before it
+#define ADLER_SIZE 4
+// bytes after the output that damaged data must leave alone
+#define GUARD_SIZE 64
+#define GUARD_BYTE 0xA5
+
+internal uint32_t read_be32(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+         (uint32_t)p[3];
+}
+
+/* join the IDAT chunks of a png that is known to be good */
+internal uint8_t *join_image_data(const uint8_t *data, size_t size,
+                                  size_t *joined) {
+  uint8_t *out = malloc(size);
+  *joined = 0;
+  if (not out) {
+    return NULL;
+  }
+  for (size_t pos = 8; pos + 12 <= size;) {
+    uint32_t length = read_be32(data + pos);
+    if (memcmp(data + pos + 4, "IDAT", 4) == 0) {
+      memcpy(out + *joined, data + pos + 8, length);
+      *joined += length;
+    }
+    pos += 12 + (size_t)length;
+  }
+  return out;
+}
+
+/* true if the png decodes, the image is freed again */
+internal bool decodes(const uint8_t *data, size_t size) {
+  image img;
+  if (not image_decode_png(&img, data, size)) {
+    return false;
+  }
+  image_destroy(&img);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : "checker.png";
+  file_map map;
+  if (not file_map_open(&map, path)) {
+    fprintf(stderr, "ERROR: could not open %s\n", path);
+    return EXIT_FAILURE;
+  }
+  const uint8_t *data = map.data;
+  size_t size = map.size;
+  double start = pacer_now_ms();
+  int failures = 0;
+
+  image img;
+  if (not image_decode_png(&img, data, size)) {
+    fprintf(stderr, "ERROR: could not decode %s\n", path);
+    file_map_close(&map);
+    return EXIT_FAILURE;
+  }
+  printf("IMAGE:: %s %ux%u decoded\n", path, img.width, img.height);
+  // generous enough for 16 bit rgba, the first inflate finds the real size
+  size_t raw_capacity = ((size_t)img.width * 8 + 1) * img.height;
+  image_destroy(&img);
+
+  // copies are owned so they can be damaged, the map is read only
+  uint8_t *copy = malloc(size);
+  size_t idat_size = 0;
+  uint8_t *idat = join_image_data(data, size, &idat_size);
+  if (not copy or not idat) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    free(copy);
+    free(idat);
+    file_map_close(&map);
+    return EXIT_FAILURE;
+  }
+
+  // truncations end where the allocation does, so a sanitizer sees overreads
+  int accepted = 0;
+  for (size_t cut = 0; cut < size; ++cut) {
+    memcpy(copy + size - cut, data, cut);
+    accepted += decodes(copy + size - cut, cut);
+  }
+  printf("IMAGE:: %zu truncations, %d accepted\n", size, accepted);
+  failures += accepted;
+
+  accepted = 0;
+  memcpy(copy, data, size);
+  for (size_t i = 0; i < size; ++i) {
+    copy[i] ^= 0xFF;
+    accepted += decodes(copy, size);
+    copy[i] ^= 0xFF;
+  }
+  printf("IMAGE:: %zu corrupted bytes, %d accepted\n", size, accepted);
+  failures += accepted;
+
+  uint8_t *raw = malloc(raw_capacity + GUARD_SIZE);
+  size_t raw_size = 0;
+  if (not raw or
+      not inflate_zlib(idat, idat_size, raw, raw_capacity, &raw_size)) {
+    fprintf(stderr, "ERROR: could not inflate the image data\n");
+    failures += 1;
+  } else {
+    accepted = 0;
+    for (size_t cut = 0; cut + ADLER_SIZE < idat_size; ++cut) {
+      accepted += inflate_zlib(idat, cut, raw, raw_size, NULL);
+    }
+    accepted += inflate_zlib(idat, idat_size, raw, raw_size - 1, NULL);
+    printf("IMAGE:: %zu short inflates, %d accepted\n",
+           idat_size - ADLER_SIZE + 1, accepted);
+    failures += accepted;
+
+    int overruns = 0;
+    int rejected = 0;
+    memset(raw + raw_size, GUARD_BYTE, GUARD_SIZE);
+    for (size_t i = 0; i < idat_size; ++i) {
+      idat[i] ^= 0xFF;
+      rejected += not inflate_zlib(idat, idat_size, raw, raw_size, NULL);
+      idat[i] ^= 0xFF;
+      for (size_t g = 0; g < GUARD_SIZE; ++g) {
+        if (raw[raw_size + g] != GUARD_BYTE) {
+          ++overruns;
+          memset(raw + raw_size, GUARD_BYTE, GUARD_SIZE);
+          break;
+        }
+      }
+    }
+    printf("IMAGE:: %zu damaged inflates, %d rejected, %d overran\n",
+           idat_size, rejected, overruns);
+    failures += overruns;
+  }
+
+  printf("IMAGE:: %s in %.0fms\n", failures ? "FAILED" : "passed",
+         pacer_now_ms() - start);
+  free(raw);
+  free(idat);
+  free(copy);
+  file_map_close(&map);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,407 @@
+/* *
+ * lighting cost against the light count
+ *
+ * usage: lightbench [max lights]
+ *
+ * run from the project directory, cube.obj and the lighting shaders are
+ * read from there. fills the screen with a wall of cubes and, for every
+ * light count from 16 up to max, 1024 by default, prints the gpu time of
+ * the g-buffer and the tiled light pass and how many lights each tile
+ * kept, the cpu time of the cluster lists and gpu time of clustered
+ * forward shading, then the gpu time of forward shading looping over
+ * every light. the sun's shadows are off, every pass reads its cascades
+ * as lit. opens a hidden window, set LIBGL_ALWAYS_SOFTWARE=1 to
+ * measure mesa's software renderer in place of the gpu.
+ * */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+
+#include "src/arena.h"
+#include "src/clusters.h"
+#include "src/deferred.h"
+#include "src/drawlist.h"
+#include "src/glstate.h"
+#include "src/lights.h"
+#include "src/mesh.h"
+#include "src/pacer.h"
+#include "src/shadows.h"
+#include "src/uniforms.h"
+#include "src/utils.h"
+#include "tools/benchshader.h"
+
+#define WIDTH 640
+#define HEIGHT 480
+#define MIN_LIGHTS 16
+#define MAX_LIGHTS 1024
+// frames before timing, the readback is a few frames behind
+#define WARMUP_FRAMES 10
+#define TIMED_FRAMES 30
+#define FRAME_DT (1.0f / 60.0f)
+#define LIGHT_RADIUS 0.6f
+// wall of cubes covering the view from 3 units away
+#define GRID_X 12
+#define GRID_Y 9
+#define OBJECT_COUNT (GRID_X * GRID_Y)
+// same froxels as the app
+#define CLUSTER_X 16
+#define CLUSTER_Y 12
+#define CLUSTER_Z 24
+#define CLUSTER_ARENA_SIZE (4 * 1024 * 1024)
+
+/* one draw per cube, each turned a little differently */
+internal bool build_wall(draw_list *dl, const mesh_lod *lod,
+                         object_block *objects) {
+  draw_list_clear(dl);
+  for (int i = 0; i < OBJECT_COUNT; ++i) {
+    vec3 scale = vec3_new(0.3f, 0.3f, 0.3f);
+    vec3 position =
+        vec3_new(((float)(i % GRID_X) - (GRID_X - 1) * 0.5f) * 0.5f,
+                 ((float)(i / GRID_X) - (GRID_Y - 1) * 0.5f) * 0.5f,
+                 -0.5f * (float)(i % 3));
+    mat4 model = mat4_identity();
+    model = mat4_scaling(&model, &scale);
+    model = mat4_rotate_x(&model, 25.0f + (float)(i * 7 % 40));
+    model = mat4_rotate_y(&model, 35.0f + (float)(i * 13 % 50));
+    model = mat4_translation(&model, &position);
+
+    object_block *obj = &objects[i];
+    mat4_cpy(&obj->model, &model);
+    for (int c = 0; c < 4; ++c) {
+      obj->colour[c] = 1.0f;
+      obj->bounds_min[c] = 0.0f;
+      obj->bounds_max[c] = 0.0f;
+    }
+    obj->uv_transform[0] = 1.0f;
+    obj->uv_transform[1] = 1.0f;
+    obj->uv_transform[2] = 0.0f;
+    obj->uv_transform[3] = 0.0f;
+    if (not draw_list_push(dl, lod->index_count, lod->first_index, 0, 1,
+                           NULL)) {
+      return false;
+    }
+  }
+  return draw_list_upload(dl);
+}
+
+/* area the lights of every run move in */
+internal aabb light_area(void) {
+  vec3 light_min = vec3_new(-3.0f, -2.5f, -1.5f);
+  vec3 light_max = vec3_new(3.0f, 2.5f, 0.5f);
+  return aabb_new(&light_min, &light_max);
+}
+
+/* mean of the per frame stats with count lights */
+internal deferred_stats run(deferred_renderer *d, light_buffer *lb,
+                            draw_list *dl, GLuint program, GLuint texture,
+                            point_light *lights, GLsizei count) {
+  aabb area = light_area();
+
+  deferred_stats total = {0};
+  for (int frame = 0; frame < WARMUP_FRAMES + TIMED_FRAMES; ++frame) {
+    lights_animate(lights, (uint32_t)count, &area, LIGHT_RADIUS,
+                   (float)frame * FRAME_DT);
+    light_buffer_upload(lb, lights, count);
+
+    deferred_stats stats;
+    deferred_begin(d, &stats);
+    // the light pass leaves the g-buffer bound to unit 0
+    glstate_bind_texture(0, GL_TEXTURE_2D, texture);
+    glstate_use_program(program);
+    draw_list_submit_range(dl, GL_TRIANGLES, 0, dl->count);
+    deferred_end(d, lb);
+
+    // results of the warmup frames are still in flight here
+    if (frame >= WARMUP_FRAMES + DEFERRED_READBACK_FRAMES) {
+      total.tile_lights += stats.tile_lights;
+      total.geometry_ms += stats.geometry_ms;
+      total.lighting_ms += stats.lighting_ms;
+    }
+  }
+  glad_glFinish();
+
+  int timed = TIMED_FRAMES - DEFERRED_READBACK_FRAMES;
+  total.lights = (unsigned)count;
+  total.tile_lights /= (float)timed;
+  total.geometry_ms /= timed;
+  total.lighting_ms /= timed;
+  return total;
+}
+
+/* *
+ * mean ms of forward shading count lights with program into target,
+ * lists are built every frame and their stats averaged into clusters
+ * when grid is set
+ * */
+internal double run_forward(light_buffer *lb, cluster_grid *grid,
+                            arena *scratch, const mat4 *view, draw_list *dl,
+                            GLuint target, GLuint program, GLuint texture,
+                            point_light *lights, GLsizei count,
+                            cluster_stats *clusters) {
+  aabb area = light_area();
+
+  double gpu_ms = 0.0;
+  *clusters = (cluster_stats){0};
+  if (not grid) {
+    glad_glProgramUniform1ui(program, 0, (GLuint)count);
+  }
+  for (int frame = 0; frame < WARMUP_FRAMES + TIMED_FRAMES; ++frame) {
+    lights_animate(lights, (uint32_t)count, &area, LIGHT_RADIUS,
+                   (float)frame * FRAME_DT);
+    light_buffer_upload(lb, lights, count);
+    light_buffer_bind(lb);
+    if (grid) {
+      cluster_lists lists;
+      cluster_stats stats;
+      arena_reset(scratch);
+      if (not clusters_assign(grid, lights, (uint32_t)count, view, scratch,
+                              &lists, &stats)) {
+        fprintf(stderr, "ERROR: cluster lists do not fit\n");
+      }
+      clusters_upload(grid, &lists);
+      clusters_bind(grid);
+      if (frame >= WARMUP_FRAMES) {
+        clusters->references += stats.references;
+        clusters->cell_lights += stats.cell_lights;
+        clusters->assign_ms += stats.assign_ms;
+      }
+    }
+
+    glstate_bind_framebuffer(GL_FRAMEBUFFER, target);
+    glstate_viewport(0, 0, WIDTH, HEIGHT);
+    glad_glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glstate_bind_texture(0, GL_TEXTURE_2D, texture);
+    glstate_use_program(program);
+    // waited on from both sides, timestamps miss the shading of drivers
+    // that only bin draws until a flush, mesa's software renderer does
+    glad_glFinish();
+    double start = pacer_now_ms();
+    draw_list_submit_range(dl, GL_TRIANGLES, 0, dl->count);
+    glad_glFinish();
+    if (frame >= WARMUP_FRAMES) {
+      gpu_ms += pacer_now_ms() - start;
+    }
+  }
+
+  clusters->lights = (unsigned)count;
+  clusters->references /= TIMED_FRAMES;
+  clusters->cell_lights /= (float)TIMED_FRAMES;
+  clusters->assign_ms /= TIMED_FRAMES;
+  return gpu_ms / TIMED_FRAMES;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [max lights]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  GLsizei max_lights = argc == 2 ? (GLsizei)atoi(argv[1]) : MAX_LIGHTS;
+  if (max_lights < MIN_LIGHTS) {
+    max_lights = MIN_LIGHTS;
+  }
+
+  if (not glfwInit()) {
+    fprintf(stderr, "ERROR: glfw init failed\n");
+    return EXIT_FAILURE;
+  }
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  GLFWwindow *window =
+      glfwCreateWindow(WIDTH, HEIGHT, "lightbench", NULL, NULL);
+  if (not window) {
+    fprintf(stderr, "ERROR: could not create a gl 4.4 context\n");
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+  glfwMakeContextCurrent(window);
+  if (not gladLoadGL()) {
+    fprintf(stderr, "ERROR: glad failed to start\n");
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+  printf("RENDERER:: %s\n", glad_glGetString(GL_RENDERER));
+
+  GLuint gbuffer_program = glad_glCreateProgram();
+  GLuint light_program = glad_glCreateProgram();
+  GLuint clustered_program = glad_glCreateProgram();
+  GLuint naive_program = glad_glCreateProgram();
+  GLuint shadow_program = glad_glCreateProgram();
+  mesh_data mesh;
+  if (not bench_attach_shader(gbuffer_program, GL_VERTEX_SHADER,
+                              "gbuffer.vert") or
+      not bench_attach_shader(gbuffer_program, GL_FRAGMENT_SHADER,
+                              "gbuffer.frag") or
+      not bench_link_program(gbuffer_program) or
+      not bench_attach_shader(light_program, GL_COMPUTE_SHADER,
+                              "deferred_light.comp") or
+      not bench_link_program(light_program) or
+      not bench_attach_shader(clustered_program, GL_VERTEX_SHADER,
+                              "forward_plus.vert") or
+      not bench_attach_shader(clustered_program, GL_FRAGMENT_SHADER,
+                              "forward_plus.frag") or
+      not bench_link_program(clustered_program) or
+      not bench_attach_shader(naive_program, GL_VERTEX_SHADER,
+                              "forward_plus.vert") or
+      not bench_attach_shader(naive_program, GL_FRAGMENT_SHADER,
+                              "forward_naive.frag") or
+      not bench_link_program(naive_program) or
+      not bench_attach_shader(shadow_program, GL_VERTEX_SHADER,
+                              "shadow.vert") or
+      not bench_link_program(shadow_program) or
+      not mesh_load(&mesh, "cube.obj", "cube.mesh", NULL)) {
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+
+  GLuint buffers[2];
+  GLuint vao = 0;
+  glad_glGenBuffers(2, buffers);
+  glad_glGenVertexArrays(1, &vao);
+  glstate_bind_vertex_array(vao);
+  mesh_upload(&mesh, buffers[0], buffers[1]);
+  mesh_bind_attributes(buffers[0], 0, 1, 3);
+  mesh_lod lod = mesh.lods[0];
+  mesh_destroy(&mesh);
+
+  draw_list draws;
+  object_block objects[OBJECT_COUNT];
+  point_light *lights = malloc(sizeof(*lights) * max_lights);
+  if (not lights or not draw_list_init(&draws, OBJECT_COUNT)) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+  draw_list_bind_draw_id(&draws, 2);
+  if (not build_wall(&draws, &lod, objects)) {
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+
+  // looking at the wall from 3 units away
+  uniform_buffers uniforms;
+  uniforms_init(&uniforms, OBJECT_COUNT);
+  float fov = DEG2RAD(67.0f);
+  float range = 1.0f / tanf(fov * 0.5f);
+  float near = 0.1f;
+  float far = 100.0f;
+  mat4 projection = mat4_new(
+      range * HEIGHT / WIDTH, 0.0f, 0.0f, 0.0f, 0.0f, range, 0.0f, 0.0f, 0.0f,
+      0.0f, -(near + far) / (far - near), -1.0f, 0.0f, 0.0f,
+      -(2.0f * far * near) / (far - near), 0.0f);
+  vec3 eye = vec3_new(0.0f, 0.0f, 3.0f);
+  vec3 to_view = vec3_mul(&eye, -1.0f);
+  mat4 view = mat4_identity();
+  view = mat4_translation(&view, &to_view);
+  camera_block camera;
+  camera_block_set(&camera, &view, &projection, &eye);
+  uniforms_upload_camera(&uniforms, &camera);
+  uniforms_upload_objects(&uniforms, objects, OBJECT_COUNT);
+  uniforms_bind(&uniforms);
+
+  // white, so the light pass sees plain tinted albedo
+  GLuint white = 0;
+  const GLubyte texel[4] = {255, 255, 255, 255};
+  glad_glGenTextures(1, &white);
+  glstate_bind_texture(0, GL_TEXTURE_2D, white);
+  glad_glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1);
+  glad_glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA,
+                       GL_UNSIGNED_BYTE, texel);
+
+  // forward passes draw offscreen too, like the g-buffer
+  GLuint target = 0;
+  GLuint target_textures[2];
+  glad_glGenFramebuffers(1, &target);
+  glad_glGenTextures(2, target_textures);
+  glstate_bind_texture(0, GL_TEXTURE_2D, target_textures[0]);
+  glad_glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, WIDTH, HEIGHT);
+  glstate_bind_texture(0, GL_TEXTURE_2D, target_textures[1]);
+  glad_glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, WIDTH, HEIGHT);
+  glstate_bind_framebuffer(GL_FRAMEBUFFER, target);
+  glad_glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_TEXTURE_2D, target_textures[0], 0);
+  glad_glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_TEXTURE_2D, target_textures[1], 0);
+  glstate_bind_framebuffer(GL_FRAMEBUFFER, 0);
+
+  glstate_enable(GL_DEPTH_TEST);
+  glstate_enable(GL_CULL_FACE);
+  glstate_clear_color(0.1f, 0.1f, 0.1f, 1.0f);
+
+  int status = EXIT_SUCCESS;
+  deferred_renderer deferred;
+  light_buffer lb = {0};
+  cluster_grid grid = {0};
+  arena scratch = {0};
+  shadow_map shadows = {0};
+  if (not shadow_init(&shadows, 1, shadow_program, fov,
+                      (float)WIDTH / (float)HEIGHT, near, far, buffers[0],
+                      buffers[1]) or
+      not deferred_init(&deferred, WIDTH, HEIGHT, light_program) or
+      not light_buffer_init(&lb, max_lights) or
+      not clusters_init(&grid, CLUSTER_X, CLUSTER_Y, CLUSTER_Z, fov,
+                        (float)WIDTH / (float)HEIGHT, near, far) or
+      not arena_init(&scratch, CLUSTER_ARENA_SIZE)) {
+    status = EXIT_FAILURE;
+  }
+  // shadow_init leaves its own vao unbound
+  glstate_bind_vertex_array(vao);
+  vec3 sun = vec3_new(0.0f, -1.0f, 0.0f);
+  shadow_update(&shadows, &view, &sun, false);
+  shadow_bind(&shadows);
+  for (GLsizei count = MIN_LIGHTS;
+       status == EXIT_SUCCESS and count <= max_lights; count *= 4) {
+    deferred_stats stats = run(&deferred, &lb, &draws, gbuffer_program, white,
+                               lights, count);
+    printf("LIGHTS:: %5u lights %7.1f per tile %8.3fms g-buffer "
+           "%8.3fms light pass\n",
+           stats.lights, stats.tile_lights, stats.geometry_ms,
+           stats.lighting_ms);
+
+    cluster_stats clusters;
+    double clustered_ms =
+        run_forward(&lb, &grid, &scratch, &view, &draws, target,
+                    clustered_program, white, lights, count, &clusters);
+    printf("CLUSTERED:: %5u lights %7.1f per cell %8.3fms assign "
+           "%8.3fms shading\n",
+           clusters.lights, clusters.cell_lights, clusters.assign_ms,
+           clustered_ms);
+
+    double naive_ms =
+        run_forward(&lb, NULL, NULL, &view, &draws, target, naive_program,
+                    white, lights, count, &clusters);
+    printf("FORWARD:: %5u lights %8.3fms shading\n", (unsigned)count,
+           naive_ms);
+  }
+
+  deferred_destroy(&deferred);
+  clusters_destroy(&grid);
+  shadow_destroy(&shadows);
+  arena_destroy(&scratch);
+  light_buffer_destroy(&lb);
+  uniforms_destroy(&uniforms);
+  draw_list_destroy(&draws);
+  free(lights);
+  glstate_forget_texture(white);
+  glad_glDeleteTextures(1, &white);
+  glstate_forget_framebuffer(target);
+  glad_glDeleteFramebuffers(1, &target);
+  for (int i = 0; i < 2; ++i) {
+    glstate_forget_texture(target_textures[i]);
+  }
+  glad_glDeleteTextures(2, target_textures);
+  glstate_forget_vertex_array(vao);
+  glad_glDeleteVertexArrays(1, &vao);
+  glad_glDeleteBuffers(2, buffers);
+  glad_glDeleteProgram(gbuffer_program);
+  glad_glDeleteProgram(light_program);
+  glad_glDeleteProgram(clustered_program);
+  glad_glDeleteProgram(naive_program);
+  glad_glDeleteProgram(shadow_program);
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return status;
+}
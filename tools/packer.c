@@ -0,0 +1,40 @@
+/* *
+ * build a pack archive from loose files
+ *
+ * usage: packer <out.pack> <file>...
+ *
+ * each file is stored under the path it was given as, so run it from the
+ * directory the app loads assets from.
+ * */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src/pack.h"
+#include "src/utils.h"
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <out.pack> <file>...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  pack_writer writer;
+  pack_writer_init(&writer);
+
+  size_t total = 0;
+  for (int i = 2; i < argc; ++i) {
+    if (not pack_writer_add_file(&writer, argv[i], argv[i])) {
+      pack_writer_destroy(&writer);
+      return EXIT_FAILURE;
+    }
+    total += writer.entries[writer.count - 1].size;
+  }
+
+  bool ok = pack_writer_write(&writer, argv[1]);
+  if (ok) {
+    printf("PACK:: %s %u files %zu bytes\n", argv[1], writer.count, total);
+  }
+
+  pack_writer_destroy(&writer);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
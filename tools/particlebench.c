@@ -0,0 +1,216 @@
+/* *
+ * gpu and cpu particle throughput
+ *
+ * usage: particlebench [max particles]
+ *
+ * run from the project directory, the particle shaders are read from
+ * there. for every pool size from 16k up to max, 1m by default, keeps the
+ * pool full and prints the gpu time of a frame from timer queries, once
+ * with zero sized sprites, which leaves the simulation, and once drawn,
+ * then the cpu time of the same pool on the job system. opens a hidden
+ * window, set LIBGL_ALWAYS_SOFTWARE=1 to measure mesa's software renderer
+ * in place of the gpu.
+ * */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+
+#include "src/cpuparticles.h"
+#include "src/glstate.h"
+#include "src/jobs.h"
+#include "src/particles.h"
+#include "src/uniforms.h"
+#include "src/utils.h"
+#include "tools/benchshader.h"
+
+#define WIDTH 640
+#define HEIGHT 480
+#define MIN_PARTICLES (16 * 1024)
+#define MAX_PARTICLES (1024 * 1024)
+// frames before timing, the pool fills and the readback catches up
+#define WARMUP_FRAMES 30
+#define TIMED_FRAMES 60
+#define FRAME_DT (1.0f / 60.0f)
+#define SPRITE_SIZE 0.01f
+// every cpu frame ends in glFinish, so two regions never overlap
+#define CPU_REGIONS 2
+
+/* emitter refilling the whole pool of capacity each frame */
+internal particle_emitter full_emitter(GLuint capacity, float size) {
+  return (particle_emitter){
+      .origin = {0.0f, -1.0f, 0.0f},
+      .rate = (float)capacity / FRAME_DT,
+      .speed = 2.0f,
+      .spread = 0.35f,
+      .lifetime = 2.0f,
+      .size = size,
+  };
+}
+
+internal bool create_programs(particle_programs *programs) {
+  programs->emit = glad_glCreateProgram();
+  programs->dispatch = glad_glCreateProgram();
+  programs->simulate = glad_glCreateProgram();
+  programs->draw = glad_glCreateProgram();
+  return bench_attach_shader(programs->emit, GL_COMPUTE_SHADER,
+                             "particle_emit.comp") and
+         bench_link_program(programs->emit) and
+         bench_attach_shader(programs->dispatch, GL_COMPUTE_SHADER,
+                             "particle_dispatch.comp") and
+         bench_link_program(programs->dispatch) and
+         bench_attach_shader(programs->simulate, GL_COMPUTE_SHADER,
+                             "particle_simulate.comp") and
+         bench_link_program(programs->simulate) and
+         bench_attach_shader(programs->draw, GL_VERTEX_SHADER,
+                             "particle.vert") and
+         bench_attach_shader(programs->draw, GL_FRAGMENT_SHADER,
+                             "particle.frag") and
+         bench_link_program(programs->draw);
+}
+
+/* mean gpu ms of a frame with the pool kept full */
+internal double run(particle_system *ps, float size, unsigned *alive) {
+  // the dead list is the limit
+  particle_emitter emitter = full_emitter(ps->capacity, size);
+
+  double total = 0.0;
+  particle_stats stats = {0};
+  for (int frame = 0; frame < WARMUP_FRAMES + TIMED_FRAMES; ++frame) {
+    glad_glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    particles_update(ps, &emitter, FRAME_DT, &stats);
+    particles_draw(ps);
+    if (frame >= WARMUP_FRAMES) {
+      total += stats.gpu_ms;
+    }
+  }
+  glad_glFinish();
+  *alive = stats.alive;
+  return total / TIMED_FRAMES;
+}
+
+/* mean cpu ms of a frame of the job system path */
+internal double run_cpu(cpu_particle_system *ps, unsigned *alive) {
+  particle_emitter emitter = full_emitter(ps->count, SPRITE_SIZE);
+
+  double total = 0.0;
+  cpu_particle_stats stats = {0};
+  for (int frame = 0; frame < WARMUP_FRAMES + TIMED_FRAMES; ++frame) {
+    glad_glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    int region = cpu_particles_update(ps, &emitter, FRAME_DT, &stats);
+    cpu_particles_draw(ps, region);
+    glad_glFinish();
+    if (frame >= WARMUP_FRAMES) {
+      total += stats.update_ms;
+    }
+  }
+  *alive = stats.alive;
+  return total / TIMED_FRAMES;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [max particles]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  GLuint max_particles = argc == 2 ? (GLuint)atoi(argv[1]) : MAX_PARTICLES;
+
+  if (not glfwInit()) {
+    fprintf(stderr, "ERROR: glfw init failed\n");
+    return EXIT_FAILURE;
+  }
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  GLFWwindow *window =
+      glfwCreateWindow(WIDTH, HEIGHT, "particlebench", NULL, NULL);
+  if (not window) {
+    fprintf(stderr, "ERROR: could not create a gl 4.4 context\n");
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+  glfwMakeContextCurrent(window);
+  if (not gladLoadGL()) {
+    fprintf(stderr, "ERROR: glad failed to start\n");
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+  printf("RENDERER:: %s\n", glad_glGetString(GL_RENDERER));
+
+  particle_programs programs;
+  GLuint cpu_program = glad_glCreateProgram();
+  if (not create_programs(&programs) or
+      not bench_attach_shader(cpu_program, GL_VERTEX_SHADER,
+                              "particle_cpu.vert") or
+      not bench_attach_shader(cpu_program, GL_FRAGMENT_SHADER,
+                              "particle.frag") or
+      not bench_link_program(cpu_program) or
+      not jobs_init(jobs_cpu_count() - 1)) {
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+
+  // looking at the emitter from 3 units away
+  uniform_buffers uniforms;
+  uniforms_init(&uniforms, 1);
+  float range = 1.0f / tanf(DEG2RAD(67.0f) * 0.5f);
+  float near = 0.1f;
+  float far = 100.0f;
+  mat4 projection = mat4_new(
+      range * HEIGHT / WIDTH, 0.0f, 0.0f, 0.0f, 0.0f, range, 0.0f, 0.0f, 0.0f,
+      0.0f, -(near + far) / (far - near), -1.0f, 0.0f, 0.0f,
+      -(2.0f * far * near) / (far - near), 0.0f);
+  vec3 eye = vec3_new(0.0f, 0.0f, 3.0f);
+  vec3 to_view = vec3_mul(&eye, -1.0f);
+  mat4 view = mat4_identity();
+  view = mat4_translation(&view, &to_view);
+  camera_block camera;
+  camera_block_set(&camera, &view, &projection, &eye);
+  uniforms_upload_camera(&uniforms, &camera);
+  uniforms_bind(&uniforms);
+
+  glstate_enable(GL_DEPTH_TEST);
+  glstate_viewport(0, 0, WIDTH, HEIGHT);
+
+  int status = EXIT_SUCCESS;
+  for (GLuint count = MIN_PARTICLES; count <= max_particles; count *= 4) {
+    particle_system ps;
+    if (not particles_init(&ps, count, &programs)) {
+      status = EXIT_FAILURE;
+      break;
+    }
+    unsigned alive = 0;
+    double simulate_ms = run(&ps, 0.0f, &alive);
+    double draw_ms = run(&ps, SPRITE_SIZE, &alive);
+    printf("PARTICLES:: %7u alive %8.3fms simulate %8.3fms with draw "
+           "%10.0f particles/ms\n",
+           alive, simulate_ms, draw_ms,
+           simulate_ms > 0.0 ? (double)alive / simulate_ms : 0.0);
+    particles_destroy(&ps);
+
+    cpu_particle_system cpu;
+    if (not cpu_particles_init(&cpu, count, CPU_REGIONS, cpu_program)) {
+      status = EXIT_FAILURE;
+      break;
+    }
+    double cpu_ms = run_cpu(&cpu, &alive);
+    printf("PARTICLES:: %7u alive %8.3fms cpu on %d threads %10.0f "
+           "particles/ms\n",
+           alive, cpu_ms, jobs_thread_count(),
+           cpu_ms > 0.0 ? (double)alive / cpu_ms : 0.0);
+    cpu_particles_destroy(&cpu);
+  }
+
+  jobs_shutdown();
+  uniforms_destroy(&uniforms);
+  glad_glDeleteProgram(cpu_program);
+  glad_glDeleteProgram(programs.emit);
+  glad_glDeleteProgram(programs.dispatch);
+  glad_glDeleteProgram(programs.simulate);
+  glad_glDeleteProgram(programs.draw);
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return status;
+}
@@ -0,0 +1,121 @@
+/* *
+ * block compress an image into a .btx texture cache
+ *
+ * usage: texcompress <out.btx> <bc1|bc3|bc7> <image> [levels]
+ *
+ * builds the mip chain, or levels of it, encodes every level and prints
+ * the size against rgba8 and the psnr of the top level. the output is
+ * loaded with texture_request like any other image.
+ * */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/bcn.h"
+#include "src/filemap.h"
+#include "src/jobs.h"
+#include "src/pacer.h"
+#include "src/texcache.h"
+#include "src/utils.h"
+
+/* peak signal to noise of the decoded top level against img, in db */
+internal double level_psnr(const texcache *tc, const image *img) {
+  size_t block_bytes = bc_block_bytes(tc->format);
+  uint32_t blocks_x = (tc->width + 3) / 4;
+  uint32_t blocks_y = (tc->height + 3) / 4;
+  double error = 0.0;
+
+  uint8_t texels[64];
+  for (uint32_t by = 0; by < blocks_y; ++by) {
+    for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+      const uint8_t *block =
+          tc->level_data[0] + ((size_t)by * blocks_x + bx) * block_bytes;
+      if (not bc_decode_block(tc->format, block, texels)) {
+        return 0.0;
+      }
+      for (uint32_t r = 0; r < 4; ++r) {
+        for (uint32_t c = 0; c < 4; ++c) {
+          uint32_t y = by * 4 + r;
+          uint32_t x = bx * 4 + c;
+          if (y >= img->height or x >= img->width) {
+            continue;
+          }
+          // blocks are bottom row first
+          const uint8_t *p =
+              img->pixels + ((size_t)(img->height - 1 - y) * img->width + x) * 4;
+          for (int k = 0; k < 4; ++k) {
+            double d = (double)p[k] - texels[(r * 4 + c) * 4 + k];
+            error += d * d;
+          }
+        }
+      }
+    }
+  }
+
+  double mse = error / ((double)img->width * img->height * 4.0);
+  return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4 or argc > 5) {
+    fprintf(stderr, "usage: %s <out.btx> <bc1|bc3|bc7> <image> [levels]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const char *out = argv[1];
+  bc_format format;
+  if (not bc_format_parse(argv[2], &format)) {
+    fprintf(stderr, "ERROR: unknown format %s\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+  int levels = argc == 5 ? atoi(argv[4]) : 0;
+
+  file_map map;
+  if (not file_map_open(&map, argv[3])) {
+    fprintf(stderr, "ERROR: could not open %s\n", argv[3]);
+    return EXIT_FAILURE;
+  }
+  image img;
+  bool ok = image_decode(&img, map.data, map.size);
+  file_map_close(&map);
+  if (not ok) {
+    fprintf(stderr, "ERROR: could not decode %s\n", argv[3]);
+    return EXIT_FAILURE;
+  }
+
+  // blocks rows encode in parallel
+  if (not jobs_init(jobs_cpu_count() - 1)) {
+    image_destroy(&img);
+    return EXIT_FAILURE;
+  }
+
+  double start = pacer_now_ms();
+  ok = texcache_write(out, &img, format, levels, texcache_key(&img));
+  double encode_ms = pacer_now_ms() - start;
+
+  texcache tc;
+  if (ok and file_map_open(&map, out)) {
+    if (texcache_parse(&tc, map.data, map.size)) {
+      size_t bytes = 0;
+      size_t raw = 0;
+      for (int i = 0; i < tc.levels; ++i) {
+        uint32_t width = img.width >> i ? img.width >> i : 1;
+        uint32_t height = img.height >> i ? img.height >> i : 1;
+        bytes += tc.level_size[i];
+        raw += (size_t)width * height * 4;
+      }
+      printf("BCN:: %s %ux%u %s %d levels %.0fKB from %.0fKB (%.1fx) "
+             "psnr %.2fdb in %.2fms\n",
+             out, tc.width, tc.height, bc_format_name(tc.format), tc.levels,
+             (double)bytes / 1024.0, (double)raw / 1024.0,
+             (double)raw / (double)bytes, level_psnr(&tc, &img), encode_ms);
+    }
+    file_map_close(&map);
+  }
+
+  jobs_shutdown();
+  image_destroy(&img);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}